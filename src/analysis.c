@@ -0,0 +1,336 @@
+/*!
+ * \file analysis.c
+ * \brief
+ * Evaluates boards with the built-in engine in a thread pool, and hands the
+ * scores back to the main loop.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "analysis.h"
+#include "cache.h"
+#include "engine.h"
+#include "protocol.h"
+#include "rules.h"
+
+/*!
+ * \brief
+ * Command line of the engine that searches the positions, which sets the
+ * size of the transposition table that the threads share
+ */
+#define ANALYSIS_ENGINE ENGINE_PREFIX ":hash=64"
+
+/*! \brief Name of the default cache file, in #CACHE_DIR */
+#define ANALYSIS_CACHE_FILE "analysis.cache"
+
+/*! \brief A unit of work for the thread pool: one board */
+typedef struct {
+  /*! \brief The row of the board */
+  gint       row;
+  /*! \brief The value of analysis::generation when the row was queued */
+  gint       generation;
+  /*! \brief The position */
+  position_t position;
+  /*! \brief The key of #position */
+  guint64    key;
+  /*! \brief Whether the game is drawn, as no moves are left */
+  gboolean   is_drawn;
+} job_t;
+
+/*! \brief An evaluation on its way to the main loop */
+typedef struct {
+  /*! \brief The row of the board */
+  gint row;
+  /*! \brief The value of analysis::generation when the row was queued */
+  gint generation;
+  /*! \brief The score from red's point of view */
+  gint score;
+} result_t;
+
+/* documented in analysis.h */
+struct analysis {
+  /*! \brief The depth in plies to search each board to */
+  guint            depth;
+  /*! \brief The engine, whose transposition table the threads share */
+  engine_t        *engine;
+  /*! \brief The worker threads */
+  GThreadPool     *pool;
+  /*! \brief Function that receives the evaluations */
+  analysis_func_t  func;
+  /*! \brief Data to pass to #func */
+  gpointer         user_data;
+  /*! \brief Incremented by analysis_cancel(), so that the results of
+             rows queued before are dropped */
+  volatile gint    generation;
+  /*! \brief Set to nonzero to abandon the searches */
+  volatile gint    is_stopped;
+  /*! \brief The key queued for each row, or zero (main loop only) */
+  GArray          *keys;
+  /*! \brief Protects #cache, #file, #results and #source_results */
+  GMutex           mutex;
+  /*! \brief The cached ::analysis_record_t of each key (in host order) */
+  GHashTable      *cache;
+  /*! \brief The cache file, positioned after its last whole record */
+  FILE            *file;
+  /*! \brief Evaluations that the main loop hasn't seen yet */
+  GQueue          *results;
+  /*! \brief Event source that passes on #results, or zero */
+  guint            source_results;
+};
+
+/*!
+ * \brief
+ * Adds a record of the cache file to analysis::cache, following the
+ * signature of ::cache_record_func_t
+ *
+ * \param[in] record     the ::analysis_record_t as stored
+ * \param[in] user_data  the analysis
+ */
+static void
+read_record(const gconstpointer record, const gpointer user_data)
+{
+  analysis_t * const analysis = user_data;
+  analysis_record_t * const entry = g_slice_new(analysis_record_t);
+
+  memcpy(entry, record, sizeof(*entry));
+  entry->key = GUINT64_FROM_LE(entry->key);
+  entry->score = GINT16_FROM_LE(entry->score);
+  /* the later record of a position replaces the earlier */
+  g_hash_table_replace(analysis->cache, &entry->key, entry);
+}
+
+/*!
+ * \brief
+ * Frees an entry of analysis::cache, following the signature of
+ * \c GDestroyNotify
+ *
+ * \param[in] data  the ::analysis_record_t
+ */
+static void
+free_record(gpointer data)
+{
+  g_slice_free(analysis_record_t, data);
+}
+
+/*!
+ * \brief
+ * Callback that passes the evaluations on from the main loop
+ *
+ * \param[in] data  the analysis
+ *
+ * \return
+ * \c FALSE, to remove the event source
+ */
+static gboolean
+results_callback(gpointer data)
+{
+  analysis_t * const analysis = data;
+  GQueue *results;
+  result_t *result;
+
+  g_mutex_lock(&analysis->mutex);
+  results = analysis->results;
+  analysis->results = g_queue_new();
+  analysis->source_results = 0;
+  g_mutex_unlock(&analysis->mutex);
+
+  while ((result = g_queue_pop_head(results)) != NULL) {
+    if (result->generation == g_atomic_int_get(&analysis->generation)) {
+      analysis->func(result->row, result->score, analysis->user_data);
+    }
+    g_slice_free(result_t, result);
+  }
+  g_queue_free(results);
+  return FALSE;
+}
+
+/*!
+ * \brief
+ * Evaluates the board of a job, following the signature of \c GFunc
+ *
+ * \param[in] data       the ::job_t, which is freed
+ * \param[in] user_data  the analysis
+ */
+static void
+analyse_job(gpointer data, gpointer user_data)
+{
+  job_t * const job = data;
+  analysis_t * const analysis = user_data;
+  const analysis_record_t *cached;
+  result_t *result;
+  gint score = 0;
+  gboolean is_cached;
+
+  if (job->generation != g_atomic_int_get(&analysis->generation)) {
+    /* the list of moves was cleared while the job was queued */
+    g_slice_free(job_t, job);
+    return;
+  }
+
+  g_mutex_lock(&analysis->mutex);
+  cached = g_hash_table_lookup(analysis->cache, &job->key);
+  is_cached = cached != NULL && cached->depth >= analysis->depth;
+  if (is_cached && !job->is_drawn) score = cached->score;
+  g_mutex_unlock(&analysis->mutex);
+
+  /* the same board is a draw once no moves are left, whatever its score */
+  if (!is_cached && !job->is_drawn) {
+    analysis_record_t * const entry = g_slice_new0(analysis_record_t);
+
+    score = engine_score(analysis->engine, &job->position, analysis->depth,
+                         &analysis->is_stopped);
+    if (g_atomic_int_get(&analysis->is_stopped)) {
+      g_slice_free(analysis_record_t, entry);
+      g_slice_free(job_t, job);
+      return;
+    }
+    entry->key = job->key;
+    entry->score = score;
+    entry->depth = analysis->depth;
+
+    g_mutex_lock(&analysis->mutex);
+    if (analysis->file != NULL) {
+      analysis_record_t record = *entry;
+      record.key = GUINT64_TO_LE(entry->key);
+      record.score = GINT16_TO_LE(entry->score);
+      cache_append(analysis->file, &record, sizeof(record));
+    }
+    g_hash_table_replace(analysis->cache, &entry->key, entry);
+    g_mutex_unlock(&analysis->mutex);
+  }
+
+  result = g_slice_new(result_t);
+  result->row = job->row;
+  result->generation = job->generation;
+  result->score = job->position.player == 'r' ? score : -score;
+  g_mutex_lock(&analysis->mutex);
+  g_queue_push_tail(analysis->results, result);
+  if (analysis->source_results == 0) {
+    analysis->source_results = g_idle_add(results_callback, analysis);
+  }
+  g_mutex_unlock(&analysis->mutex);
+  g_slice_free(job_t, job);
+}
+
+/* documented in analysis.h */
+analysis_t *
+analysis_new(guint            depth,
+             const gchar     *path,
+             analysis_func_t  func,
+             gpointer         user_data,
+             GError         **error)
+{
+  extern guint option_jobs;
+  analysis_t *analysis;
+  gchar *default_path = NULL;
+
+  assert(depth > 0);
+  assert(func != NULL);
+  assert(error == NULL || *error == NULL);
+
+  if (path == NULL) {
+    path = default_path = cache_get_path(ANALYSIS_CACHE_FILE);
+  }
+
+  analysis = g_new0(analysis_t, 1);
+  analysis->depth = MIN(depth, G_MAXUINT8);
+  analysis->func = func;
+  analysis->user_data = user_data;
+  analysis->keys = g_array_new(FALSE, TRUE, sizeof(guint64));
+  analysis->cache = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                                          NULL, free_record);
+  analysis->results = g_queue_new();
+  g_mutex_init(&analysis->mutex);
+  if (!cache_open(path, ANALYSIS_MAGIC, ANALYSIS_VERSION,
+                  sizeof(analysis_record_t), "analysis cache", read_record,
+                  analysis, &analysis->file, error)) {
+    g_free(default_path);
+    analysis_free(analysis);
+    return NULL;
+  }
+  g_free(default_path);
+
+  analysis->engine = engine_new(ANALYSIS_ENGINE, NULL, NULL, NULL);
+  assert(analysis->engine != NULL);
+  analysis->pool = g_thread_pool_new(analyse_job, analysis,
+                                     option_jobs > 0 ? (gint)option_jobs : 1,
+                                     TRUE, error);
+  if (analysis->pool == NULL) {
+    analysis_free(analysis);
+    return NULL;
+  }
+  return analysis;
+}
+
+/* documented in analysis.h */
+void
+analysis_request(analysis_t      *analysis,
+                 gint             row,
+                 const message_t *message)
+{
+  job_t *job;
+
+  assert(analysis != NULL);
+  assert(row >= 0);
+  assert(message != NULL);
+
+  /* the result of a game isn't a position to play from */
+  if (message->action <= -2 && message->action >= -4) return;
+
+  job = g_slice_new(job_t);
+  if (!get_position(message, &job->position)) {
+    g_slice_free(job_t, job);
+    return;
+  }
+  job->key = get_position_key(&job->position);
+  if ((guint)row < analysis->keys->len &&
+      g_array_index(analysis->keys, guint64, row) == job->key) {
+    /* more output of the same row */
+    g_slice_free(job_t, job);
+    return;
+  }
+  if ((guint)row >= analysis->keys->len) {
+    g_array_set_size(analysis->keys, row + 1);
+  }
+  g_array_index(analysis->keys, guint64, row) = job->key;
+
+  job->row = row;
+  job->generation = g_atomic_int_get(&analysis->generation);
+  job->is_drawn = message->moves_left == 0;
+  g_thread_pool_push(analysis->pool, job, NULL);
+}
+
+/* documented in analysis.h */
+void
+analysis_cancel(analysis_t *analysis)
+{
+  assert(analysis != NULL);
+
+  g_atomic_int_inc(&analysis->generation);
+  g_array_set_size(analysis->keys, 0);
+}
+
+/* documented in analysis.h */
+void
+analysis_free(analysis_t *analysis)
+{
+  if (analysis == NULL) return;
+
+  /* the queued jobs are abandoned as soon as they start */
+  g_atomic_int_set(&analysis->is_stopped, 1);
+  if (analysis->pool != NULL) g_thread_pool_free(analysis->pool, FALSE, TRUE);
+  if (analysis->source_results != 0) {
+    g_source_remove(analysis->source_results);
+  }
+  while (!g_queue_is_empty(analysis->results)) {
+    g_slice_free(result_t, g_queue_pop_head(analysis->results));
+  }
+  g_queue_free(analysis->results);
+  if (analysis->file != NULL) fclose(analysis->file);
+  engine_free(analysis->engine);
+  g_hash_table_destroy(analysis->cache);
+  g_array_free(analysis->keys, TRUE);
+  g_mutex_clear(&analysis->mutex);
+  g_free(analysis);
+}
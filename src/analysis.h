@@ -0,0 +1,120 @@
+/*!
+ * \file analysis.h
+ * \brief
+ * Provides background analysis of the boards in the list of moves, with the
+ * built-in engine in a pool of worker threads and an evaluation cache that
+ * is kept on disk between runs
+ */
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <gtk/gtk.h>
+#include "cache.h"
+#include "protocol.h"
+
+/*!
+ * \brief
+ * The magic in the ::cache_header_t at the beginning of every analysis cache
+ * file
+ */
+#define ANALYSIS_MAGIC "CKVEVAL"
+
+/*! \brief The version of the file format written by this program */
+#define ANALYSIS_VERSION 1
+
+/*!
+ * \brief
+ * One evaluated position as stored in an analysis cache file, directly
+ * after the header and the records before it
+ *
+ * A position that is evaluated again to a greater depth is appended once
+ * more, and the last record of a position counts.
+ */
+typedef struct {
+  /*! \brief The key of the position, from get_position_key() */
+  guint64 key;
+  /*! \brief The score for the player to move (see #ENGINE_SCORE_WIN) */
+  gint16  score;
+  /*! \brief The depth in plies that the position was searched to */
+  guint8  depth;
+  /*! \brief Reserved for future use (zero) */
+  guint8  reserved[5];
+} analysis_record_t;
+
+/*!
+ * \brief
+ * Function that receives the evaluation of a row, from the main loop
+ *
+ * \param[in] row        the row given to analysis_request()
+ * \param[in] score      the score from red's point of view (see
+ *                       #ENGINE_SCORE_WIN)
+ * \param[in] user_data  the data given to analysis_new()
+ */
+typedef void (*analysis_func_t)(gint row, gint score, gpointer user_data);
+
+/*! \brief Background analysis (private to analysis.c) */
+typedef struct analysis analysis_t;
+
+/*!
+ * \brief
+ * Starts the worker threads and reads the cache
+ *
+ * The number of threads is set by option \c -j, and is one by default, so
+ * that the analysis doesn't compete with the clients for the processors.
+ *
+ * \param[in] depth      the depth in plies to search each board to
+ * \param[in] path       the cache file, which is created if it doesn't
+ *                       exist, or \c NULL for one in the user's cache
+ *                       directory
+ * \param[in] func       the function to pass the evaluations to
+ * \param[in] user_data  data to pass to \p func
+ * \param[in] error      either \c NULL to disregard errors, or the address
+ *                       of a pointer initialized to \c NULL (which should be
+ *                       freed afterwards if set)
+ *
+ * \return
+ * the analysis, or \c NULL if the cache couldn't be opened
+ */
+analysis_t *
+analysis_new(guint            depth,
+             const gchar     *path,
+             analysis_func_t  func,
+             gpointer         user_data,
+             GError         **error);
+
+/*!
+ * \brief
+ * Queues the board of a row to be evaluated
+ *
+ * Returns at once. A row whose board is already queued or evaluated isn't
+ * queued again, and neither are the results of games.
+ *
+ * \param[in] analysis  the analysis
+ * \param[in] row       the row, which is passed back with the evaluation
+ * \param[in] message   the message of the row
+ */
+void
+analysis_request(analysis_t      *analysis,
+                 gint             row,
+                 const message_t *message);
+
+/*!
+ * \brief
+ * Forgets the queued rows, as the list of moves is cleared, so that no more
+ * evaluations are passed on for them
+ *
+ * \param[in] analysis  the analysis
+ */
+void
+analysis_cancel(analysis_t *analysis);
+
+/*!
+ * \brief
+ * Stops the worker threads, writes the cache and frees the analysis
+ *
+ * \param[in] analysis  the analysis (or \c NULL)
+ */
+void
+analysis_free(analysis_t *analysis);
+
+#endif /* ANALYSIS_H */
@@ -9,6 +9,7 @@
 #include "board.h"
 #include "gui.h"
 #include "main.h"
+#include "protocol.h"
 
 /* -- macros for colors */
 /* square and piece color definitions - borrowed from the problem statement */
@@ -33,6 +34,12 @@
 #define MOVE_G     (  0./255.) /*!< \brief Move arrow, green component */
 #define MOVE_B     (255./255.) /*!< \brief Move arrow, blue component */
 
+/* color for the heatmap, drawn over the dark squares */
+#define HEAT_R     (255./255.) /*!< \brief Heatmap, red component */
+#define HEAT_G     (128./255.) /*!< \brief Heatmap, green component */
+#define HEAT_B     (  0./255.) /*!< \brief Heatmap, blue component */
+#define HEAT_ALPHA .8          /*!< \brief Heatmap, opacity at the most */
+
 /* color for piece border (including the empty circle for removed pieces) */
 #define BORDER_R   (  0./255.) /*!< \brief Piece border, red component */
 #define BORDER_G   (  0./255.) /*!< \brief Piece border, green component */
@@ -52,34 +59,6 @@
 #define PIECE_RADIUS           .3  /*!< \brief Piece circle radius */
 #define KING_MARK_RADIUS       .15 /*!< \brief King mark size */
 
-/* -- macros to get the row and column for a dark square in the range 0..31 */
-/*!
- * \brief
- * Gets the board row from a dark square index
- */
-#define BOARD_ROW(i) ((i)/4)
-/*!
- * \brief
- * Gets the board column from a dark square index
- *
- * Use the three least significant bits, rotate them to the left and flip the
- * least significant bit, so that \f$[b_4, b_3, b_2, b_1, b_0]\f$ becomes
- * \f$[0, 0, b_1, b_0, !b_2]\f$, or in other words
- * (given that rows and columns are both in the range `0..7`) map
- *
- * From (square id) | To (column id) | Row  | Column
- * ---------------- | -------------- | ---: | ------
- * xx000            | 00001          | even | 1
- * xx001            | 00011          | even | 3
- * xx010            | 00101          | even | 5
- * xx011            | 00111          | even | 7
- * xx100            | 00000          |  odd | 0
- * xx101            | 00010          |  odd | 2
- * xx110            | 00100          |  odd | 4
- * xx111            | 00110          |  odd | 6
- */
-#define BOARD_COL(i) ((((i)&3)<<1) | (((i)&4)==0))
-
 /* -- macros meant to make the code easier to read */
 /*!
  * \brief
@@ -195,11 +174,12 @@ draw_moves(cairo_t * const cr, const GSList * const moves)
 
 /* documented in board.h */
 void
-draw_board(cairo_t      * const cr,
-           const int            width_px,
-           const int            height_px,
-           const gchar  * const board,
-           const GSList * const moves)
+draw_board(cairo_t       * const cr,
+           const int             width_px,
+           const int             height_px,
+           const gchar   * const board,
+           const GSList  * const moves,
+           const gdouble * const shades)
 {
   assert(cr != NULL);
   assert(board == NULL ||
@@ -220,6 +200,13 @@ draw_board(cairo_t      * const cr,
   cairo_set_source_rgb(cr, DARK_SQ_R, DARK_SQ_G, DARK_SQ_B);
   cairo_fill(cr);
 
+  /* draw the heatmap over the dark squares */
+  for (guint8 i=0; shades != NULL && i<NUM_DARK_SQ; ++i) {
+    cairo_rectangle(cr, BOARD_COL(i), BOARD_ROW(i), 1., 1.);
+    cairo_set_source_rgba(cr, HEAT_R, HEAT_G, HEAT_B, HEAT_ALPHA*shades[i]);
+    cairo_fill(cr);
+  }
+
   /* draw square numbers */
   cairo_set_font_size(cr, SQUARE_NUMBER_FONTSIZE);
   cairo_set_source_rgb(cr, LIGHT_SQ_R, LIGHT_SQ_G, LIGHT_SQ_B);
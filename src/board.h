@@ -32,12 +32,15 @@
  * \endparblock
  * \param[in] moves     a singly-linked list with a sequence of moves between
  *                      the dark squares (range `0..31`) in order (or \c NULL)
+ * \param[in] shades    how strongly to tint each dark square as a heatmap,
+ *                      from `0` to `1` (or \c NULL for no heatmap)
  */
 void
-draw_board(cairo_t      *cr,
-           int           width_px,
-           int           height_px,
-           const gchar  *board,
-           const GSList *moves);
+draw_board(cairo_t       *cr,
+           int            width_px,
+           int            height_px,
+           const gchar   *board,
+           const GSList  *moves,
+           const gdouble *shades);
 
 #endif /* BOARD_H */
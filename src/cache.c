@@ -0,0 +1,194 @@
+/*!
+ * \file cache.c
+ * \brief
+ * Finds the files of the user's cache directory, and reads, creates and
+ * appends to cache files of fixed-size records.
+ */
+/*! \cond */
+#define _POSIX_C_SOURCE 200112L
+/*! \endcond */
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "cache.h"
+
+/* documented in cache.h */
+gchar *
+cache_get_path(const gchar *name)
+{
+  gchar *dir;
+  gchar *path;
+
+  assert(name != NULL);
+
+  dir = g_build_filename(g_get_user_cache_dir(), CACHE_DIR, NULL);
+  g_mkdir_with_parents(dir, 0755);
+  path = g_build_filename(dir, name, NULL);
+  g_free(dir);
+  return path;
+}
+
+/*!
+ * \brief
+ * Gets the offset after the last whole record of a cache file, at which the
+ * next record is written over any partial record left by a crash
+ *
+ * \param[in] file         the cache file
+ * \param[in] record_size  the size of each record
+ *
+ * \return
+ * the offset
+ */
+static glong
+get_append_offset(FILE * const file, const gsize record_size)
+{
+  glong end;
+
+  fseek(file, 0, SEEK_END);
+  end = ftell(file);
+  if (end < (glong)sizeof(cache_header_t)) return sizeof(cache_header_t);
+  return sizeof(cache_header_t) +
+         (end - sizeof(cache_header_t)) / record_size * record_size;
+}
+
+/*!
+ * \brief
+ * Writes a new header over a cache file, dropping its records
+ *
+ * \param[in] file         the cache file
+ * \param[in] magic        the magic of the kind of cache
+ * \param[in] version      the version of the file format
+ * \param[in] record_size  the size of each record
+ */
+static void
+write_header(FILE * const        file,
+             const gchar * const magic,
+             const guint32       version,
+             const gsize         record_size)
+{
+  cache_header_t header;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, magic, strlen(magic) + 1);
+  header.version = GUINT32_TO_LE(version);
+  header.record_size = GUINT32_TO_LE(record_size);
+  if (ftruncate(fileno(file), 0) == 0) {
+    rewind(file);
+    fwrite(&header, sizeof(header), 1, file);
+    fflush(file);
+  }
+}
+
+/* documented in cache.h */
+gboolean
+cache_open(const gchar          *path,
+           const gchar          *magic,
+           guint32               version,
+           gsize                 record_size,
+           const gchar          *description,
+           cache_record_func_t   func,
+           gpointer              user_data,
+           FILE                **file,
+           GError              **error)
+{
+  cache_header_t header;
+  gpointer record;
+  guint32 file_version;
+  guint32 file_record_size;
+  glong offset;
+  FILE *handle;
+  int fd;
+
+  assert(path != NULL);
+  assert(magic != NULL);
+  assert(strlen(magic) < sizeof(header.magic));
+  assert(record_size > 0);
+  assert(func != NULL);
+  assert(file != NULL);
+  assert(error == NULL || *error == NULL);
+
+  *file = NULL;
+  /* the file is never truncated by opening it, since other processes may
+     be writing to it */
+  fd = g_open(path, O_RDWR | O_CREAT, 0644);
+  handle = fd >= 0 ? fdopen(fd, "r+b") : NULL;
+  if (handle == NULL) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't open the %s \"%s\"", description, path);
+    if (fd >= 0) close(fd);
+    return FALSE;
+  }
+  flock(fd, LOCK_EX);
+
+  fseek(handle, 0, SEEK_END);
+  if (ftell(handle) == 0) {
+    /* a new file */
+    write_header(handle, magic, version, record_size);
+    flock(fd, LOCK_UN);
+    *file = handle;
+    return TRUE;
+  }
+  rewind(handle);
+  if (fread(&header, sizeof(header), 1, handle) != 1) {
+    memset(&header, 0, sizeof(header));
+  }
+  file_version = GUINT32_FROM_LE(header.version);
+  file_record_size = GUINT32_FROM_LE(header.record_size);
+  if (memcmp(header.magic, magic, strlen(magic) + 1) != 0) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "\"%s\" isn't a valid %s", path, description);
+    fclose(handle);
+    return FALSE;
+  }
+  if (file_version > version) {
+    /* the records of a newer format can't be read, nor written over */
+    fclose(handle);
+    return TRUE;
+  }
+  if (file_version < version || file_record_size < record_size) {
+    /* the records of an older format are dropped */
+    write_header(handle, magic, version, record_size);
+    flock(fd, LOCK_UN);
+    *file = handle;
+    return TRUE;
+  }
+
+  record = g_malloc(record_size);
+  offset = sizeof(header);
+  while (fseek(handle, offset, SEEK_SET) == 0 &&
+         fread(record, record_size, 1, handle) == 1) {
+    func(record, user_data);
+    offset += file_record_size;
+  }
+  g_free(record);
+  /* a file whose records were extended by a newer version is only read */
+  if (file_record_size != record_size) {
+    fclose(handle);
+    return TRUE;
+  }
+  flock(fd, LOCK_UN);
+  *file = handle;
+  return TRUE;
+}
+
+/* documented in cache.h */
+void
+cache_append(FILE *file, gconstpointer record, gsize record_size)
+{
+  assert(file != NULL);
+  assert(record != NULL);
+  assert(record_size > 0);
+
+  /* other processes append to the same file, so the end is found again
+     under the lock */
+  flock(fileno(file), LOCK_EX);
+  fseek(file, get_append_offset(file, record_size), SEEK_SET);
+  fwrite(record, record_size, 1, file);
+  fflush(file);
+  flock(fileno(file), LOCK_UN);
+}
@@ -0,0 +1,110 @@
+/*!
+ * \file cache.h
+ * \brief
+ * Provides the files that are kept in the user's cache directory between
+ * runs, and the reading of cache files that hold records of a fixed size
+ * after a header
+ */
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <gtk/gtk.h>
+
+/*! \brief Directory of the cache files, in the user's cache directory */
+#define CACHE_DIR "checkers-visualizer"
+
+/*!
+ * \brief
+ * Header at the beginning of a cache file (all integers little-endian),
+ * which is followed directly by the records
+ */
+typedef struct {
+  /*! \brief The magic of the kind of cache, including the terminating
+             zero */
+  gchar   magic[8];
+  /*! \brief The version of the file format of the writer */
+  guint32 version;
+  /*! \brief Size of each record, allowing records to grow */
+  guint32 record_size;
+} cache_header_t;
+
+/*!
+ * \brief
+ * Function that receives each record of a cache file, in the order of the
+ * file
+ *
+ * \param[in] record     the record as stored (little-endian), of the size
+ *                       given to cache_open()
+ * \param[in] user_data  the data given to cache_open()
+ */
+typedef void (*cache_record_func_t)(gconstpointer record,
+                                    gpointer      user_data);
+
+/*!
+ * \brief
+ * Gets the name of a file in #CACHE_DIR, creating the directory if needed
+ *
+ * \param[in] name  the name of the file
+ *
+ * \return
+ * the absolute name, which should be freed
+ */
+gchar *
+cache_get_path(const gchar *name);
+
+/*!
+ * \brief
+ * Opens a cache file, creating it with a header if it doesn't exist, and
+ * reads its records
+ *
+ * The file is locked while it's read, so that records that other processes
+ * append with cache_append() are read whole. The records of an older
+ * version are dropped, and the file is started over. A file of a newer
+ * version is neither read nor written, and one whose records are larger,
+ * as written by a newer version of the same format, is only read.
+ *
+ * \param[in]  path         the file name
+ * \param[in]  magic        the magic of the kind of cache
+ * \param[in]  version      the version of the file format
+ * \param[in]  record_size  the size of each record
+ * \param[in]  description  the kind of cache for the error messages, such as
+ *                          "analysis cache"
+ * \param[in]  func         the function that receives each record
+ * \param[in]  user_data    data to pass to \p func
+ * \param[out] file         the file to pass to cache_append(), or \c NULL
+ *                          if it's only read
+ * \param[in]  error        either \c NULL to disregard errors, or the
+ *                          address of a pointer initialized to \c NULL
+ *                          (which should be freed afterwards if set)
+ *
+ * \return
+ * whether the file was opened and is a cache of the kind
+ */
+gboolean
+cache_open(const gchar          *path,
+           const gchar          *magic,
+           guint32               version,
+           gsize                 record_size,
+           const gchar          *description,
+           cache_record_func_t   func,
+           gpointer              user_data,
+           FILE                **file,
+           GError              **error);
+
+/*!
+ * \brief
+ * Appends a record to a cache file, writing over a partial record left by a
+ * crash
+ *
+ * The file is locked while the record is written, so that processes that
+ * share the file don't write over each other's records.
+ *
+ * \param[in] file         the file opened by cache_open()
+ * \param[in] record       the record as stored (little-endian)
+ * \param[in] record_size  the size of the record, as given to cache_open()
+ */
+void
+cache_append(FILE *file, gconstpointer record, gsize record_size);
+
+#endif /* CACHE_H */
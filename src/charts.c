@@ -0,0 +1,274 @@
+/*!
+ * \file charts.c
+ * \brief
+ * Keeps the think time, output volume and moves left of each row, and draws
+ * them as charts of bars through plot.c.
+ */
+#include <assert.h>
+#include <gtk/gtk.h>
+#include "charts.h"
+#include "gui.h"
+#include "plot.h"
+#include "protocol.h"
+
+/* -- macros for various sizes */
+/*! \brief Number of charts, stacked from top to bottom */
+#define N_CHARTS 3
+/*! \brief Space around and between the charts in pixels */
+#define MARGIN_PX 4.
+/*!
+ * \brief
+ * Width of a row in pixels while few enough rows have been added
+ *
+ * Once the rows don't fit, the width is halved until they do.
+ */
+#define MAX_ROW_WIDTH_PX 8.
+/*! \brief Smallest full scale of the think time chart in microseconds */
+#define MIN_THINK_SCALE_US 1000
+/*! \brief Smallest full scale of the output volume chart in bytes */
+#define MIN_LEN_SCALE 100
+
+/*! \brief The values plotted for a row */
+typedef struct {
+  /*! \brief The client that the row belongs to */
+  guint8 client_id;
+  /*! \brief Time in microseconds that the client took to reply, or -1 */
+  gint64 think_us;
+  /*! \brief Number of bytes of output on stdout and stderr */
+  gsize  len;
+  /*! \brief Number of moves left before the game is drawn, or -1 */
+  gint   moves_left;
+} chart_row_t;
+
+/*! \brief The charts of a game */
+struct charts {
+  /*! \brief Array of ::chart_row_t, one per row */
+  GArray *rows;
+  /*! \brief Full scale of the think time chart in microseconds */
+  gint64  think_scale_us;
+  /*! \brief Full scale of the output volume chart in bytes */
+  gint64  len_scale;
+  /*! \brief The drawing state */
+  plot_t  plot;
+};
+
+/*!
+ * \brief
+ * Rounds a value up to the next full scale in a 1, 2, 5, 10, 20... sequence
+ *
+ * \param[in] value    the value to fit in the scale
+ * \param[in] minimum  the smallest scale, which starts the sequence
+ *
+ * \return
+ * the scale
+ */
+static gint64
+round_up_scale(const gint64 value, gint64 minimum)
+{
+  for (;;) {
+    if (value <=   minimum) return minimum;
+    if (value <= 2*minimum) return 2*minimum;
+    if (value <= 5*minimum) return 5*minimum;
+    minimum *= 10;
+  }
+}
+
+/* documented in charts.h */
+charts_t *
+charts_new(void)
+{
+  charts_t *charts;
+
+  charts = g_slice_new(charts_t);
+  charts->rows = g_array_new(FALSE, FALSE, sizeof(chart_row_t));
+  plot_init(&charts->plot, MARGIN_PX, MAX_ROW_WIDTH_PX);
+  charts_clear(charts);
+  return charts;
+}
+
+/* documented in charts.h */
+void
+charts_clear(charts_t *charts)
+{
+  assert(charts != NULL);
+
+  g_array_set_size(charts->rows, 0);
+  charts->think_scale_us = MIN_THINK_SCALE_US;
+  charts->len_scale = MIN_LEN_SCALE;
+  plot_clear(&charts->plot);
+}
+
+/* documented in charts.h */
+void
+charts_update(charts_t *charts,
+              guint     row,
+              guint8    client_id,
+              gsize     len,
+              gint64    think_us,
+              gint      moves_left)
+{
+  chart_row_t *chart_row;
+
+  assert(charts != NULL);
+  assert(row <= charts->rows->len);
+
+  if (row == charts->rows->len) {
+    const chart_row_t empty = { client_id, -1, 0, -1 };
+    g_array_append_val(charts->rows, empty);
+  }
+  chart_row = &g_array_index(charts->rows, chart_row_t, row);
+  chart_row->client_id = client_id;
+  chart_row->think_us = think_us;
+  chart_row->len += len;
+  chart_row->moves_left = moves_left;
+  plot_invalidate(&charts->plot, row);
+
+  /* a larger scale makes every row drawn so far obsolete */
+  if (think_us > charts->think_scale_us) {
+    charts->think_scale_us = round_up_scale(think_us, MIN_THINK_SCALE_US);
+    plot_invalidate(&charts->plot, 0);
+  }
+  if ((gint64)chart_row->len > charts->len_scale) {
+    charts->len_scale = round_up_scale(chart_row->len, MIN_LEN_SCALE);
+    plot_invalidate(&charts->plot, 0);
+  }
+}
+
+/* documented in charts.h */
+void
+charts_select(charts_t *charts, gint row)
+{
+  assert(charts != NULL);
+
+  charts->plot.selected = row;
+}
+
+/*!
+ * \brief
+ * Gets a value of a row relative to the full scale of its chart
+ *
+ * \param[in] charts     the charts
+ * \param[in] chart_row  the row
+ * \param[in] chart      the chart, counted from the top
+ *
+ * \return
+ * the value in the range \c 0..1, or a negative value if unknown
+ */
+static gdouble
+get_fraction(const charts_t    * const charts,
+             const chart_row_t * const chart_row,
+             const guint8              chart)
+{
+  switch (chart) {
+  case 0:
+    return (gdouble)chart_row->think_us / charts->think_scale_us;
+  case 1:
+    return (gdouble)chart_row->len / charts->len_scale;
+  default:
+    return (gdouble)chart_row->moves_left / MOVES_LEFT;
+  }
+}
+
+/*!
+ * \brief
+ * Draws the rows from a given row onwards, following the signature of
+ * ::plot_rows_func_t
+ *
+ * \param[in] cr         the Cairo context of the cache
+ * \param[in] first      the number of the first row to draw
+ * \param[in] user_data  the charts
+ */
+static void
+draw_rows(cairo_t * const cr, const guint first, const gpointer user_data)
+{
+  const charts_t * const charts = user_data;
+  const gdouble chart_height = plot_get_part_height(&charts->plot,
+                                                    N_CHARTS);
+  const gdouble row_width = charts->plot.row_width_px;
+  const gdouble bar_width = row_width > 2. ? row_width - 1. : row_width;
+
+  /* one path per client, to change the source as rarely as possible */
+  for (guint8 client_id = 0; client_id < NUM_CLIENTS; ++client_id) {
+    for (guint8 chart = 0; chart < N_CHARTS; ++chart) {
+      const gdouble bottom = (chart + 1)*(MARGIN_PX + chart_height);
+      for (guint i = first; i < charts->rows->len; ++i) {
+        const chart_row_t * const chart_row =
+          &g_array_index(charts->rows, chart_row_t, i);
+        const gdouble fraction = get_fraction(charts, chart_row, chart);
+        if (chart_row->client_id != client_id || fraction < 0.) continue;
+        cairo_rectangle(cr, plot_get_row_x(&charts->plot, i),
+                        bottom - fraction*chart_height,
+                        bar_width, fraction*chart_height);
+      }
+    }
+    /* the first player plays white */
+    plot_set_player_source(cr, client_id == 0 ? 'w' : 'r');
+    cairo_fill(cr);
+  }
+}
+
+/*!
+ * \brief
+ * Draws the axes and labels, following the signature of
+ * ::plot_labels_func_t
+ *
+ * \param[in] cr         the Cairo context to draw on
+ * \param[in] user_data  the charts
+ */
+static void
+draw_labels(cairo_t * const cr, const gpointer user_data)
+{
+  const charts_t * const charts = user_data;
+  const gdouble chart_height = plot_get_part_height(&charts->plot,
+                                                    N_CHARTS);
+  gchar *labels[N_CHARTS];
+
+  if (charts->think_scale_us >= 1000000) {
+    labels[0] = g_strdup_printf("Think time (%" G_GINT64_FORMAT " s)",
+                                charts->think_scale_us/1000000);
+  } else {
+    labels[0] = g_strdup_printf("Think time (%" G_GINT64_FORMAT " ms)",
+                                charts->think_scale_us/1000);
+  }
+  labels[1] = g_strdup_printf("Output (%" G_GINT64_FORMAT " bytes)",
+                              charts->len_scale);
+  labels[2] = g_strdup_printf("Moves left (%d)", MOVES_LEFT);
+
+  for (guint8 chart = 0; chart < N_CHARTS; ++chart) {
+    const gdouble top = MARGIN_PX + chart*(MARGIN_PX + chart_height);
+    plot_draw_axis(&charts->plot, cr, top + chart_height, MARGIN_PX, top,
+                   labels[chart]);
+    g_free(labels[chart]);
+  }
+}
+
+/* documented in charts.h */
+void
+charts_draw(charts_t *charts, cairo_t *cr, int width_px, int height_px)
+{
+  assert(charts != NULL);
+  assert(cr != NULL);
+
+  plot_draw(&charts->plot, cr, width_px, height_px, charts->rows->len,
+            draw_rows, draw_labels, charts);
+}
+
+/* documented in charts.h */
+gint
+charts_get_row_at(const charts_t *charts, gdouble x)
+{
+  assert(charts != NULL);
+
+  return plot_get_row_at(&charts->plot, x, charts->rows->len);
+}
+
+/* documented in charts.h */
+void
+charts_free(charts_t *charts)
+{
+  assert(charts != NULL);
+
+  plot_finish(&charts->plot);
+  g_array_free(charts->rows, TRUE);
+  g_slice_free(charts_t, charts);
+}
@@ -0,0 +1,103 @@
+/*!
+ * \file charts.h
+ * \brief
+ * Provides charts of the think time, output volume and moves left of each
+ * row, which are drawn incrementally as rows are added
+ */
+#ifndef CHARTS_H
+#define CHARTS_H
+
+#include <gtk/gtk.h>
+
+/*! \brief The charts of a game (private to charts.c) */
+typedef struct charts charts_t;
+
+/*!
+ * \brief
+ * Creates empty charts
+ *
+ * \return
+ * the charts, to be freed with charts_free()
+ */
+charts_t *
+charts_new(void);
+
+/*!
+ * \brief
+ * Removes every row from the charts
+ *
+ * \param[in] charts  the charts
+ */
+void
+charts_clear(charts_t *charts);
+
+/*!
+ * \brief
+ * Updates a row, or adds it if it's the row after the last one
+ *
+ * Only the updated row is redrawn by the next call to charts_draw(), unless
+ * the row no longer fits in the current scale.
+ *
+ * \param[in] charts      the charts
+ * \param[in] row         the number of the row, which must not be greater
+ *                        than the number of rows
+ * \param[in] client_id   the client that the row belongs to
+ * \param[in] len         the number of bytes of output to add to the row
+ * \param[in] think_us    the time in microseconds that the client took to
+ *                        reply, or -1 if unknown
+ * \param[in] moves_left  the number of moves left before the game is drawn,
+ *                        or -1 if unknown
+ */
+void
+charts_update(charts_t *charts,
+              guint     row,
+              guint8    client_id,
+              gsize     len,
+              gint64    think_us,
+              gint      moves_left);
+
+/*!
+ * \brief
+ * Marks a row as selected
+ *
+ * \param[in] charts  the charts
+ * \param[in] row     the number of the row, or -1 to select none
+ */
+void
+charts_select(charts_t *charts, gint row);
+
+/*!
+ * \brief
+ * Draws the charts, reusing what was drawn previously at the same size
+ *
+ * \param[in] charts     the charts
+ * \param[in] cr         the Cairo context to draw on
+ * \param[in] width_px   the width of the widget in pixels
+ * \param[in] height_px  the height of the widget in pixels
+ */
+void
+charts_draw(charts_t *charts, cairo_t *cr, int width_px, int height_px);
+
+/*!
+ * \brief
+ * Finds the row drawn at a horizontal position
+ *
+ * \param[in] charts  the charts
+ * \param[in] x       the position in pixels, as in the last charts_draw()
+ *
+ * \return
+ * the number of the row, or -1 if there is no row at \p x
+ */
+gint
+charts_get_row_at(const charts_t *charts, gdouble x);
+
+/*!
+ * \brief
+ * Frees the charts
+ *
+ * \param[in] charts  the charts
+ */
+void
+charts_free(charts_t *charts);
+
+#endif /* CHARTS_H */
@@ -6,24 +6,743 @@
  */
 /*! \cond */
 #define _POSIX_C_SOURCE 1
+#define _DEFAULT_SOURCE
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
 /*! \endcond */
 #include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 #include <signal.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/timerfd.h>
+#endif
 #include <gtk/gtk.h>
 #include "clients.h"
 #include "main.h"
+#include "engine.h"
 #include "gui.h"
+#include "protocol.h"
+#include "ring.h"
 
 /*! \brief Size of the buffer when reading from the client */
 #define BUFFER_SIZE (64<<10)
 
+/*!
+ * \brief
+ * Interval between samples of the clients' resource usage, which is also how
+ * often the clients are checked for having exited
+ */
+#define SAMPLE_INTERVAL_MS 50
+
 /*! \brief Standard input channels for each of the clients */
 static GIOChannel *channel_stdin[NUM_CLIENTS];
 
 /*! \brief Information about the child processes */
 static client_t clients[NUM_CLIENTS];
 
+/*!
+ * \brief
+ * Monotonic time (in microseconds) when each client was last sent a message,
+ * or was launched
+ *
+ * Reset to zero when the client's reply begins to arrive, so that only the
+ * first output of each reply is timed.
+ */
+static gint64 waiting_since_us[NUM_CLIENTS];
+
+/*!
+ * \brief
+ * CPU time (in microseconds) that each client had used when it was last sent
+ * a message, or -1 if unknown
+ */
+static gint64 cpu_since_us[NUM_CLIENTS];
+
+/*! \brief Event source for sampling the clients, or zero */
+static guint source_sample = 0;
+
+/*!
+ * \brief
+ * The message most recently handed to each client, as far as it has been
+ * passed on
+ */
+static GString *messages_sent[NUM_CLIENTS];
+
+/*!
+ * \brief
+ * Monotonic time (in microseconds) when each client was handed the message
+ * that it's expected to reply to, or zero if it isn't its turn
+ */
+static gint64 turn_since_us[NUM_CLIENTS];
+
+/*!
+ * \brief
+ * Indicates whether each client is expected to write a message, from the
+ * start of its turn (or of the game) until a whole line of it is passed on
+ *
+ * Only such a line starts the opponent's turn, so that stray output of the
+ * other client leaves the opponent's clock alone.
+ */
+static gboolean is_to_move[NUM_CLIENTS];
+
+/*!
+ * \brief
+ * Time (in microseconds) that each client has spent thinking on its finished
+ * moves of the game
+ */
+static gint64 clock_used_us[NUM_CLIENTS];
+
+/*!
+ * \brief
+ * Indicates whether a client has forfeited, after which nothing more is
+ * passed on
+ */
+static gboolean is_game_over = FALSE;
+
+#ifdef __linux__
+/*! \brief Timer file descriptor for each client's deadline, or -1 */
+static gint timer_fds[NUM_CLIENTS] = { -1, -1 };
+#else
+/*! \brief Event source for each client's deadline, or zero */
+static guint source_deadlines[NUM_CLIENTS];
+#endif
+
+#ifdef __linux__
+/*! \brief The CPUs that each client is pinned to (if #is_pinned) */
+static cpu_set_t client_cpus[NUM_CLIENTS];
+#endif
+/*! \brief Indicates whether each client is pinned to a set of CPUs */
+static gboolean is_pinned[NUM_CLIENTS];
+
+/*!
+ * \brief
+ * Pseudo-terminal slave for each channel while its client is being spawned,
+ * or -1 if the channel is a pipe
+ */
+static gint pty_slave_fds[NUM_CHANNELS] = { -1, -1, -1, -1 };
+
+/*! \brief Indicates whether each channel is read from a pseudo-terminal */
+static gboolean is_pty[NUM_CHANNELS];
+
+/*!
+ * \brief
+ * Shared-memory transport of each client that uses one instead of its stdin
+ * and stdout, or \c NULL
+ */
+static ring_t *rings[NUM_CLIENTS];
+
+/*! \brief Event source for each client's ring, or zero */
+static guint source_rings[NUM_CLIENTS];
+
+/*!
+ * \brief
+ * Output for each client that didn't fit in its ring yet, which is retried
+ * whenever the clients are sampled
+ */
+static GString *ring_pending[NUM_CLIENTS];
+
+/*!
+ * \brief
+ * The built-in engine of each client that is one, until it has finished, or
+ * \c NULL
+ */
+static engine_t *engines[NUM_CLIENTS];
+
+static void
+check_deadline(guint8 client_id);
+
+static void
+deliver_pending(guint8 client_id);
+
+static void
+drain_ring(guint8 client_id);
+
+static void
+stop_engine(guint8 client_id);
+
+/* documented in clients.h */
+const gchar *
+get_forfeit_description(forfeit_t forfeit)
+{
+  static const gchar * const descriptions[N_FORFEITS] = {
+    "didn't forfeit",
+    "exceeded the time limit for a move",
+    "exceeded the time limit for the game",
+    "exited unsuccessfully, likely at the memory limit",
+    "exceeded the CPU time limit",
+    "exited unsuccessfully, likely at the open file limit",
+    "exited unsuccessfully under the resource limits"
+  };
+
+  assert(forfeit < N_FORFEITS);
+
+  return descriptions[forfeit];
+}
+
+/*!
+ * \brief
+ * Gets how long a client may think about its current move
+ *
+ * \param[in]  client_id  the client
+ * \param[out] forfeit    the reason to forfeit once the time is up
+ *
+ * \return
+ * the time in microseconds from when the message was handed over, or -1 if
+ * the time is unlimited
+ */
+static gint64
+get_time_limit_us(const guint8 client_id, forfeit_t * const forfeit)
+{
+  extern guint option_move_time_ms;
+  extern guint option_game_time_ms;
+  gint64 limit_us = -1;
+
+  if (option_move_time_ms > 0) {
+    limit_us = option_move_time_ms * (gint64)1000;
+    *forfeit = FORFEIT_MOVE_TIME;
+  }
+  if (option_game_time_ms > 0) {
+    const gint64 left_us =
+      option_game_time_ms * (gint64)1000 - clock_used_us[client_id];
+    if (limit_us < 0 || left_us < limit_us) {
+      limit_us = MAX(left_us, 0);
+      *forfeit = FORFEIT_GAME_TIME;
+    }
+  }
+  return limit_us;
+}
+
+#ifdef __linux__
+/*!
+ * \brief
+ * Callback for when a client's deadline timer has expired
+ *
+ * \param[in] source     the channel of the timer file descriptor
+ * \param[in] condition  not used
+ * \param[in] data       the client ID, converted to a \c gpointer using
+ *                       \c GUINT_TO_POINTER()
+ *
+ * \return
+ * \c TRUE (to keep the source)
+ */
+static gboolean
+timer_callback(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+  guint64 expirations;
+
+  UNUSED(condition);
+
+  /* reading the number of expirations rearms the readiness */
+  if (read(g_io_channel_unix_get_fd(source), &expirations,
+           sizeof(expirations)) == sizeof(expirations)) {
+    check_deadline(GPOINTER_TO_UINT(data));
+  }
+  return TRUE;
+}
+#else
+/*!
+ * \brief
+ * Callback for when a client's deadline has passed
+ *
+ * \param[in] data  the client ID, converted to a \c gpointer using
+ *                  \c GUINT_TO_POINTER()
+ *
+ * \return
+ * \c FALSE (to remove the source)
+ */
+static gboolean
+deadline_callback(gpointer data)
+{
+  source_deadlines[GPOINTER_TO_UINT(data)] = 0;
+  check_deadline(GPOINTER_TO_UINT(data));
+  return FALSE;
+}
+#endif
+
+/*!
+ * \brief
+ * Arms or disarms a client's deadline
+ *
+ * A timer file descriptor wakes the main loop with microsecond precision
+ * where available, and a timeout source is used elsewhere.
+ *
+ * \param[in] client_id   the client
+ * \param[in] timeout_us  the time from now in microseconds, or -1 to disarm
+ */
+static void
+set_deadline(const guint8 client_id, const gint64 timeout_us)
+{
+#ifdef __linux__
+  struct itimerspec spec = { { 0, 0 }, { 0, 0 } };
+
+  if (timer_fds[client_id] < 0) return;
+  if (timeout_us >= 0) {
+    /* a zero value would disarm the timer */
+    const gint64 value_us = MAX(timeout_us, 1);
+    spec.it_value.tv_sec = value_us / G_USEC_PER_SEC;
+    spec.it_value.tv_nsec = value_us % G_USEC_PER_SEC * 1000;
+  }
+  timerfd_settime(timer_fds[client_id], 0, &spec, NULL);
+#else
+  if (source_deadlines[client_id] > 0) {
+    g_source_remove(source_deadlines[client_id]);
+    source_deadlines[client_id] = 0;
+  }
+  if (timeout_us >= 0) {
+    source_deadlines[client_id] =
+      g_timeout_add((timeout_us + 999) / 1000,
+                    (GSourceFunc)deadline_callback,
+                    GUINT_TO_POINTER(client_id));
+  }
+#endif
+}
+
+/*!
+ * \brief
+ * Starts a client's turn once a message has been handed to it, arming its
+ * deadline unless the message ends the game
+ *
+ * \param[in] client_id  the client
+ */
+static void
+start_turn(const guint8 client_id)
+{
+  forfeit_t forfeit = FORFEIT_NONE;
+  message_t message;
+
+  if (parse_message(messages_sent[client_id]->str, &message) &&
+      message.action <= -2 && message.action >= -4) {
+    /* nobody replies to a result */
+    turn_since_us[client_id] = 0;
+    is_to_move[client_id] = FALSE;
+    set_deadline(client_id, -1);
+    return;
+  }
+  turn_since_us[client_id] = g_get_monotonic_time();
+  is_to_move[client_id] = TRUE;
+  set_deadline(client_id, get_time_limit_us(client_id, &forfeit));
+}
+
+/*!
+ * \brief
+ * Makes a client forfeit the game, which is recorded as a win for the
+ * opponent and ends both clients
+ *
+ * The reason is written as if the client wrote it to stderr, followed by a
+ * result message as if it wrote that to stdout, so that the forfeit is kept
+ * in sessions, transcripts and exports just like any other result.
+ *
+ * \param[in] client_id  the client
+ * \param[in] forfeit    the reason
+ * \param[in] think_us   the time that the client spent on the move, or -1 if
+ *                       it wasn't thinking
+ */
+static void
+forfeit_game(const guint8    client_id,
+             const forfeit_t forfeit,
+             const gint64    think_us)
+{
+  client_t * const client = &clients[client_id];
+  const reply_stats_t stats = { think_us, -1, -1 };
+  message_t message;
+  gchar *text;
+
+  is_game_over = TRUE;
+  client->forfeit = forfeit;
+  turn_since_us[client_id] = 0;
+  if (think_us >= 0) {
+    clock_used_us[client_id] += think_us;
+    client->clock_us = clock_used_us[client_id];
+  }
+  for (guint8 i = 0; i < NUM_CLIENTS; ++i) set_deadline(i, -1);
+
+  if (think_us >= 0) {
+    text = g_strdup_printf(FORFEIT_PREFIX "%s (%.3f ms)\n",
+                           get_forfeit_description(forfeit), think_us/1000.);
+  } else {
+    text = g_strdup_printf(FORFEIT_PREFIX "%s\n",
+                           get_forfeit_description(forfeit));
+  }
+  append_text(text, strlen(text), CHANNEL_ID(client_id, STDERR), NULL);
+  g_free(text);
+  if (parse_message(messages_sent[client_id]->str, &message)) {
+    /* the client that forfeits is the one to move */
+    text = g_strdup_printf("%.*s %d %c %u\n", NUM_DARK_SQ, message.board,
+                           message.next_player == 'r' ? -3 : -2,
+                           message.next_player, message.moves_left);
+    append_text(text, strlen(text), CHANNEL_ID(client_id, STDOUT), &stats);
+    g_free(text);
+  }
+
+  if (client->is_running && !client->is_builtin) kill(client->pid, SIGKILL);
+  kill_clients();
+  update_status(clients);
+}
+
+/*!
+ * \brief
+ * Ends a client's turn when its reply begins to arrive
+ *
+ * \param[in] client_id  the client
+ * \param[in] now_us     the monotonic time of the reply
+ *
+ * \return
+ * \c FALSE if the reply came too late, in which case the client has
+ * forfeited
+ */
+static gboolean
+end_turn(const guint8 client_id, const gint64 now_us)
+{
+  forfeit_t forfeit = FORFEIT_NONE;
+  const gint64 think_us = now_us - turn_since_us[client_id];
+  const gint64 limit_us = get_time_limit_us(client_id, &forfeit);
+
+  if (turn_since_us[client_id] == 0) return TRUE;
+
+  /* a late reply forfeits even if the deadline hasn't been handled yet */
+  if (limit_us >= 0 && think_us > limit_us) {
+    forfeit_game(client_id, forfeit, think_us);
+    return FALSE;
+  }
+  clock_used_us[client_id] += think_us;
+  clients[client_id].clock_us = clock_used_us[client_id];
+  turn_since_us[client_id] = 0;
+  set_deadline(client_id, -1);
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Makes a client forfeit if its deadline has passed, or rearms the deadline
+ * if it woke up early
+ *
+ * \param[in] client_id  the client
+ */
+static void
+check_deadline(const guint8 client_id)
+{
+  forfeit_t forfeit = FORFEIT_NONE;
+  gint64 limit_us;
+  gint64 think_us;
+
+  if (is_game_over || turn_since_us[client_id] == 0) return;
+
+  limit_us = get_time_limit_us(client_id, &forfeit);
+  if (limit_us < 0) return;
+  think_us = g_get_monotonic_time() - turn_since_us[client_id];
+  if (think_us >= limit_us) {
+    forfeit_game(client_id, forfeit, think_us);
+  } else {
+    set_deadline(client_id, limit_us - think_us);
+  }
+}
+
+/*!
+ * \brief
+ * Reads the CPU times and resident set size of a running client from
+ * \c /proc/PID/stat, and updates its peak resident set size
+ *
+ * \param[in,out] client  the client
+ * \param[out]    rss_kb  the current resident set size in KiB, or \c NULL
+ *
+ * \return
+ * \c FALSE if the figures couldn't be read (e.g. on systems without
+ * \c /proc), in which case nothing is changed
+ */
+static gboolean
+sample_client(client_t * const client, gint64 * const rss_kb)
+{
+  extern guint option_limit_files;
+  gchar path[32];
+  gchar buffer[1024];
+  gchar **fields;
+  const gchar *p;
+  FILE *file;
+  gsize n;
+  gboolean success = FALSE;
+
+  /* the figures of the visualizer itself would be misleading */
+  if (client->is_builtin) return FALSE;
+
+  g_snprintf(path, sizeof(path), "/proc/%d/stat", (gint)client->pid);
+  file = fopen(path, "r");
+  if (file == NULL) return FALSE;
+  n = fread(buffer, 1, sizeof(buffer) - 1, file);
+  fclose(file);
+  buffer[n] = '\0';
+
+  /* the command name may contain spaces, so start after its closing
+     parenthesis, i.e. at the third field (the state) */
+  p = strrchr(buffer, ')');
+  if (p == NULL) return FALSE;
+  fields = g_strsplit(p + 1, " ", 0);
+  if (g_strv_length(fields) > 22) {
+    /* fields 14, 15, 23 and 24: utime, stime (clock ticks), vsize (bytes)
+       and rss (pages) */
+    const guint64 ticks = sysconf(_SC_CLK_TCK);
+    const guint64 page_kb = sysconf(_SC_PAGESIZE) >> 10;
+    const gint64 rss = g_ascii_strtoll(fields[22], NULL, 10) * page_kb;
+    client->user_us =
+      g_ascii_strtoull(fields[12], NULL, 10) * G_USEC_PER_SEC / ticks;
+    client->system_us =
+      g_ascii_strtoull(fields[13], NULL, 10) * G_USEC_PER_SEC / ticks;
+    client->peak_vm_kb = MAX(client->peak_vm_kb,
+                             g_ascii_strtoll(fields[21], NULL, 10) >> 10);
+    client->peak_rss_kb = MAX(client->peak_rss_kb, rss);
+    if (rss_kb != NULL) *rss_kb = rss;
+    success = TRUE;
+  }
+  g_strfreev(fields);
+
+  /* counting the open files takes a directory listing, so only do it when
+     they're limited */
+  if (option_limit_files > 0) {
+    GDir *dir;
+    g_snprintf(path, sizeof(path), "/proc/%d/fd", (gint)client->pid);
+    dir = g_dir_open(path, 0, NULL);
+    if (dir != NULL) {
+      gint64 n_files = 0;
+      while (g_dir_read_name(dir) != NULL) ++n_files;
+      g_dir_close(dir);
+      client->peak_files = MAX(client->peak_files, n_files);
+    }
+  }
+  return success;
+}
+
+/*!
+ * \brief
+ * Sets a resource limit, without going above the current hard limit
+ *
+ * \param[in] resource  the resource, such as \c RLIMIT_AS
+ * \param[in] soft      the soft limit
+ * \param[in] hard      the hard limit
+ */
+static void
+set_limit(const int resource, const rlim_t soft, const rlim_t hard)
+{
+  struct rlimit limit;
+
+  if (getrlimit(resource, &limit) != 0) return;
+  if (limit.rlim_max != RLIM_INFINITY) {
+    limit.rlim_cur = MIN(soft, limit.rlim_max);
+    limit.rlim_max = MIN(hard, limit.rlim_max);
+  } else {
+    limit.rlim_cur = soft;
+    limit.rlim_max = hard;
+  }
+  setrlimit(resource, &limit);
+}
+
+/*!
+ * \brief
+ * Prepares a client process before its program is executed, by letting it
+ * inherit any ring, attaching its output to any pseudo-terminals, pinning
+ * it to its CPUs and applying the resource limits of the judge emulation
+ *
+ * Follows the signature of \c GSpawnChildSetupFunc, and runs in the child
+ * after \c fork(), where only async-signal-safe functions may be called.
+ *
+ * \param[in] user_data  the client id, as a pointer
+ */
+static void
+child_setup(gpointer user_data)
+{
+  extern guint option_limit_mib;
+  extern guint option_limit_cpu_s;
+  extern guint option_limit_files;
+  const guint8 client_id = GPOINTER_TO_UINT(user_data);
+
+  if (rings[client_id] != NULL) ring_prepare_child(rings[client_id]);
+  if (pty_slave_fds[CHANNEL_ID(client_id, STDOUT)] >= 0) {
+    dup2(pty_slave_fds[CHANNEL_ID(client_id, STDOUT)], STDOUT_FILENO);
+  }
+  if (pty_slave_fds[CHANNEL_ID(client_id, STDERR)] >= 0) {
+    dup2(pty_slave_fds[CHANNEL_ID(client_id, STDERR)], STDERR_FILENO);
+  }
+#ifdef __linux__
+  if (is_pinned[client_id]) {
+    sched_setaffinity(0, sizeof(cpu_set_t), &client_cpus[client_id]);
+  }
+#endif
+  if (option_limit_mib > 0) {
+    const rlim_t bytes = (rlim_t)option_limit_mib << 20;
+    set_limit(RLIMIT_AS, bytes, bytes);
+  }
+  if (option_limit_cpu_s > 0) {
+    /* SIGXCPU at the soft limit, and SIGKILL a second later if it's
+       caught */
+    set_limit(RLIMIT_CPU, option_limit_cpu_s, option_limit_cpu_s + 1);
+  }
+  if (option_limit_files > 0) {
+    set_limit(RLIMIT_NOFILE, option_limit_files, option_limit_files);
+  }
+}
+
+/*!
+ * \brief
+ * Finds out whether a client that has exited was stopped by one of the
+ * resource limits of the judge emulation
+ *
+ * Only the CPU time limit leaves hard evidence: its signal, or the CPU time
+ * used. A client that runs out of address space or file descriptors merely
+ * fails to allocate them, and the samples may miss a quick allocation, so
+ * any other unsuccessful exit under those limits is only a forfeit that is
+ * likely due to the memory limit if the sampled address space came within a
+ * tenth of it, or to the open file limit if the sampled number of open
+ * files reached it.
+ *
+ * \param[in] client  the client
+ *
+ * \return
+ * the limit that was breached, or #FORFEIT_NONE
+ */
+static forfeit_t
+get_limit_breach(const client_t * const client)
+{
+  extern guint option_limit_mib;
+  extern guint option_limit_cpu_s;
+  extern guint option_limit_files;
+  const gint status = client->status;
+
+  if (WIFEXITED(status) && WEXITSTATUS(status) == 0) return FORFEIT_NONE;
+  /* stopped by kill_clients() */
+  if (WIFSIGNALED(status) && WTERMSIG(status) == SIGTERM) {
+    return FORFEIT_NONE;
+  }
+
+  if (option_limit_cpu_s > 0 &&
+      ((WIFSIGNALED(status) && WTERMSIG(status) == SIGXCPU) ||
+       client->user_us + client->system_us >=
+       option_limit_cpu_s * (gint64)G_USEC_PER_SEC)) {
+    return FORFEIT_CPU_TIME;
+  }
+  if (option_limit_mib > 0 &&
+      client->peak_vm_kb >= option_limit_mib * (gint64)1024 * 9/10) {
+    return FORFEIT_LIKELY_MEMORY;
+  }
+  if (option_limit_files > 0 && client->peak_files >= option_limit_files) {
+    return FORFEIT_LIKELY_FILES;
+  }
+  if (option_limit_mib > 0 || option_limit_files > 0) return FORFEIT_EXITED;
+  return FORFEIT_NONE;
+}
+
+/*!
+ * \brief
+ * Records the exit of a client, along with its final resource usage
+ *
+ * \param[in,out] client  the client
+ * \param[in]     status  the exit status
+ * \param[in]     usage   the resource usage, or \c NULL if unknown
+ */
+static void
+client_exited(client_t * const client,
+              const gint status,
+              const struct rusage * const usage)
+{
+  client->is_running = FALSE;
+  client->status = status;
+  if (usage != NULL) {
+    client->user_us   = usage->ru_utime.tv_sec * (gint64)G_USEC_PER_SEC +
+                        usage->ru_utime.tv_usec;
+    client->system_us = usage->ru_stime.tv_sec * (gint64)G_USEC_PER_SEC +
+                        usage->ru_stime.tv_usec;
+    /* ru_maxrss is in KiB on Linux */
+    client->peak_rss_kb = MAX(client->peak_rss_kb, usage->ru_maxrss);
+  }
+  g_spawn_close_pid(client->pid);
+}
+
+/*!
+ * \brief
+ * Callback for sampling the clients' resource usage, and reaping the ones
+ * that have exited
+ *
+ * Reaping the clients with \c wait4() rather than through a child watch is
+ * what gives access to their final resource usage.
+ *
+ * \param[in] user_data  not used
+ *
+ * \return
+ * \c TRUE while any client is running (to keep the source)
+ */
+static gboolean
+sample_callback(gpointer user_data)
+{
+  const gint64 now_us = g_get_monotonic_time();
+  gboolean any_running = FALSE;
+
+  UNUSED(user_data);
+
+  for (guint8 i = 0; i < NUM_CLIENTS; ++i) {
+    struct rusage usage;
+    gint64 think_us = -1;
+    gint status;
+    pid_t pid;
+
+    if (!clients[i].is_running) continue;
+
+    /* the clock of the client whose turn it is keeps running */
+    if (turn_since_us[i] != 0) {
+      clients[i].clock_us = clock_used_us[i] + now_us - turn_since_us[i];
+    }
+
+    /* the engine ends like a client that exits once the game is over */
+    if (clients[i].is_builtin) {
+      if (engine_is_finished(engines[i])) {
+        stop_engine(i);
+      } else {
+        any_running = TRUE;
+      }
+      continue;
+    }
+
+    pid = wait4(clients[i].pid, &status, WNOHANG, &usage);
+    if (pid != 0 && source_rings[i] != 0) {
+      /* pass on what the client wrote to its ring before exiting */
+      drain_ring(i);
+      g_source_remove(source_rings[i]);
+      source_rings[i] = 0;
+    }
+    if (pid != 0) {
+      /* a client that has exited won't reply in time or otherwise */
+      think_us = turn_since_us[i] != 0 ? now_us - turn_since_us[i] : -1;
+      turn_since_us[i] = 0;
+      set_deadline(i, -1);
+    }
+    if (pid == clients[i].pid) {
+      forfeit_t breach;
+      client_exited(&clients[i], status, &usage);
+      breach = get_limit_breach(&clients[i]);
+      if (breach != FORFEIT_NONE && !is_game_over) {
+        forfeit_game(i, breach, think_us);
+      }
+    } else if (pid < 0) {
+      /* somebody else reaped it */
+      client_exited(&clients[i], -1, NULL);
+    } else {
+      sample_client(&clients[i], NULL);
+      deliver_pending(i);
+      any_running = TRUE;
+    }
+  }
+
+  update_status(clients);
+  if (!any_running) source_sample = 0;
+  return any_running;
+}
+
 /*!
  * \brief
  * Shuts down a pair of channels due to errors or end-of-file
@@ -48,6 +767,114 @@ stop_channels(GIOChannel *channel_in, GIOChannel *channel_out)
   g_io_channel_unref(channel_out);
 }
 
+/*!
+ * \brief
+ * Hands output to a client, through its ring if it has one and through its
+ * stdin otherwise
+ *
+ * \param[in] client_id  the client
+ * \param[in] text       the output
+ * \param[in] len        the length of \p text in bytes
+ */
+static void
+deliver(const guint8 client_id, const gchar * const text, const gsize len)
+{
+  if (engines[client_id] != NULL) {
+    engine_receive(engines[client_id], text, len);
+    return;
+  }
+  if (rings[client_id] == NULL) {
+    g_io_channel_write_chars(channel_stdin[client_id], text, len, NULL,
+                             NULL);
+    g_io_channel_flush(channel_stdin[client_id], NULL);
+    return;
+  }
+
+  /* whatever doesn't fit waits until the client has read some more */
+  if (ring_pending[client_id]->len == 0) {
+    const gsize written = ring_write(rings[client_id], text, len);
+    g_string_append_len(ring_pending[client_id], text + written,
+                        len - written);
+  } else {
+    g_string_append_len(ring_pending[client_id], text, len);
+  }
+}
+
+/*!
+ * \brief
+ * Writes the output that didn't fit in a client's ring, as far as it fits
+ * now
+ *
+ * \param[in] client_id  the client
+ */
+static void
+deliver_pending(const guint8 client_id)
+{
+  gsize written;
+
+  if (rings[client_id] == NULL || ring_pending[client_id]->len == 0) return;
+
+  written = ring_write(rings[client_id], ring_pending[client_id]->str,
+                       ring_pending[client_id]->len);
+  g_string_erase(ring_pending[client_id], 0, written);
+}
+
+/*!
+ * \brief
+ * Passes a client's output on to its opponent, and to the GUI
+ *
+ * \param[in] client_id  the client
+ * \param[in] text       the output, from its stdout or its ring
+ * \param[in] len        the length of \p text in bytes
+ */
+static void
+relay_output(const guint8 client_id, const gchar * const text, gsize len)
+{
+  client_t * const client = &clients[client_id];
+  const guint8 opponent_id = 1 ^ client_id;
+  const gint64 now_us = g_get_monotonic_time();
+  reply_stats_t stats = { -1, -1, -1 };
+  gboolean is_reply = FALSE;
+
+  if (client->startup_us < 0) {
+    client->startup_us = now_us - client->launched_us;
+  }
+  if (is_game_over || !end_turn(client_id, now_us)) {
+    /* nothing is passed on after a forfeit, including a late reply */
+    return;
+  }
+  if (waiting_since_us[client_id] != 0) {
+    is_reply = TRUE;
+    stats.think_us = now_us - waiting_since_us[client_id];
+    waiting_since_us[client_id] = 0;
+    if (sample_client(client, &stats.rss_kb) &&
+        cpu_since_us[client_id] >= 0) {
+      stats.cpu_us = client->user_us + client->system_us -
+                     cpu_since_us[client_id];
+    }
+  }
+
+  if (is_reply) g_string_truncate(messages_sent[opponent_id], 0);
+  g_string_append_len(messages_sent[opponent_id], text, len);
+  deliver(opponent_id, text, len);
+
+  /* the opponent's clock starts once the whole message has been handed
+     over, and only if it was a move */
+  if (is_to_move[client_id] && memchr(text, '\n', len) != NULL) {
+    is_to_move[client_id] = FALSE;
+    start_turn(opponent_id);
+    waiting_since_us[opponent_id] = g_get_monotonic_time();
+    cpu_since_us[opponent_id] = -1;
+    if (clients[opponent_id].is_running &&
+        sample_client(&clients[opponent_id], NULL)) {
+      cpu_since_us[opponent_id] = clients[opponent_id].user_us +
+                                  clients[opponent_id].system_us;
+    }
+  }
+  append_text(text, len, CHANNEL_ID(client_id, STDOUT),
+              is_reply ? &stats : NULL);
+}
+
 /*!
  * \brief
  * Callback for when new data is available in a pipe
@@ -65,30 +892,41 @@ static gboolean
 io_watch_callback(GIOChannel *source, GIOCondition condition, gpointer data)
 {
   const guint8 input_type = GPOINTER_TO_UINT(data);
+  const guint8 client_id = CLIENT_ID(input_type);
+  /* a client with a ring only writes its messages there */
+  const gboolean is_relayed = IS_STDOUT(input_type) &&
+                              rings[client_id] == NULL;
   gchar buffer[BUFFER_SIZE];
   gsize bytes_read;
   GError *error = NULL;
   GIOStatus status;
   GIOChannel *write_to = NULL;
 
-  if (IS_STDOUT(input_type)) {
-    write_to = channel_stdin[1 ^ CLIENT_ID(input_type)];
-  }
+  if (IS_STDOUT(input_type)) write_to = channel_stdin[1 ^ client_id];
 
   do {
     status = g_io_channel_read_chars(source, buffer, BUFFER_SIZE,
                                      &bytes_read, &error);
     if (error != NULL) {
       stop_channels(source, write_to);
-      print_error(error->message);
+      /* a pseudo-terminal reports EIO rather than end-of-file once the
+         client has closed it */
+      if (!is_pty[input_type] ||
+          !g_error_matches(error, G_IO_CHANNEL_ERROR,
+                           G_IO_CHANNEL_ERROR_IO)) {
+        print_error(error->message);
+      }
       return FALSE;
     }
     if (bytes_read == 0) continue;
-    if (write_to != NULL) {
-      g_io_channel_write_chars(write_to, buffer, bytes_read, NULL, NULL);
-      g_io_channel_flush(write_to, NULL);
+    if (is_relayed) {
+      relay_output(client_id, buffer, bytes_read);
+    } else if (IS_STDOUT(input_type)) {
+      /* shown like stderr, since only the ring carries messages */
+      append_text(buffer, bytes_read, CHANNEL_ID(client_id, STDERR), NULL);
+    } else {
+      append_text(buffer, bytes_read, input_type, NULL);
     }
-    append_text(buffer, bytes_read, input_type);
   } while (status == G_IO_STATUS_NORMAL);
 
   if ((condition & ~G_IO_IN) != 0) {
@@ -98,33 +936,331 @@ io_watch_callback(GIOChannel *source, GIOCondition condition, gpointer data)
   /* for some reason I can't figure out, this function is called repeatedly
      with condition==G_IO_IN when the client process ends - this check should
      prevent the program from becoming unresponsive and consuming 100% CPU */
-  return clients[CLIENT_ID(input_type)].is_running;
+  return clients[client_id].is_running;
+}
+
+/*!
+ * \brief
+ * Passes on everything that a client has written to its ring so far
+ *
+ * \param[in] client_id  the client
+ */
+static void
+drain_ring(const guint8 client_id)
+{
+  gchar buffer[BUFFER_SIZE];
+  gsize len;
+
+  while ((len = ring_read(rings[client_id], buffer, sizeof(buffer))) > 0) {
+    relay_output(client_id, buffer, len);
+  }
+}
+
+/*!
+ * \brief
+ * Callback for when a client has written to its ring
+ *
+ * \param[in] source     the event source
+ * \param[in] condition  the condition which has been satisfied
+ * \param[in] data       the client id, converted to a \c gpointer using
+ *                       \c GUINT_TO_POINTER()
+ *
+ * \return
+ * \c TRUE, as the event source is removed when the client exits
+ */
+static gboolean
+ring_watch_callback(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+  const guint8 client_id = GPOINTER_TO_UINT(data);
+
+  UNUSED(source);
+  UNUSED(condition);
+
+  drain_ring(client_id);
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Opens a pseudo-terminal, which passes the output through unchanged
+ *
+ * \param[out] master_fd  the master side, for reading the output
+ * \param[out] slave_fd   the slave side, for the client to write to
+ *
+ * \return
+ * whether the pseudo-terminal could be opened
+ */
+static gboolean
+open_pty(gint * const master_fd, gint * const slave_fd)
+{
+  const gint master = posix_openpt(O_RDWR | O_NOCTTY);
+  struct termios attrs;
+  gint slave = -1;
+
+  if (master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0) {
+    const char * const name = ptsname(master);
+    if (name != NULL) slave = open(name, O_RDWR | O_NOCTTY);
+  }
+  if (slave < 0) {
+    if (master >= 0) close(master);
+    return FALSE;
+  }
+
+  /* raw mode keeps the line discipline from turning "\n" into "\r\n",
+     while the client's stdio still sees a terminal and flushes each line */
+  if (tcgetattr(slave, &attrs) == 0) {
+    cfmakeraw(&attrs);
+    tcsetattr(slave, TCSANOW, &attrs);
+  }
+  fcntl(master, F_SETFD, FD_CLOEXEC);
+  fcntl(slave, F_SETFD, FD_CLOEXEC);
+  *master_fd = master;
+  *slave_fd = slave;
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Opens the pseudo-terminals for those channels of a client that should be
+ * attached to one
+ *
+ * \param[in]  client_id     the client
+ * \param[out] fd_stdouterr  the file descriptors to read the channels from,
+ *                           indexed as specified by #CHANNEL_ID
+ * \param[in]  error         as for launch_clients()
+ *
+ * \return
+ * whether every pseudo-terminal could be opened
+ */
+static gboolean
+open_ptys(const guint8 client_id,
+          gint         fd_stdouterr[static NUM_CHANNELS],
+          GError     **error)
+{
+  extern guint option_pty_types;
+
+  for (guint8 type = STDOUT; type <= STDERR; ++type) {
+    const guint8 channel_id = CHANNEL_ID(client_id, type);
+    is_pty[channel_id] = (option_pty_types & 1 << type) != 0;
+    if (is_pty[channel_id] &&
+        !open_pty(&fd_stdouterr[channel_id], &pty_slave_fds[channel_id])) {
+      if (type == STDERR && is_pty[CHANNEL_ID(client_id, STDOUT)]) {
+        close(fd_stdouterr[CHANNEL_ID(client_id, STDOUT)]);
+        close(pty_slave_fds[CHANNEL_ID(client_id, STDOUT)]);
+        pty_slave_fds[CHANNEL_ID(client_id, STDOUT)] = -1;
+      }
+      g_set_error(error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                  "Couldn't open a pseudo-terminal for player %u",
+                  client_id + 1);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Closes the shared-memory transport of a client's previous run, if it had
+ * one
+ *
+ * \param[in] client_id  the client
+ */
+static void
+close_ring(const guint8 client_id)
+{
+  if (source_rings[client_id] != 0) {
+    g_source_remove(source_rings[client_id]);
+    source_rings[client_id] = 0;
+  }
+  ring_free(rings[client_id]);
+  rings[client_id] = NULL;
 }
 
 /*!
  * \brief
- * Callback for when one of the child processes finishes
+ * Sets up the shared-memory transport of a client, if it should have one
  *
- * The callback writes changes to ::clients provided through \p user_data, and
- * causes the status bar to be updated.
+ * \param[in]  client_id  the client
+ * \param[out] envp       the environment for the client, which tells it
+ *                        the ring (or \c NULL to inherit the environment
+ *                        unchanged), to be freed with \c g_strfreev()
+ * \param[in]  error      as for launch_clients()
  *
- * \param[in] pid       child process id
- * \param[in] status    child exit status
- * \param[in] user_data a pointer to the \ref client_t structure associated
- *                      with this child
+ * \return
+ * whether the transport could be set up
+ */
+static gboolean
+open_ring(const guint8 client_id, gchar ***envp, GError **error)
+{
+  extern guint option_ring_clients;
+  gchar **names;
+  GPtrArray *env;
+
+  close_ring(client_id);
+  *envp = NULL;
+  if ((option_ring_clients & 1 << client_id) == 0) return TRUE;
+
+  rings[client_id] = ring_new(error);
+  if (rings[client_id] == NULL) return FALSE;
+  if (ring_pending[client_id] == NULL) {
+    ring_pending[client_id] = g_string_new(NULL);
+  }
+  g_string_truncate(ring_pending[client_id], 0);
+
+  names = g_listenv();
+  env = g_ptr_array_new();
+  for (gchar **name = names; *name != NULL; ++name) {
+    if (strcmp(*name, RING_ENV) == 0) continue;
+    g_ptr_array_add(env, g_strconcat(*name, "=", g_getenv(*name), NULL));
+  }
+  g_ptr_array_add(env, ring_get_env(rings[client_id]));
+  g_ptr_array_add(env, NULL);
+  g_strfreev(names);
+  *envp = (gchar **)g_ptr_array_free(env, FALSE);
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Spawns a client process
+ *
+ * \param[in]  client_id     the client
+ * \param[in]  cmd           the command line
+ * \param[out] fd_stdin      the pipe to the client's stdin
+ * \param[out] fd_stdouterr  the pipes or pseudo-terminals of the client's
+ *                           stdout and stderr, indexed by #CHANNEL_ID
+ * \param[in]  error         as for launch_clients()
+ *
+ * \return
+ * whether the client was spawned
+ */
+static gboolean
+spawn_client(const guint8        client_id,
+             const gchar * const cmd,
+             gint * const        fd_stdin,
+             gint                fd_stdouterr[static NUM_CHANNELS],
+             GError            **error)
+{
+  gchar **cmdline;
+  gchar **envp;
+  gboolean success;
+
+  engine_free(engines[client_id]);
+  engines[client_id] = NULL;
+  if (!open_ring(client_id, &envp, error)) return FALSE;
+  if (!open_ptys(client_id, fd_stdouterr, error)) {
+    g_strfreev(envp);
+    return FALSE;
+  }
+  cmdline = g_strsplit(cmd, " ", 0);
+  success =
+    g_spawn_async_with_pipes(/* const gchar *working_directory */
+                             NULL,
+                             /* gchar **argv */
+                             cmdline,
+                             /* gchar **envp */
+                             envp,
+                             /* GSpawnFlags flags */
+                             G_SPAWN_SEARCH_PATH |
+                             G_SPAWN_DO_NOT_REAP_CHILD,
+                             /* GSpawnChildSetupFunc child_setup */
+                             child_setup,
+                             /* gpointer user_data */
+                             GUINT_TO_POINTER(client_id),
+                             /* GPid *child_pid */
+                             &clients[client_id].pid,
+                             /* gint *standard_input */
+                             fd_stdin,
+                             /* gint *standard_output */
+                             is_pty[CHANNEL_ID(client_id, STDOUT)] ? NULL :
+                             &fd_stdouterr[CHANNEL_ID(client_id, STDOUT)],
+                             /* gint *standard_error */
+                             is_pty[CHANNEL_ID(client_id, STDERR)] ? NULL :
+                             &fd_stdouterr[CHANNEL_ID(client_id, STDERR)],
+                             /* GError **error */
+                             error);
+  g_strfreev(cmdline);
+  g_strfreev(envp);
+  /* the client has its own copies of the slaves, and the masters report
+     its exit only once no other copies are left */
+  for (guint8 type = STDOUT; type <= STDERR; ++type) {
+    gint * const slave_fd = &pty_slave_fds[CHANNEL_ID(client_id, type)];
+    if (*slave_fd < 0) continue;
+    close(*slave_fd);
+    *slave_fd = -1;
+    if (!success) close(fd_stdouterr[CHANNEL_ID(client_id, type)]);
+  }
+  clients[client_id].is_builtin = FALSE;
+  return success;
+}
+
+/*!
+ * \brief
+ * Passes the output of a built-in engine on, like that of a client process,
+ * following the signature of ::engine_output_func_t
+ *
+ * \param[in] type       #STDOUT or #STDERR
+ * \param[in] text       the output
+ * \param[in] len        the length of \p text in bytes
+ * \param[in] user_data  the client id, converted to a \c gpointer using
+ *                       \c GUINT_TO_POINTER()
  */
 static void
-child_exit_callback(GPid pid, gint status, gpointer user_data)
+engine_output_callback(guint8       type,
+                       const gchar *text,
+                       gsize        len,
+                       gpointer     user_data)
 {
-  client_t * const client = user_data;
+  const guint8 client_id = GPOINTER_TO_UINT(user_data);
 
-  assert(client != NULL);
-  assert(client->is_running);
+  if (type == STDOUT) {
+    relay_output(client_id, text, len);
+  } else {
+    append_text(text, len, CHANNEL_ID(client_id, STDERR), NULL);
+  }
+}
 
-  client->is_running = FALSE;
-  client->status = status;
-  g_spawn_close_pid(pid);
-  update_status(clients);
+/*!
+ * \brief
+ * Starts the built-in engine in place of a client process
+ *
+ * \param[in] client_id  the client
+ * \param[in] cmd        the command line, starting with #ENGINE_PREFIX
+ * \param[in] error      as for launch_clients()
+ *
+ * \return
+ * whether the engine was started
+ */
+static gboolean
+start_engine(const guint8 client_id, const gchar * const cmd, GError **error)
+{
+  close_ring(client_id);
+  engine_free(engines[client_id]);
+  engines[client_id] = engine_new(cmd, engine_output_callback,
+                                  GUINT_TO_POINTER(client_id), error);
+  if (engines[client_id] == NULL) return FALSE;
+  clients[client_id].pid = 0;
+  clients[client_id].is_builtin = TRUE;
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Stops a built-in engine, which is recorded like the successful exit of a
+ * client process
+ *
+ * \param[in] client_id  the client
+ */
+static void
+stop_engine(const guint8 client_id)
+{
+  engine_free(engines[client_id]);
+  engines[client_id] = NULL;
+  clients[client_id].is_running = FALSE;
+  clients[client_id].status = 0;
+  turn_since_us[client_id] = 0;
+  is_to_move[client_id] = FALSE;
+  set_deadline(client_id, -1);
 }
 
 /* documented in clients.h */
@@ -138,58 +1274,80 @@ launch_clients(const gchar *cmds[static NUM_CLIENTS], GError **error)
   assert(error == NULL || *error == NULL);
 
   for (guint8 i = 0; i < NUM_CLIENTS; ++i) {
-    gchar **cmdline;
     gboolean success;
 
     assert(cmds[i] != NULL);
 
-    cmdline = g_strsplit(cmds[i], " ", 0);
-    success =
-      g_spawn_async_with_pipes(/* const gchar *working_directory */
-                               NULL,
-                               /* gchar **argv */
-                               cmdline,
-                               /* gchar **envp */
-                               NULL,
-                               /* GSpawnFlags flags */
-                               G_SPAWN_SEARCH_PATH |
-                               G_SPAWN_DO_NOT_REAP_CHILD,
-                               /* GSpawnChildSetupFunc child_setup */
-                               NULL,
-                               /* gpointer user_data */
-                               NULL,
-                               /* GPid *child_pid */
-                               &clients[i].pid,
-                               /* gint *standard_input */
-                               &fd_stdin[i],
-                               /* gint *standard_output */
-                               &fd_stdouterr[CHANNEL_ID(i, STDOUT)],
-                               /* gint *standard_error */
-                               &fd_stdouterr[CHANNEL_ID(i, STDERR)],
-                               /* GError **error */
-                               error);
-    g_strfreev(cmdline);
+    if (g_str_has_prefix(cmds[i], ENGINE_PREFIX)) {
+      success = start_engine(i, cmds[i], error);
+      fd_stdin[i] = -1;
+      fd_stdouterr[CHANNEL_ID(i, STDOUT)] = -1;
+      fd_stdouterr[CHANNEL_ID(i, STDERR)] = -1;
+    } else {
+      success = spawn_client(i, cmds[i], &fd_stdin[i], fd_stdouterr, error);
+    }
     if (!success) {
       /* don't keep one client running if the other one couldn't start */
       kill_clients();
       return;
     }
-    g_child_watch_add(clients[i].pid,
-                      (GChildWatchFunc)child_exit_callback,
-                      &clients[i]);
-    clients[i].is_running = TRUE;
+    clients[i].is_running  = TRUE;
+    clients[i].launched_us = g_get_monotonic_time();
+    clients[i].startup_us  = -1;
+    clients[i].user_us     = -1;
+    clients[i].system_us   = -1;
+    clients[i].peak_rss_kb = -1;
+    clients[i].peak_vm_kb  = -1;
+    clients[i].peak_files  = -1;
+    clients[i].clock_us    = 0;
+    clients[i].forfeit     = FORFEIT_NONE;
+    waiting_since_us[i] = clients[i].launched_us;
+    cpu_since_us[i] = 0;
+    turn_since_us[i] = 0;
+    /* either client may start the game */
+    is_to_move[i] = TRUE;
+    clock_used_us[i] = 0;
+    if (messages_sent[i] == NULL) messages_sent[i] = g_string_new(NULL);
+    g_string_truncate(messages_sent[i], 0);
+    if (rings[i] != NULL) {
+      GIOChannel *channel = g_io_channel_unix_new(ring_get_fd(rings[i]));
+      source_rings[i] = g_io_add_watch(channel, G_IO_IN,
+                                       (GIOFunc)ring_watch_callback,
+                                       GUINT_TO_POINTER(i));
+      g_io_channel_unref(channel);
+    }
+#ifdef __linux__
+    if (timer_fds[i] < 0) {
+      timer_fds[i] = timerfd_create(CLOCK_MONOTONIC,
+                                    TFD_NONBLOCK | TFD_CLOEXEC);
+      if (timer_fds[i] >= 0) {
+        GIOChannel *channel = g_io_channel_unix_new(timer_fds[i]);
+        g_io_add_watch(channel, G_IO_IN, (GIOFunc)timer_callback,
+                       GUINT_TO_POINTER(i));
+        g_io_channel_unref(channel);
+      }
+    }
+#endif
+  }
+  is_game_over = FALSE;
+  if (source_sample == 0) {
+    source_sample = g_timeout_add(SAMPLE_INTERVAL_MS,
+                                  (GSourceFunc)sample_callback, NULL);
   }
 
   g_get_charset(&charset);
 
   /* open two channels for writing */
   for (guint8 i = 0; i < NUM_CLIENTS; ++i) {
+    channel_stdin[i] = NULL;
+    if (fd_stdin[i] < 0) continue;
     channel_stdin[i] = g_io_channel_unix_new(fd_stdin[i]);
     g_io_channel_set_encoding(channel_stdin[i], charset, NULL);
   }
   /* open four channels for reading, and start watching them */
   for (guint8 i = 0; i < NUM_CHANNELS; ++i) {
     GIOChannel *channel;
+    if (fd_stdouterr[i] < 0) continue;
     channel = g_io_channel_unix_new(fd_stdouterr[i]);
     g_io_channel_set_flags(channel, G_IO_FLAG_NONBLOCK, NULL);
     g_io_channel_set_encoding(channel, charset, NULL);
@@ -207,8 +1365,160 @@ void
 kill_clients(void)
 {
   for (guint8 i = 0; i < NUM_CLIENTS; ++i) {
-    if (clients[i].is_running) {
+    if (engines[i] != NULL) {
+      stop_engine(i);
+    } else if (clients[i].is_running) {
       kill(clients[i].pid, SIGTERM); /* POSIX extension */
     }
   }
 }
+
+#ifdef __linux__
+/*!
+ * \brief
+ * Parses a list of CPUs, such as "2,3" or "4-7"
+ *
+ * \param[in]  list   the list, which may be empty
+ * \param[out] cpus   the CPUs
+ * \param[in]  error  as for pin_clients()
+ *
+ * \return
+ * whether the list is valid
+ */
+static gboolean
+parse_cpu_list(const gchar * const list,
+               cpu_set_t * const   cpus,
+               GError            **error)
+{
+  gchar **items = g_strsplit(list, ",", -1);
+  gboolean success = TRUE;
+
+  CPU_ZERO(cpus);
+  for (gchar **item = items; *item != NULL && success; ++item) {
+    gchar *end = *item;
+    guint64 first = 0;
+    guint64 last;
+
+    if (*g_strstrip(*item) == '\0') continue;
+    if (g_ascii_isdigit(*end)) first = g_ascii_strtoull(*item, &end, 10);
+    last = first;
+    if (*end == '-' && g_ascii_isdigit(end[1])) {
+      last = g_ascii_strtoull(end + 1, &end, 10);
+    }
+    if (end == *item || *end != '\0' || first > last ||
+        last >= CPU_SETSIZE) {
+      g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                  "Invalid CPU list \"%s\"", list);
+      success = FALSE;
+      continue;
+    }
+    for (guint64 cpu = first; cpu <= last; ++cpu) CPU_SET(cpu, cpus);
+  }
+  g_strfreev(items);
+  return success;
+}
+#endif
+
+/* documented in clients.h */
+gboolean
+pin_clients(const gchar *cpus, GError **error)
+{
+#ifdef __linux__
+  gchar **lists;
+  cpu_set_t own;
+  gboolean success = TRUE;
+
+  assert(cpus != NULL);
+  assert(error == NULL || *error == NULL);
+
+  if (sched_getaffinity(0, sizeof(own), &own) != 0) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+                "Couldn't get the CPU affinity of the visualizer");
+    return FALSE;
+  }
+
+  lists = g_strsplit(cpus, ":", NUM_CLIENTS);
+  for (guint8 i = 0; i < NUM_CLIENTS && lists[i] != NULL && success; ++i) {
+    cpu_set_t allowed;
+    success = parse_cpu_list(lists[i], &client_cpus[i], error);
+    if (!success || CPU_COUNT(&client_cpus[i]) == 0) continue;
+    CPU_AND(&allowed, &client_cpus[i], &own);
+    if (!CPU_EQUAL(&allowed, &client_cpus[i])) {
+      g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                  "Player %u can't be pinned to CPUs \"%s\" that aren't "
+                  "available", i + 1, lists[i]);
+      success = FALSE;
+    }
+    is_pinned[i] = success;
+  }
+  g_strfreev(lists);
+
+  /* keep the visualizer (and the threads that it creates later) off the
+     clients' CPUs, so that it doesn't take time from them */
+  for (guint8 i = 0; i < NUM_CLIENTS && success; ++i) {
+    if (!is_pinned[i]) continue;
+    for (guint cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &client_cpus[i])) CPU_CLR(cpu, &own);
+    }
+  }
+  if (success && CPU_COUNT(&own) == 0) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "No CPU is left for the visualizer");
+    success = FALSE;
+  }
+  if (success && sched_setaffinity(0, sizeof(own), &own) != 0) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+                "Couldn't set the CPU affinity of the visualizer");
+    success = FALSE;
+  }
+  if (!success) {
+    for (guint8 i = 0; i < NUM_CLIENTS; ++i) is_pinned[i] = FALSE;
+  }
+  return success;
+#else
+  assert(cpus != NULL);
+
+  g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+              "Pinning to CPUs is only supported on Linux");
+  return FALSE;
+#endif
+}
+
+/* documented in clients.h */
+guint64
+get_client_cpu_mask(guint8 client_id)
+{
+  guint64 mask = 0;
+
+  assert(client_id < NUM_CLIENTS);
+
+#ifdef __linux__
+  if (is_pinned[client_id]) {
+    for (guint cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &client_cpus[client_id])) mask |= (guint64)1 << cpu;
+    }
+  }
+#endif
+  return mask;
+}
+
+/* documented in clients.h */
+gchar *
+format_cpu_mask(guint64 mask)
+{
+  GString *list = g_string_new(NULL);
+
+  for (guint cpu = 0; cpu < 64; ++cpu) {
+    guint last = cpu;
+    if ((mask >> cpu & 1) == 0) continue;
+    while (last < 63 && (mask >> (last + 1) & 1) != 0) ++last;
+    if (list->len > 0) g_string_append_c(list, ',');
+    if (last > cpu) {
+      g_string_append_printf(list, "%u-%u", cpu, last);
+    } else {
+      g_string_append_printf(list, "%u", cpu);
+    }
+    cpu = last;
+  }
+  return g_string_free(list, FALSE);
+}
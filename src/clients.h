@@ -16,19 +16,93 @@
  */
 #define NUM_CLIENTS 2
 
+/*!
+ * \brief
+ * Beginning of the line written to a client's stderr output when it forfeits,
+ * followed by the description of the reason
+ *
+ * \sa get_forfeit_description
+ */
+#define FORFEIT_PREFIX "Forfeited: "
+
+/*!
+ * \brief
+ * Enumeration of the reasons for a client to forfeit the game
+ */
+typedef enum {
+  FORFEIT_NONE,          /*!< the client hasn't forfeited */
+  FORFEIT_MOVE_TIME,     /*!< the client exceeded the time limit for a
+                              move */
+  FORFEIT_GAME_TIME,     /*!< the client exceeded the time limit for the
+                              game */
+  FORFEIT_LIKELY_MEMORY, /*!< the client exited unsuccessfully after coming
+                              close to the address space limit */
+  FORFEIT_CPU_TIME,      /*!< the client died at the CPU time limit */
+  FORFEIT_LIKELY_FILES,  /*!< the client exited unsuccessfully after
+                              reaching the open file limit */
+  FORFEIT_EXITED,        /*!< the client exited unsuccessfully under the
+                              address space or open file limit */
+  N_FORFEITS             /*!< number of reasons (end of enum) */
+} forfeit_t;
+
 /*!
  * \brief
  * Holds information about a running or finished client
+ *
+ * Resource figures are sampled from \c /proc while the client runs (where
+ * available), and replaced by the final resource usage when it exits. Figures
+ * that are unknown are -1, as are all of them for the built-in engine.
  */
 typedef struct {
   /*! \brief Process id */
   GPid pid;
   /*! \brief `TRUE` until the parent has been notified of the client's exit */
   gboolean is_running;
+  /*! \brief `TRUE` if the client is the built-in engine (see engine.h),
+             which runs in threads of the visualizer rather than as a
+             process of its own */
+  gboolean is_builtin;
   /*! \brief Exit status code (relevant only if #is_running is `FALSE`) */
   gint status;
+  /*! \brief Monotonic time when the client was launched, in microseconds */
+  gint64 launched_us;
+  /*! \brief Time from the launch until the first stdout data arrived, in
+             microseconds */
+  gint64 startup_us;
+  /*! \brief User CPU time used so far, in microseconds */
+  gint64 user_us;
+  /*! \brief System CPU time used so far, in microseconds */
+  gint64 system_us;
+  /*! \brief Peak resident set size so far, in KiB */
+  gint64 peak_rss_kb;
+  /*! \brief Peak virtual memory size (address space) so far, in KiB */
+  gint64 peak_vm_kb;
+  /*! \brief Largest number of open files so far (sampled only with an
+             open file limit) */
+  gint64 peak_files;
+  /*! \brief Time spent thinking in the game so far, including the current
+             move, in microseconds */
+  gint64 clock_us;
+  /*! \brief Why the client forfeited the game, if it did */
+  forfeit_t forfeit;
 } client_t;
 
+/*!
+ * \brief
+ * Measurements of a client's reply to a message
+ *
+ * Figures that are unknown are -1.
+ */
+typedef struct {
+  /*! \brief Time from handing over the message until the reply began to
+             arrive, in microseconds */
+  gint64 think_us;
+  /*! \brief CPU time (user and system) used meanwhile, in microseconds */
+  gint64 cpu_us;
+  /*! \brief Resident set size when the reply arrived, in KiB */
+  gint64 rss_kb;
+} reply_stats_t;
+
 /*!
  * \brief
  * Spawns asynchronous client processes
@@ -48,4 +122,60 @@ launch_clients(const gchar *cmds[static NUM_CLIENTS], GError **error);
 void
 kill_clients(void);
 
+/*!
+ * \brief
+ * Describes why a client forfeited
+ *
+ * \param[in] forfeit  the reason
+ *
+ * \return
+ * a static string, such as "exceeded the time limit for a move"
+ */
+const gchar *
+get_forfeit_description(forfeit_t forfeit);
+
+/*!
+ * \brief
+ * Pins each client to its own set of CPUs, and keeps the visualizer off them
+ *
+ * Should be called before any threads are created, so that they inherit the
+ * affinity of the visualizer. The clients are pinned when they're launched.
+ * Only supported on Linux.
+ *
+ * \param[in] cpus   the CPU lists of the clients separated by a colon, such
+ *                   as "2:3" or "4-5:6-7", where an empty list leaves the
+ *                   client unpinned
+ * \param[in] error  as for launch_clients()
+ *
+ * \return
+ * whether the CPUs are valid and the visualizer's affinity was changed
+ */
+gboolean
+pin_clients(const gchar *cpus, GError **error);
+
+/*!
+ * \brief
+ * Gets the CPUs that a client is pinned to
+ *
+ * \param[in] client_id  the client
+ *
+ * \return
+ * a mask with bit N set for CPU N (of the first 64), or zero if the client
+ * isn't pinned
+ */
+guint64
+get_client_cpu_mask(guint8 client_id);
+
+/*!
+ * \brief
+ * Formats a mask of CPUs as a list
+ *
+ * \param[in] mask  the mask, as from get_client_cpu_mask()
+ *
+ * \return
+ * a list such as "2,4-7" in a string that should be freed by the caller
+ */
+gchar *
+format_cpu_mask(guint64 mask);
+
 #endif /* CLIENTS_H */
@@ -0,0 +1,388 @@
+/*!
+ * \file dataset.c
+ * \brief
+ * Collects the columns of each session in a thread pool, and writes them
+ * one after the other, session by session, as a dataset.
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "dataset.h"
+#include "gui.h"
+#include "main.h"
+#include "metrics.h"
+#include "session.h"
+
+/*! \brief The columns that every dataset has, before the metrics */
+typedef enum {
+  COLUMN_BOARD,      /*!< the bits of the pieces */
+  COLUMN_PLAYER,     /*!< the player to move */
+  COLUMN_MOVES_LEFT, /*!< the moves left before a draw */
+  COLUMN_RESULT,     /*!< the result of the game */
+  COLUMN_THINK_US,   /*!< the think time */
+  COLUMN_CLIENT,     /*!< the client that wrote the board */
+  COLUMN_GAME,       /*!< the number of the game */
+  N_FIXED_COLUMNS    /*!< number of columns (end of enum) */
+} fixed_column_t;
+
+/*! \brief The name, type and width of each ::fixed_column_t */
+static const dataset_column_t fixed_columns[N_FIXED_COLUMNS] = {
+  { "board",      DATASET_UINT32, 3*sizeof(guint32), 0 },
+  { "player",     DATASET_UINT8,  sizeof(guint8),    0 },
+  { "moves_left", DATASET_UINT8,  sizeof(guint8),    0 },
+  { "result",     DATASET_INT8,   sizeof(gint8),     0 },
+  { "think_us",   DATASET_INT64,  sizeof(gint64),    0 },
+  { "client",     DATASET_UINT8,  sizeof(guint8),    0 },
+  { "game",       DATASET_UINT32, sizeof(guint32),   0 }
+};
+
+/*!
+ * \brief
+ * The columns of one session, with every number already little-endian
+ */
+typedef struct {
+  /*! \brief The file name of the session */
+  const gchar *path;
+  /*! \brief The values of each ::fixed_column_t */
+  GArray      *columns[N_FIXED_COLUMNS];
+  /*! \brief The metrics keys, in order of appearance */
+  GPtrArray   *keys;
+  /*! \brief Maps each key to its GArray of doubles, which may be shorter
+             than the other columns where the last rows lack the key */
+  GHashTable  *metrics;
+  /*! \brief Number of games */
+  guint32      n_games;
+  /*! \brief The error if the session couldn't be read, or \c NULL */
+  GError      *error;
+} part_t;
+
+/*!
+ * \brief
+ * Appends a double to an array, as little-endian
+ *
+ * \param[in,out] array  the GArray of doubles
+ * \param[in]     value  the number
+ */
+static void
+append_double(GArray * const array, const gdouble value)
+{
+  union { gdouble d; guint64 u; } number;
+
+  number.d = value;
+  number.u = GUINT64_TO_LE(number.u);
+  g_array_append_val(array, number.d);
+}
+
+/*!
+ * \brief
+ * Pads a metrics column with missing values up to a number of rows
+ *
+ * \param[in,out] array   the GArray of doubles
+ * \param[in]     n_rows  the number of rows
+ */
+static void
+pad_metrics(GArray * const array, const guint n_rows)
+{
+  while (array->len < n_rows) append_double(array, NAN);
+}
+
+/*!
+ * \brief
+ * Appends the value of a key to the row being collected, following the
+ * signature of ::metrics_func_t
+ *
+ * \param[in] key        the key
+ * \param[in] value      the value, which is missing unless it's a number
+ * \param[in] user_data  the ::part_t, whose last row is being collected
+ */
+static void
+collect_metrics(const gchar *key, const gchar *value, gpointer user_data)
+{
+  part_t * const part = user_data;
+  const guint row = part->columns[COLUMN_BOARD]->len - 1;
+  GArray *array;
+  gchar *end;
+  gdouble number;
+
+  array = g_hash_table_lookup(part->metrics, key);
+  if (array == NULL) {
+    gchar * const name = g_strdup(key);
+    array = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    g_ptr_array_add(part->keys, name);
+    g_hash_table_insert(part->metrics, name, array);
+  }
+  /* a key that appears twice in a reply keeps its first value */
+  if (array->len > row) return;
+  pad_metrics(array, row);
+  number = g_ascii_strtod(value, &end);
+  append_double(array, end != value && *end == '\0' ? number : NAN);
+}
+
+/*!
+ * \brief
+ * Collects the columns of a session, following the signature of \c GFunc
+ *
+ * \param[in] data       the ::part_t, whose #path is set
+ * \param[in] user_data  not used
+ */
+static void
+collect_job(gpointer data, gpointer user_data)
+{
+  part_t * const part = data;
+  session_t *session;
+  guint game_start = 0;
+  guint64 n_moves;
+
+  UNUSED(user_data);
+
+  session = session_open(part->path, &part->error);
+  if (session == NULL) return;
+
+  n_moves = session_get_n_moves(session);
+  for (guint64 n = 0; n < n_moves; ++n) {
+    const session_record_t * const record = session_get_record(session, n);
+    const guint rows = part->columns[COLUMN_BOARD]->len;
+    guint32 bits[3] = { 0, 0, 0 };
+    reply_stats_t stats;
+    metrics_t *metrics;
+    const gchar *text;
+    gsize length;
+    guint8 byte;
+    gint64 think_us;
+    guint32 game;
+
+    /* a corrupt record ends the session, as if it was never closed */
+    if (record == NULL) break;
+    if (!(record->flags & SESSION_PARSED)) continue;
+
+    /* a result belongs to the rows of its game, and isn't a row */
+    if (record->action <= -2 && record->action >= -4) {
+      const gint8 result = record->action == -2 ?  1
+                         : record->action == -3 ? -1 : 0;
+      for (guint i = game_start; i < rows; ++i) {
+        g_array_index(part->columns[COLUMN_RESULT], gint8, i) = result;
+      }
+      continue;
+    }
+    if (record->action == -1 && rows > game_start) {
+      game_start = rows;
+      ++part->n_games;
+    }
+
+    for (guint8 i = 0; i < NUM_DARK_SQ; ++i) {
+      switch (record->board[i]) {
+      case 'R': bits[2] |= 1u << i; /* FALLTHROUGH */
+      case 'r': bits[0] |= 1u << i; break;
+      case 'W': bits[2] |= 1u << i; /* FALLTHROUGH */
+      case 'w': bits[1] |= 1u << i; break;
+      }
+    }
+    for (guint8 i = 0; i < 3; ++i) bits[i] = GUINT32_TO_LE(bits[i]);
+    g_array_append_vals(part->columns[COLUMN_BOARD], bits, 1);
+    byte = record->next_player == 'r' ? 0 : 1;
+    g_array_append_val(part->columns[COLUMN_PLAYER], byte);
+    g_array_append_val(part->columns[COLUMN_MOVES_LEFT],
+                       record->moves_left);
+    byte = (guint8)DATASET_RESULT_UNKNOWN;
+    g_array_append_val(part->columns[COLUMN_RESULT], byte);
+    session_get_reply_stats(session, record, &stats);
+    think_us = GINT64_TO_LE(stats.think_us);
+    g_array_append_val(part->columns[COLUMN_THINK_US], think_us);
+    g_array_append_val(part->columns[COLUMN_CLIENT], record->client_id);
+    game = GUINT32_TO_LE(part->n_games);
+    g_array_append_val(part->columns[COLUMN_GAME], game);
+
+    text = session_get_blob(session, record, STDERR, &length);
+    metrics = metrics_new_from_text(text, length);
+    metrics_foreach(metrics, stats.think_us, collect_metrics, part);
+    metrics_free(metrics);
+  }
+  if (part->columns[COLUMN_BOARD]->len > game_start) ++part->n_games;
+  session_close(session);
+}
+
+/*!
+ * \brief
+ * Writes zeros after a column up to a multiple of eight bytes
+ *
+ * \param[in] file  the dataset file
+ * \param[in] size  the number of bytes of the column
+ */
+static void
+write_padding(FILE * const file, const guint64 size)
+{
+  static const gchar zeros[8] = { 0 };
+
+  if (size % 8 != 0) fwrite(zeros, 8 - size % 8, 1, file);
+}
+
+/* documented in dataset.h */
+gboolean
+write_dataset(gchar * const *files, GError **error)
+{
+  extern gchar *option_output;
+  extern guint  option_jobs;
+  GThreadPool *pool;
+  part_t *parts;
+  guint n_parts = 0;
+  GPtrArray *keys;
+  GHashTable *seen;
+  dataset_header_t header;
+  dataset_column_t *columns;
+  guint64 n_rows = 0;
+  guint64 offset;
+  gboolean success = TRUE;
+  FILE *file;
+
+  assert(files != NULL);
+  assert(error == NULL || *error == NULL);
+
+  while (files[n_parts] != NULL) ++n_parts;
+  parts = g_new0(part_t, n_parts);
+  pool = g_thread_pool_new(collect_job, NULL,
+                           option_jobs > 0 ? (gint)option_jobs
+                                           : (gint)g_get_num_processors(),
+                           TRUE, error);
+  if (pool == NULL) {
+    g_free(parts);
+    return FALSE;
+  }
+  for (guint i = 0; i < n_parts; ++i) {
+    parts[i].path = files[i];
+    for (guint8 c = 0; c < N_FIXED_COLUMNS; ++c) {
+      parts[i].columns[c] = g_array_new(FALSE, FALSE,
+                                        fixed_columns[c].width);
+    }
+    parts[i].keys = g_ptr_array_new();
+    parts[i].metrics = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                             g_free,
+                                             (GDestroyNotify)g_array_unref);
+    g_thread_pool_push(pool, &parts[i], NULL);
+  }
+  /* wait for the queued jobs to finish */
+  g_thread_pool_free(pool, FALSE, TRUE);
+
+  /* the columns of the metrics are in order of appearance, as in tsv */
+  keys = g_ptr_array_new();
+  seen = g_hash_table_new(g_str_hash, g_str_equal);
+  for (guint i = 0; i < n_parts; ++i) {
+    if (parts[i].error != NULL && success) {
+      g_propagate_prefixed_error(error, parts[i].error, "%s: ",
+                                 parts[i].path);
+      parts[i].error = NULL;
+      success = FALSE;
+    }
+    n_rows += parts[i].columns[COLUMN_BOARD]->len;
+    for (guint k = 0; k < parts[i].keys->len; ++k) {
+      gchar * const key = g_ptr_array_index(parts[i].keys, k);
+      if (g_hash_table_lookup(seen, key) != NULL) continue;
+      g_hash_table_insert(seen, key, key);
+      g_ptr_array_add(keys, key);
+    }
+  }
+
+  file = NULL;
+  if (success) {
+    if (option_output == NULL || strcmp(option_output, "-") == 0) {
+      file = stdout;
+    } else if ((file = g_fopen(option_output, "wb")) == NULL) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                  "Couldn't open \"%s\" for writing", option_output);
+      success = FALSE;
+    }
+  }
+
+  if (success) {
+    const guint n_columns = N_FIXED_COLUMNS + keys->len;
+
+    /* every column starts at a multiple of eight bytes */
+    columns = g_new0(dataset_column_t, n_columns);
+    offset = sizeof(header) + n_columns*sizeof(dataset_column_t);
+    for (guint c = 0; c < n_columns; ++c) {
+      gsize width;
+      if (c < N_FIXED_COLUMNS) {
+        columns[c] = fixed_columns[c];
+      } else {
+        g_strlcpy(columns[c].name,
+                  g_ptr_array_index(keys, c - N_FIXED_COLUMNS),
+                  sizeof(columns[c].name));
+        columns[c].type = DATASET_FLOAT64;
+        columns[c].width = sizeof(gdouble);
+      }
+      width = columns[c].width;
+      columns[c].type = GUINT32_TO_LE(columns[c].type);
+      columns[c].width = GUINT32_TO_LE(columns[c].width);
+      columns[c].offset = GUINT64_TO_LE(offset);
+      offset += (n_rows*width + 7) & ~G_GUINT64_CONSTANT(7);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+    header.version = GUINT32_TO_LE(DATASET_VERSION);
+    header.n_columns = GUINT32_TO_LE(n_columns);
+    header.n_rows = GUINT64_TO_LE(n_rows);
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(columns, sizeof(dataset_column_t), n_columns, file);
+
+    for (guint c = 0; c < n_columns; ++c) {
+      guint32 game_base = 0;
+      guint64 size = 0;
+
+      for (guint i = 0; i < n_parts; ++i) {
+        const guint rows = parts[i].columns[COLUMN_BOARD]->len;
+        if (c == COLUMN_GAME) {
+          /* the games are numbered across the sessions */
+          GArray * const games = parts[i].columns[COLUMN_GAME];
+          for (guint r = 0; r < rows; ++r) {
+            const guint32 game =
+              GUINT32_FROM_LE(g_array_index(games, guint32, r));
+            g_array_index(games, guint32, r) =
+              GUINT32_TO_LE(game_base + game);
+          }
+          game_base += parts[i].n_games;
+        }
+        if (c < N_FIXED_COLUMNS) {
+          fwrite(parts[i].columns[c]->data, fixed_columns[c].width, rows,
+                 file);
+          size += rows*fixed_columns[c].width;
+        } else {
+          const gchar * const key = g_ptr_array_index(keys,
+                                                      c - N_FIXED_COLUMNS);
+          GArray *array = g_hash_table_lookup(parts[i].metrics, key);
+          if (array == NULL) {
+            array = g_array_new(FALSE, FALSE, sizeof(gdouble));
+            g_hash_table_insert(parts[i].metrics, g_strdup(key), array);
+          }
+          pad_metrics(array, rows);
+          fwrite(array->data, sizeof(gdouble), rows, file);
+          size += rows*sizeof(gdouble);
+        }
+      }
+      write_padding(file, size);
+    }
+    g_free(columns);
+
+    if ((fflush(file) != 0 || ferror(file))) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                  "Couldn't write the output");
+      success = FALSE;
+    }
+  }
+  if (file != NULL && file != stdout) fclose(file);
+
+  g_hash_table_destroy(seen);
+  g_ptr_array_free(keys, TRUE);
+  for (guint i = 0; i < n_parts; ++i) {
+    for (guint8 c = 0; c < N_FIXED_COLUMNS; ++c) {
+      g_array_free(parts[i].columns[c], TRUE);
+    }
+    g_ptr_array_free(parts[i].keys, TRUE);
+    g_hash_table_destroy(parts[i].metrics);
+    if (parts[i].error != NULL) g_error_free(parts[i].error);
+  }
+  g_free(parts);
+  return success;
+}
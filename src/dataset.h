@@ -0,0 +1,108 @@
+/*!
+ * \file dataset.h
+ * \brief
+ * Provides the export of the moves of sessions as a columnar binary dataset,
+ * laid out so that each column can be mapped into memory as an array
+ */
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <gtk/gtk.h>
+
+/*! \brief The export format (option \c -E) that writes a dataset */
+#define DATASET_FORMAT "dataset"
+
+/*! \brief The first eight bytes of every dataset file */
+#define DATASET_MAGIC "CKVDSET"
+
+/*! \brief The version of the file format written by this program */
+#define DATASET_VERSION 1
+
+/*! \brief Size of the name of a column, including the terminating zero */
+#define DATASET_NAME_SIZE 32
+
+/*! \brief The result of a game that has no result in the session */
+#define DATASET_RESULT_UNKNOWN G_MININT8
+
+/*! \brief The type of the values of a column */
+typedef enum {
+  DATASET_UINT8,   /*!< unsigned 8-bit integers */
+  DATASET_INT8,    /*!< signed 8-bit integers */
+  DATASET_UINT32,  /*!< unsigned 32-bit integers */
+  DATASET_INT64,   /*!< signed 64-bit integers */
+  DATASET_FLOAT64  /*!< IEEE 754 doubles, NaN where a value is missing */
+} dataset_type_t;
+
+/*!
+ * \brief
+ * Header at the beginning of a dataset file (all numbers little-endian),
+ * followed by a ::dataset_column_t for each column
+ */
+typedef struct {
+  /*! \brief #DATASET_MAGIC including the terminating zero */
+  gchar   magic[8];
+  /*! \brief #DATASET_VERSION of the writer */
+  guint32 version;
+  /*! \brief Number of columns */
+  guint32 n_columns;
+  /*! \brief Number of rows, which is the same in every column */
+  guint64 n_rows;
+} dataset_header_t;
+
+/*!
+ * \brief
+ * The location of one column in a dataset file
+ *
+ * A column is an array of \c n_rows values of #width bytes, each made of
+ * one or more numbers of #type, and starts at an offset divisible by eight.
+ * The columns are, in order:
+ *
+ * - \c board: three ::DATASET_UINT32, the bits of the red pieces, of the
+ *   white pieces and of the kings, where bit N is square N+1
+ * - \c player: ::DATASET_UINT8, the player to move, 0 for red and 1 for
+ *   white
+ * - \c moves_left: ::DATASET_UINT8, the moves left before the game is drawn
+ * - \c result: ::DATASET_INT8, 1 if red won the game, -1 if white won, 0
+ *   for a draw, or #DATASET_RESULT_UNKNOWN
+ * - \c think_us: ::DATASET_INT64, the time that the client took to reply in
+ *   microseconds, or -1 if unknown
+ * - \c client: ::DATASET_UINT8, the client that wrote the board, 0 or 1
+ * - \c game: ::DATASET_UINT32, the number of the game, counted across the
+ *   sessions from zero
+ *
+ * followed by a ::DATASET_FLOAT64 column for each key that the clients wrote
+ * to stderr, as selected by option \c -M (see metrics.h), named after the
+ * key (cut to fit #name).
+ */
+typedef struct {
+  /*! \brief The name of the column, terminated by zeros */
+  gchar   name[DATASET_NAME_SIZE];
+  /*! \brief The ::dataset_type_t of the numbers */
+  guint32 type;
+  /*! \brief Number of bytes of each value */
+  guint32 width;
+  /*! \brief Offset of the column from the beginning of the file */
+  guint64 offset;
+} dataset_column_t;
+
+/*!
+ * \brief
+ * Writes the boards of one or more sessions as a dataset, to the file set
+ * by option \c -o or to standard output
+ *
+ * Each session is read in one of the worker threads set by option \c -j.
+ * Every parsed board is a row, except for the results of games, which set
+ * the \c result of the rows of their game instead.
+ *
+ * \param[in] files  a \c NULL-terminated array of session files
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * whether every session was read and the dataset was written
+ */
+gboolean
+write_dataset(gchar * const *files, GError **error);
+
+#endif /* DATASET_H */
@@ -0,0 +1,294 @@
+/*!
+ * \file diverge.c
+ * \brief
+ * Compares recorded runs by the keys of the boards of their rows, one pair
+ * of files per job in a pool of worker threads.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "diverge.h"
+#include "positions.h"
+#include "protocol.h"
+#include "rules.h"
+
+/*! \brief The rows of a file as they are read */
+typedef struct {
+  /*! \brief The key of each row */
+  GArray *keys;
+  /*! \brief The message of each row, or \c NULL */
+  GArray *messages;
+  /*! \brief Number of rows in the arrays before the file was read */
+  guint   first;
+} rows_t;
+
+/*! \brief A pair of files to compare, and the outcome */
+typedef struct {
+  /*! \brief The file names */
+  gchar    *paths[2];
+  /*! \brief The first row where the files differ, or -1 if they're the
+             same */
+  gint      row;
+  /*! \brief Whether both files were read */
+  gboolean  is_read;
+} pair_t;
+
+/*! \brief State shared between the worker threads */
+typedef struct {
+  /*! \brief Protects #error */
+  GMutex  mutex;
+  /*! \brief The error of the first pair that couldn't be read, or \c NULL */
+  GError *error;
+} diverge_state_t;
+
+/*!
+ * \brief
+ * Stores the key and message of a row, following the signature of
+ * ::positions_row_func_t
+ *
+ * \param[in] row        the row
+ * \param[in] message    the message of the row
+ * \param[in] user_data  the ::rows_t
+ */
+static void
+add_row(const guint32           row,
+        const message_t * const message,
+        const gpointer          user_data)
+{
+  rows_t * const rows = user_data;
+  const guint index = rows->first + row;
+  position_t position;
+
+  if (!get_position(message, &position)) return;
+  /* the rows in between have no board, and are left as zeros */
+  if (index >= rows->keys->len) g_array_set_size(rows->keys, index + 1);
+  g_array_index(rows->keys, guint64, index) = get_position_key(&position);
+  if (rows->messages != NULL) {
+    if (index >= rows->messages->len) {
+      g_array_set_size(rows->messages, index + 1);
+    }
+    g_array_index(rows->messages, message_t, index) = *message;
+  }
+}
+
+/* documented in diverge.h */
+gboolean
+diverge_read_file(const gchar  *path,
+                  GArray       *keys,
+                  GArray       *messages,
+                  GError      **error)
+{
+  rows_t rows;
+
+  assert(path != NULL);
+  assert(keys != NULL);
+  assert(error == NULL || *error == NULL);
+
+  rows.keys = keys;
+  rows.messages = messages;
+  rows.first = keys->len;
+  return positions_read_file(path, add_row, &rows, error);
+}
+
+/* documented in diverge.h */
+gint
+diverge_find(const GArray *keys_a, const GArray *keys_b)
+{
+  const guint64 * const a = (const guint64 *)keys_a->data;
+  const guint64 * const b = (const guint64 *)keys_b->data;
+  const guint n = MIN(keys_a->len, keys_b->len);
+  guint row = 0;
+
+  while (row < n && a[row] == b[row]) ++row;
+  if (row == keys_a->len && row == keys_b->len) return -1;
+  return row;
+}
+
+/*!
+ * \brief
+ * Compares a pair of files, following the signature of \c GFunc
+ *
+ * \param[in] data       the ::pair_t
+ * \param[in] user_data  the ::diverge_state_t
+ */
+static void
+diverge_job(gpointer data, gpointer user_data)
+{
+  pair_t * const pair = data;
+  diverge_state_t * const state = user_data;
+  GArray *keys[2];
+  GError *error = NULL;
+
+  for (guint8 i = 0; i < 2; ++i) {
+    keys[i] = g_array_new(FALSE, TRUE, sizeof(guint64));
+  }
+  if (diverge_read_file(pair->paths[0], keys[0], NULL, &error) &&
+      diverge_read_file(pair->paths[1], keys[1], NULL, &error)) {
+    pair->row = diverge_find(keys[0], keys[1]);
+    pair->is_read = TRUE;
+  } else {
+    g_mutex_lock(&state->mutex);
+    if (state->error == NULL) {
+      state->error = error;
+      error = NULL;
+    }
+    g_mutex_unlock(&state->mutex);
+    g_clear_error(&error);
+  }
+  for (guint8 i = 0; i < 2; ++i) g_array_free(keys[i], TRUE);
+}
+
+/*!
+ * \brief
+ * Compares strings, following the signature of \c GCompareFunc for the
+ * elements of a \c GPtrArray
+ *
+ * \param[in] a  a pointer to the first string
+ * \param[in] b  a pointer to the second string
+ *
+ * \return
+ * as for \c strcmp()
+ */
+static gint
+compare_names(gconstpointer a, gconstpointer b)
+{
+  return strcmp(*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+/*!
+ * \brief
+ * Adds a pair of files to compare, or the pairs of files with the same name
+ * if both are directories
+ *
+ * \param[in]     path_a  the first file or directory
+ * \param[in]     path_b  the second file or directory
+ * \param[in,out] pairs   the array of ::pair_t to add to
+ * \param[in,out] state   the state, whose #error is set if it's the first
+ *                        and the first directory can't be read
+ */
+static void
+add_pairs(const gchar * const     path_a,
+          const gchar * const     path_b,
+          GArray * const          pairs,
+          diverge_state_t * const state)
+{
+  pair_t pair = { { NULL, NULL }, -1, FALSE };
+
+  if (g_file_test(path_a, G_FILE_TEST_IS_DIR) &&
+      g_file_test(path_b, G_FILE_TEST_IS_DIR)) {
+    GError *error = NULL;
+    GDir * const handle = g_dir_open(path_a, 0, &error);
+    GPtrArray *names;
+    const gchar *name;
+
+    if (handle == NULL) {
+      /* as for a file that can't be read */
+      if (state->error == NULL) {
+        state->error = error;
+      } else {
+        g_error_free(error);
+      }
+      return;
+    }
+    names = g_ptr_array_new_with_free_func(g_free);
+    while ((name = g_dir_read_name(handle)) != NULL) {
+      g_ptr_array_add(names, g_strdup(name));
+    }
+    g_dir_close(handle);
+    /* in the same order on every run */
+    g_ptr_array_sort(names, compare_names);
+    for (guint i = 0; i < names->len; ++i) {
+      name = g_ptr_array_index(names, i);
+      pair.paths[0] = g_build_filename(path_a, name, NULL);
+      pair.paths[1] = g_build_filename(path_b, name, NULL);
+      if (g_file_test(pair.paths[0], G_FILE_TEST_IS_REGULAR) &&
+          g_file_test(pair.paths[1], G_FILE_TEST_IS_REGULAR)) {
+        g_array_append_val(pairs, pair);
+      } else {
+        g_free(pair.paths[0]);
+        g_free(pair.paths[1]);
+      }
+    }
+    g_ptr_array_free(names, TRUE);
+  } else {
+    pair.paths[0] = g_strdup(path_a);
+    pair.paths[1] = g_strdup(path_b);
+    g_array_append_val(pairs, pair);
+  }
+}
+
+/* documented in diverge.h */
+gboolean
+run_diverge(gchar * const *args, GError **error)
+{
+  extern guint option_jobs;
+  diverge_state_t state;
+  GThreadPool *pool;
+  GArray *pairs;
+  guint n_args = 0;
+  guint n_differ = 0;
+  gint64 start_us;
+
+  assert(args != NULL);
+  assert(error == NULL || *error == NULL);
+
+  while (args[n_args] != NULL) ++n_args;
+  if (n_args == 0 || n_args % 2 != 0) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Expected " DIVERGE_COMMAND " FILE1 FILE2...");
+    return FALSE;
+  }
+
+  start_us = g_get_monotonic_time();
+  g_mutex_init(&state.mutex);
+  state.error = NULL;
+  pairs = g_array_new(FALSE, FALSE, sizeof(pair_t));
+  for (guint i = 0; i < n_args; i += 2) {
+    add_pairs(args[i], args[i + 1], pairs, &state);
+  }
+
+  pool = g_thread_pool_new(diverge_job, &state,
+                           option_jobs > 0 ? (gint)option_jobs
+                                           : (gint)g_get_num_processors(),
+                           TRUE, error);
+  if (pool != NULL) {
+    for (guint i = 0; i < pairs->len; ++i) {
+      g_thread_pool_push(pool, &g_array_index(pairs, pair_t, i), NULL);
+    }
+    /* wait for the queued pairs to be compared */
+    g_thread_pool_free(pool, FALSE, TRUE);
+  }
+  g_mutex_clear(&state.mutex);
+
+  /* one line per pair, in the order given, with the row counted from one
+     as in the list of moves */
+  for (guint i = 0; i < pairs->len; ++i) {
+    pair_t * const pair = &g_array_index(pairs, pair_t, i);
+    if (pair->is_read) {
+      if (pair->row >= 0) {
+        printf("%d\t%s\t%s\n", pair->row + 1, pair->paths[0],
+               pair->paths[1]);
+        ++n_differ;
+      } else {
+        printf("same\t%s\t%s\n", pair->paths[0], pair->paths[1]);
+      }
+    }
+    g_free(pair->paths[0]);
+    g_free(pair->paths[1]);
+  }
+  fprintf(stderr, "Compared %u pairs in %.3f s, %u of them differ\n",
+          pairs->len, (g_get_monotonic_time() - start_us) / 1e6, n_differ);
+  g_array_free(pairs, TRUE);
+
+  if (pool == NULL) {
+    g_clear_error(&state.error);
+    return FALSE;
+  }
+  if (state.error != NULL) {
+    g_propagate_error(error, state.error);
+    return FALSE;
+  }
+  return TRUE;
+}
@@ -0,0 +1,75 @@
+/*!
+ * \file diverge.h
+ * \brief
+ * Provides the comparison of two recorded runs of the same pairing, which
+ * finds the first row where their boards differ
+ */
+#ifndef DIVERGE_H
+#define DIVERGE_H
+
+#include <gtk/gtk.h>
+
+/*! \brief The word on the command line that compares pairs of files */
+#define DIVERGE_COMMAND "diverge"
+
+/*!
+ * \brief
+ * Reads the key of the board of each row of a session, transcript or PDN
+ * file, with the rows numbered as when the file is loaded in the window
+ *
+ * \param[in]     path      the file name
+ * \param[in,out] keys      an array of \c guint64 that the key of each row
+ *                          (from get_position_key()) is appended to, zero
+ *                          for a row without a board
+ * \param[in,out] messages  either \c NULL, or an array of ::message_t that
+ *                          the message of each row is appended to, cleared
+ *                          to zeros for a row without a board
+ * \param[in]     error     either \c NULL to disregard errors, or the
+ *                          address of a pointer initialized to \c NULL
+ *                          (which should be freed afterwards if set)
+ *
+ * \return
+ * whether the file was read
+ */
+gboolean
+diverge_read_file(const gchar  *path,
+                  GArray       *keys,
+                  GArray       *messages,
+                  GError      **error);
+
+/*!
+ * \brief
+ * Finds the first row where two runs differ
+ *
+ * A row that only one of the runs has counts as a difference.
+ *
+ * \param[in] keys_a  the keys of the first run, from diverge_read_file()
+ * \param[in] keys_b  the keys of the second run
+ *
+ * \return
+ * the number of the row, or -1 if the runs are the same
+ */
+gint
+diverge_find(const GArray *keys_a, const GArray *keys_b);
+
+/*!
+ * \brief
+ * Compares pairs of files in the worker threads set by option \c -j, and
+ * writes the first row where each pair differs to standard output
+ *
+ * A pair of directories stands for every pair of files with the same name
+ * in both of them.
+ *
+ * \param[in] args   a \c NULL-terminated array of file names, taken two at
+ *                   a time
+ * \param[in] error  as for diverge_read_file(), set for the first pair or
+ *                   directory that couldn't be read (the others are still
+ *                   compared)
+ *
+ * \return
+ * whether every pair was compared
+ */
+gboolean
+run_diverge(gchar * const *args, GError **error);
+
+#endif /* DIVERGE_H */
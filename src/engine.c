@@ -0,0 +1,760 @@
+/*!
+ * \file engine.c
+ * \brief
+ * Implements the built-in engine: alpha-beta search over the bitboards of
+ * rules.c, in threads that share a lock-free transposition table.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "engine.h"
+#include "gui.h"
+#include "protocol.h"
+#include "rules.h"
+
+/*! \brief Depth of the search in plies, unless set on the command line */
+#define DEFAULT_DEPTH 8
+
+/*! \brief Number of search threads, unless set on the command line */
+#define DEFAULT_THREADS 1
+
+/*!
+ * \brief
+ * Size of the transposition table in MiB, unless set on the command line
+ */
+#define DEFAULT_HASH_MIB 16
+
+/*! \brief Largest accepted depth, which also bounds the helpers' depths */
+#define MAX_DEPTH 64
+
+/*! \brief Value of a man */
+#define MAN_VALUE 100
+
+/*! \brief Value of a king */
+#define KING_VALUE 160
+
+/*! \brief Value of each row that a man has advanced */
+#define ROW_VALUE 3
+
+/*! \brief Number of nodes between checks of whether to stop searching */
+#define CHECK_INTERVAL 1024
+
+/*! \brief The message that an engine with \c init starts the game with */
+#define SETUP_MESSAGE "rrrrrrrrrrrr........wwwwwwwwwwww -1 r 50\n"
+
+/*! \brief Enumeration of the kinds of scores in the transposition table */
+typedef enum {
+  BOUND_EXACT, /*!< the exact score */
+  BOUND_LOWER, /*!< a lower bound, as the search failed high */
+  BOUND_UPPER  /*!< an upper bound, as the search failed low */
+} bound_t;
+
+/*!
+ * \brief
+ * An entry of the transposition table
+ *
+ * The threads read and write the entries without locks. An entry is only
+ * used if #check equals the key of the position exclusive-ored with #data,
+ * so an entry that another thread has only partly written is ignored.
+ */
+typedef struct {
+  /*! \brief The key of the position exclusive-ored with #data */
+  volatile guint64 check;
+  /*! \brief Score (bits 0-15), depth (16-23), ::bound_t (24-25) and index
+             of the best move in the order of generate_moves() (32-39) */
+  volatile guint64 data;
+} entry_t;
+
+/* documented in engine.h */
+struct engine {
+  /*! \brief Depth of the search in plies */
+  guint                 depth;
+  /*! \brief Number of search threads */
+  guint                 n_threads;
+  /*! \brief The transposition table */
+  entry_t              *table;
+  /*! \brief Number of entries in #table minus one (a power of two minus
+             one) */
+  guint64               mask;
+  /*! \brief Function that receives the output */
+  engine_output_func_t  func;
+  /*! \brief Data to pass to #func */
+  gpointer              user_data;
+  /*! \brief Input that doesn't make a whole line yet */
+  GString              *input;
+  /*! \brief The message that the engine is replying to */
+  message_t             message;
+  /*! \brief The latest message received during a reply, which is replied
+             to once that reply has been passed on */
+  message_t             queued;
+  /*! \brief Indicates whether #queued holds a message */
+  gboolean              is_queued;
+  /*! \brief The thread that is replying, or \c NULL */
+  GThread              *thread;
+  /*! \brief Set to nonzero to abandon the reply */
+  volatile gint         is_aborted;
+  /*! \brief Set to nonzero to stop the helper threads */
+  volatile gint         is_searched;
+  /*! \brief Indicates whether the game is over for the engine */
+  gboolean              is_finished;
+  /*! \brief Event source that passes on #stats and #reply, or zero */
+  guint                 source_output;
+  /*! \brief Statistics to pass on, or \c NULL */
+  gchar                *stats;
+  /*! \brief Message to pass on, or \c NULL */
+  gchar                *reply;
+};
+
+/*! \brief The state of one search thread */
+typedef struct {
+  /*! \brief The engine */
+  engine_t      *engine;
+  /*! \brief The flag that stops this thread */
+  volatile gint *stop;
+  /*! \brief The position to search */
+  position_t     root;
+  /*! \brief The first depth to search, which differs between threads */
+  guint          first_depth;
+  /*! \brief Number of positions visited */
+  guint64        nodes;
+  /*! \brief Set once #stop has been seen */
+  gboolean       is_stopped;
+} worker_t;
+
+static gpointer
+reply_thread(gpointer data);
+
+/*!
+ * \brief
+ * Sums the number of rows that the men of a player have advanced
+ *
+ * \param[in] men     the men
+ * \param[in] is_red  whether the men are red, which advance towards row 7
+ *
+ * \return
+ * the number of rows
+ */
+static gint
+count_advance(const guint32 men, const gboolean is_red)
+{
+  gint rows = 0;
+
+  for (guint8 row = 0; row < 8; ++row) {
+    rows += count_bits(men & (guint32)0xf << 4*row) *
+            (is_red ? row : 7 - row);
+  }
+  return rows;
+}
+
+/*!
+ * \brief
+ * Evaluates a quiet position statically
+ *
+ * \param[in] position  the position
+ *
+ * \return
+ * the score for the player to move
+ */
+static gint
+evaluate(const position_t * const position)
+{
+  const gboolean is_red = position->player == 'r';
+  const guint32 own_men = position->own & ~position->kings;
+  const guint32 opponent_men = position->opponent & ~position->kings;
+
+  return MAN_VALUE * ((gint)count_bits(own_men) -
+                      (gint)count_bits(opponent_men)) +
+         KING_VALUE * ((gint)count_bits(position->own & position->kings) -
+                       (gint)count_bits(position->opponent &
+                                        position->kings)) +
+         ROW_VALUE * (count_advance(own_men, is_red) -
+                      count_advance(opponent_men, !is_red));
+}
+
+/*!
+ * \brief
+ * Looks up a position in the transposition table
+ *
+ * \param[in]  engine  the engine
+ * \param[in]  key     the key of the position
+ * \param[out] data    the data of the entry, as in entry_t::data
+ *
+ * \return
+ * whether the position was found
+ */
+static gboolean
+probe(const engine_t * const engine, const guint64 key, guint64 * const data)
+{
+  const entry_t * const entry = &engine->table[key & engine->mask];
+  const guint64 entry_data = entry->data;
+
+  if ((entry->check ^ entry_data) != key) return FALSE;
+  *data = entry_data;
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Stores a position in the transposition table, replacing what was there
+ *
+ * \param[in] engine  the engine
+ * \param[in] key     the key of the position
+ * \param[in] score   the score, with wins counted from the position
+ * \param[in] depth   the depth that the position was searched to
+ * \param[in] bound   what the score means
+ * \param[in] best    the index of the best move
+ */
+static void
+store(engine_t * const engine,
+      const guint64    key,
+      const gint       score,
+      const gint       depth,
+      const bound_t    bound,
+      const guint      best)
+{
+  entry_t * const entry = &engine->table[key & engine->mask];
+  const guint64 data = (guint64)(guint16)(gint16)score |
+                       (guint64)CLAMP(depth, 0, G_MAXUINT8) << 16 |
+                       (guint64)bound << 24 |
+                       (guint64)best << 32;
+
+  entry->data = data;
+  entry->check = key ^ data;
+}
+
+/*!
+ * \brief
+ * Searches a position with alpha-beta (in the negamax form)
+ *
+ * Jumps are searched beyond the nominal depth until the position is quiet,
+ * since they're forced anyway.
+ *
+ * \param[in,out] worker    the search thread
+ * \param[in]     position  the position
+ * \param[in]     depth     the remaining depth in plies
+ * \param[in]     alpha     the lower bound of the window
+ * \param[in]     beta      the upper bound of the window
+ * \param[in]     ply       the number of plies from the root
+ *
+ * \return
+ * the score for the player to move, or zero if the search was stopped
+ */
+static gint
+search(worker_t * const         worker,
+       const position_t * const position,
+       const gint               depth,
+       gint                     alpha,
+       const gint               beta,
+       const gint               ply)
+{
+  move_t moves[MAX_MOVES];
+  const gint alpha_in = alpha;
+  gint best_score = -ENGINE_SCORE_WIN;
+  guint best = 0;
+  guint tt_best = 0;
+  guint n_moves;
+  guint64 key;
+  guint64 data;
+
+  if (worker->is_stopped ||
+      (++worker->nodes % CHECK_INTERVAL == 0 &&
+       (worker->is_stopped = g_atomic_int_get(worker->stop) != 0))) {
+    return 0;
+  }
+
+  n_moves = generate_moves(position, moves);
+  if (n_moves == 0) return -ENGINE_SCORE_WIN + ply;
+  if (depth <= 0 && moves[0].captured == 0) return evaluate(position);
+
+  key = get_position_key(position);
+  if (probe(worker->engine, key, &data)) {
+    const gint tt_depth = data >> 16 & 0xff;
+    const bound_t bound = data >> 24 & 3;
+    gint score = (gint16)(data & 0xffff);
+
+    if (score > ENGINE_SCORE_WON) score -= ply;
+    if (score < -ENGINE_SCORE_WON) score += ply;
+    if (tt_depth >= depth &&
+        (bound == BOUND_EXACT ||
+         (bound == BOUND_LOWER && score >= beta) ||
+         (bound == BOUND_UPPER && score <= alpha))) return score;
+
+    /* search the best move of the earlier search first */
+    tt_best = data >> 32 & 0xff;
+    if (tt_best < n_moves) {
+      const move_t move = moves[0];
+      moves[0] = moves[tt_best];
+      moves[tt_best] = move;
+    } else {
+      tt_best = 0;
+    }
+  }
+
+  for (guint i = 0; i < n_moves; ++i) {
+    position_t child;
+    gint score;
+
+    make_move(position, &moves[i], &child);
+    score = -search(worker, &child, depth - 1, -beta, -alpha, ply + 1);
+    if (worker->is_stopped) return 0;
+    if (score > best_score) {
+      best_score = score;
+      best = i;
+    }
+    if (score > alpha) alpha = score;
+    if (alpha >= beta) break;
+  }
+
+  /* undo the swap, so that the index is that of generate_moves() */
+  if (best == 0) {
+    best = tt_best;
+  } else if (best == tt_best) {
+    best = 0;
+  }
+  store(worker->engine, key,
+        best_score > ENGINE_SCORE_WON ? best_score + ply :
+        best_score < -ENGINE_SCORE_WON ? best_score - ply : best_score,
+        depth,
+        best_score >= beta ? BOUND_LOWER :
+        best_score <= alpha_in ? BOUND_UPPER : BOUND_EXACT,
+        best);
+  return best_score;
+}
+
+/*!
+ * \brief
+ * Searches the root position to a given depth
+ *
+ * \param[in,out] worker  the search thread
+ * \param[in]     moves   the moves of the root position
+ * \param[in]     n_moves the number of moves, at least one
+ * \param[in]     depth   the depth in plies
+ * \param[in,out] best    the index of the best move, which is searched first
+ *
+ * \return
+ * the score of the best move, or zero if the search was stopped
+ */
+static gint
+search_root(worker_t * const     worker,
+            const move_t * const moves,
+            const guint          n_moves,
+            const gint           depth,
+            guint * const        best)
+{
+  gint alpha = -ENGINE_SCORE_WIN - 1;
+  guint new_best = *best;
+
+  for (guint n = 0; n < n_moves; ++n) {
+    /* the previous best move first, and then the others in order */
+    const guint i = n == 0 ? *best : n <= *best ? n - 1 : n;
+    position_t child;
+    gint score;
+
+    make_move(&worker->root, &moves[i], &child);
+    score = -search(worker, &child, depth - 1, -ENGINE_SCORE_WIN - 1,
+                    -alpha, 1);
+    if (worker->is_stopped) return 0;
+    if (score > alpha) {
+      alpha = score;
+      new_best = i;
+    }
+  }
+  *best = new_best;
+  return alpha;
+}
+
+/*!
+ * \brief
+ * Searches the root position at ever greater depths until stopped, to fill
+ * the transposition table for the main thread
+ *
+ * \param[in] data  the ::worker_t
+ *
+ * \return
+ * \c NULL
+ */
+static gpointer
+helper_thread(gpointer data)
+{
+  worker_t * const worker = data;
+  move_t moves[MAX_MOVES];
+  const guint n_moves = generate_moves(&worker->root, moves);
+  guint best = 0;
+
+  for (guint depth = worker->first_depth;
+       depth <= MAX_DEPTH && !worker->is_stopped; ++depth) {
+    search_root(worker, moves, n_moves, depth, &best);
+  }
+  return NULL;
+}
+
+/*!
+ * \brief
+ * Formats a move as a message
+ *
+ * \param[in] before  the message that the move replies to
+ * \param[in] move    the move
+ *
+ * \return
+ * the message, ending with a newline, in a string that should be freed
+ */
+static gchar *
+format_reply(const message_t * const before, const move_t * const move)
+{
+  GString *reply = g_string_sized_new(64);
+  position_t position;
+  position_t after;
+  gchar board[NUM_DARK_SQ];
+
+  get_position(before, &position);
+  make_move(&position, move, &after);
+  put_board(&after, board);
+  g_string_append_len(reply, board, NUM_DARK_SQ);
+  g_string_append_printf(reply, " %d", move->n_squares - 1 -
+                                       (move->captured == 0));
+  for (guint8 i = 0; i < move->n_squares; ++i) {
+    g_string_append_printf(reply, "_%u", move->squares[i] + 1);
+  }
+  /* only a jump resets the number of moves left */
+  g_string_append_printf(reply, " %c %u\n", after.player,
+                         move->captured != 0 ? MOVES_LEFT :
+                         MAX(before->moves_left, 1) - 1);
+  return g_string_free(reply, FALSE);
+}
+
+/*!
+ * \brief
+ * Callback that passes the output of an engine on from the main loop
+ *
+ * \param[in] data  the engine
+ *
+ * \return
+ * \c FALSE, to remove the event source
+ */
+static gboolean
+output_callback(gpointer data)
+{
+  engine_t * const engine = data;
+  const engine_output_func_t func = engine->func;
+  const gpointer user_data = engine->user_data;
+  gchar *stats;
+  gchar *reply;
+  message_t message;
+  gboolean is_dropped;
+
+  /* the thread may still be storing the id of this source */
+  if (engine->thread != NULL) {
+    g_thread_join(engine->thread);
+    engine->thread = NULL;
+  }
+  stats = engine->stats;
+  reply = engine->reply;
+  engine->stats = NULL;
+  engine->reply = NULL;
+  engine->source_output = 0;
+  /* a game that ended during the reply has nothing to reply to */
+  is_dropped = engine->is_finished;
+  if (parse_message(reply, &message) &&
+      message.action <= -2 && message.action >= -4) {
+    engine->is_finished = TRUE;
+  }
+  if (engine->is_queued && !engine->is_finished) {
+    engine->message = engine->queued;
+    engine->is_queued = FALSE;
+    engine->thread = g_thread_new("engine", reply_thread, engine);
+  }
+  if (is_dropped) {
+    g_free(stats);
+    g_free(reply);
+    return FALSE;
+  }
+
+  /* the engine may be freed by the receiving end, so it's not used after
+     this point */
+  if (stats != NULL) func(STDERR, stats, strlen(stats), user_data);
+  func(STDOUT, reply, strlen(reply), user_data);
+  g_free(stats);
+  g_free(reply);
+  return FALSE;
+}
+
+/*!
+ * \brief
+ * Thinks of a reply to the message that an engine has received, and hands
+ * it over to the main loop
+ *
+ * \param[in] data  the engine
+ *
+ * \return
+ * \c NULL
+ */
+static gpointer
+reply_thread(gpointer data)
+{
+  engine_t * const engine = data;
+  const message_t * const message = &engine->message;
+  worker_t * const workers = g_new0(worker_t, engine->n_threads);
+  GThread ** const threads = g_new0(GThread *, engine->n_threads);
+  move_t moves[MAX_MOVES];
+  guint n_moves;
+  guint best = 0;
+  gint score = 0;
+  guint depth = 0;
+  guint64 nodes = 0;
+
+  get_position(message, &workers[0].root);
+  n_moves = generate_moves(&workers[0].root, moves);
+
+  if (message->moves_left == 0) {
+    engine->reply = g_strdup_printf("%.*s -4 %c 0\n", NUM_DARK_SQ,
+                                    message->board,
+                                    message->next_player == 'r' ? 'w' : 'r');
+  } else if (n_moves == 0) {
+    /* the player to move has lost */
+    engine->reply = g_strdup_printf("%.*s %d %c %u\n", NUM_DARK_SQ,
+                                    message->board,
+                                    message->next_player == 'r' ? -3 : -2,
+                                    message->next_player == 'r' ? 'w' : 'r',
+                                    message->moves_left);
+  } else {
+    g_atomic_int_set(&engine->is_searched, 0);
+    for (guint i = 0; i < engine->n_threads; ++i) {
+      workers[i].engine = engine;
+      workers[i].root = workers[0].root;
+      workers[i].stop = i == 0 ? &engine->is_aborted : &engine->is_searched;
+      /* half of the helpers start one ply deeper, so that the threads
+         spread over more of the tree */
+      workers[i].first_depth = 1 + (i & 1);
+      if (i > 0 && n_moves > 1) {
+        threads[i] = g_thread_new("helper", helper_thread, &workers[i]);
+      }
+    }
+
+    /* a forced move is played at once */
+    for (guint d = 1; d <= engine->depth && n_moves > 1; ++d) {
+      const gint d_score = search_root(&workers[0], moves, n_moves, d,
+                                       &best);
+      if (workers[0].is_stopped) break;
+      score = d_score;
+      depth = d;
+    }
+
+    g_atomic_int_set(&engine->is_searched, 1);
+    for (guint i = 0; i < engine->n_threads; ++i) {
+      if (threads[i] != NULL) g_thread_join(threads[i]);
+      nodes += workers[i].nodes;
+    }
+    engine->stats = g_strdup_printf("depth=%u score=%d nodes=%"
+                                    G_GUINT64_FORMAT " threads=%u\n",
+                                    depth, score, nodes,
+                                    engine->n_threads);
+    engine->reply = format_reply(message, &moves[best]);
+  }
+  g_free(threads);
+  g_free(workers);
+
+  if (!g_atomic_int_get(&engine->is_aborted)) {
+    engine->source_output = g_idle_add(output_callback, engine);
+  }
+  return NULL;
+}
+
+/*!
+ * \brief
+ * Reads the options of the command line of an engine
+ *
+ * \param[in,out] engine  the engine
+ * \param[in]     cmd     the command line
+ * \param[out]    is_init whether the engine sends the first message
+ * \param[in]     error   as for engine_new()
+ *
+ * \return
+ * whether the command line is valid
+ */
+static gboolean
+parse_cmd(engine_t * const    engine,
+          const gchar * const cmd,
+          gboolean * const    is_init,
+          GError            **error)
+{
+  gchar **words = g_strsplit(cmd, " ", 0);
+  gchar **options = NULL;
+  guint hash_mib = DEFAULT_HASH_MIB;
+  gboolean success = TRUE;
+
+  *is_init = FALSE;
+  if (strncmp(words[0], ENGINE_PREFIX ":", strlen(ENGINE_PREFIX) + 1) == 0) {
+    options = g_strsplit(words[0] + strlen(ENGINE_PREFIX) + 1, ",", 0);
+  } else if (strcmp(words[0], ENGINE_PREFIX) != 0) {
+    success = FALSE;
+  }
+  for (gchar **option = options; success && option != NULL && *option != NULL;
+       ++option) {
+    guint value;
+    gchar *end;
+
+    if (strchr(*option, '=') == NULL) {
+      success = FALSE;
+      break;
+    }
+    value = strtoul(strchr(*option, '=') + 1, &end, 10);
+    if (*end != '\0' || value == 0) {
+      success = FALSE;
+    } else if (g_str_has_prefix(*option, "depth=")) {
+      engine->depth = MIN(value, MAX_DEPTH);
+    } else if (g_str_has_prefix(*option, "threads=")) {
+      engine->n_threads = value;
+    } else if (g_str_has_prefix(*option, "hash=")) {
+      hash_mib = value;
+    } else {
+      success = FALSE;
+    }
+  }
+  for (gchar **word = words + 1; success && *word != NULL; ++word) {
+    if (strcmp(*word, "init") == 0) {
+      *is_init = TRUE;
+    } else if (**word != '\0') {
+      success = FALSE;
+    }
+  }
+  g_strfreev(options);
+  g_strfreev(words);
+
+  if (!success) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Invalid engine \"%s\" (expected " ENGINE_PREFIX
+                "[:depth=N,threads=N,hash=MIB] [init])", cmd);
+    return FALSE;
+  }
+
+  /* the largest power of two that fits */
+  engine->mask = 1;
+  while (engine->mask * 2 * sizeof(entry_t) <= (guint64)hash_mib << 20) {
+    engine->mask *= 2;
+  }
+  --engine->mask;
+  return TRUE;
+}
+
+/* documented in engine.h */
+engine_t *
+engine_new(const gchar          *cmd,
+           engine_output_func_t  func,
+           gpointer              user_data,
+           GError              **error)
+{
+  engine_t *engine;
+  gboolean is_init;
+
+  assert(cmd != NULL);
+  assert(error == NULL || *error == NULL);
+
+  engine = g_new0(engine_t, 1);
+  engine->depth = DEFAULT_DEPTH;
+  engine->n_threads = DEFAULT_THREADS;
+  if (!parse_cmd(engine, cmd, &is_init, error)) {
+    g_free(engine);
+    return NULL;
+  }
+  assert(func != NULL || !is_init);
+  engine->table = g_new0(entry_t, engine->mask + 1);
+  engine->func = func;
+  engine->user_data = user_data;
+  engine->input = g_string_new(NULL);
+  if (is_init) {
+    engine->reply = g_strdup(SETUP_MESSAGE);
+    engine->source_output = g_idle_add(output_callback, engine);
+  }
+  return engine;
+}
+
+/* documented in engine.h */
+void
+engine_receive(engine_t *engine, const gchar *text, gsize len)
+{
+  const gchar *newline;
+
+  assert(engine != NULL);
+
+  g_string_append_len(engine->input, text, len);
+  while (!engine->is_finished &&
+         (newline = memchr(engine->input->str, '\n',
+                           engine->input->len)) != NULL) {
+    message_t message;
+    const gboolean is_parsed = parse_message(engine->input->str, &message);
+
+    g_string_erase(engine->input, 0, newline + 1 - engine->input->str);
+    /* a message that can't be replied to, like a client that doesn't
+       understand, or a result ends the game, and any reply to a message
+       before it is abandoned */
+    if (!is_parsed || (message.action <= -2 && message.action >= -4)) {
+      engine->is_finished = TRUE;
+      g_atomic_int_set(&engine->is_aborted, 1);
+    } else if (engine->thread == NULL && engine->source_output == 0) {
+      engine->message = message;
+      engine->thread = g_thread_new("engine", reply_thread, engine);
+    } else {
+      /* the thread reads the message until it has replied */
+      engine->queued = message;
+      engine->is_queued = TRUE;
+    }
+  }
+}
+
+/* documented in engine.h */
+gint
+engine_score(engine_t         *engine,
+             const position_t *position,
+             guint             depth,
+             volatile gint    *stop)
+{
+  worker_t worker;
+  move_t moves[MAX_MOVES];
+  guint n_moves;
+  guint best = 0;
+  gint score = 0;
+
+  assert(engine != NULL);
+  assert(position != NULL);
+  assert(stop != NULL);
+
+  memset(&worker, 0, sizeof(worker));
+  worker.engine = engine;
+  worker.stop = stop;
+  worker.root = *position;
+  n_moves = generate_moves(position, moves);
+  if (n_moves == 0) return -ENGINE_SCORE_WIN;
+
+  for (guint d = 1; d <= MIN(depth, MAX_DEPTH); ++d) {
+    const gint d_score = search_root(&worker, moves, n_moves, d, &best);
+    if (worker.is_stopped) break;
+    score = d_score;
+  }
+  return score;
+}
+
+/* documented in engine.h */
+gboolean
+engine_is_finished(const engine_t *engine)
+{
+  assert(engine != NULL);
+
+  return engine->is_finished;
+}
+
+/* documented in engine.h */
+void
+engine_free(engine_t *engine)
+{
+  if (engine == NULL) return;
+
+  g_atomic_int_set(&engine->is_aborted, 1);
+  if (engine->thread != NULL) g_thread_join(engine->thread);
+  if (engine->source_output != 0) g_source_remove(engine->source_output);
+  g_free(engine->stats);
+  g_free(engine->reply);
+  g_string_free(engine->input, TRUE);
+  g_free(engine->table);
+  g_free(engine);
+}
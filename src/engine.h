@@ -0,0 +1,145 @@
+/*!
+ * \file engine.h
+ * \brief
+ * Provides a built-in opponent, which plays in a thread of the visualizer
+ * instead of as a client process
+ *
+ * The engine is chosen in place of a command line, as
+ * <tt>@engine[:KEY=VALUE[,KEY=VALUE]...] [init]</tt>, where the keys are
+ * \c depth (the depth of the search in plies, default 8), \c threads (the
+ * number of search threads, default 1) and \c hash (the size of the
+ * transposition table in MiB, default 16), and \c init makes the engine send
+ * the first message like the skeleton client. It replies to the messages it
+ * receives just like a client, and writes a line of \c key=value statistics
+ * before each reply as if to stderr.
+ *
+ * The search is alpha-beta with iterative deepening. Extra threads search
+ * the same position at staggered depths and share the transposition table
+ * without locks (lazy SMP), so that the main thread finds more of its
+ * positions already searched.
+ */
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <gtk/gtk.h>
+#include "rules.h"
+
+/*! \brief Beginning of a command line that runs the built-in engine */
+#define ENGINE_PREFIX "@engine"
+
+/*!
+ * \brief
+ * Score of a won position, less the number of plies to the win
+ *
+ * Other scores are in hundredths of a man.
+ */
+#define ENGINE_SCORE_WIN 30000
+
+/*!
+ * \brief
+ * Scores above this (or below its negation) are wins (or losses)
+ */
+#define ENGINE_SCORE_WON (ENGINE_SCORE_WIN - 1000)
+
+/*!
+ * \brief
+ * Function that receives the output of the engine
+ *
+ * \param[in] type       #STDOUT for a message, or #STDERR for statistics
+ * \param[in] text       the output
+ * \param[in] len        the length of \p text in bytes
+ * \param[in] user_data  the data given to engine_new()
+ */
+typedef void (*engine_output_func_t)(guint8       type,
+                                     const gchar *text,
+                                     gsize        len,
+                                     gpointer     user_data);
+
+/*! \brief A running engine (private to engine.c) */
+typedef struct engine engine_t;
+
+/*!
+ * \brief
+ * Starts an engine
+ *
+ * The output is passed to \p func from the main loop, never from within
+ * engine_new() or engine_receive().
+ *
+ * \param[in] cmd        the command line, starting with #ENGINE_PREFIX
+ * \param[in] func       the function to pass the output to, or \c NULL for
+ *                       an engine that is only used with engine_score()
+ * \param[in] user_data  data to pass to \p func
+ * \param[in] error      either \c NULL to disregard errors, or the address
+ *                       of a pointer initialized to \c NULL (which should be
+ *                       freed afterwards if set)
+ *
+ * \return
+ * the engine, or \c NULL if the command line is invalid
+ */
+engine_t *
+engine_new(const gchar          *cmd,
+           engine_output_func_t  func,
+           gpointer              user_data,
+           GError              **error);
+
+/*!
+ * \brief
+ * Hands input to an engine, which starts to think once it has a whole line
+ *
+ * Every whole line is a message. A message that arrives while the engine is
+ * replying is replied to after that reply, and only the latest one is kept.
+ * A result, or a line that isn't a message, ends the game and abandons the
+ * reply in progress.
+ *
+ * \param[in] engine  the engine
+ * \param[in] text    the input
+ * \param[in] len     the length of \p text in bytes
+ */
+void
+engine_receive(engine_t *engine, const gchar *text, gsize len);
+
+/*!
+ * \brief
+ * Searches a position to a depth in the calling thread
+ *
+ * Any number of threads may search with the same engine at once, and share
+ * its transposition table, as long as it isn't replying to messages.
+ *
+ * \param[in] engine    the engine
+ * \param[in] position  the position
+ * \param[in] depth     the depth in plies
+ * \param[in] stop      a flag that abandons the search once it's nonzero
+ *
+ * \return
+ * the score for the player to move (see #ENGINE_SCORE_WIN), which is
+ * meaningless if the search was abandoned
+ */
+gint
+engine_score(engine_t         *engine,
+             const position_t *position,
+             guint             depth,
+             volatile gint    *stop);
+
+/*!
+ * \brief
+ * Checks whether an engine has received or sent the result of the game,
+ * after which it does nothing more
+ *
+ * \param[in] engine  the engine
+ *
+ * \return
+ * whether the game is over for the engine
+ */
+gboolean
+engine_is_finished(const engine_t *engine);
+
+/*!
+ * \brief
+ * Stops an engine, waiting for its threads, and frees it
+ *
+ * \param[in] engine  the engine (or \c NULL)
+ */
+void
+engine_free(engine_t *engine);
+
+#endif /* ENGINE_H */
@@ -0,0 +1,811 @@
+/*!
+ * \file export.c
+ * \brief
+ * Renders recorded games to PNG, SVG or PDF files using a pool of worker
+ * threads, without opening a window, and the game in the window on request.
+ * Animated formats are handed over to video.c, and the games can also be
+ * converted to PDN or to plain messages, checked against the rules, or the
+ * statistics that the clients wrote to stderr can be listed. Datasets are
+ * handed over to dataset.c.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <cairo-pdf.h>
+#include <cairo-svg.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "export.h"
+#include "board.h"
+#include "dataset.h"
+#include "gamelog.h"
+#include "main.h"
+#include "metrics.h"
+#include "pdn.h"
+#include "protocol.h"
+#include "rules.h"
+#include "session.h"
+#include "video.h"
+
+/*! \brief Enumeration of the supported export formats */
+typedef enum {
+  FORMAT_PNG, /*!< one raster image per position */
+  FORMAT_SVG, /*!< one vector image per position */
+  FORMAT_PDF, /*!< one multi-page document per game */
+  N_FORMATS   /*!< number of formats (end of enum) */
+} format_t;
+
+/*! \brief File name extensions (and format names), indexed by ::format_t */
+static const gchar * const extensions[N_FORMATS] = { "png", "svg", "pdf" };
+
+/*!
+ * \brief
+ * A unit of work for the thread pool: one output file
+ */
+typedef struct {
+  /*! \brief Path of the file to write */
+  gchar  *path;
+  /*! \brief \c NULL-terminated array of messages, one per page */
+  gchar **lines;
+} job_t;
+
+/*!
+ * \brief
+ * State shared between the worker threads
+ */
+typedef struct {
+  /*! \brief The format to render */
+  format_t format;
+  /*! \brief Width and height of each page, in pixels or points */
+  gint     size;
+  /*! \brief Protects #error */
+  GMutex   mutex;
+  /*! \brief The first error that occurred, or \c NULL */
+  GError  *error;
+} export_state_t;
+
+/*!
+ * \brief
+ * Draws a single message on a page of the given surface
+ *
+ * \param[in] cr    a Cairo context
+ * \param[in] line  the message to draw
+ * \param[in] size  the width and height of the page
+ */
+static void
+draw_message(cairo_t * const cr, gchar * const line, const gint size)
+{
+  gchar  *board       = NULL;
+  GSList *moves       = NULL;
+  gchar  *description = NULL;
+  gchar  *player      = NULL;
+
+  /* an unparsable line is drawn as an empty board */
+  parse_client_stdout(line, &board, &moves, &description, &player);
+
+  /* draw_board() scales the context, so let every page start afresh */
+  cairo_save(cr);
+  draw_board(cr, size, size, board, moves, NULL);
+  cairo_restore(cr);
+
+  g_free(board);
+  g_slist_free(moves);
+  g_free(description);
+  g_free(player);
+}
+
+/*!
+ * \brief
+ * Renders one job on a surface of its own and writes it to disk
+ *
+ * Follows the signature of \c GFunc, as expected by \c GThreadPool.
+ *
+ * \param[in] data       the ::job_t to render, which is freed afterwards
+ * \param[in] user_data  the shared ::export_state_t
+ */
+static void
+render_job(gpointer data, gpointer user_data)
+{
+  job_t          * const job   = data;
+  export_state_t * const state = user_data;
+  cairo_surface_t *surface;
+  cairo_status_t status;
+  cairo_t *cr;
+
+  assert(job != NULL && job->lines != NULL);
+  assert(state != NULL);
+
+  switch (state->format) {
+  case FORMAT_SVG:
+    surface = cairo_svg_surface_create(job->path, state->size, state->size);
+    break;
+  case FORMAT_PDF:
+    surface = cairo_pdf_surface_create(job->path, state->size, state->size);
+    break;
+  default:
+    surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+                                         state->size, state->size);
+  }
+
+  cr = cairo_create(surface);
+  for (gchar **line = job->lines; *line != NULL; ++line) {
+    draw_message(cr, *line, state->size);
+    if (state->format == FORMAT_PDF) cairo_show_page(cr);
+  }
+  cairo_destroy(cr);
+
+  if (state->format == FORMAT_PNG) {
+    status = cairo_surface_write_to_png(surface, job->path);
+  } else {
+    /* vector surfaces write their output when they're finished */
+    cairo_surface_finish(surface);
+    status = cairo_surface_status(surface);
+  }
+  cairo_surface_destroy(surface);
+
+  if (status != CAIRO_STATUS_SUCCESS) {
+    g_mutex_lock(&state->mutex);
+    if (state->error == NULL) {
+      state->error = g_error_new(G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                 "%s: %s", job->path,
+                                 cairo_status_to_string(status));
+    }
+    g_mutex_unlock(&state->mutex);
+  }
+
+  g_free(job->path);
+  g_strfreev(job->lines);
+  g_slice_free(job_t, job);
+}
+
+/*!
+ * \brief
+ * Creates a job and hands it over to the thread pool
+ *
+ * \param[in] pool   the thread pool
+ * \param[in] path   the output path, which is owned by the job afterwards
+ * \param[in] lines  the messages to render, owned by the job afterwards
+ */
+static void
+push_job(GThreadPool * const pool, gchar * const path, gchar ** const lines)
+{
+  job_t * const job = g_slice_new(job_t);
+  job->path  = path;
+  job->lines = lines;
+  g_thread_pool_push(pool, job, NULL);
+}
+
+/*!
+ * \brief
+ * Queues a position for rendering to a file of its own, or adds it to the
+ * pages of a game
+ *
+ * \param[in]     pool   the thread pool to push jobs to
+ * \param[in]     state  the shared export state
+ * \param[in]     stem   the stem of the file names
+ * \param[in]     dir    the directory to write the files to
+ * \param[in]     n      the number of the position, counted from one
+ * \param[in]     line   the message of the position, owned by the job or
+ *                       \p pages afterwards
+ * \param[in,out] pages  the pages of a PDF file
+ */
+static void
+queue_position(GThreadPool          * const pool,
+               const export_state_t * const state,
+               const gchar          * const stem,
+               const gchar          * const dir,
+               const guint                  n,
+               gchar                * const line,
+               GPtrArray            * const pages)
+{
+  gchar *name;
+  gchar **lines;
+
+  if (state->format == FORMAT_PDF) {
+    g_ptr_array_add(pages, line);
+    return;
+  }
+  /* every position gets a file (and a job) of its own */
+  lines = g_new(gchar *, 2);
+  lines[0] = line;
+  lines[1] = NULL;
+  name = g_strdup_printf("%s-%04u.%s", stem, n, extensions[state->format]);
+  push_job(pool, g_build_filename(dir, name, NULL), lines);
+  g_free(name);
+}
+
+/*!
+ * \brief
+ * Queues the pages of a game for rendering to a PDF file, or releases them
+ * for the other formats
+ *
+ * \param[in] pool   the thread pool to push the job to
+ * \param[in] state  the shared export state
+ * \param[in] stem   the stem of the file name
+ * \param[in] dir    the directory to write the file to
+ * \param[in] pages  the pages, which are freed or owned by the job
+ *                   afterwards
+ * \param[in] keep   whether to render the pages at all
+ */
+static void
+queue_pages(GThreadPool          * const pool,
+            const export_state_t * const state,
+            const gchar          * const stem,
+            const gchar          * const dir,
+            GPtrArray            * const pages,
+            const gboolean               keep)
+{
+  g_ptr_array_add(pages, NULL);
+  if (state->format == FORMAT_PDF && keep) {
+    gchar *name = g_strdup_printf("%s.%s", stem, extensions[FORMAT_PDF]);
+    push_job(pool, g_build_filename(dir, name, NULL),
+             (gchar **)g_ptr_array_free(pages, FALSE));
+    g_free(name);
+  } else {
+    g_strfreev((gchar **)g_ptr_array_free(pages, FALSE));
+  }
+}
+
+/*!
+ * \brief
+ * Reads a game file and queues its positions for rendering
+ *
+ * \param[in]  pool   the thread pool to push jobs to
+ * \param[in]  state  the shared export state
+ * \param[in]  file   the name of the file, or \c "-" for standard input
+ * \param[in]  dir    the directory to write the files to
+ * \param[out] error  the location for an error, as for export_games()
+ *
+ * \return
+ * whether the file could be read
+ */
+static gboolean
+export_file(GThreadPool          * const pool,
+            const export_state_t * const state,
+            const gchar          * const file,
+            const gchar          * const dir,
+            GError              ** const error)
+{
+  gamelog_t *log;
+  GPtrArray *pages;
+  gchar *stem;
+  gchar *line;
+  GError *read_error = NULL;
+  guint n_positions = 0;
+
+  log = gamelog_open(file, error);
+  if (log == NULL) return FALSE;
+
+  stem = gamelog_get_stem(file);
+  pages = g_ptr_array_new();
+
+  while ((line = gamelog_read(log, &read_error)) != NULL) {
+    queue_position(pool, state, stem, dir, ++n_positions, line, pages);
+  }
+  gamelog_close(log);
+
+  queue_pages(pool, state, stem, dir, pages, read_error == NULL);
+  g_free(stem);
+
+  if (read_error != NULL) {
+    g_propagate_error(error, read_error);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Finds an image format by its name, and starts a pool of worker threads to
+ * render it into a directory
+ *
+ * \param[in]  name   the name of the format
+ * \param[in]  dir    the directory, which is created if needed
+ * \param[out] state  the shared export state, to be passed to
+ *                    stop_rendering() afterwards
+ * \param[in]  error  as for export_games()
+ *
+ * \return
+ * the thread pool, or \c NULL on error
+ */
+static GThreadPool *
+start_rendering(const gchar * const    name,
+                const gchar * const    dir,
+                export_state_t * const state,
+                GError               **error)
+{
+  extern guint option_jobs;
+  extern gint  option_size_px;
+  GThreadPool *pool;
+
+  for (state->format = 0; state->format < N_FORMATS; ++state->format) {
+    if (g_ascii_strcasecmp(name, extensions[state->format]) == 0) break;
+  }
+  if (state->format == N_FORMATS) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "Unknown export format \"%s\"", name);
+    return NULL;
+  }
+  if (g_mkdir_with_parents(dir, 0755) != 0) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't create the directory \"%s\"", dir);
+    return NULL;
+  }
+
+  state->size = option_size_px;
+  state->error = NULL;
+  g_mutex_init(&state->mutex);
+
+  pool = g_thread_pool_new(render_job, state,
+                           option_jobs > 0 ? (gint)option_jobs
+                                           : (gint)g_get_num_processors(),
+                           TRUE, error);
+  if (pool == NULL) g_mutex_clear(&state->mutex);
+  return pool;
+}
+
+/*!
+ * \brief
+ * Waits for the jobs of start_rendering() to finish, and stops the pool
+ *
+ * \param[in] pool     the thread pool
+ * \param[in] state    the shared export state
+ * \param[in] success  whether the jobs were queued successfully
+ * \param[in] error    as for export_games(), set only if \p success is
+ *                     \c TRUE
+ *
+ * \return
+ * whether every job was queued and rendered successfully
+ */
+static gboolean
+stop_rendering(GThreadPool * const    pool,
+               export_state_t * const state,
+               gboolean               success,
+               GError               **error)
+{
+  /* wait for the queued jobs to finish */
+  g_thread_pool_free(pool, FALSE, TRUE);
+  g_mutex_clear(&state->mutex);
+
+  if (state->error != NULL) {
+    if (success) {
+      g_propagate_error(error, state->error);
+      success = FALSE;
+    } else {
+      g_error_free(state->error);
+    }
+  }
+  return success;
+}
+
+/*!
+ * \brief
+ * Opens the file given by the option \c -o for a stream of output
+ *
+ * \param[in] error  as for export_games()
+ *
+ * \return
+ * the file, or standard output if no file (or \c "-") was given, or \c NULL
+ * on error
+ */
+static FILE *
+open_output(GError **error)
+{
+  extern gchar *option_output;
+  FILE *file;
+
+  if (option_output == NULL || strcmp(option_output, "-") == 0) {
+    return stdout;
+  }
+  file = g_fopen(option_output, "wb");
+  if (file == NULL) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't create \"%s\"", option_output);
+  }
+  return file;
+}
+
+/*!
+ * \brief
+ * Closes a file opened by open_output(), checking that it was written
+ *
+ * \param[in] file     the file
+ * \param[in] success  whether the output was successful so far
+ * \param[in] error    as for export_games(), set only if \p success is
+ *                     \c TRUE
+ *
+ * \return
+ * whether the output was successful
+ */
+static gboolean
+close_output(FILE * const file, gboolean success, GError **error)
+{
+  if ((fflush(file) != 0 || ferror(file)) && success) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't write the output");
+    success = FALSE;
+  }
+  if (file != stdout) fclose(file);
+  return success;
+}
+
+/*!
+ * \brief
+ * Converts recorded games to a single stream of PDN or of plain messages
+ *
+ * Every message is written as soon as it has been read, so the memory use
+ * doesn't depend on the length of the games.
+ *
+ * \param[in] files   the files to read, as for export_games()
+ * \param[in] as_pdn  whether to write PDN rather than one message per line
+ * \param[in] error   as for export_games()
+ *
+ * \return
+ * whether every game was successfully converted
+ */
+static gboolean
+convert_games(gchar * const *files, const gboolean as_pdn, GError **error)
+{
+  pdn_writer_t *writer = NULL;
+  gboolean success = TRUE;
+  FILE *file;
+
+  file = open_output(error);
+  if (file == NULL) return FALSE;
+  if (as_pdn) writer = pdn_writer_new(file);
+
+  for (; *files != NULL && success; ++files) {
+    gamelog_t * const log = gamelog_open(*files, error);
+    GError *read_error = NULL;
+    gchar *line;
+
+    if (log == NULL) {
+      success = FALSE;
+      break;
+    }
+    while ((line = gamelog_read(log, &read_error)) != NULL) {
+      if (writer != NULL) {
+        pdn_writer_add(writer, line, gamelog_get_think_time(log),
+                       gamelog_get_comment(log));
+      } else {
+        fprintf(file, "%s\n", line);
+      }
+      g_free(line);
+    }
+    gamelog_close(log);
+    if (read_error != NULL) {
+      g_propagate_prefixed_error(error, read_error, "%s: ", *files);
+      success = FALSE;
+    }
+  }
+
+  if (writer != NULL) pdn_writer_free(writer);
+  return close_output(file, success, error);
+}
+
+/*!
+ * \brief
+ * Lists the moves in recorded games that break the rules
+ *
+ * Each illegal move is written on a line of its own as
+ * <tt>FILE:N: MESSAGE: REASON</tt>, where \c N counts the messages in
+ * \c FILE from one.
+ *
+ * \param[in] files  the files to read, as for export_games()
+ * \param[in] error  as for export_games(), also set if a move is illegal
+ *
+ * \return
+ * whether every game was read and every move was legal
+ */
+static gboolean
+check_games(gchar * const *files, GError **error)
+{
+  gboolean success = TRUE;
+  gulong n_moves = 0;
+  gulong n_illegal = 0;
+  FILE *file;
+
+  file = open_output(error);
+  if (file == NULL) return FALSE;
+
+  for (; *files != NULL && success; ++files) {
+    gamelog_t * const log = gamelog_open(*files, error);
+    GError *read_error = NULL;
+    message_t messages[2];
+    guint8 current = 0;
+    gboolean has_before = FALSE;
+    gulong n = 0;
+    gchar *line;
+
+    if (log == NULL) {
+      success = FALSE;
+      break;
+    }
+    /* the two most recent messages take turns in the array */
+    while ((line = gamelog_read(log, &read_error)) != NULL) {
+      ++n;
+      if (parse_message(line, &messages[current])) {
+        if (has_before && messages[current].action >= 0) {
+          const verdict_t verdict =
+            check_move(&messages[!current], &messages[current]);
+          ++n_moves;
+          if (verdict != VERDICT_LEGAL) {
+            fprintf(file, "%s:%lu: %s: %s\n", *files, n, line,
+                    get_verdict_description(verdict));
+            ++n_illegal;
+          }
+        }
+        has_before = TRUE;
+        current = !current;
+      }
+      g_free(line);
+    }
+    gamelog_close(log);
+    if (read_error != NULL) {
+      g_propagate_prefixed_error(error, read_error, "%s: ", *files);
+      success = FALSE;
+    }
+  }
+
+  if (success && n_illegal > 0) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "%lu of %lu moves break the rules", n_illegal, n_moves);
+    return close_output(file, FALSE, NULL);
+  }
+  return close_output(file, success, error);
+}
+
+/*!
+ * \brief
+ * Columns of the statistics being listed by list_metrics()
+ */
+typedef struct {
+  /*! \brief The keys, in the order of the columns */
+  GPtrArray  *keys;
+  /*! \brief Maps each key to its column number plus one */
+  GHashTable *columns;
+  /*! \brief The values of the current move, indexed like #keys */
+  GPtrArray  *values;
+} metrics_columns_t;
+
+/*!
+ * \brief
+ * Adds a column for a key that hasn't been seen before, following the
+ * signature of ::metrics_func_t
+ *
+ * \param[in] key        the key
+ * \param[in] value      not used
+ * \param[in] user_data  the ::metrics_columns_t
+ */
+static void
+add_metrics_column(const gchar *key, const gchar *value, gpointer user_data)
+{
+  metrics_columns_t * const columns = user_data;
+
+  UNUSED(value);
+
+  if (g_hash_table_lookup(columns->columns, key) != NULL) return;
+  g_ptr_array_add(columns->keys, g_strdup(key));
+  g_hash_table_insert(columns->columns, g_strdup(key),
+                      GUINT_TO_POINTER(columns->keys->len));
+}
+
+/*!
+ * \brief
+ * Sets the value of a move in its column, following the signature of
+ * ::metrics_func_t
+ *
+ * \param[in] key        the key
+ * \param[in] value      the value
+ * \param[in] user_data  the ::metrics_columns_t
+ */
+static void
+set_metrics_value(const gchar *key, const gchar *value, gpointer user_data)
+{
+  metrics_columns_t * const columns = user_data;
+  const guint column =
+    GPOINTER_TO_UINT(g_hash_table_lookup(columns->columns, key)) - 1;
+
+  g_free(g_ptr_array_index(columns->values, column));
+  g_ptr_array_index(columns->values, column) = g_strdup(value);
+}
+
+/*!
+ * \brief
+ * Calls a function for the statistics of each move in some sessions
+ *
+ * \param[in] sessions   the sessions
+ * \param[in] func       the function, which gets a ::metrics_columns_t
+ * \param[in] columns    the columns
+ * \param[in] file       the stream to write a line to after each move, or
+ *                       \c NULL to write nothing
+ * \param[in] files      the file names of the sessions, for the lines
+ */
+static void
+foreach_metrics(const GPtrArray   * const sessions,
+                const metrics_func_t      func,
+                metrics_columns_t * const columns,
+                FILE              * const file,
+                gchar     * const * const files)
+{
+  for (guint i = 0; i < sessions->len; ++i) {
+    const session_t * const session = g_ptr_array_index(sessions, i);
+    const guint64 n_moves = session_get_n_moves(session);
+
+    for (guint64 n = 0; n < n_moves; ++n) {
+      const session_record_t * const record =
+        session_get_record(session, n);
+      reply_stats_t stats;
+      metrics_t *metrics;
+      const gchar *text;
+      gsize length;
+
+      /* a corrupt record ends the session, as if it was never closed */
+      if (record == NULL) break;
+      session_get_reply_stats(session, record, &stats);
+      text = session_get_blob(session, record, STDERR, &length);
+      metrics = metrics_new_from_text(text, length);
+      metrics_foreach(metrics, stats.think_us, func, columns);
+      metrics_free(metrics);
+      if (file == NULL) continue;
+
+      fprintf(file, "%s\t%" G_GUINT64_FORMAT "\t%u\t", files[i], n + 1,
+              record->client_id + 1);
+      if (stats.think_us >= 0) {
+        fprintf(file, "%.3f", stats.think_us/1000.);
+      }
+      for (guint j = 0; j < columns->values->len; ++j) {
+        const gchar * const value = g_ptr_array_index(columns->values, j);
+        fprintf(file, "\t%s", value != NULL ? value : "");
+        g_free(g_ptr_array_index(columns->values, j));
+        g_ptr_array_index(columns->values, j) = NULL;
+      }
+      fputc('\n', file);
+    }
+  }
+}
+
+/*!
+ * \brief
+ * Lists the statistics that the clients wrote to stderr, as configured by
+ * the option \c -M, for each move in one or more sessions
+ *
+ * The output is tab-separated values, starting with a line that names the
+ * columns: the session, the number of the move, the player, the think time
+ * in milliseconds and each key that any move has, in order of appearance.
+ * Since the sessions are mapped, they are simply read twice, first to find
+ * the keys and then to write the moves.
+ *
+ * \param[in] files  the sessions to read, as for export_games() (but not
+ *                   standard input)
+ * \param[in] error  as for export_games()
+ *
+ * \return
+ * whether every session was successfully read and listed
+ */
+static gboolean
+list_metrics(gchar * const *files, GError **error)
+{
+  GPtrArray *sessions;
+  metrics_columns_t columns;
+  FILE *file;
+
+  sessions = g_ptr_array_new_with_free_func((GDestroyNotify)session_close);
+  for (gchar * const *path = files; *path != NULL; ++path) {
+    session_t * const session = session_open(*path, error);
+    if (session == NULL) {
+      g_ptr_array_free(sessions, TRUE);
+      return FALSE;
+    }
+    g_ptr_array_add(sessions, session);
+  }
+  file = open_output(error);
+  if (file == NULL) {
+    g_ptr_array_free(sessions, TRUE);
+    return FALSE;
+  }
+
+  columns.keys = g_ptr_array_new_with_free_func(g_free);
+  columns.columns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                          NULL);
+  foreach_metrics(sessions, add_metrics_column, &columns, NULL, files);
+  columns.values = g_ptr_array_new_with_free_func(g_free);
+  g_ptr_array_set_size(columns.values, columns.keys->len);
+
+  fputs("session\tmove\tplayer\tthink_ms", file);
+  for (guint i = 0; i < columns.keys->len; ++i) {
+    fprintf(file, "\t%s", (gchar *)g_ptr_array_index(columns.keys, i));
+  }
+  fputc('\n', file);
+  foreach_metrics(sessions, set_metrics_value, &columns, file, files);
+
+  g_ptr_array_free(columns.values, TRUE);
+  g_hash_table_destroy(columns.columns);
+  g_ptr_array_free(columns.keys, TRUE);
+  g_ptr_array_free(sessions, TRUE);
+  return close_output(file, TRUE, error);
+}
+
+/* documented in export.h */
+gboolean
+export_games(gchar * const *files, GError **error)
+{
+  extern gchar *option_export_format;
+  extern gchar *option_output;
+  static gchar * const from_stdin[] = { "-", NULL };
+  const gchar * const dir = option_output != NULL ? option_output : ".";
+  export_state_t state;
+  GThreadPool *pool;
+  gboolean success = TRUE;
+
+  assert(option_export_format != NULL);
+  assert(error == NULL || *error == NULL);
+
+  if (files == NULL || *files == NULL) files = from_stdin;
+
+  if (is_video_format(option_export_format)) {
+    return encode_games(files, error);
+  }
+  if (g_ascii_strcasecmp(option_export_format, "pdn") == 0 ||
+      g_ascii_strcasecmp(option_export_format, "log") == 0) {
+    return convert_games(files,
+                         g_ascii_strcasecmp(option_export_format, "pdn") == 0,
+                         error);
+  }
+  if (g_ascii_strcasecmp(option_export_format, "check") == 0) {
+    return check_games(files, error);
+  }
+  if (g_ascii_strcasecmp(option_export_format, "tsv") == 0) {
+    if (files == from_stdin) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                  "Listing the statistics needs session files");
+      return FALSE;
+    }
+    return list_metrics(files, error);
+  }
+  if (g_ascii_strcasecmp(option_export_format, DATASET_FORMAT) == 0) {
+    if (files == from_stdin) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                  "Writing a dataset needs session files");
+      return FALSE;
+    }
+    return write_dataset(files, error);
+  }
+
+  pool = start_rendering(option_export_format, dir, &state, error);
+  if (pool == NULL) return FALSE;
+  for (; *files != NULL && success; ++files) {
+    success = export_file(pool, &state, *files, dir, error);
+  }
+  return stop_rendering(pool, &state, success, error);
+}
+
+/* documented in export.h */
+gboolean
+export_messages(gchar * const * const lines,
+                const gchar   * const stem,
+                const gchar   * const format,
+                GError             **error)
+{
+  extern gchar *option_output;
+  const gchar * const dir = option_output != NULL ? option_output : ".";
+  export_state_t state;
+  GThreadPool *pool;
+  GPtrArray *pages;
+  guint n = 0;
+
+  assert(lines != NULL);
+  assert(stem != NULL);
+  assert(format != NULL);
+  assert(error == NULL || *error == NULL);
+
+  pool = start_rendering(format, dir, &state, error);
+  if (pool == NULL) return FALSE;
+  pages = g_ptr_array_new();
+  for (; lines[n] != NULL; ++n) {
+    queue_position(pool, &state, stem, dir, n + 1, g_strdup(lines[n]),
+                   pages);
+  }
+  queue_pages(pool, &state, stem, dir, pages, TRUE);
+  return stop_rendering(pool, &state, TRUE, error);
+}
@@ -0,0 +1,65 @@
+/*!
+ * \file export.h
+ * \brief
+ * Provides functions to render recorded games to files without a window, or
+ * the game shown in the window
+ */
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <gtk/gtk.h>
+
+/*!
+ * \brief
+ * Renders every position of one or more recorded games to files
+ *
+ * A recorded game is a text file with one client message per line, in the
+ * format described by the protocol (lines that can't be parsed are skipped).
+ * Depending on the export format, each position is written to a numbered PNG
+ * or SVG file, or each game is written to a multi-page PDF file. The work is
+ * spread across a pool of worker threads, each drawing on its own surface.
+ * Games read from files ending with \c .pdn are converted from PDN first.
+ * The formats \c pdn and \c log instead convert all the games to a single
+ * stream of PDN or of messages (one per line).
+ * The format \c tsv lists the statistics extracted from the stderr output
+ * of each move in session files instead (see metrics.h), the format
+ * \c dataset writes the boards of session files as columns (see dataset.h),
+ * and the format \c check lists the moves that break the rules (see
+ * rules.h).
+ *
+ * \param[in] files  a \c NULL-terminated array of file names to read the games
+ *                   from, where \c "-" means standard input
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * whether every position was successfully exported
+ */
+gboolean
+export_games(gchar * const *files, GError **error);
+
+/*!
+ * \brief
+ * Renders the positions of a game that is held in memory to files
+ *
+ * The files are written as by export_games(), in the directory given by the
+ * option \c -o, but only the image formats are supported. This is how the
+ * game in the window (which may still be running) is exported.
+ *
+ * \param[in] lines   a \c NULL-terminated array of messages, one per
+ *                    position
+ * \param[in] stem    the stem of the file names
+ * \param[in] format  the format, one of \c png, \c svg or \c pdf
+ * \param[in] error   as for export_games()
+ *
+ * \return
+ * whether every position was successfully exported
+ */
+gboolean
+export_messages(gchar * const * const lines,
+                const gchar   * const stem,
+                const gchar   * const format,
+                GError             **error);
+
+#endif /* EXPORT_H */
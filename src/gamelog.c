@@ -0,0 +1,201 @@
+/*!
+ * \file gamelog.c
+ * \brief
+ * Reads recorded games line by line, so that arbitrarily long recordings can
+ * be processed with bounded memory. Session files and PDN are read through
+ * the same interface.
+ */
+#include <assert.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "clients.h"
+#include "gamelog.h"
+#include "pdn.h"
+#include "protocol.h"
+#include "session.h"
+
+/*! \brief An open recorded game */
+struct gamelog {
+  /*! \brief The channel that the lines are read from (unless #session) */
+  GIOChannel   *channel;
+  /*! \brief Converts PDN to messages, or \c NULL if the file isn't PDN */
+  pdn_reader_t *pdn;
+  /*! \brief The session file being read, or \c NULL */
+  session_t    *session;
+  /*! \brief Number of the next record to read from #session */
+  guint64       next_move;
+  /*! \brief Think time belonging to the last message read, or -1 */
+  gint64        think_us;
+  /*! \brief Comment belonging to the last message read, or \c NULL */
+  gchar        *comment;
+};
+
+/*!
+ * \brief
+ * Finds the reason for a forfeit in the stderr output of a move
+ *
+ * \param[in] text  the output, which needn't be zero-terminated
+ * \param[in] len   the length of \p text in bytes
+ *
+ * \return
+ * the line that gives the reason, without the trailing newline, in a string
+ * that should be freed by the caller, or \c NULL if there is none
+ */
+static gchar *
+find_forfeit(const gchar * const text, const gsize len)
+{
+  const gchar * const end = text + len;
+  const gsize prefix_len = strlen(FORFEIT_PREFIX);
+
+  for (const gchar *line = text; line < end; ) {
+    const gchar *line_end = memchr(line, '\n', end - line);
+    if (line_end == NULL) line_end = end;
+    if ((gsize)(line_end - line) >= prefix_len &&
+        memcmp(line, FORFEIT_PREFIX, prefix_len) == 0) {
+      return g_strndup(line, line_end - line);
+    }
+    line = line_end + 1;
+  }
+  return NULL;
+}
+
+/* documented in gamelog.h */
+gamelog_t *
+gamelog_open(const gchar *file, GError **error)
+{
+  GIOChannel *channel;
+  session_t *session;
+  gamelog_t *log;
+
+  assert(file != NULL);
+
+  /* a session file is recognized by its header */
+  if (strcmp(file, "-") != 0 && (session = session_open(file, NULL)) != NULL) {
+    log = g_slice_new0(gamelog_t);
+    log->session = session;
+    log->think_us = -1;
+    return log;
+  }
+
+  if (strcmp(file, "-") == 0) {
+    channel = g_io_channel_unix_new(0);
+  } else {
+    channel = g_io_channel_new_file(file, "r", error);
+    if (channel == NULL) return NULL;
+  }
+
+  /* the messages are ASCII, while the names in a PDN database may well be
+     in Latin-1 */
+  g_io_channel_set_encoding(channel, NULL, NULL);
+
+  log = g_slice_new0(gamelog_t);
+  log->channel = channel;
+  log->think_us = -1;
+  if (g_str_has_suffix(file, ".pdn") || g_str_has_suffix(file, ".PDN")) {
+    log->pdn = pdn_reader_new(channel);
+  }
+  return log;
+}
+
+/* documented in gamelog.h */
+gchar *
+gamelog_read(gamelog_t *log, GError **error)
+{
+  gchar *line;
+
+  assert(log != NULL);
+
+  if (log->pdn != NULL) return pdn_reader_next(log->pdn, error);
+
+  while (log->session != NULL &&
+         log->next_move < session_get_n_moves(log->session)) {
+    const session_record_t * const record =
+      session_get_record(log->session, log->next_move++);
+    gsize length;
+    const gchar *text;
+    const gchar *stderr_text;
+    reply_stats_t stats;
+    /* a corrupt record ends the session, as if it was never closed */
+    if (record == NULL) {
+      log->next_move = session_get_n_moves(log->session);
+      break;
+    }
+    if ((record->flags & SESSION_PARSED) == 0) continue;
+    session_get_reply_stats(log->session, record, &stats);
+    log->think_us = stats.think_us;
+    g_free(log->comment);
+    stderr_text = session_get_blob(log->session, record, STDERR, &length);
+    log->comment = find_forfeit(stderr_text, length);
+    text = session_get_blob(log->session, record, STDOUT, &length);
+    line = g_strndup(text, length);
+    return g_strchomp(line);
+  }
+  if (log->session != NULL) return NULL;
+
+  while (g_io_channel_read_line(log->channel, &line, NULL, NULL, error)
+         == G_IO_STATUS_NORMAL) {
+    gchar  *board       = NULL;
+    GSList *moves       = NULL;
+    gchar  *description = NULL;
+    gchar  *player      = NULL;
+
+    g_strchomp(line);
+    if (parse_client_stdout(line, &board, &moves, &description, &player)) {
+      g_free(board);
+      g_slist_free(moves);
+      g_free(description);
+      g_free(player);
+      return line;
+    }
+    g_free(line);
+  }
+  return NULL;
+}
+
+/* documented in gamelog.h */
+void
+gamelog_close(gamelog_t *log)
+{
+  assert(log != NULL);
+
+  if (log->pdn != NULL) pdn_reader_free(log->pdn);
+  if (log->session != NULL) session_close(log->session);
+  g_free(log->comment);
+  if (log->channel != NULL) g_io_channel_unref(log->channel);
+  g_slice_free(gamelog_t, log);
+}
+
+/* documented in gamelog.h */
+gint64
+gamelog_get_think_time(const gamelog_t *log)
+{
+  assert(log != NULL);
+
+  return log->think_us;
+}
+
+/* documented in gamelog.h */
+const gchar *
+gamelog_get_comment(const gamelog_t *log)
+{
+  assert(log != NULL);
+
+  return log->comment;
+}
+
+/* documented in gamelog.h */
+gchar *
+gamelog_get_stem(const gchar *file)
+{
+  gchar *stem;
+  gchar *dot;
+
+  assert(file != NULL);
+
+  if (strcmp(file, "-") == 0) return g_strdup("stdin");
+
+  stem = g_path_get_basename(file);
+  dot = strrchr(stem, '.');
+  if (dot != NULL && dot != stem) *dot = '\0';
+  return stem;
+}
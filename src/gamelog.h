@@ -0,0 +1,101 @@
+/*!
+ * \file gamelog.h
+ * \brief
+ * Provides functions to read recorded games one message at a time
+ */
+#ifndef GAMELOG_H
+#define GAMELOG_H
+
+#include <gtk/gtk.h>
+
+/*!
+ * \brief
+ * An open recorded game (the structure is private to gamelog.c)
+ */
+typedef struct gamelog gamelog_t;
+
+/*!
+ * \brief
+ * Opens a recorded game for reading
+ *
+ * A recorded game is a text file with one client message per line, in the
+ * format described by the protocol. A file may hold several games after each
+ * other. Files whose names end with \c .pdn are read as Portable Draughts
+ * Notation instead, and converted to messages on the fly. Session files
+ * (see session.h) are recognized by their header, and yield the stdout text
+ * of each move that holds a valid message.
+ *
+ * \param[in] file   the name of the file, or \c "-" for standard input
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * the opened game, or \c NULL on error
+ */
+gamelog_t *
+gamelog_open(const gchar *file, GError **error);
+
+/*!
+ * \brief
+ * Reads the next message that can be parsed, skipping any other lines
+ *
+ * \param[in] log    the game to read from
+ * \param[in] error  as for gamelog_open()
+ *
+ * \return
+ * the message without trailing newline in a string that should be freed by
+ * the caller, or \c NULL at end-of-file or on error
+ */
+gchar *
+gamelog_read(gamelog_t *log, GError **error);
+
+/*!
+ * \brief
+ * Gets the think time belonging to the message that was read last
+ *
+ * \param[in] log  the game
+ *
+ * \return
+ * the time in microseconds that the client took to reply with the message,
+ * or -1 if it's unknown (only session files record think times)
+ */
+gint64
+gamelog_get_think_time(const gamelog_t *log);
+
+/*!
+ * \brief
+ * Gets the comment belonging to the message that was read last
+ *
+ * \param[in] log  the game
+ *
+ * \return
+ * a string owned by \p log and valid until the next read, such as the reason
+ * that a client forfeited with the message, or \c NULL if there is none
+ * (only session files record comments)
+ */
+const gchar *
+gamelog_get_comment(const gamelog_t *log);
+
+/*!
+ * \brief
+ * Closes a recorded game and frees its resources
+ *
+ * \param[in] log  the game to close
+ */
+void
+gamelog_close(gamelog_t *log);
+
+/*!
+ * \brief
+ * Gets the name of a game file without directory and extension
+ *
+ * \param[in] file  the name of the file, or \c "-" for standard input
+ *
+ * \return
+ * the stem of the file name in a string that should be freed by the caller
+ */
+gchar *
+gamelog_get_stem(const gchar *file);
+
+#endif /* GAMELOG_H */
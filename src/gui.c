@@ -9,8 +9,23 @@
 #include <gtk/gtk.h>
 #include "gui.h"
 #include "main.h"
+#include "analysis.h"
 #include "board.h"
+#include "charts.h"
 #include "clients.h"
+#include "diverge.h"
+#include "engine.h"
+#include "export.h"
+#include "gamelog.h"
+#include "heatmap.h"
+#include "metrics.h"
+#include "positions.h"
+#include "protocol.h"
+#include "rules.h"
+#include "session.h"
+#include "tablebase.h"
+#include "timeline.h"
+#include "transcript.h"
 
 /*!
  * \brief
@@ -18,9 +33,62 @@
  */
 #define BORDER 3
 
+/*!
+ * \brief
+ * Number of rows to load from a session file beyond the last visible row of
+ * the list
+ */
+#define SESSION_LOAD_BATCH 64
+
+/*!
+ * \brief
+ * Number of rows to read ahead of the selected row when replaying a
+ * transcript or loading a session
+ *
+ * A row isn't complete until the next one has begun, hence at least two.
+ */
+#define REPLAY_LOOKAHEAD 2
+
+/*! \brief Value of #EVAL_COLUMN for a board that isn't evaluated (yet) */
+#define NO_EVAL G_MININT
+
+/*!
+ * \brief
+ * Loss in the score of the player who moved (in hundredths of a man) from
+ * which a move is marked as a likely blunder
+ */
+#define BLUNDER_LOSS 150
+
+/*! \brief Background of the moves to a board that occurred before */
+#define REPEAT_BACKGROUND "#FFE0A0"
+
+/*! \brief Largest number of other games listed in the menu of a board */
+#define MAX_JUMP_ITEMS 30
+
+/*! \brief The image formats that the game in the window is exported to */
+static const gchar * const export_formats[] = { "png", "svg", "pdf" };
+
+/*! \brief An export of the game in the window, in a thread of its own */
+typedef struct {
+  /*! \brief The messages of the rows */
+  gchar  **lines;
+  /*! \brief The stem of the file names */
+  gchar   *stem;
+  /*! \brief The format */
+  const gchar *format;
+  /*! \brief The error, if the export failed */
+  GError  *error;
+} live_export_t;
+
 static gboolean
 animation_timeout_callback(gpointer user_data);
 
+static void
+load_session(const gchar *path);
+
+static void
+start_replay(const gchar *path);
+
 /*!
  * \brief
  * Enumeration of GtkListStore columns
@@ -28,10 +96,20 @@ animation_timeout_callback(gpointer user_data);
 enum {
   PLAYER_COLUMN,     /*!< player information to display to the user */
   DESC_COLUMN,       /*!< description of the move to display to the user */
+  EVAL_COLUMN,       /*!< score of the board from red's point of view, or
+                          #NO_EVAL */
+  BLUNDER_COLUMN,    /*!< whether the score dropped by #BLUNDER_LOSS */
+  REPEAT_COLUMN,     /*!< number of earlier rows of the game with the same
+                          board */
   BOARD_COLUMN,      /*!< string representing the board setup */
   MOVES_COLUMN,      /*!< list of moves/jumps leading to the current setup */
   CLIENT_ID_COLUMN,  /*!< client ID of the source */
   STDOUT_COLUMN,     /*!< buffer to store stdout data for the current move */
+  THINK_COLUMN,      /*!< time in microseconds that the client took to reply,
+                          or -1 if unknown */
+  CPU_COLUMN,        /*!< CPU time in microseconds used for the reply, or -1 */
+  RSS_COLUMN,        /*!< resident set size in KiB after the reply, or -1 */
+  METRICS_COLUMN,    /*!< statistics extracted from stderr (metrics_t *) */
   N_COLUMNS          /*!< number of columns (end of enum) */
 };
 
@@ -56,10 +134,46 @@ static GSList *list_moves = NULL;
 
 /*! \brief GtkDrawingArea where the graphical board representation is drawn */
 static GtkWidget *drawing_area;
+/*! \brief Array of GtkLabel showing each player's clock */
+static GtkWidget *clock_labels[NUM_CLIENTS];
+/*! \brief GtkLabel showing the outcome of the board in ::tablebase */
+static GtkWidget *tablebase_label;
+/*! \brief GtkDrawingArea where ::charts are drawn */
+static GtkWidget *charts_area;
+/*! \brief Charts of the rows in the store */
+static charts_t *charts;
+/*!
+ * \brief
+ * GtkDrawingArea next to ::drawing_area where the board of the selected row
+ * of the file given by option \c -D is drawn
+ */
+static GtkWidget *compare_area;
+/*!
+ * \brief
+ * ::message_t of each row of the file given by option \c -D, cleared to
+ * zeros for a row without a board
+ */
+static GArray *compare_messages = NULL;
+/*! \brief GtkDrawingArea where ::timeline is drawn */
+static GtkWidget *timeline_area;
+/*! \brief Material and mobility of the rows in the store */
+static timeline_t *timeline;
 /*! \brief GtkButton that starts or kills the children */
 static GtkWidget *btn_run_kill;
 /*! \brief GtkToggleButton that controls animation */
 static GtkWidget *btn_animate;
+/*!
+ * \brief
+ * GtkComboBox that chooses the heatmap drawn over the board, with "Off" and
+ * then each ::heatmap_kind_t
+ */
+static GtkWidget *combo_heatmap;
+/*!
+ * \brief
+ * GtkComboBox that exports the game in the window, with a title and then
+ * each image format
+ */
+static GtkWidget *combo_export;
 /*!
  * \brief
  * GtkStatusbar that provides information primarily about the children
@@ -96,6 +210,56 @@ static GtkWidget *textviews[NUM_CHANNELS];
 static GtkTextBuffer *buffers[NUM_CHANNELS];
 /*! \brief Indicates whether any of the clients is currently running */
 static gboolean is_running = FALSE;
+/*! \brief Session file being written during play, or \c NULL */
+static session_writer_t *session_writer = NULL;
+/*! \brief Session file being loaded into the store, or \c NULL */
+static session_t *session_loading = NULL;
+/*! \brief Number of the next move to load from ::session_loading */
+static guint64 session_next_move = 0;
+/*!
+ * \brief
+ * The stdout and stderr text of the last row as it was received, which
+ * save_row() writes with the length it had (even with a zero in it)
+ */
+static GString *row_texts[2];
+/*! \brief Transcript being recorded during play, or \c NULL */
+static transcript_writer_t *transcript_writer = NULL;
+/*! \brief Background analysis of the boards, or \c NULL */
+static analysis_t *analysis = NULL;
+/*! \brief Endgame tablebase to look the boards up in, or \c NULL */
+static tablebase_t *tablebase = NULL;
+/*! \brief Heatmaps of the games given by option \c -H, or \c NULL */
+static heatmap_t *heatmap = NULL;
+/*! \brief Index of the positions of recorded games, or \c NULL */
+static positions_t *positions = NULL;
+/*!
+ * \brief
+ * Number of the file in ::positions that the rows come from, or -1 if
+ * they aren't indexed
+ */
+static gint positions_file = -1;
+/*! \brief Key of the board of each row, or zero if it isn't parsed yet */
+static GArray *row_keys = NULL;
+/*!
+ * \brief
+ * Number of rows with each key (a pointer to a \c guint, by a pointer to the
+ * \c guint64 key) in the game that the last row belongs to
+ */
+static GHashTable *game_keys = NULL;
+/*!
+ * \brief
+ * Row to select once its board is loaded, after a jump to another game, or
+ * -1 for none
+ */
+static gint jump_row = -1;
+/*! \brief Key of the board of ::jump_row */
+static guint64 jump_key;
+/*! \brief GtkMenu of the other games with a board, or \c NULL */
+static GtkWidget *jump_menu = NULL;
+/*! \brief Transcript being replayed, or \c NULL */
+static transcript_reader_t *replay_reader = NULL;
+/*! \brief Recorded game (such as a PDN file) being replayed, or \c NULL */
+static gamelog_t *replay_log = NULL;
 
 /*!
  * \brief
@@ -145,163 +309,281 @@ start_animation_timeout(void)
 
 /*!
  * \brief
- * Parses the line that the client wrote to standard output
+ * Appends a finished row to the session file that is being written
  *
- * \param[in]  move_line    the string to be parsed
- * \param[out] board        the board setup described by the input
- * \param[out] moves        the set of moves or jumps described by the input
- * \param[out] description  a description of the move to display to the user
- * \param[out] player       a string describing which player made the move, or
- *                          \c NULL if it's a special move
- *
- * \return
- * whether the line was successfully parsed
+ * \param[in] model  the store that the row belongs to
+ * \param[in] row    the number of the row
  */
-static gboolean
-parse_client_stdout(gchar   *move_line,
-                    gchar  **board,
-                    GSList **moves,
-                    gchar  **description,
-                    gchar  **player)
+static void
+save_row(GtkTreeModel *model, gint row)
 {
-  gchar **split_line;
-  guint n_squares;
-  int action;
-
-  assert(board != NULL && *board == NULL);
-  assert(moves != NULL && *moves == NULL);
-  assert(description != NULL && *description == NULL);
-  assert(player != NULL && *player == NULL);
+  GtkTreeIter iter;
+  guint client_id;
+  reply_stats_t stats;
 
-  if (move_line == NULL) return FALSE;
+  assert(session_writer != NULL);
 
-  /* split_line needs to be freed before every return statement */
-  split_line = g_strsplit(move_line, " ", 0);
+  if (!gtk_tree_model_iter_nth_child(model, &iter, NULL, row)) return;
+  gtk_tree_model_get(model, &iter,
+                     CLIENT_ID_COLUMN, &client_id,
+                     THINK_COLUMN, &stats.think_us,
+                     CPU_COLUMN, &stats.cpu_us,
+                     RSS_COLUMN, &stats.rss_kb,
+                     -1);
 
-  /* we need at least the three first sequences to parse */
-  if (g_strv_length(split_line) < 3) {
-    g_strfreev(split_line);
-    return FALSE;
-  }
+  session_writer_append(session_writer, client_id, &stats,
+                        row_texts[STDOUT]->str, row_texts[STDOUT]->len,
+                        row_texts[STDERR]->str, row_texts[STDERR]->len);
+}
 
-  /* the first sequence needs to correspond to the board size */
-  if (strlen(split_line[0]) != NUM_DARK_SQ) {
-    g_strfreev(split_line);
-    return FALSE;
+/*!
+ * \brief
+ * Extracts the statistic that the stderr output of a row ends with, once
+ * the row is complete, and shows it
+ *
+ * \param[in] model  the store
+ * \param[in] row    the number of the row
+ */
+static void
+finish_row_metrics(GtkTreeModel *model, gint row)
+{
+  GtkTreeIter iter;
+  metrics_t *metrics;
+
+  if (!gtk_tree_model_iter_nth_child(model, &iter, NULL, row)) return;
+  gtk_tree_model_get(model, &iter, METRICS_COLUMN, &metrics, -1);
+  if (metrics != NULL && metrics_finish(metrics)) {
+    GtkTreePath * const path = gtk_tree_path_new_from_indices(row, -1);
+    gtk_tree_model_row_changed(model, path, &iter);
+    gtk_tree_path_free(path);
   }
+}
 
-  {
-    gchar **strv_moves;
-    /* strv_moves needs to be freed before leaving this block */
-    strv_moves = g_strsplit(split_line[1], "_", 0);
-    n_squares = g_strv_length(strv_moves);
-
-    /* str_action should be non-empty, and thus strv_moves as well */
-    assert(n_squares != 0);
-
-    action = atoi(strv_moves[0]);
-
-    /* the action identifier is not one of the squares */
-    --n_squares;
-
-    /* verify that the action is legal and that it has a corresponding
-       number of moves in the sequence */
-    if ((action  < -5) ||
-        (action  <  0  &&  n_squares != 0) ||
-        (action ==  0  &&  n_squares != 2) ||
-        (action  >  0  &&  n_squares != 1 + (guint)action)) {
-      g_strfreev(strv_moves);
-      g_strfreev(split_line);
-      return FALSE;
-    }
+/*!
+ * \brief
+ * Marks the description of a move that breaks the rules
+ *
+ * The move is checked against the closest earlier row with a message, which
+ * is the one that it replies to.
+ *
+ * \param[in]     model          the store
+ * \param[in]     row            the number of the row of the move
+ * \param[in]     stdout_column  the move
+ * \param[in,out] desc_column    the description of the move, which is
+ *                               replaced if the move is illegal
+ */
+static void
+mark_illegal_move(GtkTreeModel  *model,
+                  gint           row,
+                  const gchar   *stdout_column,
+                  gchar        **desc_column)
+{
+  message_t move;
+  message_t before;
+  gboolean is_found = FALSE;
+  verdict_t verdict;
+  gchar *temp;
 
-    /* early return if this is a special action */
-    if (action < 0) {
-      static const gchar * const special_actions[5] = {
-        "Initial setup", /* -1 */
-        "Red wins",      /* -2 */
-        "White wins",    /* -3 */
-        "Draw",          /* -4 */
-        "Null move",     /* -5 */
-      };
-
-      *description = g_strdup(special_actions[-1-action]);
-      *board = g_strdup(split_line[0]);
-      g_strfreev(strv_moves);
-      g_strfreev(split_line);
-      return TRUE;
-    }
+  if (!parse_message(stdout_column, &move) || move.action < 0) return;
 
-    /* read the integers from the array of squares */
-    /* read backwards, since prepending the linked list is cheaper */
-    for (guint i = n_squares; i != 0; --i) {
-      const int sq = atoi(strv_moves[i]);
-
-      /* verify that the number is in range, otherwise quit */
-      if (sq < 1 || sq > NUM_DARK_SQ) {
-        /* illegal value, restore and abort */
-        g_slist_free(*moves);
-        *moves = NULL;
-        g_strfreev(strv_moves);
-        g_strfreev(split_line);
-        return FALSE;
-      }
-      assert(sq > 0);
-      *moves = g_slist_prepend(*moves, GUINT_TO_POINTER((guint)sq - 1));
-    }
-    g_strfreev(strv_moves);
+  while (!is_found && --row >= 0) {
+    GtkTreeIter iter;
+    gchar *text;
+    if (!gtk_tree_model_iter_nth_child(model, &iter, NULL, row)) return;
+    gtk_tree_model_get(model, &iter, STDOUT_COLUMN, &text, -1);
+    is_found = parse_message(text, &before);
+    g_free(text);
   }
+  if (!is_found) return;
+
+  verdict = check_move(&before, &move);
+  if (verdict == VERDICT_LEGAL) return;
+  temp = g_strdup_printf("%s (illegal: %s)", *desc_column,
+                         get_verdict_description(verdict));
+  g_free(*desc_column);
+  *desc_column = temp;
+}
 
-  *player = g_strdup(strcmp(split_line[2], "r") == 0 ? "[W]" : "[R]");
-  *board = g_strdup(split_line[0]);
-
-  /* generate the description string and the list of moves */
-  {
-    GSList *move = *moves;
-    /* moves are written "A-B", and jumps "AxB", "AxBxC", ... */
-    const gchar * const append_string = (action == 0) ? "-%u" : "x%u";
-
-    /* a reasonable starting length is the length of the input string */
-    GString *desc = g_string_sized_new(strlen(split_line[1]));
-    guint old;
+/*!
+ * \brief
+ * Ranks an outcome for the player it belongs to, from a loss up to a win
+ *
+ * \param[in] outcome  the outcome, which isn't #OUTCOME_UNKNOWN
+ *
+ * \return
+ * 0 for a loss, 1 for a draw and 2 for a win
+ */
+static guint
+rank_outcome(const outcome_t outcome)
+{
+  return outcome == OUTCOME_WIN ? 2 : outcome == OUTCOME_DRAW ? 1 : 0;
+}
 
-    /* there should be at least two squares in the list */
-    assert(move != NULL);
-    old = GPOINTER_TO_UINT(move->data);
+/*!
+ * \brief
+ * Marks the description of a move that makes the outcome with best play
+ * worse for the player who made it, if both boards are in ::tablebase
+ *
+ * The move is compared with the closest earlier row with a message, as in
+ * mark_illegal_move().
+ *
+ * \param[in]     model          the store
+ * \param[in]     row            the number of the row of the move
+ * \param[in]     stdout_column  the move
+ * \param[in,out] desc_column    the description of the move, which is
+ *                               replaced if the outcome gets worse
+ */
+static void
+mark_tablebase_loss(GtkTreeModel  *model,
+                    gint           row,
+                    const gchar   *stdout_column,
+                    gchar        **desc_column)
+{
+  static const gchar * const names[] = { "loss", "draw", "win" };
+  message_t move;
+  message_t before;
+  position_t position_before;
+  position_t position;
+  gboolean is_found = FALSE;
+  outcome_t outcome_before;
+  outcome_t outcome;
+  guint rank_before;
+  guint rank;
+  gchar *temp;
+
+  if (!parse_message(stdout_column, &move) || move.action < 0 ||
+      !get_position(&move, &position)) return;
+
+  while (!is_found && --row >= 0) {
+    GtkTreeIter iter;
+    gchar *text;
+    if (!gtk_tree_model_iter_nth_child(model, &iter, NULL, row)) return;
+    gtk_tree_model_get(model, &iter, STDOUT_COLUMN, &text, -1);
+    is_found = parse_message(text, &before);
+    g_free(text);
+  }
+  /* the player to move before is the one who made the move */
+  if (!is_found || !get_position(&before, &position_before) ||
+      position_before.player == position.player) return;
+
+  outcome_before = tablebase_probe(tablebase, &position_before, NULL);
+  outcome = tablebase_probe(tablebase, &position, NULL);
+  if (outcome_before == OUTCOME_UNKNOWN || outcome == OUTCOME_UNKNOWN) {
+    return;
+  }
+  rank_before = rank_outcome(outcome_before);
+  /* the outcome after the move is the opponent's */
+  rank = 2 - rank_outcome(outcome);
+  if (rank >= rank_before) return;
+  temp = g_strdup_printf("%s (tablebase: %s to %s)", *desc_column,
+                         names[rank_before], names[rank]);
+  g_free(*desc_column);
+  *desc_column = temp;
+}
 
-    /* write the first value, without leading "-" or "x" */
-    g_string_append_printf(desc, "%u", old + 1);
+/*!
+ * \brief
+ * Selects a row and scrolls the list to it
+ *
+ * \param[in] row  the number of the row
+ */
+static void
+select_row(gint row)
+{
+  GtkTreePath * const path = gtk_tree_path_new_from_indices(row, -1);
 
-    while ((move = g_slist_next(move)) != NULL) {
-      const guint new = GPOINTER_TO_UINT(move->data);
-      g_string_append_printf(desc, append_string, new + 1);
+  gtk_tree_view_set_cursor(GTK_TREE_VIEW(list), path, NULL, FALSE);
+  gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(list), path, NULL, FALSE, 0, 0);
+  gtk_tree_path_free(path);
+}
 
-      /* figure out which square we're jumping over, and mark it "x" */
-      if (action > 0) (*board)[(old + new)/2 + ((new&4) == 0)] = 'x';
+/*!
+ * \brief
+ * Keys the board of a row once it's parsed, counts the earlier rows of the
+ * game with the same board, adds the row to the position index and updates
+ * the timeline
+ *
+ * Selects the row if it's the target of a jump to another game.
+ *
+ * \param[in] model    the store
+ * \param[in] iter     an iterator to the row
+ * \param[in] row      the number of the row
+ * \param[in] message  the message of the row
+ */
+static void
+index_row(GtkTreeModel    *model,
+          GtkTreeIter     *iter,
+          gint             row,
+          const message_t *message)
+{
+  position_t position;
+  guint64 key;
+  guint *count;
+  guint n_repeats = 0;
+
+  if (!get_position(message, &position)) return;
+  key = get_position_key(&position);
+  /* the stdout of a row may arrive in pieces */
+  if ((guint)row < row_keys->len) {
+    const guint64 old_key = g_array_index(row_keys, guint64, row);
+    if (old_key == key) return;
+    /* the row no longer has the board of an earlier piece */
+    count = g_hash_table_lookup(game_keys, &old_key);
+    if (count != NULL && *count > 0) --*count;
+  }
 
-      old = new;
-    }
-    /* free the GString but keep the character data */
-    *description = g_string_free(desc, FALSE);
+  if ((guint)row >= row_keys->len) g_array_set_size(row_keys, row + 1);
+  g_array_index(row_keys, guint64, row) = key;
+  if (message->action == -1) g_hash_table_remove_all(game_keys);
+  count = g_hash_table_lookup(game_keys, &key);
+  if (count == NULL) {
+    guint64 * const game_key = g_new(guint64, 1);
+    *game_key = key;
+    count = g_new0(guint, 1);
+    g_hash_table_insert(game_keys, game_key, count);
   }
+  n_repeats = (*count)++;
+  gtk_list_store_set(GTK_LIST_STORE(model), iter,
+                     REPEAT_COLUMN, n_repeats,
+                     -1);
 
-  g_strfreev(split_line);
-  return TRUE;
+  if (positions != NULL && positions_file >= 0) {
+    positions_add(positions, positions_file, row, key);
+  }
+  /* the timeline only draws this row again */
+  timeline_update(timeline, row, message);
+  gtk_widget_queue_draw(timeline_area);
+  if (jump_row >= 0 && row >= jump_row && key == jump_key) {
+    jump_row = -1;
+    select_row(row);
+  }
 }
 
 /* documented in gui.h */
 void
-append_text(const gchar *text, gsize len, guint8 channel_id)
+append_text(const gchar         *text,
+            gsize                len,
+            guint8               channel_id,
+            const reply_stats_t *stats)
 {
   gchar *player_column = NULL;
   gchar *desc_column   = NULL;
   gchar *board_column  = NULL;
   GSList *moves_column = NULL;
   gchar *stdout_column = NULL;
+  reply_stats_t stats_columns = { -1, -1, -1 };
+  metrics_t *metrics_column = NULL;
+  message_t message;
+  gboolean is_parsed;
   GtkListStore *store;
   GtkTreeIter iter;
   gint nrows; /* number of rows except for the currently added/edited */
 
+  if (transcript_writer != NULL) {
+    transcript_writer_append(transcript_writer, text, len, channel_id,
+                             stats);
+  }
+
   store = GTK_LIST_STORE(gtk_tree_view_get_model(GTK_TREE_VIEW(list)));
   nrows = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(store), NULL);
 
@@ -315,6 +597,10 @@ append_text(const gchar *text, gsize len, guint8 channel_id)
     gtk_tree_model_get(GTK_TREE_MODEL(store), &iter,
                        CLIENT_ID_COLUMN, &client_id,
                        STDOUT_COLUMN, &stdout_column,
+                       THINK_COLUMN, &stats_columns.think_us,
+                       CPU_COLUMN, &stats_columns.cpu_us,
+                       RSS_COLUMN, &stats_columns.rss_kb,
+                       METRICS_COLUMN, &metrics_column,
                        -1);
     /* did we receive more data from the same client? */
     if (CLIENT_ID(channel_id) == client_id) {
@@ -323,6 +609,12 @@ append_text(const gchar *text, gsize len, guint8 channel_id)
     }
     g_free(stdout_column);
     stdout_column = NULL;
+    /* the previous row won't get any more output */
+    finish_row_metrics(GTK_TREE_MODEL(store), nrows - 1);
+    metrics_column = NULL;
+    stats_columns.think_us = -1;
+    stats_columns.cpu_us   = -1;
+    stats_columns.rss_kb   = -1;
     /* FALLTHROUGH */
   }
   default: {
@@ -330,6 +622,13 @@ append_text(const gchar *text, gsize len, guint8 channel_id)
     gchar *mark_name_begin;
     gchar *mark_name_end;
 
+    /* the previous row won't change anymore */
+    if (session_writer != NULL && nrows > 0) {
+      save_row(GTK_TREE_MODEL(store), nrows - 1);
+    }
+    g_string_truncate(row_texts[STDOUT], 0);
+    g_string_truncate(row_texts[STDERR], 0);
+
     /* add buffer textmarks */
     mark_name_begin = get_mark_name_begin(nrows);
     mark_name_end = get_mark_name_end(nrows);
@@ -346,9 +645,17 @@ append_text(const gchar *text, gsize len, guint8 channel_id)
     /* add store entry - nb: the 'row-inserted' callback will try to read
        the textmarks, and assumes that they have already been created */
     gtk_list_store_append(store, &iter);
+    gtk_list_store_set(store, &iter, EVAL_COLUMN, NO_EVAL, -1);
+    metrics_column = metrics_new();
   }
   }
 
+  /* the statistics are extracted as they stream in, so that the whole
+     output of a move never has to be parsed again */
+  if (IS_STDERR(channel_id)) metrics_feed(metrics_column, text, len);
+  g_string_append_len(row_texts[IS_STDERR(channel_id) ? STDERR : STDOUT],
+                      text, len);
+
   /* add text to the relevant buffer and move the ending textmark */
   {
     GtkTextIter iter;
@@ -392,6 +699,22 @@ append_text(const gchar *text, gsize len, guint8 channel_id)
     desc_column = g_strdup("Unparsable move");
   }
 
+  {
+    extern gboolean option_validate;
+    if (option_validate) {
+      mark_illegal_move(GTK_TREE_MODEL(store), nrows, stdout_column,
+                        &desc_column);
+    }
+  }
+  if (tablebase != NULL) {
+    mark_tablebase_loss(GTK_TREE_MODEL(store), nrows, stdout_column,
+                        &desc_column);
+  }
+
+  /* the measurements come with the first stdout data of a reply, which may
+     have been preceded by output on stderr */
+  if (stats != NULL && stats->think_us >= 0) stats_columns = *stats;
+
   /* update the store entry */
   gtk_list_store_set(store, &iter,
                      PLAYER_COLUMN, player_column,
@@ -400,7 +723,24 @@ append_text(const gchar *text, gsize len, guint8 channel_id)
                      MOVES_COLUMN, moves_column,
                      CLIENT_ID_COLUMN, CLIENT_ID(channel_id),
                      STDOUT_COLUMN, stdout_column,
+                     THINK_COLUMN, stats_columns.think_us,
+                     CPU_COLUMN, stats_columns.cpu_us,
+                     RSS_COLUMN, stats_columns.rss_kb,
+                     METRICS_COLUMN, metrics_column,
                      -1);
+
+  is_parsed = parse_message(stdout_column, &message);
+  if (is_parsed) index_row(GTK_TREE_MODEL(store), &iter, nrows, &message);
+  if (is_parsed && analysis != NULL) {
+    analysis_request(analysis, nrows, &message);
+  }
+
+  /* only this row is drawn again */
+  charts_update(charts, nrows, CLIENT_ID(channel_id), len,
+                stats_columns.think_us,
+                is_parsed ? message.moves_left : -1);
+  gtk_widget_queue_draw(charts_area);
+
   g_free(player_column);
   g_free(desc_column);
   g_free(board_column);
@@ -409,7 +749,8 @@ append_text(const gchar *text, gsize len, guint8 channel_id)
 
 /*!
  * \brief
- * Releases the linked list of moves, stored in a datastore entry
+ * Releases the linked list of moves and the statistics, stored in a
+ * datastore entry
  *
  * Should be called for each entry in the store. The function follows the
  * signature of \c GtkTreeModelForeachFunc.
@@ -429,14 +770,17 @@ free_move_callback(GtkTreeModel *model,
                    gpointer      user_data)
 {
   GSList *moves_column;
+  metrics_t *metrics_column;
 
   UNUSED(path);
   UNUSED(user_data);
 
   gtk_tree_model_get(model, iter,
                      MOVES_COLUMN, &moves_column,
+                     METRICS_COLUMN, &metrics_column,
                      -1);
   g_slist_free(moves_column);
+  metrics_free(metrics_column);
   return FALSE;
 }
 
@@ -454,10 +798,54 @@ release_resources(void)
   list_moves = NULL;
 
   store = GTK_LIST_STORE(gtk_tree_view_get_model(GTK_TREE_VIEW(list)));
+
+  if (session_loading != NULL) {
+    session_close(session_loading);
+    session_loading = NULL;
+  }
+  if (replay_reader != NULL) {
+    transcript_reader_close(replay_reader);
+    replay_reader = NULL;
+  }
+  if (replay_log != NULL) {
+    gamelog_close(replay_log);
+    replay_log = NULL;
+  }
+  if (transcript_writer != NULL) {
+    transcript_writer_close(transcript_writer);
+    transcript_writer = NULL;
+  }
+  if (session_writer != NULL) {
+    /* the last row is complete once it's about to be cleared */
+    GError *error = NULL;
+    const gint nrows =
+      gtk_tree_model_iter_n_children(GTK_TREE_MODEL(store), NULL);
+    if (nrows > 0) save_row(GTK_TREE_MODEL(store), nrows - 1);
+    g_string_truncate(row_texts[STDOUT], 0);
+    g_string_truncate(row_texts[STDERR], 0);
+    if (!session_writer_close(session_writer, &error)) {
+      print_error(error->message);
+      g_error_free(error);
+    }
+    session_writer = NULL;
+  }
+
+  /* the evaluations still to come are for the old rows */
+  if (analysis != NULL) analysis_cancel(analysis);
+  g_array_set_size(row_keys, 0);
+  g_hash_table_remove_all(game_keys);
+  positions_file = -1;
+  jump_row = -1;
+
   gtk_tree_model_foreach(GTK_TREE_MODEL(store),
                          (GtkTreeModelForeachFunc)free_move_callback,
                          NULL);
   gtk_list_store_clear(store);
+
+  charts_clear(charts);
+  gtk_widget_queue_draw(charts_area);
+  timeline_clear(timeline);
+  gtk_widget_queue_draw(timeline_area);
 }
 
 /*!
@@ -491,15 +879,74 @@ wipe_buffers(void)
 static gchar *
 get_client_description(guint16 n, const client_t * const client)
 {
+  GString *usage = g_string_new(NULL);
+  gchar *text;
+
+  if (client->user_us >= 0) {
+    g_string_append_printf(usage, ", %.2f s user, %.2f s system",
+                           client->user_us/1e6, client->system_us/1e6);
+  }
+  if (client->peak_rss_kb >= 0) {
+    g_string_append_printf(usage, ", peak %.1f MiB",
+                           client->peak_rss_kb/1024.);
+  }
+  if (client->startup_us >= 0) {
+    g_string_append_printf(usage, ", started in %.1f ms",
+                           client->startup_us/1000.);
+  }
+  if (client->forfeit != FORFEIT_NONE) {
+    g_string_append_printf(usage, ", forfeited as it %s",
+                           get_forfeit_description(client->forfeit));
+  }
+
+  if (client->is_builtin) {
+    g_string_prepend(usage, "built-in engine");
+  } else {
+    gchar * const pid = g_strdup_printf("pid %d", client->pid);
+    g_string_prepend(usage, pid);
+    g_free(pid);
+  }
+
   ++n;
   if (client->is_running) {
-    return g_strdup_printf("Player %" G_GUINT16_FORMAT
-                           " (pid %d) is running.", n, client->pid);
+    text = g_strdup_printf("Player %" G_GUINT16_FORMAT
+                           " (%s) is running.", n, usage->str);
   } else {
-    return g_strdup_printf("Player %" G_GUINT16_FORMAT
-                           " (pid %d) exited with status %d.",
-                           n, client->pid, client->status);
+    text = g_strdup_printf("Player %" G_GUINT16_FORMAT
+                           " (%s) exited with status %d.",
+                           n, usage->str, client->status);
   }
+  g_string_free(usage, TRUE);
+  return text;
+}
+
+/*!
+ * \brief
+ * Gets the text for a player's clock, which counts down from the time limit
+ * for the game if there is one, and otherwise up from zero
+ *
+ * \param[in] n       the zero-based number of the player
+ * \param[in] client  the client of the player
+ *
+ * \return
+ * the text, which should be freed by the caller
+ */
+static gchar *
+get_clock_text(guint16 n, const client_t * const client)
+{
+  extern guint option_game_time_ms;
+  gint64 clock_us = client->clock_us;
+
+  ++n;
+  if (client->forfeit != FORFEIT_NONE) {
+    return g_strdup_printf("Player %" G_GUINT16_FORMAT ": forfeited", n);
+  }
+  if (option_game_time_ms > 0) {
+    clock_us = MAX(option_game_time_ms * (gint64)1000 - clock_us, 0);
+  }
+  return g_strdup_printf("Player %" G_GUINT16_FORMAT ": %" G_GINT64_FORMAT
+                         ":%04.1f", n, clock_us / (60 * G_USEC_PER_SEC),
+                         clock_us % (60 * G_USEC_PER_SEC) / 1e6);
 }
 
 /* documented in gui.h */
@@ -522,12 +969,23 @@ update_status(const client_t clients[static NUM_CLIENTS])
     for (guint8 i=0; i<NUM_CLIENTS; ++i) g_free(descriptions[i]);
   }
 
+  for (guint8 i=0; i<NUM_CLIENTS; ++i) {
+    gchar *clock = get_clock_text(i, &clients[i]);
+    gtk_label_set_text(GTK_LABEL(clock_labels[i]), clock);
+    g_free(clock);
+  }
+
   gtk_statusbar_pop(GTK_STATUSBAR(statusbar), statusbar_context_id);
   gtk_statusbar_push(GTK_STATUSBAR(statusbar), statusbar_context_id, text);
   g_free(text);
 
   gtk_button_set_label(GTK_BUTTON(btn_run_kill), is_running ? "Kill" : "Run");
   if (!is_running) {
+    GtkTreeModel * const model =
+      gtk_tree_view_get_model(GTK_TREE_VIEW(list));
+    /* the last row won't get any more output */
+    finish_row_metrics(model,
+                       gtk_tree_model_iter_n_children(model, NULL) - 1);
     /* hack to update the board if redrawing was delayed */
     gtk_widget_queue_draw(drawing_area);
   }
@@ -550,80 +1008,443 @@ expose_event_callback(GtkWidget      *widget,
                       gpointer        user_data)
 {
   cairo_t *cr;
+  gdouble shades[NUM_DARK_SQ];
+  gint kind;
 
   UNUSED(event);
   UNUSED(user_data);
 
+  kind = gtk_combo_box_get_active(GTK_COMBO_BOX(combo_heatmap)) - 1;
   cr = gdk_cairo_create(gtk_widget_get_window(widget));
   draw_board(cr, widget->allocation.width, widget->allocation.height,
-             str_board, list_moves);
+             str_board, list_moves,
+             heatmap != NULL && kind >= 0 &&
+             heatmap_get(heatmap, kind, shades) ? shades : NULL);
   cairo_destroy(cr);
   return TRUE;
 }
 
 /*!
  * \brief
- * Callback for when the drawing area is about to get resized
+ * Callback for when the board of the compared file needs to be redrawn,
+ * which draws the board of the same row as the selected one
  *
- * \param[in] widget      the widget that received the signal
- * \param[in] allocation  the widget's allocated region
- * \param[in] user_data   not used
+ * \param[in] widget     the widget that received the signal
+ * \param[in] event      not used
+ * \param[in] user_data  not used
+ *
+ * \return
+ * \c TRUE (to stop other handlers from being invoked for the event)
  */
-static void
-size_allocate_callback(GtkWidget     *widget,
-                       GtkAllocation *allocation,
-                       gpointer       user_data)
+static gboolean
+compare_expose_event_callback(GtkWidget      *widget,
+                              GdkEventExpose *event,
+                              gpointer        user_data)
 {
+  GtkTreePath *path;
+  gchar board[NUM_DARK_SQ + 1];
+  GSList *moves = NULL;
+  const message_t *message = NULL;
+  cairo_t *cr;
+
+  UNUSED(event);
   UNUSED(user_data);
 
-  /* force the width to be equal to the height */
-  gtk_widget_set_size_request(widget, allocation->height, -1);
-}
+  gtk_tree_view_get_cursor(GTK_TREE_VIEW(list), &path, NULL);
+  if (path != NULL) {
+    const gint row = *gtk_tree_path_get_indices(path);
+    if (compare_messages != NULL && (guint)row < compare_messages->len) {
+      message = &g_array_index(compare_messages, message_t, row);
+      /* a row without a board is drawn as an empty board */
+      if (message->board[0] == '\0') message = NULL;
+    }
+    gtk_tree_path_free(path);
+  }
+  if (message != NULL) {
+    memcpy(board, message->board, NUM_DARK_SQ);
+    board[NUM_DARK_SQ] = '\0';
+    /* the jumped pieces are marked as by parse_client_stdout() */
+    for (guint i = message->n_squares; i-- > 0; ) {
+      const guint new = message->squares[i];
+      moves = g_slist_prepend(moves, GUINT_TO_POINTER(new));
+      if (message->action > 0 && i > 0) {
+        const guint old = message->squares[i - 1];
+        board[(old + new)/2 + ((new&4) == 0)] = 'x';
+      }
+    }
+  }
 
-/* documented in gui.h */
-void
-print_error(gchar *message)
-{
-  GtkWidget *dialog;
-  dialog = gtk_message_dialog_new(GTK_WINDOW(window),
-                                  GTK_DIALOG_DESTROY_WITH_PARENT,
-                                  GTK_MESSAGE_ERROR,
-                                  GTK_BUTTONS_CLOSE,
-                                  "%s", message);
-  gtk_dialog_run(GTK_DIALOG(dialog));
-  gtk_widget_destroy(dialog);
+  cr = gdk_cairo_create(gtk_widget_get_window(widget));
+  draw_board(cr, widget->allocation.width, widget->allocation.height,
+             message != NULL ? board : NULL, moves, NULL);
+  cairo_destroy(cr);
+  g_slist_free(moves);
+  return TRUE;
 }
 
 /*!
  * \brief
- * Callback for when the animation timed out and it's time to change the
- * selected row
+ * Callback for when the charts need to be redrawn
  *
+ * \param[in] widget     the widget that received the signal
+ * \param[in] event      not used
  * \param[in] user_data  not used
  *
  * \return
- * \c FALSE (to remove the source)
+ * \c TRUE (to stop other handlers from being invoked for the event)
  */
 static gboolean
-animation_timeout_callback(gpointer user_data)
+charts_expose_event_callback(GtkWidget      *widget,
+                             GdkEventExpose *event,
+                             gpointer        user_data)
 {
-  GtkTreeSelection *selection;
-  GList *rows;
-  GtkListStore *store;
-  GtkTreeIter iter;
+  cairo_t *cr;
 
+  UNUSED(event);
   UNUSED(user_data);
 
-  source_timeout = 0;
+  cr = gdk_cairo_create(gtk_widget_get_window(widget));
+  charts_draw(charts, cr, widget->allocation.width,
+              widget->allocation.height);
+  cairo_destroy(cr);
+  return TRUE;
+}
 
-  selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(list));
-  rows = gtk_tree_selection_get_selected_rows(selection, NULL);
+/*!
+ * \brief
+ * Callback for when the charts are clicked, which selects the row that was
+ * clicked in the tree view
+ *
+ * \param[in] widget     not used
+ * \param[in] event      the event, with the position of the pointer
+ * \param[in] user_data  not used
+ *
+ * \return
+ * \c TRUE (to stop other handlers from being invoked for the event)
+ */
+static gboolean
+charts_button_press_callback(GtkWidget      *widget,
+                             GdkEventButton *event,
+                             gpointer        user_data)
+{
+  const gint row = charts_get_row_at(charts, event->x);
 
-  if (g_list_first(rows) != NULL) {
-    GtkTreePath *path;
-    path = (GtkTreePath *)g_list_first(rows)->data;
-    store = GTK_LIST_STORE(gtk_tree_view_get_model(GTK_TREE_VIEW(list)));
-    gtk_tree_model_get_iter(GTK_TREE_MODEL(store), &iter, path);
+  UNUSED(widget);
+  UNUSED(user_data);
+
+  if (row >= 0) {
+    GtkTreePath *path = gtk_tree_path_new_from_indices(row, -1);
+    gtk_tree_view_set_cursor(GTK_TREE_VIEW(list), path, NULL, FALSE);
+    gtk_tree_path_free(path);
+  }
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Callback for when the timeline needs to be redrawn
+ *
+ * \param[in] widget     the widget that received the signal
+ * \param[in] event      not used
+ * \param[in] user_data  not used
+ *
+ * \return
+ * \c TRUE (to stop other handlers from being invoked for the event)
+ */
+static gboolean
+timeline_expose_event_callback(GtkWidget      *widget,
+                               GdkEventExpose *event,
+                               gpointer        user_data)
+{
+  cairo_t *cr;
+
+  UNUSED(event);
+  UNUSED(user_data);
+
+  cr = gdk_cairo_create(gtk_widget_get_window(widget));
+  timeline_draw(timeline, cr, widget->allocation.width,
+                widget->allocation.height);
+  cairo_destroy(cr);
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Callback for when the timeline is clicked, which selects the row that was
+ * clicked in the tree view
+ *
+ * \param[in] widget     not used
+ * \param[in] event      the event, with the position of the pointer
+ * \param[in] user_data  not used
+ *
+ * \return
+ * \c TRUE (to stop other handlers from being invoked for the event)
+ */
+static gboolean
+timeline_button_press_callback(GtkWidget      *widget,
+                               GdkEventButton *event,
+                               gpointer        user_data)
+{
+  const gint row = timeline_get_row_at(timeline, event->x);
+
+  UNUSED(widget);
+  UNUSED(user_data);
+
+  if (row >= 0) {
+    GtkTreePath *path = gtk_tree_path_new_from_indices(row, -1);
+    gtk_tree_view_set_cursor(GTK_TREE_VIEW(list), path, NULL, FALSE);
+    gtk_tree_path_free(path);
+  }
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Callback for when the drawing area is about to get resized
+ *
+ * \param[in] widget      the widget that received the signal
+ * \param[in] allocation  the widget's allocated region
+ * \param[in] user_data   not used
+ */
+static void
+size_allocate_callback(GtkWidget     *widget,
+                       GtkAllocation *allocation,
+                       gpointer       user_data)
+{
+  UNUSED(user_data);
+
+  /* force the width to be equal to the height */
+  gtk_widget_set_size_request(widget, allocation->height, -1);
+}
+
+/* documented in gui.h */
+void
+print_error(gchar *message)
+{
+  GtkWidget *dialog;
+  dialog = gtk_message_dialog_new(GTK_WINDOW(window),
+                                  GTK_DIALOG_DESTROY_WITH_PARENT,
+                                  GTK_MESSAGE_ERROR,
+                                  GTK_BUTTONS_CLOSE,
+                                  "%s", message);
+  gtk_dialog_run(GTK_DIALOG(dialog));
+  gtk_widget_destroy(dialog);
+}
+
+/*!
+ * \brief
+ * Reads the next line to replay from ::replay_reader or ::replay_log
+ *
+ * Messages of a recorded game are attributed to the client that would have
+ * sent them: the first player sets up the board and plays white, so it sends
+ * the messages after which red is to move.
+ *
+ * \param[out] channel_id  the channel that the line came from
+ * \param[out] len         the length of the line in bytes
+ * \param[out] stats       the recorded measurements, as for append_text()
+ *
+ * \return
+ * the line, which is valid until the next call, or \c NULL at the end
+ */
+static const gchar *
+replay_next(guint8 * const channel_id,
+            gsize  * const len,
+            reply_stats_t * const stats)
+{
+  static gchar *line = NULL;
+  GError *error = NULL;
+  message_t message;
+
+  if (replay_reader != NULL) {
+    return transcript_reader_next(replay_reader, channel_id, len, stats);
+  }
+
+  g_free(line);
+  line = gamelog_read(replay_log, &error);
+  stats->think_us = gamelog_get_think_time(replay_log);
+  stats->cpu_us = stats->rss_kb = -1;
+  if (error != NULL) {
+    print_error(error->message);
+    g_error_free(error);
+  }
+  if (line == NULL || !parse_message(line, &message)) return NULL;
+
+  *channel_id = CHANNEL_ID(message.next_player == 'r' ? 0 : 1, STDOUT);
+  line = g_realloc(line, strlen(line) + 2);
+  strcat(line, "\n");
+  *len = strlen(line);
+  return line;
+}
+
+/*!
+ * \brief
+ * Feeds the next move of ::session_loading through append_text(), as if it
+ * came from the clients
+ *
+ * \return
+ * whether there was a move, which is \c FALSE at the end of the session or
+ * at a corrupt record
+ */
+static gboolean
+load_next_move(void)
+{
+  const session_record_t *record;
+  reply_stats_t stats;
+
+  if (session_next_move >= session_get_n_moves(session_loading)) {
+    return FALSE;
+  }
+  record = session_get_record(session_loading, session_next_move);
+  if (record == NULL) return FALSE;
+  ++session_next_move;
+
+  session_get_reply_stats(session_loading, record, &stats);
+  for (guint8 type = STDOUT; type <= STDERR; ++type) {
+    gsize length;
+    const gchar *text = session_get_blob(session_loading, record, type,
+                                         &length);
+    if (length > 0) {
+      append_text(text, length, CHANNEL_ID(record->client_id, type),
+                  type == STDOUT ? &stats : NULL);
+    }
+  }
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Closes the file being loaded or replayed once it has ended
+ *
+ * The end of a replay is told in the statusbar, as is a session that ends
+ * early at a corrupt record.
+ */
+static void
+finish_filling(void)
+{
+  const gchar *text = "Replay finished.";
+  GtkTreeModel * const model = gtk_tree_view_get_model(GTK_TREE_VIEW(list));
+
+  /* the last row won't get any more output */
+  finish_row_metrics(model, gtk_tree_model_iter_n_children(model, NULL) - 1);
+  if (session_loading != NULL) {
+    text = session_next_move < session_get_n_moves(session_loading)
+      ? "The rest of the session file is corrupt." : NULL;
+    session_close(session_loading);
+  }
+  if (replay_reader != NULL) transcript_reader_close(replay_reader);
+  if (replay_log != NULL) gamelog_close(replay_log);
+  session_loading = NULL;
+  replay_reader = NULL;
+  replay_log = NULL;
+  if (text != NULL) {
+    gtk_statusbar_pop(GTK_STATUSBAR(statusbar), statusbar_context_id);
+    gtk_statusbar_push(GTK_STATUSBAR(statusbar), statusbar_context_id,
+                       text);
+  }
+}
+
+/*!
+ * \brief
+ * Feeds the moves of the session being loaded, or the lines from the
+ * transcript or game being replayed, through append_text(), until the store
+ * holds #REPLAY_LOOKAHEAD rows beyond the given row
+ *
+ * The file is closed when it ends. Nothing happens if nothing is being
+ * loaded or replayed.
+ *
+ * \param[in] row  the number of the row that is about to be displayed
+ */
+static void
+fill_rows(const gint row)
+{
+  /* appending rows might select another row, which calls this function */
+  static gboolean is_filling = FALSE;
+  GtkTreeModel *model;
+
+  if ((session_loading == NULL && replay_reader == NULL &&
+       replay_log == NULL) || is_filling) return;
+
+  is_filling = TRUE;
+  model = gtk_tree_view_get_model(GTK_TREE_VIEW(list));
+  while (gtk_tree_model_iter_n_children(model, NULL) <=
+         row + REPLAY_LOOKAHEAD) {
+    const gchar *text;
+    guint8 channel_id;
+    gsize len;
+    reply_stats_t stats;
+
+    if (session_loading != NULL) {
+      if (load_next_move()) continue;
+      finish_filling();
+      break;
+    }
+    text = replay_next(&channel_id, &len, &stats);
+    if (text == NULL) {
+      finish_filling();
+      break;
+    }
+    append_text(text, len, channel_id,
+                IS_STDOUT(channel_id) ? &stats : NULL);
+  }
+  is_filling = FALSE;
+}
+
+/*!
+ * \brief
+ * Callback for when the list of moves is scrolled, which loads the moves of
+ * a session up to a batch beyond the last visible row
+ *
+ * \param[in] adjustment  not used
+ * \param[in] user_data   not used
+ */
+static void
+list_scrolled_callback(GtkAdjustment *adjustment, gpointer user_data)
+{
+  GtkTreePath *end;
+
+  UNUSED(adjustment);
+  UNUSED(user_data);
+
+  /* replays follow the selection only, since they select their new rows */
+  if (session_loading == NULL ||
+      !gtk_tree_view_get_visible_range(GTK_TREE_VIEW(list), NULL, &end)) {
+    return;
+  }
+  fill_rows(*gtk_tree_path_get_indices(end) + SESSION_LOAD_BATCH);
+  gtk_tree_path_free(end);
+}
+
+/*!
+ * \brief
+ * Callback for when the animation timed out and it's time to change the
+ * selected row
+ *
+ * \param[in] user_data  not used
+ *
+ * \return
+ * \c FALSE (to remove the source)
+ */
+static gboolean
+animation_timeout_callback(gpointer user_data)
+{
+  GtkTreeSelection *selection;
+  GList *rows;
+  GtkListStore *store;
+  GtkTreeIter iter;
+
+  UNUSED(user_data);
+
+  source_timeout = 0;
+
+  selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(list));
+  rows = gtk_tree_selection_get_selected_rows(selection, NULL);
+
+  if (g_list_first(rows) != NULL) {
+    GtkTreePath *path;
+    path = (GtkTreePath *)g_list_first(rows)->data;
+    fill_rows(*gtk_tree_path_get_indices(path) + 1);
+    store = GTK_LIST_STORE(gtk_tree_view_get_model(GTK_TREE_VIEW(list)));
+    gtk_tree_model_get_iter(GTK_TREE_MODEL(store), &iter, path);
 
     if (gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &iter)) {
       GtkTreePath *path;
@@ -663,12 +1484,34 @@ run_kill_clicked_callback(GtkWidget *widget, gpointer user_data)
   if (is_running) {
     kill_clients();
   } else {
+    extern gchar *option_session_file;
+    extern gchar *option_transcript_file;
     const gchar *cmds[2];
 
     /* clear data that might exist from a previous run */
     release_resources();
     wipe_buffers();
 
+    if (option_session_file != NULL) {
+      session_writer = session_writer_open(option_session_file, &error);
+      if (error != NULL) {
+        print_error(error->message);
+        g_clear_error(&error);
+      }
+      if (session_writer != NULL && positions != NULL) {
+        positions_file = positions_begin_file(positions,
+                                              option_session_file);
+      }
+    }
+    if (option_transcript_file != NULL) {
+      transcript_writer = transcript_writer_open(option_transcript_file,
+                                                 &error);
+      if (error != NULL) {
+        print_error(error->message);
+        g_clear_error(&error);
+      }
+    }
+
     cmds[0] = gtk_entry_get_text(GTK_ENTRY(entry_cmds[0]));
     cmds[1] = gtk_entry_get_text(GTK_ENTRY(entry_cmds[1]));
     launch_clients(cmds, &error);
@@ -679,6 +1522,130 @@ run_kill_clicked_callback(GtkWidget *widget, gpointer user_data)
   }
 }
 
+/*!
+ * \brief
+ * Callback for when another heatmap is chosen
+ *
+ * \param[in] combo      the combo box that received the signal
+ * \param[in] user_data  not used
+ */
+static void
+heatmap_changed_callback(GtkComboBox *combo, gpointer user_data)
+{
+  UNUSED(combo);
+  UNUSED(user_data);
+
+  gtk_widget_queue_draw(drawing_area);
+}
+
+/*!
+ * \brief
+ * Reports the outcome of an export in the statusbar, in the main thread
+ *
+ * \param[in] user_data  the ::live_export_t, which is freed
+ *
+ * \return
+ * \c FALSE (to be called once)
+ */
+static gboolean
+export_done_callback(gpointer user_data)
+{
+  extern gchar *option_output;
+  live_export_t * const export = user_data;
+
+  if (export->error != NULL) {
+    print_error(export->error->message);
+    g_error_free(export->error);
+  } else {
+    gchar * const text =
+      g_strdup_printf("Exported %u positions as %s to %s.",
+                      g_strv_length(export->lines), export->stem,
+                      option_output != NULL ? option_output : ".");
+    gtk_statusbar_push(GTK_STATUSBAR(statusbar), statusbar_context_id,
+                       text);
+    g_free(text);
+  }
+  g_strfreev(export->lines);
+  g_free(export->stem);
+  g_slice_free(live_export_t, export);
+  gtk_widget_set_sensitive(combo_export, TRUE);
+  return FALSE;
+}
+
+/*!
+ * \brief
+ * Renders the game in the window, in a thread of its own
+ *
+ * \param[in] data  the ::live_export_t
+ *
+ * \return
+ * \c NULL
+ */
+static gpointer
+export_thread(gpointer data)
+{
+  live_export_t * const export = data;
+
+  export_messages(export->lines, export->stem, export->format,
+                  &export->error);
+  g_idle_add(export_done_callback, export);
+  return NULL;
+}
+
+/*!
+ * \brief
+ * Callback for when a format is chosen to export the game in the window
+ *
+ * The messages of the rows are copied, so the game can go on while they're
+ * rendered.
+ *
+ * \param[in] combo      the combo box that received the signal
+ * \param[in] user_data  not used
+ */
+static void
+export_changed_callback(GtkComboBox *combo, gpointer user_data)
+{
+  const gint format = gtk_combo_box_get_active(combo) - 1;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  GPtrArray *lines;
+  GDateTime *now;
+  live_export_t *export;
+  gboolean valid;
+
+  UNUSED(user_data);
+
+  if (format < 0) return;
+  gtk_combo_box_set_active(combo, 0);
+
+  model = gtk_tree_view_get_model(GTK_TREE_VIEW(list));
+  lines = g_ptr_array_new();
+  for (valid = gtk_tree_model_get_iter_first(model, &iter); valid;
+       valid = gtk_tree_model_iter_next(model, &iter)) {
+    message_t message;
+    gchar *text;
+    gtk_tree_model_get(model, &iter, STDOUT_COLUMN, &text, -1);
+    /* the rows without a board aren't positions */
+    if (parse_message(text, &message)) {
+      g_ptr_array_add(lines, text);
+    } else {
+      g_free(text);
+    }
+  }
+  g_ptr_array_add(lines, NULL);
+
+  export = g_slice_new(live_export_t);
+  export->lines = (gchar **)g_ptr_array_free(lines, FALSE);
+  now = g_date_time_new_now_local();
+  export->stem = g_date_time_format(now, "game-%Y%m%d-%H%M%S");
+  g_date_time_unref(now);
+  export->format = export_formats[format];
+  export->error = NULL;
+  /* one export at a time */
+  gtk_widget_set_sensitive(combo_export, FALSE);
+  g_thread_unref(g_thread_new("export", export_thread, export));
+}
+
 /*!
  * \brief
  * Callback for when the 'Animate' button is clicked
@@ -701,6 +1668,53 @@ animate_toggled_callback(GtkToggleButton *button, gpointer user_data)
   }
 }
 
+/*!
+ * \brief
+ * Shows the outcome of the board of a row with best play, if it's in the
+ * endgame tablebase
+ *
+ * \param[in] model  the store from which to read
+ * \param[in] iter   an iterator to the row
+ */
+static void
+update_tablebase_label(GtkTreeModel *model, GtkTreeIter iter)
+{
+  gchar *text;
+  gchar *outcome = NULL;
+  message_t message;
+  position_t position;
+
+  gtk_tree_model_get(model, &iter, STDOUT_COLUMN, &text, -1);
+  if (text != NULL && parse_message(text, &message) &&
+      get_position(&message, &position)) {
+    const gchar * const mover = position.player == 'r' ? "Red" : "White";
+    const gchar * const opponent = position.player == 'r' ? "White"
+                                                          : "Red";
+    guint plies = 0;
+
+    switch (tablebase_probe(tablebase, &position, &plies)) {
+    case OUTCOME_WIN:
+      outcome = g_strdup_printf("%s to move wins in %u plies", mover,
+                                plies);
+      break;
+    case OUTCOME_LOSS:
+      outcome = plies == 0 ? g_strdup_printf("%s has won", opponent)
+                           : g_strdup_printf("%s to move loses in %u plies",
+                                             mover, plies);
+      break;
+    case OUTCOME_DRAW:
+      outcome = g_strdup("Drawn with best play");
+      break;
+    case OUTCOME_UNKNOWN:
+      break;
+    }
+  }
+  gtk_label_set_text(GTK_LABEL(tablebase_label),
+                     outcome != NULL ? outcome : "Not in the tablebase");
+  g_free(outcome);
+  g_free(text);
+}
+
 /*!
  * \brief
  * Gets board appearance from the store, to display in the drawing area
@@ -722,6 +1736,7 @@ load_board_and_moves(GtkTreeModel *model, GtkTreeIter iter)
                      BOARD_COLUMN, &str_board,
                      MOVES_COLUMN, &list_moves,
                      -1);
+  if (tablebase != NULL) update_tablebase_label(model, iter);
   /* hack to avoid flickering - delay redrawing if we expect
      to get something to draw soon */
   if (!is_running || str_board != NULL ||
@@ -732,159 +1747,556 @@ load_board_and_moves(GtkTreeModel *model, GtkTreeIter iter)
 
 /*!
  * \brief
- * Highlights text in the relevant text buffers
+ * Highlights text in the relevant text buffers
+ *
+ * \param[in] path  the path to the list row that has been selected
+ */
+static void
+highlight_text(GtkTreePath *path)
+{
+  gint row;
+  gchar *mark_name_begin;
+  gchar *mark_name_end;
+
+  row = *gtk_tree_path_get_indices(path);
+  mark_name_begin = get_mark_name_begin(row);
+  mark_name_end = get_mark_name_end(row);
+
+  for (guint8 i = 0; i < NUM_CHANNELS; ++i) {
+    GtkTextIter iter_begin;
+    GtkTextIter iter_end;
+    GtkTextMark *mark_begin;
+    GtkTextMark *mark_end;
+
+    /* clear old highlighting */
+    gtk_text_buffer_get_start_iter(buffers[i], &iter_begin);
+    gtk_text_buffer_get_end_iter(buffers[i], &iter_end);
+    gtk_text_buffer_remove_tag_by_name(buffers[i], "emph",
+                                       &iter_begin, &iter_end);
+
+    /* create new highlighting */
+    mark_begin = gtk_text_buffer_get_mark(buffers[i], mark_name_begin);
+    mark_end   = gtk_text_buffer_get_mark(buffers[i], mark_name_end);
+
+    gtk_text_buffer_get_iter_at_mark(buffers[i], &iter_begin, mark_begin);
+    gtk_text_buffer_get_iter_at_mark(buffers[i], &iter_end,   mark_end);
+    gtk_text_buffer_apply_tag_by_name(buffers[i], "emph",
+                                      &iter_begin, &iter_end);
+    gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(textviews[i]), mark_begin,
+                                 .0, TRUE, .0, .0);
+  }
+
+  g_free(mark_name_begin);
+  g_free(mark_name_end);
+}
+
+/*!
+ * \brief
+ * Callback for when a row is selected in the tree view
+ *
+ * \param[in] widget     the widget that received the signal
+ * \param[in] user_data  not used
+ */
+static void
+cursor_changed_callback(GtkWidget *widget, gpointer user_data)
+{
+  GtkTreeSelection *selection;
+  GList *rows;
+
+  UNUSED(user_data);
+
+  g_free(str_board);
+  str_board = NULL;
+  list_moves = NULL;
+
+  selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(widget));
+  rows = gtk_tree_selection_get_selected_rows(selection, NULL);
+
+  /* we want one and only one row to have been selected */
+  if (g_list_first(rows) != NULL && g_list_next(rows) == NULL) {
+    GtkTreePath *path;
+    GtkListStore *store;
+    GtkTreeIter iter;
+
+    path = (GtkTreePath *)g_list_first(rows)->data;
+    store = GTK_LIST_STORE(gtk_tree_view_get_model(GTK_TREE_VIEW(list)));
+    gtk_tree_model_get_iter(GTK_TREE_MODEL(store), &iter, path);
+    load_board_and_moves(GTK_TREE_MODEL(store), iter);
+
+    highlight_text(path);
+    charts_select(charts, *gtk_tree_path_get_indices(path));
+    gtk_widget_queue_draw(charts_area);
+    timeline_select(timeline, *gtk_tree_path_get_indices(path));
+    gtk_widget_queue_draw(timeline_area);
+    if (compare_messages != NULL) gtk_widget_queue_draw(compare_area);
+    fill_rows(*gtk_tree_path_get_indices(path));
+  }
+
+  g_list_foreach(rows, (GFunc)gtk_tree_path_free, NULL);
+  g_list_free(rows);
+
+  /* abort current animation and restart it */
+  if (source_timeout > 0) {
+    g_source_remove(source_timeout);
+    source_timeout = 0;
+  }
+  if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(btn_animate))) {
+    start_animation_timeout();
+  }
+}
+
+/*!
+ * \brief
+ * Callback for when data was changed in the store, as it might affect what's
+ * currently displayed
+ *
+ * \param[in]  model      the model on which the signal was emitted
+ * \param[in]  path       a path identifying the changed row
+ * \param[in]  iter       an iterator pointing to the changed row
+ * \param[out] user_data  not used
+ */
+static void
+row_changed_callback(GtkTreeModel *model,
+                     GtkTreePath  *path,
+                     GtkTreeIter  *iter,
+                     gpointer      user_data)
+{
+  GtkTreeSelection *selection;
+
+  UNUSED(user_data);
+
+  selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(list));
+  if (gtk_tree_selection_path_is_selected(selection, path)) {
+    g_free(str_board);
+    str_board = NULL;
+    list_moves = NULL;
+    load_board_and_moves(model, *iter);
+
+    highlight_text(path);
+  }
+}
+
+/*!
+ * \brief
+ * Callback for when data was inserted into the store, as it might cause us to
+ * select another row
+ *
+ * \param[in]  model      not used
+ * \param[in]  path       a path identifying the new row
+ * \param[in]  iter       not used
+ * \param[out] user_data  not used
+ */
+static void
+row_inserted_callback(GtkTreeModel *model,
+                      GtkTreePath  *path,
+                      GtkTreeIter  *iter,
+                      gpointer      user_data)
+{
+  GtkTreeSelection *selection;
+
+  UNUSED(model);
+  UNUSED(iter);
+  UNUSED(user_data);
+
+  /* the rows of a session are loaded on demand, without moving the
+     selection to them */
+  if (session_loading != NULL) return;
+
+  selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(list));
+
+  /* abort if an animation is in progress */
+  if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(btn_animate)) &&
+      !is_animation_stalled &&
+      gtk_tree_selection_count_selected_rows(selection) == 1) return;
+
+  gtk_tree_view_set_cursor(GTK_TREE_VIEW(list), path, NULL, FALSE);
+}
+
+/*!
+ * \brief
+ * Formats a measurement of a row for the "Time", "CPU" or "Memory" column
+ *
+ * Follows the signature of \c GtkTreeCellDataFunc.
+ *
+ * \param[in] column     not used
+ * \param[in] renderer   the cell renderer to set the text of
+ * \param[in] model      the store
+ * \param[in] iter       the row
+ * \param[in] user_data  the store column to format (#THINK_COLUMN,
+ *                       #CPU_COLUMN or #RSS_COLUMN), converted to a
+ *                       \c gpointer using \c GINT_TO_POINTER()
+ */
+static void
+stats_data_func(GtkTreeViewColumn *column,
+                GtkCellRenderer   *renderer,
+                GtkTreeModel      *model,
+                GtkTreeIter       *iter,
+                gpointer           user_data)
+{
+  const gint store_column = GPOINTER_TO_INT(user_data);
+  gint64 value;
+  gchar *text;
+
+  UNUSED(column);
+
+  gtk_tree_model_get(model, iter,
+                     store_column, &value,
+                     -1);
+  if (value < 0) {
+    text = g_strdup("");
+  } else if (store_column == RSS_COLUMN) {
+    text = g_strdup_printf("%.1f MiB", value/1024.);
+  } else {
+    text = g_strdup_printf("%.3f ms", value/1000.);
+  }
+  g_object_set(renderer, "text", text, NULL);
+  g_free(text);
+}
+
+/*!
+ * \brief
+ * Formats the statistics of a row for the "Metrics" column, with the rates
+ * derived from the think time of the row
+ *
+ * Follows the signature of \c GtkTreeCellDataFunc.
+ *
+ * \param[in] column     not used
+ * \param[in] renderer   the cell renderer to set the text of
+ * \param[in] model      the store
+ * \param[in] iter       the row
+ * \param[in] user_data  not used
+ */
+static void
+metrics_data_func(GtkTreeViewColumn *column,
+                  GtkCellRenderer   *renderer,
+                  GtkTreeModel      *model,
+                  GtkTreeIter       *iter,
+                  gpointer           user_data)
+{
+  metrics_t *metrics;
+  gint64 think_us;
+  gchar *text = NULL;
+
+  UNUSED(column);
+  UNUSED(user_data);
+
+  gtk_tree_model_get(model, iter,
+                     THINK_COLUMN, &think_us,
+                     METRICS_COLUMN, &metrics,
+                     -1);
+  if (metrics != NULL) text = metrics_to_string(metrics, think_us);
+  g_object_set(renderer, "text", text, NULL);
+  g_free(text);
+}
+
+/*!
+ * \brief
+ * Shows the description of a move in the "Move" column, highlighted if the
+ * board occurred earlier in the game
+ *
+ * Follows the signature of \c GtkTreeCellDataFunc.
+ *
+ * \param[in] column     not used
+ * \param[in] renderer   the cell renderer to set the text of
+ * \param[in] model      the store
+ * \param[in] iter       the row
+ * \param[in] user_data  not used
+ */
+static void
+desc_data_func(GtkTreeViewColumn *column,
+               GtkCellRenderer   *renderer,
+               GtkTreeModel      *model,
+               GtkTreeIter       *iter,
+               gpointer           user_data)
+{
+  gchar *desc;
+  guint n_repeats;
+
+  UNUSED(column);
+  UNUSED(user_data);
+
+  gtk_tree_model_get(model, iter,
+                     DESC_COLUMN, &desc,
+                     REPEAT_COLUMN, &n_repeats,
+                     -1);
+  g_object_set(renderer,
+               "text", desc,
+               "cell-background", REPEAT_BACKGROUND,
+               "cell-background-set", n_repeats > 0,
+               NULL);
+  g_free(desc);
+}
+
+/*!
+ * \brief
+ * Formats the evaluation of a row for the "Eval" column, in men from red's
+ * point of view, or as the number of plies to a win
+ *
+ * Follows the signature of \c GtkTreeCellDataFunc.
+ *
+ * \param[in] column     not used
+ * \param[in] renderer   the cell renderer to set the text of
+ * \param[in] model      the store
+ * \param[in] iter       the row
+ * \param[in] user_data  not used
+ */
+static void
+eval_data_func(GtkTreeViewColumn *column,
+               GtkCellRenderer   *renderer,
+               GtkTreeModel      *model,
+               GtkTreeIter       *iter,
+               gpointer           user_data)
+{
+  gint score;
+  gboolean is_blunder;
+  gchar *text = NULL;
+
+  UNUSED(column);
+  UNUSED(user_data);
+
+  gtk_tree_model_get(model, iter,
+                     EVAL_COLUMN, &score,
+                     BLUNDER_COLUMN, &is_blunder,
+                     -1);
+  if (score == NO_EVAL) {
+    text = NULL;
+  } else if (ABS(score) > ENGINE_SCORE_WON) {
+    text = g_strdup_printf("%c#%d%s", score > 0 ? '+' : '-',
+                           ENGINE_SCORE_WIN - ABS(score),
+                           is_blunder ? " ??" : "");
+  } else {
+    text = g_strdup_printf("%+.2f%s", score/100., is_blunder ? " ??" : "");
+  }
+  g_object_set(renderer, "text", text, NULL);
+  g_free(text);
+}
+
+/*!
+ * \brief
+ * Marks a move as a likely blunder if the score of the player who made it
+ * dropped by at least #BLUNDER_LOSS, once both boards are evaluated
  *
- * \param[in] path  the path to the list row that has been selected
+ * \param[in] model  the store
+ * \param[in] row    the number of the row of the move
  */
 static void
-highlight_text(GtkTreePath *path)
+mark_blunder(GtkTreeModel *model, gint row)
 {
-  gint row;
-  gchar *mark_name_begin;
-  gchar *mark_name_end;
-
-  row = *gtk_tree_path_get_indices(path);
-  mark_name_begin = get_mark_name_begin(row);
-  mark_name_end = get_mark_name_end(row);
-
-  for (guint8 i = 0; i < NUM_CHANNELS; ++i) {
-    GtkTextIter iter_begin;
-    GtkTextIter iter_end;
-    GtkTextMark *mark_begin;
-    GtkTextMark *mark_end;
-
-    /* clear old highlighting */
-    gtk_text_buffer_get_start_iter(buffers[i], &iter_begin);
-    gtk_text_buffer_get_end_iter(buffers[i], &iter_end);
-    gtk_text_buffer_remove_tag_by_name(buffers[i], "emph",
-                                       &iter_begin, &iter_end);
+  GtkTreeIter iter_before;
+  GtkTreeIter iter;
+  gint score_before;
+  gint score;
+  gchar *text;
+  message_t before;
 
-    /* create new highlighting */
-    mark_begin = gtk_text_buffer_get_mark(buffers[i], mark_name_begin);
-    mark_end   = gtk_text_buffer_get_mark(buffers[i], mark_name_end);
+  if (row < 1 ||
+      !gtk_tree_model_iter_nth_child(model, &iter_before, NULL, row - 1) ||
+      !gtk_tree_model_iter_nth_child(model, &iter, NULL, row)) return;
 
-    gtk_text_buffer_get_iter_at_mark(buffers[i], &iter_begin, mark_begin);
-    gtk_text_buffer_get_iter_at_mark(buffers[i], &iter_end,   mark_end);
-    gtk_text_buffer_apply_tag_by_name(buffers[i], "emph",
-                                      &iter_begin, &iter_end);
-    gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(textviews[i]), mark_begin,
-                                 .0, TRUE, .0, .0);
+  gtk_tree_model_get(model, &iter_before,
+                     EVAL_COLUMN, &score_before,
+                     STDOUT_COLUMN, &text,
+                     -1);
+  gtk_tree_model_get(model, &iter, EVAL_COLUMN, &score, -1);
+  if (score_before != NO_EVAL && score != NO_EVAL &&
+      parse_message(text, &before)) {
+    /* the player to move before is the one who made the move */
+    const gint loss = before.next_player == 'r' ? score_before - score
+                                                : score - score_before;
+    gtk_list_store_set(GTK_LIST_STORE(model), &iter,
+                       BLUNDER_COLUMN, loss >= BLUNDER_LOSS,
+                       -1);
   }
-
-  g_free(mark_name_begin);
-  g_free(mark_name_end);
+  g_free(text);
 }
 
 /*!
  * \brief
- * Callback for when a row is selected in the tree view
+ * Receives the evaluation of a row from the background analysis
  *
- * \param[in] widget     the widget that received the signal
+ * Follows the signature of ::analysis_func_t.
+ *
+ * \param[in] row        the row
+ * \param[in] score      the score from red's point of view
  * \param[in] user_data  not used
  */
 static void
-cursor_changed_callback(GtkWidget *widget, gpointer user_data)
+analysis_callback(gint row, gint score, gpointer user_data)
 {
-  GtkTreeSelection *selection;
-  GList *rows;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
 
   UNUSED(user_data);
 
-  g_free(str_board);
-  str_board = NULL;
-  list_moves = NULL;
-
-  selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(widget));
-  rows = gtk_tree_selection_get_selected_rows(selection, NULL);
-
-  /* we want one and only one row to have been selected */
-  if (g_list_first(rows) != NULL && g_list_next(rows) == NULL) {
-    GtkTreePath *path;
-    GtkListStore *store;
-    GtkTreeIter iter;
-
-    path = (GtkTreePath *)g_list_first(rows)->data;
-    store = GTK_LIST_STORE(gtk_tree_view_get_model(GTK_TREE_VIEW(list)));
-    gtk_tree_model_get_iter(GTK_TREE_MODEL(store), &iter, path);
-    load_board_and_moves(GTK_TREE_MODEL(store), iter);
+  model = gtk_tree_view_get_model(GTK_TREE_VIEW(list));
+  if (!gtk_tree_model_iter_nth_child(model, &iter, NULL, row)) return;
+  gtk_list_store_set(GTK_LIST_STORE(model), &iter, EVAL_COLUMN, score, -1);
+  /* the move to this board, and the move from it */
+  mark_blunder(model, row);
+  mark_blunder(model, row + 1);
+}
 
-    highlight_text(path);
-  }
+/*!
+ * \brief
+ * Lets a heatmap be chosen once every file is counted
+ *
+ * Follows the signature of ::heatmap_func_t.
+ *
+ * \param[in] user_data  not used
+ */
+static void
+heatmap_callback(gpointer user_data)
+{
+  UNUSED(user_data);
 
-  g_list_foreach(rows, (GFunc)gtk_tree_path_free, NULL);
-  g_list_free(rows);
+  gtk_widget_set_sensitive(combo_heatmap, TRUE);
+  gtk_widget_queue_draw(drawing_area);
+}
 
-  /* abort current animation and restart it */
-  if (source_timeout > 0) {
-    g_source_remove(source_timeout);
-    source_timeout = 0;
-  }
-  if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(btn_animate))) {
-    start_animation_timeout();
+/*!
+ * \brief
+ * Selects a row of a file that is being loaded or replayed, once its board
+ * is loaded
+ *
+ * \param[in] row  the number of the row
+ * \param[in] key  the key of the board of the row
+ */
+static void
+jump_to_row(gint row, guint64 key)
+{
+  fill_rows(row);
+
+  /* the row may already be loaded, or else is selected as it arrives */
+  jump_key = key;
+  for (guint i = row; i < row_keys->len; ++i) {
+    if (g_array_index(row_keys, guint64, i) == jump_key) {
+      select_row(i);
+      return;
+    }
   }
+  jump_row = row;
 }
 
 /*!
  * \brief
- * Callback for when data was changed in the store, as it might affect what's
- * currently displayed
+ * Loads the file of a menu item of other games with a board, and selects
+ * the row of the board once it's loaded
  *
- * \param[in]  model      the model on which the signal was emitted
- * \param[in]  path       a path identifying the changed row
- * \param[in]  iter       an iterator pointing to the changed row
- * \param[out] user_data  not used
+ * \param[in] item       the GtkMenuItem, with the file and row as data
+ * \param[in] user_data  not used
  */
 static void
-row_changed_callback(GtkTreeModel *model,
-                     GtkTreePath  *path,
-                     GtkTreeIter  *iter,
-                     gpointer      user_data)
+jump_activate_callback(GtkMenuItem *item, gpointer user_data)
 {
-  GtkTreeSelection *selection;
+  /* the menu, and its data, live until the next menu pops up */
+  const gchar * const path = g_object_get_data(G_OBJECT(item), "path");
+  const gint row = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(item),
+                                                     "row"));
+  session_t * const session = session_open(path, NULL);
 
   UNUSED(user_data);
 
-  selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(list));
-  if (gtk_tree_selection_path_is_selected(selection, path)) {
-    g_free(str_board);
-    str_board = NULL;
-    list_moves = NULL;
-    load_board_and_moves(model, *iter);
-
-    highlight_text(path);
+  if (session != NULL) {
+    session_close(session);
+    load_session(path);
+  } else {
+    start_replay(path);
   }
+  jump_to_row(row,
+              *(const guint64 *)g_object_get_data(G_OBJECT(item), "key"));
 }
 
 /*!
  * \brief
- * Callback for when data was inserted into the store, as it might cause us to
- * select another row
+ * Callback for mouse clicks in the list of moves, which pops up a menu of
+ * the other games that reached the board of a row on a right click
  *
- * \param[in]  model      not used
- * \param[in]  path       a path identifying the new row
- * \param[in]  iter       not used
- * \param[out] user_data  not used
+ * \param[in] widget     the GtkTreeView
+ * \param[in] event      the click
+ * \param[in] user_data  not used
+ *
+ * \return
+ * whether the click was handled
  */
-static void
-row_inserted_callback(GtkTreeModel *model,
-                      GtkTreePath  *path,
-                      GtkTreeIter  *iter,
-                      gpointer      user_data)
+static gboolean
+list_button_press_callback(GtkWidget      *widget,
+                           GdkEventButton *event,
+                           gpointer        user_data)
 {
-  GtkTreeSelection *selection;
+  GtkTreePath *path;
+  GtkWidget *menu;
+  GArray *found;
+  guint64 key;
+  gint row;
+  guint n_items = 0;
 
-  UNUSED(model);
-  UNUSED(iter);
   UNUSED(user_data);
 
-  selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(list));
-
-  /* abort if an animation is in progress */
-  if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(btn_animate)) &&
-      !is_animation_stalled &&
-      gtk_tree_selection_count_selected_rows(selection) == 1) return;
+  if (event->type != GDK_BUTTON_PRESS || event->button != 3 ||
+      positions == NULL ||
+      !gtk_tree_view_get_path_at_pos(GTK_TREE_VIEW(widget), event->x,
+                                     event->y, &path, NULL, NULL, NULL)) {
+    return FALSE;
+  }
+  row = *gtk_tree_path_get_indices(path);
+  gtk_tree_view_set_cursor(GTK_TREE_VIEW(widget), path, NULL, FALSE);
+  gtk_tree_path_free(path);
+  if ((guint)row >= row_keys->len) return TRUE;
+  key = g_array_index(row_keys, guint64, row);
+  if (key == 0) return TRUE;
+
+  if (jump_menu != NULL) gtk_widget_destroy(jump_menu);
+  menu = jump_menu = gtk_menu_new();
+  found = positions_find(positions, key);
+  for (guint i = 0; i < found->len; ++i) {
+    const positions_entry_t * const entry =
+      &g_array_index(found, positions_entry_t, i);
+    const gchar * const file = positions_get_file(positions, entry->file);
+    gchar *basename;
+    gchar *label;
+    GtkWidget *item;
+    guint64 *item_key;
+
+    /* the row itself */
+    if ((gint)entry->file == positions_file && (gint)entry->row == row) {
+      continue;
+    }
+    if (n_items++ == MAX_JUMP_ITEMS) {
+      label = g_strdup_printf("%u more", found->len - i);
+      item = gtk_menu_item_new_with_label(label);
+      gtk_widget_set_sensitive(item, FALSE);
+      gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+      g_free(label);
+      break;
+    }
+    basename = g_path_get_basename(file);
+    label = g_strdup_printf("%s, row %u", basename, entry->row + 1);
+    item = gtk_menu_item_new_with_label(label);
+    g_object_set_data_full(G_OBJECT(item), "path", g_strdup(file), g_free);
+    g_object_set_data(G_OBJECT(item), "row", GINT_TO_POINTER(entry->row));
+    item_key = g_new(guint64, 1);
+    *item_key = key;
+    g_object_set_data_full(G_OBJECT(item), "key", item_key, g_free);
+    g_signal_connect(G_OBJECT(item), "activate",
+                     G_CALLBACK(jump_activate_callback), NULL);
+    /* the clients' output would mix with the loaded rows */
+    gtk_widget_set_sensitive(item, !is_running);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+    g_free(label);
+    g_free(basename);
+  }
+  if (n_items == 0) {
+    GtkWidget * const item =
+      gtk_menu_item_new_with_label("No other game reached this board");
+    gtk_widget_set_sensitive(item, FALSE);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+  }
+  g_array_free(found, TRUE);
 
-  gtk_tree_view_set_cursor(GTK_TREE_VIEW(list), path, NULL, FALSE);
+  gtk_widget_show_all(menu);
+  gtk_menu_popup(GTK_MENU(menu), NULL, NULL, NULL, NULL, event->button,
+                 event->time);
+  return TRUE;
 }
 
 /*!
@@ -908,6 +2320,28 @@ window_destroy_callback(GtkObject *object,
   kill_clients();
 
   release_resources();
+  analysis_free(analysis);
+  analysis = NULL;
+  tablebase_close(tablebase);
+  tablebase = NULL;
+  heatmap_free(heatmap);
+  heatmap = NULL;
+  if (positions != NULL) {
+    GError *error = NULL;
+    if (!positions_save(positions, &error)) {
+      print_error(error->message);
+      g_error_free(error);
+    }
+    positions_close(positions);
+    positions = NULL;
+  }
+  g_array_free(row_keys, TRUE);
+  g_hash_table_destroy(game_keys);
+  g_string_free(row_texts[STDOUT], TRUE);
+  g_string_free(row_texts[STDERR], TRUE);
+  if (compare_messages != NULL) g_array_free(compare_messages, TRUE);
+  charts_free(charts);
+  timeline_free(timeline);
 
   gtk_main_quit();
 }
@@ -1009,14 +2443,173 @@ create_player_panel(guint8 id)
   return frame_outer;
 }
 
+/*!
+ * \brief
+ * Starts loading a session file into the store
+ *
+ * The file is mapped, and only the moves up to a batch beyond the last
+ * visible row are loaded here. The rest are loaded as the list is scrolled,
+ * or as the animation (or the user) advances through the rows, so that a
+ * session of any length opens at once.
+ *
+ * \param[in] path  the session file
+ */
+static void
+load_session(const gchar *path)
+{
+  GError *error = NULL;
+  GString *text;
+
+  release_resources();
+  wipe_buffers();
+
+  session_loading = session_open(path, &error);
+  if (session_loading == NULL) {
+    print_error(error->message);
+    g_error_free(error);
+    return;
+  }
+  session_next_move = 0;
+  if (positions != NULL) {
+    positions_file = positions_begin_file(positions, path);
+  }
+
+  text = g_string_new(NULL);
+  g_string_printf(text, "Opened %s.", path);
+  for (guint8 i = 0; i < NUM_CLIENTS; ++i) {
+    const guint64 mask = session_get_cpu_mask(session_loading, i);
+    if (mask != 0) {
+      gchar * const cpus = format_cpu_mask(mask);
+      g_string_append_printf(text, " Player %u was pinned to CPUs %s.",
+                             i + 1, cpus);
+      g_free(cpus);
+    }
+  }
+  gtk_statusbar_pop(GTK_STATUSBAR(statusbar), statusbar_context_id);
+  gtk_statusbar_push(GTK_STATUSBAR(statusbar), statusbar_context_id,
+                     text->str);
+  g_string_free(text, TRUE);
+
+  /* the session may end (or be corrupt) within the first batch */
+  fill_rows(SESSION_LOAD_BATCH);
+  if (gtk_tree_model_iter_n_children(
+        gtk_tree_view_get_model(GTK_TREE_VIEW(list)), NULL) > 0) {
+    select_row(0);
+  }
+}
+
+/*!
+ * \brief
+ * Starts replaying a transcript, or a PDN file
+ *
+ * Only the first few rows are read here, while the rest of the file is read
+ * as the animation (or the user) advances through the rows.
+ *
+ * \param[in] path  the transcript or PDN file, or \c "-" for a transcript
+ *                  from standard input
+ */
+static void
+start_replay(const gchar *path)
+{
+  GError *error = NULL;
+  gchar *text;
+
+  release_resources();
+  wipe_buffers();
+
+  if (g_str_has_suffix(path, ".pdn") || g_str_has_suffix(path, ".PDN")) {
+    replay_log = gamelog_open(path, &error);
+  } else {
+    replay_reader = transcript_reader_open(path, &error);
+  }
+  if (replay_reader == NULL && replay_log == NULL) {
+    print_error(error->message);
+    g_error_free(error);
+    return;
+  }
+
+  if (positions != NULL && strcmp(path, "-") != 0) {
+    positions_file = positions_begin_file(positions, path);
+  }
+
+  text = g_strdup_printf("Replaying %s.", path);
+  gtk_statusbar_pop(GTK_STATUSBAR(statusbar), statusbar_context_id);
+  gtk_statusbar_push(GTK_STATUSBAR(statusbar), statusbar_context_id, text);
+  g_free(text);
+
+  fill_rows(0);
+}
+
+/*!
+ * \brief
+ * Reads the file to compare with (option \c -D), and selects the first row
+ * where the boards of the loaded or replayed file differ from it
+ *
+ * Both files are read in full here, which takes far less time than loading
+ * them into the list.
+ *
+ * \param[in] path  the loaded or replayed file, or \c NULL if there is none
+ */
+static void
+start_compare(const gchar *path)
+{
+  extern gchar *option_compare_file;
+  GError *error = NULL;
+  GArray *keys[2];
+  gchar *text;
+  gint row;
+
+  compare_messages = g_array_new(FALSE, TRUE, sizeof(message_t));
+  for (guint8 i = 0; i < 2; ++i) {
+    keys[i] = g_array_new(FALSE, TRUE, sizeof(guint64));
+  }
+  if (!diverge_read_file(option_compare_file, keys[1], compare_messages,
+                         &error) ||
+      (path != NULL && strcmp(path, "-") != 0 &&
+       !diverge_read_file(path, keys[0], NULL, &error))) {
+    print_error(error->message);
+    g_error_free(error);
+  } else if (path != NULL && strcmp(path, "-") != 0) {
+    row = diverge_find(keys[0], keys[1]);
+    if (row < 0) {
+      text = g_strdup_printf("The boards are the same as in %s.",
+                             option_compare_file);
+    } else {
+      text = g_strdup_printf("The boards first differ from %s at row %d.",
+                             option_compare_file, row + 1);
+      /* the last board before the end of a shorter file, where an empty
+         file has none */
+      if (keys[0]->len == 0) {
+        row = -1;
+      } else if ((guint)row >= keys[0]->len) {
+        row = keys[0]->len - 1;
+      }
+      while (row >= 0 && g_array_index(keys[0], guint64, row) == 0) --row;
+      if (row >= 0) jump_to_row(row, g_array_index(keys[0], guint64, row));
+    }
+    gtk_statusbar_push(GTK_STATUSBAR(statusbar), statusbar_context_id,
+                       text);
+    g_free(text);
+  }
+  for (guint8 i = 0; i < 2; ++i) g_array_free(keys[i], TRUE);
+}
+
 /* documented in gui.h */
 void
 create_window_with_widgets(void)
 {
   extern gboolean option_run;
+  extern gchar   *option_load_session;
+  extern gchar   *option_replay_file;
   extern gboolean option_maximize;
   extern gint     option_width_px;
   extern gint     option_height_px;
+  extern guint    option_analysis_depth;
+  extern gchar   *option_analysis_cache;
+  extern gchar   *option_tablebase;
+  extern gchar   *option_positions;
+  extern gchar   *option_heatmap;
+  extern gchar   *option_compare_file;
 
   GtkWidget *paned;
 
@@ -1031,12 +2624,26 @@ create_window_with_widgets(void)
   g_signal_connect(G_OBJECT(window), "destroy",
                    G_CALLBACK(window_destroy_callback), NULL);
 
+  charts = charts_new();
+  timeline = timeline_new();
+  row_keys = g_array_new(FALSE, TRUE, sizeof(guint64));
+  game_keys = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free,
+                                    g_free);
+  row_texts[STDOUT] = g_string_new(NULL);
+  row_texts[STDERR] = g_string_new(NULL);
+
   /* initialize the data model for the GtkTreeView */
   {
+    static const gint stats_columns[] = {
+      THINK_COLUMN, CPU_COLUMN, RSS_COLUMN
+    };
+    static const gchar * const stats_titles[] = { "Time", "CPU", "Memory" };
     GtkCellRenderer *renderer1;
     GtkCellRenderer *renderer2;
+    GtkCellRenderer *renderer3;
     GtkTreeViewColumn *column1;
     GtkTreeViewColumn *column2;
+    GtkTreeViewColumn *column3;
     GtkListStore *store;
     GtkTreeSelection *selection;
 
@@ -1049,16 +2656,48 @@ create_window_with_widgets(void)
     gtk_tree_view_append_column(GTK_TREE_VIEW(list), column1);
     renderer2 = gtk_cell_renderer_text_new();
     column2 = gtk_tree_view_column_new_with_attributes("Move", renderer2,
-                                                       "text", DESC_COLUMN,
                                                        NULL);
+    gtk_tree_view_column_set_cell_data_func(column2, renderer2,
+      desc_data_func, NULL, NULL);
     gtk_tree_view_append_column(GTK_TREE_VIEW(list), column2);
+    if (option_analysis_depth > 0) {
+      renderer3 = gtk_cell_renderer_text_new();
+      g_object_set(renderer3, "xalign", 1.0, NULL);
+      column3 = gtk_tree_view_column_new_with_attributes("Eval", renderer3,
+                                                         NULL);
+      gtk_tree_view_column_set_cell_data_func(column3, renderer3,
+        eval_data_func, NULL, NULL);
+      gtk_tree_view_append_column(GTK_TREE_VIEW(list), column3);
+    }
+    for (guint8 i = 0; i < G_N_ELEMENTS(stats_columns); ++i) {
+      renderer3 = gtk_cell_renderer_text_new();
+      g_object_set(renderer3, "xalign", 1.0, NULL);
+      column3 = gtk_tree_view_column_new_with_attributes(stats_titles[i],
+                                                         renderer3, NULL);
+      gtk_tree_view_column_set_cell_data_func(column3, renderer3,
+        stats_data_func, GINT_TO_POINTER(stats_columns[i]), NULL);
+      gtk_tree_view_append_column(GTK_TREE_VIEW(list), column3);
+    }
+    renderer3 = gtk_cell_renderer_text_new();
+    column3 = gtk_tree_view_column_new_with_attributes("Metrics", renderer3,
+                                                       NULL);
+    gtk_tree_view_column_set_cell_data_func(column3, renderer3,
+      metrics_data_func, NULL, NULL);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(list), column3);
     store = gtk_list_store_new(N_COLUMNS,
                                G_TYPE_STRING,
                                G_TYPE_STRING,
+                               G_TYPE_INT,
+                               G_TYPE_BOOLEAN,
+                               G_TYPE_UINT,
                                G_TYPE_STRING,
                                G_TYPE_POINTER,
                                G_TYPE_UINT,
-                               G_TYPE_STRING);
+                               G_TYPE_STRING,
+                               G_TYPE_INT64,
+                               G_TYPE_INT64,
+                               G_TYPE_INT64,
+                               G_TYPE_POINTER);
     gtk_tree_view_set_model(GTK_TREE_VIEW(list), GTK_TREE_MODEL(store));
     selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(list));
     gtk_tree_selection_set_mode(selection, GTK_SELECTION_BROWSE);
@@ -1070,6 +2709,8 @@ create_window_with_widgets(void)
 
     g_signal_connect(list, "cursor-changed",
                      G_CALLBACK(cursor_changed_callback), NULL);
+    g_signal_connect(list, "button-press-event",
+                     G_CALLBACK(list_button_press_callback), NULL);
   }
 
   /* build outmost wrapper to contain the GtkPaned and GtkStatusbar */
@@ -1104,6 +2745,7 @@ create_window_with_widgets(void)
     {
       GtkWidget *frame;
       GtkWidget *box_padding;
+      GtkWidget *box_boards;
 
       /* GtkAspectFrame doesn't cut it - rolling my own */
       frame = gtk_frame_new("Board");
@@ -1115,30 +2757,94 @@ create_window_with_widgets(void)
       box_padding = gtk_vbox_new(FALSE, BORDER);
       gtk_container_set_border_width(GTK_CONTAINER(box_padding), BORDER);
       gtk_container_add(GTK_CONTAINER(frame), box_padding);
-      gtk_container_add(GTK_CONTAINER(box_padding), drawing_area);
+      /* the board of a compared file is only shown with -D, to the right */
+      box_boards = gtk_hbox_new(FALSE, BORDER);
+      gtk_container_add(GTK_CONTAINER(box_padding), box_boards);
+      gtk_container_add(GTK_CONTAINER(box_boards), drawing_area);
       g_signal_connect(G_OBJECT(drawing_area), "expose_event",
                        G_CALLBACK(expose_event_callback), NULL);
+      compare_area = gtk_drawing_area_new();
+      gtk_container_add(GTK_CONTAINER(box_boards), compare_area);
+      gtk_widget_set_no_show_all(compare_area, option_compare_file == NULL);
+      g_signal_connect(G_OBJECT(compare_area), "expose_event",
+                       G_CALLBACK(compare_expose_event_callback), NULL);
+      g_signal_connect(G_OBJECT(compare_area), "size-allocate",
+                       G_CALLBACK(size_allocate_callback), NULL);
+
+      /* the players' clocks are only shown with a time limit */
+      {
+        extern guint option_move_time_ms;
+        extern guint option_game_time_ms;
+        GtkWidget *box_clocks;
+
+        box_clocks = gtk_hbox_new(TRUE, BORDER);
+        for (guint8 i = 0; i < NUM_CLIENTS; ++i) {
+          clock_labels[i] = gtk_label_new(NULL);
+          gtk_box_pack_start(GTK_BOX(box_clocks), clock_labels[i],
+                             TRUE, TRUE, 0);
+        }
+        gtk_box_pack_start(GTK_BOX(box_padding), box_clocks,
+                           FALSE, FALSE, 0);
+        gtk_widget_set_no_show_all(box_clocks, option_move_time_ms == 0 &&
+                                               option_game_time_ms == 0);
+      }
+      /* the outcome of endgames is only shown with a tablebase */
+      tablebase_label = gtk_label_new(NULL);
+      gtk_box_pack_start(GTK_BOX(box_padding), tablebase_label,
+                         FALSE, FALSE, 0);
+      gtk_widget_set_no_show_all(tablebase_label, option_tablebase == NULL);
       g_signal_connect(G_OBJECT(drawing_area), "size-allocate",
                        G_CALLBACK(size_allocate_callback), NULL);
     }
-    /* create the list of moves */
+    /* create the list of moves and the charts next to it */
     {
+      GtkWidget *paned_moves;
       GtkWidget *frame;
       GtkWidget *box_padding;
       GtkWidget *scrolledwindow;
 
+      paned_moves = gtk_hpaned_new();
+      gtk_table_attach(GTK_TABLE(table), paned_moves, 1, 2, 0, 1,
+                       GTK_EXPAND | GTK_FILL, GTK_EXPAND | GTK_FILL, 0, 0);
+
       frame = gtk_frame_new("Moves");
       box_padding = gtk_vbox_new(FALSE, BORDER);
       gtk_container_set_border_width(GTK_CONTAINER(box_padding), BORDER);
       gtk_container_add(GTK_CONTAINER(frame), box_padding);
+      timeline_area = gtk_drawing_area_new();
+      gtk_widget_set_size_request(timeline_area, -1, 48);
+      gtk_widget_add_events(timeline_area, GDK_BUTTON_PRESS_MASK);
+      gtk_box_pack_start(GTK_BOX(box_padding), timeline_area,
+                         FALSE, FALSE, 0);
+      g_signal_connect(G_OBJECT(timeline_area), "expose_event",
+                       G_CALLBACK(timeline_expose_event_callback), NULL);
+      g_signal_connect(G_OBJECT(timeline_area), "button-press-event",
+                       G_CALLBACK(timeline_button_press_callback), NULL);
       scrolledwindow = gtk_scrolled_window_new(NULL, NULL);
       gtk_container_add(GTK_CONTAINER(scrolledwindow), list);
+      g_signal_connect(gtk_scrolled_window_get_vadjustment(
+                         GTK_SCROLLED_WINDOW(scrolledwindow)),
+                       "value-changed", G_CALLBACK(list_scrolled_callback),
+                       NULL);
       gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolledwindow),
                                      GTK_POLICY_AUTOMATIC,
                                      GTK_POLICY_AUTOMATIC);
       gtk_container_add(GTK_CONTAINER(box_padding), scrolledwindow);
-      gtk_table_attach(GTK_TABLE(table), frame, 1, 2, 0, 1,
-                       GTK_EXPAND | GTK_FILL, GTK_EXPAND | GTK_FILL, 0, 0);
+      gtk_paned_pack1(GTK_PANED(paned_moves), frame, TRUE, TRUE);
+
+      frame = gtk_frame_new("Charts");
+      box_padding = gtk_vbox_new(FALSE, BORDER);
+      gtk_container_set_border_width(GTK_CONTAINER(box_padding), BORDER);
+      gtk_container_add(GTK_CONTAINER(frame), box_padding);
+      charts_area = gtk_drawing_area_new();
+      gtk_widget_set_size_request(charts_area, 120, -1);
+      gtk_widget_add_events(charts_area, GDK_BUTTON_PRESS_MASK);
+      gtk_container_add(GTK_CONTAINER(box_padding), charts_area);
+      g_signal_connect(G_OBJECT(charts_area), "expose_event",
+                       G_CALLBACK(charts_expose_event_callback), NULL);
+      g_signal_connect(G_OBJECT(charts_area), "button-press-event",
+                       G_CALLBACK(charts_button_press_callback), NULL);
+      gtk_paned_pack2(GTK_PANED(paned_moves), frame, TRUE, TRUE);
     }
     /* place the buttons */
     {
@@ -1154,12 +2860,41 @@ create_window_with_widgets(void)
                                    option_animate);
       gtk_widget_set_size_request(btn_animate, 80, 35);
       gtk_box_pack_end(GTK_BOX(box), btn_animate, FALSE, FALSE, 0);
+      /* the heatmaps are only chosen with -H, once they're counted */
+      combo_heatmap = gtk_combo_box_text_new();
+      gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo_heatmap),
+                                     "Heatmap off");
+      gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo_heatmap),
+                                     "Occupancy");
+      gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo_heatmap),
+                                     "Captures");
+      gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo_heatmap),
+                                     "Move origins");
+      gtk_combo_box_set_active(GTK_COMBO_BOX(combo_heatmap), 0);
+      gtk_widget_set_sensitive(combo_heatmap, FALSE);
+      gtk_widget_set_no_show_all(combo_heatmap, option_heatmap == NULL);
+      gtk_box_pack_end(GTK_BOX(box), combo_heatmap, FALSE, FALSE, BORDER);
+      combo_export = gtk_combo_box_text_new();
+      gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo_export),
+                                     "Export");
+      for (guint8 i = 0; i < G_N_ELEMENTS(export_formats); ++i) {
+        gchar * const text = g_ascii_strup(export_formats[i], -1);
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo_export),
+                                       text);
+        g_free(text);
+      }
+      gtk_combo_box_set_active(GTK_COMBO_BOX(combo_export), 0);
+      gtk_box_pack_end(GTK_BOX(box), combo_export, FALSE, FALSE, 0);
       gtk_table_attach(GTK_TABLE(table), box, 1, 2, 1, 2,
                        GTK_EXPAND | GTK_FILL, 0, 0, 0);
       g_signal_connect(btn_run_kill, "clicked",
                        G_CALLBACK(run_kill_clicked_callback), NULL);
       g_signal_connect(btn_animate, "toggled",
                        G_CALLBACK(animate_toggled_callback), NULL);
+      g_signal_connect(combo_heatmap, "changed",
+                       G_CALLBACK(heatmap_changed_callback), NULL);
+      g_signal_connect(combo_export, "changed",
+                       G_CALLBACK(export_changed_callback), NULL);
     }
   }
 
@@ -1177,7 +2912,50 @@ create_window_with_widgets(void)
 
   gtk_widget_show_all(window);
 
+  if (option_analysis_depth > 0) {
+    GError *error = NULL;
+    analysis = analysis_new(option_analysis_depth, option_analysis_cache,
+                            analysis_callback, NULL, &error);
+    if (analysis == NULL) {
+      print_error(error->message);
+      g_error_free(error);
+    }
+  }
+  if (option_tablebase != NULL) {
+    GError *error = NULL;
+    tablebase = tablebase_open(option_tablebase, &error);
+    if (tablebase == NULL) {
+      print_error(error->message);
+      g_error_free(error);
+    }
+  }
+  if (option_heatmap != NULL) {
+    GError *error = NULL;
+    heatmap = heatmap_new(option_heatmap, heatmap_callback, NULL, &error);
+    if (heatmap == NULL) {
+      print_error(error->message);
+      g_error_free(error);
+    }
+  }
+  {
+    GError *error = NULL;
+    positions = positions_open(option_positions, &error);
+    if (positions == NULL) {
+      print_error(error->message);
+      g_error_free(error);
+    }
+  }
+
   if (option_run) {
     gtk_button_clicked(GTK_BUTTON(btn_run_kill));
+  } else if (option_load_session != NULL) {
+    load_session(option_load_session);
+  } else if (option_replay_file != NULL) {
+    start_replay(option_replay_file);
+  }
+  if (option_compare_file != NULL) {
+    start_compare(option_run ? NULL :
+                  option_load_session != NULL ? option_load_session :
+                  option_replay_file);
   }
 }
@@ -42,9 +42,14 @@
  * \param[in] channel_id  an integer less than #NUM_CHANNELS, as specified by
  *                        #CHANNEL_ID, indicating where the text originates
  *                        from
+ * \param[in] stats       measurements of the client's reply, if the text is
+ *                        the first stdout data of a reply, otherwise \c NULL
  */
 void
-append_text(const gchar *text, gsize len, guint8 channel_id);
+append_text(const gchar         *text,
+            gsize                len,
+            guint8               channel_id,
+            const reply_stats_t *stats);
 
 /*!
  * \brief
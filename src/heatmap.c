@@ -0,0 +1,388 @@
+/*!
+ * \file heatmap.c
+ * \brief
+ * Counts the squares of recorded games in a thread pool, one file per job,
+ * and adds the counts up for the main loop.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "heatmap.h"
+#include "cache.h"
+#include "main.h"
+#include "positions.h"
+#include "protocol.h"
+
+/*! \brief Name of the cache file, in #CACHE_DIR */
+#define HEATMAP_CACHE_FILE "heatmap.cache"
+
+/* documented in heatmap.h */
+struct heatmap {
+  /*! \brief The worker threads */
+  GThreadPool    *pool;
+  /*! \brief Function to call once every file is counted */
+  heatmap_func_t  func;
+  /*! \brief Data to pass to #func */
+  gpointer        user_data;
+  /*! \brief Number of files that aren't counted yet */
+  volatile gint   n_pending;
+  /*! \brief Set to nonzero to skip the queued files */
+  volatile gint   is_stopped;
+  /*! \brief Protects the members below */
+  GMutex          mutex;
+  /*! \brief The cached ::heatmap_record_t of each key (in host order) */
+  GHashTable     *cache;
+  /*! \brief The cache file, positioned after its last whole record */
+  FILE           *file;
+  /*! \brief The sum of the counts of the files */
+  guint64         totals[NUM_HEATMAPS][NUM_DARK_SQ];
+  /*! \brief Whether every file is counted and #func was called */
+  gboolean        is_done;
+  /*! \brief Event source that calls #func, or zero */
+  guint           source_done;
+};
+
+/*!
+ * \brief
+ * Adds a record of the cache file to heatmap::cache, following the signature
+ * of ::cache_record_func_t
+ *
+ * \param[in] record     the ::heatmap_record_t as stored
+ * \param[in] user_data  the heatmaps
+ */
+static void
+read_record(const gconstpointer record, const gpointer user_data)
+{
+  heatmap_t * const heatmap = user_data;
+  heatmap_record_t * const entry = g_slice_new(heatmap_record_t);
+
+  memcpy(entry, record, sizeof(*entry));
+  entry->key = GUINT64_FROM_LE(entry->key);
+  entry->n_boards = GUINT64_FROM_LE(entry->n_boards);
+  for (guint kind = 0; kind < NUM_HEATMAPS; ++kind) {
+    for (guint8 i = 0; i < NUM_DARK_SQ; ++i) {
+      entry->counts[kind][i] = GUINT32_FROM_LE(entry->counts[kind][i]);
+    }
+  }
+  g_hash_table_replace(heatmap->cache, &entry->key, entry);
+}
+
+/*!
+ * \brief
+ * Frees an entry of heatmap::cache, following the signature of
+ * \c GDestroyNotify
+ *
+ * \param[in] data  the ::heatmap_record_t
+ */
+static void
+free_record(gpointer data)
+{
+  g_slice_free(heatmap_record_t, data);
+}
+
+/*!
+ * \brief
+ * Gets the cache key of a file, which changes whenever the file is written
+ *
+ * \param[in] path  the absolute name of the file
+ * \param[in] st    the status of the file
+ *
+ * \return
+ * the 64-bit FNV-1a hash of the name, size and modification time
+ */
+static guint64
+get_file_key(const gchar * const path, const GStatBuf * const st)
+{
+  const guint64 numbers[2] = { (guint64)st->st_size,
+                               (guint64)st->st_mtime };
+  const guint8 *bytes = (const guint8 *)numbers;
+  guint64 key = G_GUINT64_CONSTANT(0xcbf29ce484222325);
+
+  for (const gchar *c = path; *c != '\0'; ++c) {
+    key = (key ^ (guint8)*c) * G_GUINT64_CONSTANT(0x100000001b3);
+  }
+  for (gsize i = 0; i < sizeof(numbers); ++i) {
+    key = (key ^ bytes[i]) * G_GUINT64_CONSTANT(0x100000001b3);
+  }
+  return key;
+}
+
+/*!
+ * \brief
+ * Counts the squares of the board and move of a row, following the
+ * signature of ::positions_row_func_t
+ *
+ * \param[in] row        not used
+ * \param[in] message    the message of the row
+ * \param[in] user_data  the ::heatmap_record_t of the file
+ */
+static void
+count_row(const guint32           row,
+          const message_t * const message,
+          const gpointer          user_data)
+{
+  heatmap_record_t * const record = user_data;
+
+  UNUSED(row);
+
+  /* the result of a game repeats the last board */
+  if (message->action <= -2 && message->action >= -4) return;
+
+  ++record->n_boards;
+  for (guint8 i = 0; i < NUM_DARK_SQ; ++i) {
+    if (message->board[i] != '.') ++record->counts[HEATMAP_OCCUPANCY][i];
+  }
+  if (message->action < 0 || message->n_squares == 0) return;
+
+  ++record->counts[HEATMAP_ORIGINS][message->squares[0]];
+  /* a jumped piece is halfway between the squares before and after it */
+  for (guint8 k = 1; message->action > 0 && k < message->n_squares; ++k) {
+    const guint8 from = message->squares[k - 1];
+    const guint8 to = message->squares[k];
+    if (abs(BOARD_ROW(from) - BOARD_ROW(to)) == 2) {
+      ++record->counts[HEATMAP_CAPTURES]
+                      [BOARD_SQ((BOARD_ROW(from) + BOARD_ROW(to)) / 2,
+                                (BOARD_COL(from) + BOARD_COL(to)) / 2)];
+    }
+  }
+}
+
+/*!
+ * \brief
+ * Callback that tells the main loop that every file is counted
+ *
+ * \param[in] data  the heatmaps
+ *
+ * \return
+ * \c FALSE, to remove the event source
+ */
+static gboolean
+done_callback(gpointer data)
+{
+  heatmap_t * const heatmap = data;
+
+  g_mutex_lock(&heatmap->mutex);
+  heatmap->source_done = 0;
+  heatmap->is_done = TRUE;
+  g_mutex_unlock(&heatmap->mutex);
+
+  heatmap->func(heatmap->user_data);
+  return FALSE;
+}
+
+/*!
+ * \brief
+ * Counts the squares of a file, or gets them from the cache, and adds them
+ * to the totals, following the signature of \c GFunc
+ *
+ * \param[in] data       the absolute name of the file, which is freed
+ * \param[in] user_data  the heatmaps
+ */
+static void
+count_job(gpointer data, gpointer user_data)
+{
+  gchar * const path = data;
+  heatmap_t * const heatmap = user_data;
+  GStatBuf st;
+
+  if (!g_atomic_int_get(&heatmap->is_stopped) && g_stat(path, &st) == 0) {
+    heatmap_record_t record;
+    const heatmap_record_t *cached;
+    gboolean is_counted = TRUE;
+
+    memset(&record, 0, sizeof(record));
+    record.key = get_file_key(path, &st);
+    g_mutex_lock(&heatmap->mutex);
+    cached = g_hash_table_lookup(heatmap->cache, &record.key);
+    if (cached != NULL) record = *cached;
+    g_mutex_unlock(&heatmap->mutex);
+
+    /* files that aren't games are skipped, and counted again next time */
+    if (cached == NULL) {
+      is_counted = positions_read_file(path, count_row, &record, NULL);
+    }
+    if (is_counted) {
+      g_mutex_lock(&heatmap->mutex);
+      for (guint kind = 0; kind < NUM_HEATMAPS; ++kind) {
+        for (guint8 i = 0; i < NUM_DARK_SQ; ++i) {
+          heatmap->totals[kind][i] += record.counts[kind][i];
+        }
+      }
+      if (cached == NULL) {
+        heatmap_record_t * const entry = g_slice_new(heatmap_record_t);
+        *entry = record;
+        g_hash_table_replace(heatmap->cache, &entry->key, entry);
+        if (heatmap->file != NULL) {
+          record.key = GUINT64_TO_LE(entry->key);
+          record.n_boards = GUINT64_TO_LE(entry->n_boards);
+          for (guint kind = 0; kind < NUM_HEATMAPS; ++kind) {
+            for (guint8 i = 0; i < NUM_DARK_SQ; ++i) {
+              record.counts[kind][i] = GUINT32_TO_LE(entry->counts[kind][i]);
+            }
+          }
+          cache_append(heatmap->file, &record, sizeof(record));
+        }
+      }
+      g_mutex_unlock(&heatmap->mutex);
+    }
+  }
+  g_free(path);
+
+  if (g_atomic_int_dec_and_test(&heatmap->n_pending)) {
+    g_mutex_lock(&heatmap->mutex);
+    heatmap->source_done = g_idle_add(done_callback, heatmap);
+    g_mutex_unlock(&heatmap->mutex);
+  }
+}
+
+/*!
+ * \brief
+ * Lists the files in a directory and its subdirectories
+ *
+ * Symbolic links are skipped, since a link to a directory above would
+ * never end the recursion.
+ *
+ * \param[in]     dir    the absolute name of the directory
+ * \param[in,out] files  the array to append the absolute names to
+ */
+static void
+list_files(const gchar * const dir, GPtrArray * const files)
+{
+  GDir * const handle = g_dir_open(dir, 0, NULL);
+  const gchar *name;
+
+  if (handle == NULL) return;
+  while ((name = g_dir_read_name(handle)) != NULL) {
+    gchar * const path = g_build_filename(dir, name, NULL);
+    if (g_file_test(path, G_FILE_TEST_IS_SYMLINK)) {
+      g_free(path);
+    } else if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+      list_files(path, files);
+      g_free(path);
+    } else {
+      g_ptr_array_add(files, path);
+    }
+  }
+  g_dir_close(handle);
+}
+
+/* documented in heatmap.h */
+heatmap_t *
+heatmap_new(const gchar     *path,
+            heatmap_func_t   func,
+            gpointer         user_data,
+            GError         **error)
+{
+  extern guint option_jobs;
+  heatmap_t *heatmap;
+  GPtrArray *files;
+  gchar *absolute;
+  gchar *cache_path;
+
+  assert(path != NULL);
+  assert(func != NULL);
+  assert(error == NULL || *error == NULL);
+
+  if (!g_file_test(path, G_FILE_TEST_EXISTS)) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                "Couldn't find \"%s\" to count the squares of", path);
+    return NULL;
+  }
+  cache_path = cache_get_path(HEATMAP_CACHE_FILE);
+  heatmap = g_new0(heatmap_t, 1);
+  heatmap->func = func;
+  heatmap->user_data = user_data;
+  heatmap->cache = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                                         NULL, free_record);
+  g_mutex_init(&heatmap->mutex);
+  if (!cache_open(cache_path, HEATMAP_MAGIC, HEATMAP_VERSION,
+                  sizeof(heatmap_record_t), "heatmap cache", read_record,
+                  heatmap, &heatmap->file, error)) {
+    g_free(cache_path);
+    heatmap_free(heatmap);
+    return NULL;
+  }
+  g_free(cache_path);
+
+  heatmap->pool = g_thread_pool_new(count_job, heatmap,
+                                    option_jobs > 0 ? (gint)option_jobs
+                                    : (gint)g_get_num_processors(),
+                                    TRUE, error);
+  if (heatmap->pool == NULL) {
+    heatmap_free(heatmap);
+    return NULL;
+  }
+
+  /* the cache knows the files by their absolute names */
+  if (g_path_is_absolute(path)) {
+    absolute = g_strdup(path);
+  } else {
+    gchar * const dir = g_get_current_dir();
+    absolute = g_build_filename(dir, path, NULL);
+    g_free(dir);
+  }
+  files = g_ptr_array_new();
+  if (g_file_test(absolute, G_FILE_TEST_IS_DIR)) {
+    list_files(absolute, files);
+    g_free(absolute);
+  } else {
+    g_ptr_array_add(files, absolute);
+  }
+
+  heatmap->n_pending = files->len;
+  if (files->len == 0) {
+    heatmap->source_done = g_idle_add(done_callback, heatmap);
+  }
+  for (guint i = 0; i < files->len; ++i) {
+    g_thread_pool_push(heatmap->pool, g_ptr_array_index(files, i), NULL);
+  }
+  g_ptr_array_free(files, TRUE);
+  return heatmap;
+}
+
+/* documented in heatmap.h */
+gboolean
+heatmap_get(const heatmap_t *heatmap,
+            heatmap_kind_t   kind,
+            gdouble          shades[static NUM_DARK_SQ])
+{
+  guint64 lowest = G_MAXUINT64;
+  guint64 highest = 0;
+
+  assert(heatmap != NULL);
+  assert(kind < NUM_HEATMAPS);
+  assert(shades != NULL);
+
+  /* the totals don't change once every file is counted */
+  if (!heatmap->is_done) return FALSE;
+
+  for (guint8 i = 0; i < NUM_DARK_SQ; ++i) {
+    lowest = MIN(lowest, heatmap->totals[kind][i]);
+    highest = MAX(highest, heatmap->totals[kind][i]);
+  }
+  for (guint8 i = 0; i < NUM_DARK_SQ; ++i) {
+    shades[i] = highest > lowest
+      ? (gdouble)(heatmap->totals[kind][i] - lowest) / (highest - lowest)
+      : 0.;
+  }
+  return TRUE;
+}
+
+/* documented in heatmap.h */
+void
+heatmap_free(heatmap_t *heatmap)
+{
+  if (heatmap == NULL) return;
+
+  /* the queued files are skipped as soon as they start */
+  g_atomic_int_set(&heatmap->is_stopped, 1);
+  if (heatmap->pool != NULL) g_thread_pool_free(heatmap->pool, FALSE, TRUE);
+  if (heatmap->source_done != 0) g_source_remove(heatmap->source_done);
+  if (heatmap->file != NULL) fclose(heatmap->file);
+  g_hash_table_destroy(heatmap->cache);
+  g_mutex_clear(&heatmap->mutex);
+  g_free(heatmap);
+}
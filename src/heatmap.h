@@ -0,0 +1,114 @@
+/*!
+ * \file heatmap.h
+ * \brief
+ * Provides heatmaps of the dark squares, counted over the boards of many
+ * recorded games in a pool of worker threads, with the counts of each file
+ * kept in a cache on disk between runs
+ */
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <gtk/gtk.h>
+#include "cache.h"
+#include "gui.h"
+
+/*!
+ * \brief
+ * The magic in the ::cache_header_t at the beginning of every heatmap cache
+ * file
+ */
+#define HEATMAP_MAGIC "CKVHEAT"
+
+/*! \brief The version of the file format written by this program */
+#define HEATMAP_VERSION 1
+
+/*! \brief What a heatmap counts on each dark square */
+typedef enum {
+  HEATMAP_OCCUPANCY, /*!< the boards where a piece is on the square */
+  HEATMAP_CAPTURES,  /*!< the pieces that are jumped on the square */
+  HEATMAP_ORIGINS,   /*!< the moves and jumps that start from the square */
+  NUM_HEATMAPS       /*!< the number of kinds of heatmaps */
+} heatmap_kind_t;
+
+/*!
+ * \brief
+ * The counts of one file as stored in a heatmap cache file, directly after
+ * the header and the records before it
+ *
+ * A file that is changed is counted again and appended once more, under
+ * another key.
+ */
+typedef struct {
+  /*! \brief Hash of the absolute name, size and modification time of the
+             file */
+  guint64 key;
+  /*! \brief Number of boards in the file */
+  guint64 n_boards;
+  /*! \brief The count of each kind of heatmap on each dark square */
+  guint32 counts[NUM_HEATMAPS][NUM_DARK_SQ];
+} heatmap_record_t;
+
+/*!
+ * \brief
+ * Function that is called from the main loop once every file is counted
+ *
+ * \param[in] user_data  the data given to heatmap_new()
+ */
+typedef void (*heatmap_func_t)(gpointer user_data);
+
+/*! \brief Heatmaps being counted or counted (private to heatmap.c) */
+typedef struct heatmap heatmap_t;
+
+/*!
+ * \brief
+ * Reads the cache and starts counting the squares of the session,
+ * transcript and PDN files in a file or directory
+ *
+ * Returns at once. Each file is counted in one of the worker threads set by
+ * option \c -j, unless it's in the cache, and the counts are added up as the
+ * files are done. The files of subdirectories are counted too, and files
+ * that can't be read as games are skipped.
+ *
+ * \param[in] path       the file or directory
+ * \param[in] func       the function to call once every file is counted
+ * \param[in] user_data  data to pass to \p func
+ * \param[in] error      either \c NULL to disregard errors, or the address
+ *                       of a pointer initialized to \c NULL (which should be
+ *                       freed afterwards if set)
+ *
+ * \return
+ * the heatmaps, or \c NULL if \p path or the cache couldn't be opened
+ */
+heatmap_t *
+heatmap_new(const gchar     *path,
+            heatmap_func_t   func,
+            gpointer         user_data,
+            GError         **error);
+
+/*!
+ * \brief
+ * Gets the shade of each dark square in a heatmap, from zero for the
+ * lowest count to one for the highest
+ *
+ * \param[in]  heatmap  the heatmaps
+ * \param[in]  kind     the kind of heatmap
+ * \param[out] shades   the shade of each dark square
+ *
+ * \return
+ * whether every file is counted, so that \p shades is set
+ */
+gboolean
+heatmap_get(const heatmap_t *heatmap,
+            heatmap_kind_t   kind,
+            gdouble          shades[static NUM_DARK_SQ]);
+
+/*!
+ * \brief
+ * Stops the worker threads and frees the heatmaps
+ *
+ * \param[in] heatmap  the heatmaps (or \c NULL)
+ */
+void
+heatmap_free(heatmap_t *heatmap);
+
+#endif /* HEATMAP_H */
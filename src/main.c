@@ -10,27 +10,71 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <gtk/gtk.h>
 #include "main.h"
 #include "clients.h"
+#include "diverge.h"
+#include "export.h"
 #include "gui.h"
+#include "perft.h"
+#include "positions.h"
+#include "suite.h"
+#include "tablebase.h"
 
 /*! \brief Usage message */
 static const gchar *usage =
-  "Usage: %s [OPTION]...\n"
+  "Usage: %s [OPTION]... [FILE]...\n"
+  "  or:  %s [OPTION]... perft DEPTH [MESSAGE]\n"
+  "  or:  %s [OPTION]... tablebase PIECES FILE\n"
+  "  or:  %s [OPTION]... suite FILE\n"
+  "  or:  %s [OPTION]... index FILE...\n"
+  "  or:  %s [OPTION]... diverge FILE1 FILE2...\n"
   "Visualizer for the Checkers homework assignment of the fall of 2014\n"
   "in DD2380 Artificial Intelligence (ai14) at KTH.\n"
   "\n"
   "Execution control:\n"
-  "  -1 CMD   use CMD as the command line for player 1 (default \"\")\n"
+  "  -1 CMD   use CMD as the command line for player 1 (default \"\"),\n"
+  "           or @engine:depth=N[,threads=N][,hash=MIB] [init] for the\n"
+  "           built-in engine\n"
   "  -2 CMD   use CMD as the command line for player 2 (default \"\")\n"
   "  -a       turn animation on (default)\n"
   "  -A       turn animation off\n"
+  "  -J MIB,SEC,FILES\n"
+  "           emulate a judge by limiting each player to MIB MiB of\n"
+  "           address space, SEC sec of CPU time and FILES open files,\n"
+  "           and make it forfeit if it exceeds one (0 for no limit,\n"
+  "           default 0,0,0)\n"
+  "  -M LIST  extract the comma-separated keys in LIST from key=value\n"
+  "           pairs on the clients' stderr, where * is every key and\n"
+  "           KEY/s is KEY per second of think time (default \"*,nodes/s\")\n"
+  "  -P C1:C2\n"
+  "           pin player 1 to the CPUs in the list C1 (such as 2 or 2,4-5)\n"
+  "           and player 2 to those in C2, and keep the visualizer off\n"
+  "           them (Linux only)\n"
   "  -r       run the player commands automatically after start-up\n"
   "  -R       don't run the player commands automatically (default)\n"
   "  -t NUM   set the animation timer to NUM msec (default 1000)\n"
-  "\n"
+  "  -T MS    make a player forfeit if it takes more than MS msec to\n"
+  "           reply, or as MS,GAME also if its replies take more than\n"
+  "           GAME msec in total (0 for no limit, default 0)\n"
+  "  -u WHAT  attach the players' stdout and stderr (all) or only their\n"
+  "           stderr (stderr) to pseudo-terminals, so that their output\n"
+  "           is line-buffered and arrives as it's written\n"
+  "  -V       check each move against the rules and mark the illegal\n"
+  "           ones in the move list\n"
+  "  -Z N     exchange messages with player N (1, 2, or 12 for both)\n"
+  "           through shared memory instead of stdin and stdout, for\n"
+  "           players that support it (Linux only)\n"
+  "\n";
+
+/*!
+ * \brief
+ * Rest of the usage message, split from #usage to keep each string within
+ * the length that C99 compilers must support
+ */
+static const gchar *usage_continued =
   "Window control:\n"
   "  -f FONT  use FONT for the output buffers (default \"monospace 8\")\n"
   "  -m       ask the window manager to maximize the window\n"
@@ -38,6 +82,87 @@ static const gchar *usage =
   "  -x NUM   set the window width to NUM px (default 600)\n"
   "  -y NUM   set the window height to NUM px (default 650)\n"
   "\n"
+  "Analysis:\n"
+  "  -e NUM   evaluate each board with the built-in engine to a depth of\n"
+  "           NUM plies in the background, and mark the moves that lose\n"
+  "           1.5 men or more as likely blunders\n"
+  "  -c FILE  cache the evaluations in FILE (default analysis.cache in\n"
+  "           the user's cache directory)\n"
+  "  -b FILE  mark the boards of endgames with their outcome and the\n"
+  "           plies to the end from the tablebase FILE\n"
+  "  -H PATH  count how often each square is occupied, jumped or moved\n"
+  "           from in the sessions, transcripts and PDN files in PATH (a\n"
+  "           file or a directory) in the threads set by -j, and let the\n"
+  "           counts be drawn over the board as heatmaps\n"
+  "\n"
+  "Sessions:\n"
+  "  -l FILE  load a session from FILE (unless -r is given)\n"
+  "  -S FILE  save each run as a session to FILE while it's played\n"
+  "  -i FILE  replay the client output transcript FILE (\"-\" for stdin),\n"
+  "           or the games in FILE if it ends with .pdn, without running\n"
+  "           any clients\n"
+  "  -w FILE  record the clients' output of each run to the transcript\n"
+  "           FILE\n"
+  "  -p FILE  index the boards of the sessions, transcripts and PDN files\n"
+  "           that are loaded, replayed or saved in FILE (default\n"
+  "           positions.index in the user's cache directory), so that a\n"
+  "           right click on a move lists the other games with its board\n"
+  "  index FILE...\n"
+  "           add FILEs to the index in the threads set by -j, without\n"
+  "           opening a window\n"
+  "  -D FILE  show the board of the same row of the session, transcript\n"
+  "           or PDN file FILE next to the board, and select the first\n"
+  "           row where the boards of the loaded or replayed file differ\n"
+  "  diverge FILE1 FILE2...\n"
+  "           list the first row where the boards of each pair of files\n"
+  "           (or of same-named files in a pair of directories) differ,\n"
+  "           in the threads set by -j, without opening a window\n"
+  "\n";
+
+/*!
+ * \brief
+ * Rest of the usage message, split from #usage_continued for the same
+ * reason
+ */
+static const gchar *usage_commands =
+  "Export (without opening a window):\n"
+  "  -E FMT   render the games in the FILE arguments (or standard input)\n"
+  "           as FMT, one of png, svg (one file per position), pdf (one\n"
+  "           file per game), apng or y4m (one animation of all games,\n"
+  "           showing each position for the time set by -t), or convert\n"
+  "           them to pdn or log (one stream of PDN or of messages), or\n"
+  "           list the extracted stderr keys of sessions as tsv, or\n"
+  "           write the boards, results, think times and stderr keys of\n"
+  "           sessions as a columnar binary dataset (dataset), or\n"
+  "           list the moves that break the rules (check); FILE\n"
+  "           arguments ending with .pdn are read as PDN\n"
+  "  -j NUM   use NUM worker threads (default: one per processor, or\n"
+  "           one for -e)\n"
+  "  -o PATH  write the exported files to the directory PATH (default\n"
+  "           \".\"), or the animation or converted games to the file\n"
+  "           PATH (default stdout)\n"
+  "  -s NUM   set the exported board size to NUM px (default 400)\n"
+  "\n"
+  "Benchmark (perft, without opening a window):\n"
+  "  perft DEPTH [MESSAGE]\n"
+  "           count the positions DEPTH plies after the board of MESSAGE\n"
+  "           (default the initial position) in the threads set by -j,\n"
+  "           and report the positions per second\n"
+  "  -d       also count them after each move (divide)\n"
+  "\n"
+  "Test suite (without opening a window):\n"
+  "  suite FILE\n"
+  "           hand each position of FILE (a message and the expected\n"
+  "           moves per line) to a new process of player 1 in the\n"
+  "           threads set by -j, and report its moves, think times and\n"
+  "           solve rate, giving up on a position after the time limit\n"
+  "           for a move set by -T\n"
+  "\n"
+  "Endgame tablebase (without opening a window):\n"
+  "  tablebase PIECES FILE\n"
+  "           solve every position with up to PIECES pieces (2 to 6) in\n"
+  "           the threads set by -j, and write the tablebase to FILE\n"
+  "\n"
   "Miscellaneous:\n"
   "  -h       display this help text and exit\n"
   "\n"
@@ -57,8 +182,73 @@ gboolean option_animate           = TRUE;
  * program starts
  */
 gboolean option_run               = FALSE;
+/*!
+ * \brief
+ * Comma-separated list of the keys to extract from the clients' stderr
+ *
+ * \sa metrics.h
+ */
+gchar   *option_metrics           = "*,nodes/s";
 /*! \brief Time spent on each animation step in milliseconds */
 guint    option_timeout_ms        = 1000;
+/*! \brief Time limit for each reply in milliseconds, or zero for none */
+guint    option_move_time_ms      = 0;
+/*!
+ * \brief
+ * Time limit for all replies of a player in a game in milliseconds, or zero
+ * for none
+ */
+guint    option_game_time_ms      = 0;
+/*! \brief Address space limit for each client in MiB, or zero for none */
+guint    option_limit_mib         = 0;
+/*! \brief CPU time limit for each client in seconds, or zero for none */
+guint    option_limit_cpu_s       = 0;
+/*! \brief Open file limit for each client, or zero for none */
+guint    option_limit_files       = 0;
+/*! \brief CPU lists to pin the clients to, separated by a colon, or \c NULL */
+gchar   *option_cpus              = NULL;
+/*!
+ * \brief
+ * Bitwise or of <tt>1 << #STDOUT</tt> and <tt>1 << #STDERR</tt> for the
+ * output of the clients to attach to pseudo-terminals rather than pipes
+ */
+guint    option_pty_types         = 0;
+/*!
+ * \brief
+ * Bitwise or of <tt>1 << N</tt> for each client N that exchanges messages
+ * through shared memory
+ *
+ * \sa ring.h
+ */
+guint    option_ring_clients      = 0;
+/*! \brief If set to \c TRUE, check the moves against the rules */
+gboolean option_validate          = FALSE;
+
+/*! \brief Depth in plies to evaluate each board to, or zero for none */
+guint    option_analysis_depth    = 0;
+/*!
+ * \brief
+ * File to cache the evaluations in, or \c NULL for the default
+ */
+gchar   *option_analysis_cache    = NULL;
+/*! \brief Endgame tablebase to look the boards up in, or \c NULL */
+gchar   *option_tablebase         = NULL;
+/*! \brief File or directory of games to count heatmaps over, or \c NULL */
+gchar   *option_heatmap           = NULL;
+
+/*! \brief Session file to write while the clients run, or \c NULL */
+gchar   *option_session_file      = NULL;
+/*! \brief Session file to load after start-up, or \c NULL */
+gchar   *option_load_session      = NULL;
+/*! \brief Transcript to replay after start-up, or \c NULL */
+gchar   *option_replay_file       = NULL;
+/*! \brief Transcript to record while the clients run, or \c NULL */
+gchar   *option_transcript_file   = NULL;
+/*! \brief Index of the positions of recorded games, or \c NULL for the
+           default */
+gchar   *option_positions         = NULL;
+/*! \brief File to compare the loaded or replayed file with, or \c NULL */
+gchar   *option_compare_file      = NULL;
 
 /*! \brief Font for the output buffer textviews */
 gchar   *option_font              = "monospace 8";
@@ -74,6 +264,24 @@ gint     option_width_px          = 600;
 /*! \brief Initial window height in pixels */
 gint     option_height_px         = 650;
 
+/*!
+ * \brief
+ * Format to export to, or \c NULL to open the window as usual
+ */
+gchar   *option_export_format     = NULL;
+/*!
+ * \brief
+ * Directory (or, for animations, file) where exports are written, or \c NULL
+ * for the default
+ */
+gchar   *option_output            = NULL;
+/*! \brief Number of worker threads, or zero for one per processor */
+guint    option_jobs              = 0;
+/*! \brief Whether perft also counts the positions after each move */
+gboolean option_divide            = FALSE;
+/*! \brief Width and height of exported boards in pixels */
+gint     option_size_px           = 400;
+
 /*!
  * \brief
  * Parses the command line options and updates global variables
@@ -96,7 +304,10 @@ parse_options(const int        argc,
   assert(display_help != NULL);
   assert(*display_help == FALSE);
 
-  while((opt = getopt(argc, argv, "1:2:aAf:hmqrRt:x:y:")) != -1) {
+  while((opt = getopt(argc, argv,
+                      "1:2:ab:dAc:D:e:E:f:hH:i:j:J:l:mM:o:p:P:"
+                      "qrRs:S:t:T:u:Vw:x:y:Z:"))
+        != -1) {
     switch (opt) {
     case '1':
       option_cmds[0] = optarg;
@@ -107,18 +318,64 @@ parse_options(const int        argc,
     case 'a':
       option_animate = TRUE;
       break;
+    case 'd':
+      option_divide = TRUE;
+      break;
     case 'A':
       option_animate = FALSE;
       break;
+    case 'b':
+      option_tablebase = optarg;
+      break;
+    case 'c':
+      option_analysis_cache = optarg;
+      break;
+    case 'D':
+      option_compare_file = optarg;
+      break;
+    case 'e':
+      sscanf(optarg, "%u", &option_analysis_depth);
+      break;
+    case 'E':
+      option_export_format = optarg;
+      break;
     case 'f':
       option_font = optarg;
       break;
     case 'h':
       *display_help = TRUE;
       break;
+    case 'H':
+      option_heatmap = optarg;
+      break;
+    case 'i':
+      option_replay_file = optarg;
+      break;
+    case 'j':
+      sscanf(optarg, "%u", &option_jobs);
+      break;
+    case 'J':
+      sscanf(optarg, "%u,%u,%u", &option_limit_mib, &option_limit_cpu_s,
+             &option_limit_files);
+      break;
+    case 'l':
+      option_load_session = optarg;
+      break;
     case 'm':
       option_maximize = TRUE;
       break;
+    case 'M':
+      option_metrics = optarg;
+      break;
+    case 'o':
+      option_output = optarg;
+      break;
+    case 'p':
+      option_positions = optarg;
+      break;
+    case 'P':
+      option_cpus = optarg;
+      break;
     case 'q':
       option_quit = TRUE;
       break;
@@ -128,15 +385,49 @@ parse_options(const int        argc,
     case 'R':
       option_run = FALSE;
       break;
+    case 's':
+      option_size_px = atoi(optarg);
+      break;
+    case 'S':
+      option_session_file = optarg;
+      break;
     case 't':
       sscanf(optarg, "%u", &option_timeout_ms);
       break;
+    case 'T':
+      sscanf(optarg, "%u,%u", &option_move_time_ms, &option_game_time_ms);
+      break;
+    case 'u':
+      if (strcmp(optarg, "all") == 0) {
+        option_pty_types = 1 << STDOUT | 1 << STDERR;
+      } else if (strcmp(optarg, "stderr") == 0) {
+        option_pty_types = 1 << STDERR;
+      } else {
+        *display_help = TRUE;
+        return FALSE;
+      }
+      break;
+    case 'V':
+      option_validate = TRUE;
+      break;
+    case 'w':
+      option_transcript_file = optarg;
+      break;
     case 'x':
       option_width_px = atoi(optarg);
       break;
     case 'y':
       option_height_px = atoi(optarg);
       break;
+    case 'Z':
+      for (const gchar *c = optarg; *c != '\0'; ++c) {
+        if (*c < '1' || *c >= '1' + NUM_CLIENTS) {
+          *display_help = TRUE;
+          return FALSE;
+        }
+        option_ring_clients |= 1 << (*c - '1');
+      }
+      break;
     default:
       *display_help = TRUE;
       return FALSE;
@@ -160,10 +451,84 @@ main(int argc, char **argv)
     for (guint8 i = 0; obfuscated_email[i] != 0; ++i) {
       obfuscated_email[i] ^= 42 + 3*i;
     }
-    fprintf(stderr, usage, argv[0], obfuscated_email);
+    fprintf(stderr, usage, argv[0], argv[0], argv[0], argv[0], argv[0],
+            argv[0]);
+    fprintf(stderr, "%s", usage_continued);
+    fprintf(stderr, usage_commands, obfuscated_email);
     exit(options_success ? EXIT_SUCCESS : EXIT_FAILURE);
   }
 
+  if (optind < argc && strcmp(argv[optind], PERFT_COMMAND) == 0) {
+    GError *error = NULL;
+    if (!run_perft(argv + optind + 1, &error)) {
+      fprintf(stderr, "%s: %s\n", argv[0], error->message);
+      g_error_free(error);
+      exit(EXIT_FAILURE);
+    }
+    exit(EXIT_SUCCESS);
+  }
+
+  if (optind < argc && strcmp(argv[optind], POSITIONS_COMMAND) == 0) {
+    GError *error = NULL;
+    if (!run_index(argv + optind + 1, &error)) {
+      fprintf(stderr, "%s: %s\n", argv[0], error->message);
+      g_error_free(error);
+      exit(EXIT_FAILURE);
+    }
+    exit(EXIT_SUCCESS);
+  }
+
+  if (optind < argc && strcmp(argv[optind], DIVERGE_COMMAND) == 0) {
+    GError *error = NULL;
+    if (!run_diverge(argv + optind + 1, &error)) {
+      fprintf(stderr, "%s: %s\n", argv[0], error->message);
+      g_error_free(error);
+      exit(EXIT_FAILURE);
+    }
+    exit(EXIT_SUCCESS);
+  }
+
+  if (optind < argc && strcmp(argv[optind], SUITE_COMMAND) == 0) {
+    GError *error = NULL;
+    if (!run_suite(argv + optind + 1, &error)) {
+      fprintf(stderr, "%s: %s\n", argv[0], error->message);
+      g_error_free(error);
+      exit(EXIT_FAILURE);
+    }
+    exit(EXIT_SUCCESS);
+  }
+
+  if (optind < argc && strcmp(argv[optind], TABLEBASE_COMMAND) == 0) {
+    GError *error = NULL;
+    if (!run_tablebase(argv + optind + 1, &error)) {
+      fprintf(stderr, "%s: %s\n", argv[0], error->message);
+      g_error_free(error);
+      exit(EXIT_FAILURE);
+    }
+    exit(EXIT_SUCCESS);
+  }
+
+  if (option_export_format != NULL) {
+    GError *error = NULL;
+    /* no display is needed, so GTK+ is never initialized */
+    if (!export_games(argv + optind, &error)) {
+      fprintf(stderr, "%s: %s\n", argv[0], error->message);
+      g_error_free(error);
+      exit(EXIT_FAILURE);
+    }
+    exit(EXIT_SUCCESS);
+  }
+
+  if (option_cpus != NULL) {
+    GError *error = NULL;
+    /* before GTK+ is initialized, so that its threads keep off the CPUs */
+    if (!pin_clients(option_cpus, &error)) {
+      fprintf(stderr, "%s: %s\n", argv[0], error->message);
+      g_error_free(error);
+      exit(EXIT_FAILURE);
+    }
+  }
+
   gtk_init(&argc, &argv);
 
   create_window_with_widgets();
@@ -0,0 +1,381 @@
+/*!
+ * \file metrics.c
+ * \brief
+ * Extracts \c key=value pairs from the clients' stderr output as it streams
+ * in, and formats them together with derived rates.
+ */
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "metrics.h"
+
+/*! \brief Longest pair that is extracted, in bytes */
+#define MAX_PAIR_LEN 64
+
+/*! \brief Size of the buffer for a formatted value */
+#define VALUE_BUF_SIZE G_ASCII_DTOSTR_BUF_SIZE
+
+/*! \brief A value extracted from the output */
+typedef struct {
+  /*! \brief The key */
+  GQuark  key;
+  /*! \brief The last value written for the key */
+  gdouble value;
+} metric_t;
+
+/*! \brief A statistic in the configuration */
+typedef struct {
+  /*! \brief The key, or zero for every key */
+  GQuark   key;
+  /*! \brief Whether the statistic is the value per second of think time */
+  gboolean is_rate;
+} spec_item_t;
+
+/*! \brief The statistics of one move */
+struct metrics {
+  /*! \brief Array of ::metric_t, in the order the keys were first written */
+  GArray  *values;
+  /*! \brief Text held back since it may be the beginning of a pair */
+  GString *pending;
+};
+
+/*!
+ * \brief
+ * Gets the configuration, parsing it on first use
+ *
+ * \return
+ * an array of ::spec_item_t, which is kept until the program ends
+ */
+static const GArray *
+get_spec(void)
+{
+  static gsize spec = 0;
+
+  if (g_once_init_enter(&spec)) {
+    extern gchar *option_metrics;
+    GArray *items = g_array_new(FALSE, FALSE, sizeof(spec_item_t));
+    gchar **keys = g_strsplit(option_metrics, ",", -1);
+
+    for (gchar **key = keys; *key != NULL; ++key) {
+      spec_item_t item = { 0, FALSE };
+      g_strstrip(*key);
+      if (**key == '\0') continue;
+      if (g_str_has_suffix(*key, "/s")) {
+        (*key)[strlen(*key) - 2] = '\0';
+        item.is_rate = TRUE;
+      }
+      if (strcmp(*key, "*") != 0) item.key = g_quark_from_string(*key);
+      g_array_append_val(items, item);
+    }
+    g_strfreev(keys);
+    g_once_init_leave(&spec, (gsize)items);
+  }
+  return (const GArray *)spec;
+}
+
+/*!
+ * \brief
+ * Finds the value of a key
+ *
+ * \param[in] metrics  the statistics
+ * \param[in] key      the key
+ *
+ * \return
+ * the value, or \c NULL if the key hasn't been written
+ */
+static metric_t *
+find_metric(const metrics_t * const metrics, const GQuark key)
+{
+  for (guint i = 0; i < metrics->values->len; ++i) {
+    metric_t * const metric = &g_array_index(metrics->values, metric_t, i);
+    if (metric->key == key) return metric;
+  }
+  return NULL;
+}
+
+/*!
+ * \brief
+ * Extracts a single pair, if the text is one
+ *
+ * \param[in] metrics  the statistics
+ * \param[in] text     the text, without whitespace
+ * \param[in] len      the length of \p text in bytes
+ */
+static void
+extract_pair(metrics_t * const metrics, const gchar * const text, gsize len)
+{
+  gchar pair[MAX_PAIR_LEN + 1];
+  gchar *equals;
+  gchar *end;
+  gdouble value;
+  metric_t *metric;
+
+  if (len == 0 || len > MAX_PAIR_LEN) return;
+  memcpy(pair, text, len);
+  /* allow the pairs to be separated by punctuation as well */
+  while (len > 0 && (pair[len - 1] == ',' || pair[len - 1] == ';')) --len;
+  pair[len] = '\0';
+
+  equals = strchr(pair, '=');
+  if (equals == NULL || equals == pair) return;
+  for (const gchar *p = pair; p < equals; ++p) {
+    if (!g_ascii_isalnum(*p) && *p != '_' && *p != '-' && *p != '.') return;
+  }
+  value = g_ascii_strtod(equals + 1, &end);
+  if (end == equals + 1 || *end != '\0') return;
+
+  *equals = '\0';
+  metric = find_metric(metrics, g_quark_from_string(pair));
+  if (metric == NULL) {
+    const metric_t new_metric = { g_quark_from_string(pair), value };
+    g_array_append_val(metrics->values, new_metric);
+  } else {
+    metric->value = value;
+  }
+}
+
+/*!
+ * \brief
+ * Extracts every pair in a text
+ *
+ * \param[in] metrics  the statistics
+ * \param[in] text     the text, where the first and last words are taken
+ *                     to be complete
+ * \param[in] len      the length of \p text in bytes
+ */
+static void
+extract_pairs(metrics_t * const metrics, const gchar *text, const gsize len)
+{
+  const gchar * const end = text + len;
+
+  while (text < end) {
+    const gchar *word_end;
+    while (text < end && g_ascii_isspace(*text)) ++text;
+    for (word_end = text; word_end < end && !g_ascii_isspace(*word_end);
+         ++word_end);
+    extract_pair(metrics, text, word_end - text);
+    text = word_end;
+  }
+}
+
+/* documented in metrics.h */
+metrics_t *
+metrics_new(void)
+{
+  metrics_t *metrics;
+
+  metrics = g_slice_new(metrics_t);
+  metrics->values = g_array_new(FALSE, FALSE, sizeof(metric_t));
+  metrics->pending = g_string_new(NULL);
+  return metrics;
+}
+
+/*!
+ * \brief
+ * Holds back the beginning of a word, which may be the beginning of a pair
+ *
+ * \param[in] metrics  the statistics
+ * \param[in] text     the text, without whitespace
+ * \param[in] len      the length of \p text in bytes
+ */
+static void
+hold_back(metrics_t   * const metrics,
+          const gchar * const text,
+          const gsize         len)
+{
+  if (metrics->pending->len + len <= MAX_PAIR_LEN) {
+    g_string_append_len(metrics->pending, text, len);
+  } else {
+    /* too long to be a pair, which extract_pair() will see by the length
+       without the text having to be kept */
+    g_string_set_size(metrics->pending, MAX_PAIR_LEN + 1);
+  }
+}
+
+/* documented in metrics.h */
+void
+metrics_feed(metrics_t *metrics, const gchar *text, gsize len)
+{
+  const gchar * const end = text + len;
+  const gchar *first_space;
+  const gchar *last_space;
+
+  assert(metrics != NULL);
+  assert(text != NULL || len == 0);
+
+  for (first_space = text; first_space < end &&
+       !g_ascii_isspace(*first_space); ++first_space);
+  if (first_space == end) {
+    hold_back(metrics, text, len);
+    return;
+  }
+  for (last_space = end - 1; !g_ascii_isspace(*last_space); --last_space);
+
+  /* complete the held back word, then extract the whole words */
+  g_string_append_len(metrics->pending, text, first_space - text);
+  extract_pair(metrics, metrics->pending->str, metrics->pending->len);
+  extract_pairs(metrics, first_space, last_space - first_space);
+  g_string_truncate(metrics->pending, 0);
+  hold_back(metrics, last_space + 1, end - (last_space + 1));
+}
+
+/* documented in metrics.h */
+gboolean
+metrics_finish(metrics_t *metrics)
+{
+  gboolean is_pending;
+
+  assert(metrics != NULL);
+
+  is_pending = metrics->pending->len > 0;
+  extract_pair(metrics, metrics->pending->str, metrics->pending->len);
+  g_string_truncate(metrics->pending, 0);
+  return is_pending;
+}
+
+/* documented in metrics.h */
+metrics_t *
+metrics_new_from_text(const gchar *text, gsize len)
+{
+  metrics_t *metrics;
+
+  assert(text != NULL || len == 0);
+
+  metrics = metrics_new();
+  extract_pairs(metrics, text, len);
+  return metrics;
+}
+
+/*!
+ * \brief
+ * Formats a value independently of the locale, without an exponent unless
+ * it's very large or has a fraction
+ *
+ * \param[out] buffer  a buffer of #VALUE_BUF_SIZE bytes
+ * \param[in]  value   the value
+ *
+ * \return
+ * \p buffer
+ */
+static const gchar *
+format_value(gchar * const buffer, const gdouble value)
+{
+  if (value == floor(value) && fabs(value) < 1e15) {
+    return g_ascii_formatd(buffer, VALUE_BUF_SIZE, "%.0f", value);
+  }
+  return g_ascii_formatd(buffer, VALUE_BUF_SIZE, "%.6g", value);
+}
+
+/*!
+ * \brief
+ * Calls the function of metrics_foreach() for one value
+ *
+ * \param[in] metric     the value
+ * \param[in] think_us   the think time, which must be known for a rate
+ * \param[in] is_rate    whether to pass on the value per second of think time
+ * \param[in] func       the function
+ * \param[in] user_data  a pointer to pass to \p func
+ */
+static void
+call_func(const metric_t * const metric,
+          const gint64           think_us,
+          const gboolean         is_rate,
+          const metrics_func_t   func,
+          const gpointer         user_data)
+{
+  gchar buffer[VALUE_BUF_SIZE];
+
+  if (is_rate) {
+    gchar *key;
+    gdouble rate = metric->value * 1e6 / think_us;
+    /* a fraction of a large rate is noise */
+    if (fabs(rate) >= 100.) rate = floor(rate + .5);
+    key = g_strconcat(g_quark_to_string(metric->key), "/s", NULL);
+    func(key, format_value(buffer, rate), user_data);
+    g_free(key);
+  } else {
+    func(g_quark_to_string(metric->key), format_value(buffer, metric->value),
+         user_data);
+  }
+}
+
+/* documented in metrics.h */
+void
+metrics_foreach(const metrics_t *metrics,
+                gint64           think_us,
+                metrics_func_t   func,
+                gpointer         user_data)
+{
+  const GArray * const spec = get_spec();
+
+  assert(metrics != NULL);
+  assert(func != NULL);
+
+  for (guint i = 0; i < spec->len; ++i) {
+    const spec_item_t * const item = &g_array_index(spec, spec_item_t, i);
+
+    if (item->is_rate && think_us <= 0) continue;
+    if (item->key != 0) {
+      const metric_t * const metric = find_metric(metrics, item->key);
+      if (metric != NULL) {
+        call_func(metric, think_us, item->is_rate, func, user_data);
+      }
+      continue;
+    }
+
+    /* a wildcard leaves out the keys that are listed by themselves */
+    for (guint j = 0; j < metrics->values->len; ++j) {
+      const metric_t * const metric =
+        &g_array_index(metrics->values, metric_t, j);
+      gboolean is_listed = FALSE;
+      for (guint k = 0; k < spec->len && !is_listed; ++k) {
+        const spec_item_t * const other =
+          &g_array_index(spec, spec_item_t, k);
+        is_listed = other->key == metric->key &&
+                    other->is_rate == item->is_rate;
+      }
+      if (!is_listed) {
+        call_func(metric, think_us, item->is_rate, func, user_data);
+      }
+    }
+  }
+}
+
+/*!
+ * \brief
+ * Appends a pair to a string, following the signature of ::metrics_func_t
+ *
+ * \param[in] key        the key
+ * \param[in] value      the value
+ * \param[in] user_data  the \c GString
+ */
+static void
+append_pair(const gchar *key, const gchar *value, gpointer user_data)
+{
+  GString * const string = user_data;
+
+  if (string->len > 0) g_string_append_c(string, ' ');
+  g_string_append_printf(string, "%s=%s", key, value);
+}
+
+/* documented in metrics.h */
+gchar *
+metrics_to_string(const metrics_t *metrics, gint64 think_us)
+{
+  GString *string = g_string_new(NULL);
+
+  metrics_foreach(metrics, think_us, append_pair, string);
+  return g_string_free(string, FALSE);
+}
+
+/* documented in metrics.h */
+void
+metrics_free(metrics_t *metrics)
+{
+  if (metrics == NULL) return;
+
+  g_array_free(metrics->values, TRUE);
+  g_string_free(metrics->pending, TRUE);
+  g_slice_free(metrics_t, metrics);
+}
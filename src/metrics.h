@@ -0,0 +1,128 @@
+/*!
+ * \file metrics.h
+ * \brief
+ * Provides extraction of search statistics, written by the clients to stderr
+ * as \c key=value pairs, and rates derived from them
+ *
+ * Which keys are kept is configured by a comma-separated list (option \c -M),
+ * where \c * stands for every key and \c KEY/s for the value of \c KEY per
+ * second of think time, such as \c nodes/s for \c nodes=1834221.
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <gtk/gtk.h>
+
+/*! \brief The statistics of one move (private to metrics.c) */
+typedef struct metrics metrics_t;
+
+/*!
+ * \brief
+ * Function that receives each statistic of a move
+ *
+ * \param[in] key        the key, such as \c depth or \c nodes/s
+ * \param[in] value      the value, formatted independently of the locale
+ * \param[in] user_data  the pointer given to metrics_foreach()
+ */
+typedef void (*metrics_func_t)(const gchar *key,
+                               const gchar *value,
+                               gpointer     user_data);
+
+/*!
+ * \brief
+ * Creates empty statistics for a move
+ *
+ * \return
+ * the statistics, to be freed with metrics_free()
+ */
+metrics_t *
+metrics_new(void);
+
+/*!
+ * \brief
+ * Extracts the pairs from the next part of a move's stderr output
+ *
+ * A pair is separated from its surroundings by whitespace, and its value must
+ * be a number. If a key occurs more than once (such as for each iteration of
+ * a deepening search), the last value is kept. Text that ends in the middle
+ * of a pair is held back until more text arrives.
+ *
+ * \param[in] metrics  the statistics
+ * \param[in] text     the text, which needn't be zero-terminated
+ * \param[in] len      the length of \p text in bytes
+ */
+void
+metrics_feed(metrics_t *metrics, const gchar *text, gsize len);
+
+/*!
+ * \brief
+ * Extracts the pair that the fed text ends with, once a move's stderr output
+ * is complete
+ *
+ * metrics_feed() holds back the last word in case more text follows, so
+ * output that doesn't end with whitespace (such as \c nodes=123 without a
+ * newline) needs this to be extracted.
+ *
+ * \param[in] metrics  the statistics
+ *
+ * \return
+ * whether any text was held back
+ */
+gboolean
+metrics_finish(metrics_t *metrics);
+
+/*!
+ * \brief
+ * Extracts the pairs from a move's complete stderr output
+ *
+ * \param[in] text  the text, which needn't be zero-terminated
+ * \param[in] len   the length of \p text in bytes
+ *
+ * \return
+ * the statistics, to be freed with metrics_free()
+ */
+metrics_t *
+metrics_new_from_text(const gchar *text, gsize len);
+
+/*!
+ * \brief
+ * Calls a function for each configured statistic of a move, in the order
+ * of the configuration (keys matched by \c * in the order they were first
+ * written)
+ *
+ * \param[in] metrics    the statistics
+ * \param[in] think_us   the time in microseconds that the client took to
+ *                       reply, or -1 if unknown (which leaves out rates)
+ * \param[in] func       the function
+ * \param[in] user_data  a pointer to pass to \p func
+ */
+void
+metrics_foreach(const metrics_t *metrics,
+                gint64           think_us,
+                metrics_func_t   func,
+                gpointer         user_data);
+
+/*!
+ * \brief
+ * Formats the configured statistics of a move as \c key=value pairs
+ *
+ * \param[in] metrics   the statistics
+ * \param[in] think_us  as for metrics_foreach()
+ *
+ * \return
+ * the pairs separated by spaces, in a string that should be freed by the
+ * caller
+ */
+gchar *
+metrics_to_string(const metrics_t *metrics, gint64 think_us);
+
+/*!
+ * \brief
+ * Frees the statistics of a move
+ *
+ * \param[in] metrics  the statistics (or \c NULL)
+ */
+void
+metrics_free(metrics_t *metrics);
+
+#endif /* METRICS_H */
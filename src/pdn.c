@@ -0,0 +1,821 @@
+/*!
+ * \file pdn.c
+ * \brief
+ * Converts recorded games to and from Portable Draughts Notation (PDN).
+ *
+ * Both directions work as streams: the writer converts one message at a time,
+ * and the reader tokenizes its input from a fixed-size buffer, playing the
+ * moves on a board of its own to produce the messages.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "pdn.h"
+#include "gui.h"
+#include "protocol.h"
+
+/*! \brief Maximum width of the move text lines that are written */
+#define LINE_WIDTH 79
+
+/*! \brief Size of the buffer when reading PDN */
+#define BUFFER_SIZE (64<<10)
+
+/*! \brief The board at the start of a standard game */
+static const gchar initial_board[] = "rrrrrrrrrrrr........wwwwwwwwwwww";
+
+/*! \brief A PDN stream being written */
+struct pdn_writer {
+  /*! \brief The stream being written */
+  FILE    *file;
+  /*! \brief Whether a game has been started but not ended */
+  gboolean in_game;
+  /*! \brief Number of games started */
+  guint    n_games;
+  /*! \brief Number of the current full move (a red and a white move) */
+  guint    move_number;
+  /*! \brief Whether the next white move needs its move number written */
+  gboolean need_number;
+  /*! \brief Length of the current line of move text */
+  gsize    column;
+};
+
+/*! \brief A PDN stream being read */
+struct pdn_reader {
+  /*! \brief The channel being read */
+  GIOChannel *channel;
+  /*! \brief Data read from the channel */
+  gchar       buffer[BUFFER_SIZE];
+  /*! \brief Position of the next character in #buffer */
+  gsize       pos;
+  /*! \brief Number of valid characters in #buffer */
+  gsize       len;
+  /*! \brief Error that occurred while reading the channel, if any */
+  GError     *read_error;
+  /*! \brief The current tag or word */
+  GString    *token;
+  /*! \brief Messages produced but not yet returned */
+  GQueue     *messages;
+  /*! \brief Current content of each dark square */
+  gchar       board[NUM_DARK_SQ];
+  /*! \brief The player to move next, \c r or \c w */
+  gchar       side;
+  /*! \brief Number of moves left before the game is drawn */
+  guint8      moves_left;
+  /*! \brief Whether the initial setup message of the game has been made */
+  gboolean    in_game;
+  /*! \brief Number of games started, for error messages */
+  guint       n_games;
+};
+
+/*!
+ * \brief
+ * Writes a token of move text, breaking the line if it would be too long
+ *
+ * \param[in] writer  the writer
+ * \param[in] token   the token
+ */
+static void
+write_token(pdn_writer_t * const writer, const gchar * const token)
+{
+  const gsize len = strlen(token);
+
+  if (writer->column > 0) {
+    if (writer->column + 1 + len > LINE_WIDTH) {
+      fputc('\n', writer->file);
+      writer->column = 0;
+    } else {
+      fputc(' ', writer->file);
+      ++writer->column;
+    }
+  }
+  fputs(token, writer->file);
+  writer->column += len;
+}
+
+/*!
+ * \brief
+ * Writes a comment, word by word so that it can be wrapped
+ *
+ * \param[in] writer   the writer
+ * \param[in] comment  the comment, from which any braces are left out
+ */
+static void
+write_comment(pdn_writer_t * const writer, const gchar * const comment)
+{
+  gchar *text = g_strdelimit(g_strdup(comment), "{}\t\n", ' ');
+  gchar **words = g_strsplit(g_strstrip(text), " ", -1);
+  gchar **last = words;
+
+  while (last[0] != NULL && last[1] != NULL) ++last;
+  for (gchar **word = words; *word != NULL; ++word) {
+    gchar *token;
+    if (**word == '\0' && word != words && word != last) continue;
+    token = g_strconcat(word == words ? "{" : "", *word,
+                        word == last ? "}" : "", NULL);
+    write_token(writer, token);
+    g_free(token);
+  }
+  g_strfreev(words);
+  g_free(text);
+}
+
+/*!
+ * \brief
+ * Ends the current game with a result token
+ *
+ * \param[in] writer  the writer
+ * \param[in] result  the result token
+ */
+static void
+end_game(pdn_writer_t * const writer, const gchar * const result)
+{
+  write_token(writer, result);
+  fputs("\n\n", writer->file);
+  writer->column = 0;
+  writer->in_game = FALSE;
+}
+
+/*!
+ * \brief
+ * Starts a new game, with a \c FEN tag unless the position is the standard
+ * starting position
+ *
+ * \param[in] writer   the writer
+ * \param[in] message  the message with the position to start from
+ */
+static void
+start_game(pdn_writer_t * const writer, const message_t * const message)
+{
+  if (writer->in_game) end_game(writer, "*");
+
+  fprintf(writer->file, "[Event \"Game %u\"]\n", ++writer->n_games);
+  if (memcmp(message->board, initial_board, NUM_DARK_SQ) != 0 ||
+      message->next_player != 'r') {
+    static const gchar colors[2] = { 'w', 'r' };
+    fprintf(writer->file, "[FEN \"%c",
+            message->next_player == 'w' ? 'W' : 'B');
+    for (guint8 i = 0; i < 2; ++i) {
+      gboolean first = TRUE;
+      fprintf(writer->file, ":%c", colors[i] == 'w' ? 'W' : 'B');
+      for (guint8 sq = 0; sq < NUM_DARK_SQ; ++sq) {
+        if ((message->board[sq] | 0x20) != colors[i]) continue;
+        fprintf(writer->file, "%s%s%u", first ? "" : ",",
+                message->board[sq] == colors[i] ? "" : "K", sq + 1);
+        first = FALSE;
+      }
+    }
+    fputs("\"]\n", writer->file);
+  }
+  fputc('\n', writer->file);
+
+  writer->in_game = TRUE;
+  writer->move_number = 1;
+  writer->need_number = TRUE;
+  writer->column = 0;
+}
+
+/* documented in pdn.h */
+pdn_writer_t *
+pdn_writer_new(FILE *file)
+{
+  pdn_writer_t *writer;
+
+  assert(file != NULL);
+
+  writer = g_slice_new0(pdn_writer_t);
+  writer->file = file;
+  return writer;
+}
+
+/* documented in pdn.h */
+void
+pdn_writer_add(pdn_writer_t *writer,
+               const gchar  *message,
+               gint64        think_us,
+               const gchar  *comment)
+{
+  message_t m;
+  gchar token[4*MAX_SQUARES];
+  gchar *p = token;
+
+  assert(writer != NULL);
+
+  if (!parse_message(message, &m)) return;
+
+  switch (m.action) {
+  case -1:
+    start_game(writer, &m);
+    return;
+  case -2:
+  case -3:
+  case -4:
+    if (writer->in_game) {
+      if (comment != NULL) write_comment(writer, comment);
+      end_game(writer, m.action == -2 ? "1-0" :
+                       m.action == -3 ? "0-1" : "1/2-1/2");
+    }
+    return;
+  case -5:
+    if (writer->in_game) {
+      write_token(writer, "{null move}");
+      if (m.next_player == 'r') ++writer->move_number;
+      writer->need_number = TRUE;
+    }
+    return;
+  }
+
+  /* without an initial setup, the game starts from the position after the
+     first move that we know of */
+  if (!writer->in_game) {
+    start_game(writer, &m);
+    return;
+  }
+
+  /* red (Black) moves first, and the number precedes each of its moves */
+  if (m.next_player == 'w') {
+    g_snprintf(token, sizeof(token), "%u.", writer->move_number);
+    write_token(writer, token);
+  } else if (writer->need_number) {
+    g_snprintf(token, sizeof(token), "%u...", writer->move_number);
+    write_token(writer, token);
+  }
+
+  for (guint8 i = 0; i < m.n_squares; ++i) {
+    p += g_snprintf(p, token + sizeof(token) - p, "%s%u",
+                    i == 0 ? "" : m.action == 0 ? "-" : "x",
+                    m.squares[i] + 1);
+  }
+  write_token(writer, token);
+
+  if (think_us >= 0) {
+    const guint64 secs = think_us/G_USEC_PER_SEC;
+    g_snprintf(token, sizeof(token), "{[%%emt %u:%02u:%02u.%06u]}",
+               (guint)(secs/3600), (guint)(secs/60%60), (guint)(secs%60),
+               (guint)(think_us%G_USEC_PER_SEC));
+    write_token(writer, token);
+    /* white's move needs its number again after a comment */
+    writer->need_number = m.next_player == 'w';
+  } else {
+    writer->need_number = FALSE;
+  }
+  if (m.next_player == 'r') ++writer->move_number;
+}
+
+/* documented in pdn.h */
+void
+pdn_writer_free(pdn_writer_t *writer)
+{
+  assert(writer != NULL);
+
+  if (writer->in_game) end_game(writer, "*");
+  fflush(writer->file);
+  g_slice_free(pdn_writer_t, writer);
+}
+
+/*!
+ * \brief
+ * Resets the board to the standard starting position
+ *
+ * \param[in] reader  the reader
+ */
+static void
+reset_game(pdn_reader_t * const reader)
+{
+  memcpy(reader->board, initial_board, NUM_DARK_SQ);
+  reader->side = 'r';
+  reader->moves_left = MOVES_LEFT;
+  reader->in_game = FALSE;
+}
+
+/*!
+ * \brief
+ * Adds a message describing the current board to the output queue
+ *
+ * \param[in] reader  the reader
+ * \param[in] action  the action and squares of the message, e.g. \c "-1" or
+ *                    \c "0_11_15"
+ */
+static void
+push_message(pdn_reader_t * const reader, const gchar * const action)
+{
+  g_queue_push_tail(reader->messages,
+                    g_strdup_printf("%.*s %s %c %u", NUM_DARK_SQ,
+                                    reader->board, action, reader->side,
+                                    reader->moves_left));
+}
+
+/*!
+ * \brief
+ * Makes sure that the initial setup message of the game has been made
+ *
+ * \param[in] reader  the reader
+ */
+static void
+start_reading_game(pdn_reader_t * const reader)
+{
+  if (reader->in_game) return;
+
+  push_message(reader, "-1");
+  reader->in_game = TRUE;
+  ++reader->n_games;
+}
+
+/*!
+ * \brief
+ * Reads the next character, refilling the buffer when needed
+ *
+ * \param[in] reader  the reader
+ *
+ * \return
+ * the character, or -1 at end-of-file or on errors
+ */
+static gint
+next_char(pdn_reader_t * const reader)
+{
+  if (reader->pos == reader->len) {
+    GIOStatus status;
+    if (reader->read_error != NULL) return -1;
+    status = g_io_channel_read_chars(reader->channel, reader->buffer,
+                                     BUFFER_SIZE, &reader->len,
+                                     &reader->read_error);
+    reader->pos = 0;
+    if (status != G_IO_STATUS_NORMAL || reader->len == 0) {
+      reader->len = 0;
+      return -1;
+    }
+  }
+  return (guchar)reader->buffer[reader->pos++];
+}
+
+/*!
+ * \brief
+ * Skips characters up to and including a terminator
+ *
+ * \param[in] reader      the reader
+ * \param[in] terminator  the character to stop at
+ */
+static void
+skip_until(pdn_reader_t * const reader, const gint terminator)
+{
+  gint c;
+  while ((c = next_char(reader)) != -1 && c != terminator) {}
+}
+
+/*!
+ * \brief
+ * Skips a (possibly nested) variation, after its opening parenthesis
+ *
+ * \param[in] reader  the reader
+ */
+static void
+skip_variation(pdn_reader_t * const reader)
+{
+  guint depth = 1;
+  gint c;
+
+  while (depth > 0 && (c = next_char(reader)) != -1) {
+    if (c == '(') {
+      ++depth;
+    } else if (c == ')') {
+      --depth;
+    } else if (c == '{') {
+      skip_until(reader, '}');
+    }
+  }
+}
+
+/*!
+ * \brief
+ * Sets up the board from the value of a \c FEN tag, such as
+ * \c "B:W18,24,K10:B12,16-20,K22"
+ *
+ * \param[in] reader  the reader
+ * \param[in] fen     the value of the tag
+ *
+ * \return
+ * whether the value could be parsed
+ */
+static gboolean
+parse_fen(pdn_reader_t * const reader, const gchar * const fen)
+{
+  gchar **sections;
+  gboolean success = TRUE;
+
+  sections = g_strsplit(fen, ":", 0);
+  memset(reader->board, '.', NUM_DARK_SQ);
+
+  switch (*g_strstrip(sections[0] != NULL ? sections[0] : "")) {
+  case 'B':
+    reader->side = 'r';
+    break;
+  case 'W':
+    reader->side = 'w';
+    break;
+  default:
+    success = FALSE;
+  }
+
+  for (guint i = 1; success && sections[i] != NULL; ++i) {
+    gchar * const section = g_strstrip(sections[i]);
+    gchar **pieces;
+    gchar color;
+
+    if (*section == 'B') {
+      color = 'r';
+    } else if (*section == 'W') {
+      color = 'w';
+    } else {
+      success = *section == '\0';
+      continue;
+    }
+
+    pieces = g_strsplit(section + 1, ",", 0);
+    for (guint j = 0; success && pieces[j] != NULL; ++j) {
+      gchar *piece = g_strstrip(pieces[j]);
+      gboolean is_king = FALSE;
+      gchar *end;
+      glong first, last;
+
+      if (*piece == 'K') {
+        is_king = TRUE;
+        ++piece;
+      }
+      if (*piece == '\0') continue;
+      first = last = strtol(piece, &end, 10);
+      if (*end == '-') last = strtol(end + 1, &end, 10);
+      if (first < 1 || last > NUM_DARK_SQ || first > last ||
+          (*end != '\0' && *end != '.')) {
+        success = FALSE;
+        break;
+      }
+      for (glong sq = first; sq <= last; ++sq) {
+        reader->board[sq - 1] = is_king ? g_ascii_toupper(color) : color;
+      }
+    }
+    g_strfreev(pieces);
+  }
+  g_strfreev(sections);
+  return success;
+}
+
+/*!
+ * \brief
+ * Reads a tag, after its opening bracket, and interprets it
+ *
+ * A tag after the moves of a game starts a new game.
+ *
+ * \param[in] reader  the reader
+ * \param[in] error   as for pdn_reader_next()
+ *
+ * \return
+ * \c FALSE if the tag was invalid
+ */
+static gboolean
+read_tag(pdn_reader_t * const reader, GError ** const error)
+{
+  gboolean in_quotes = FALSE;
+  gchar **split;
+  gint c;
+
+  g_string_truncate(reader->token, 0);
+  while ((c = next_char(reader)) != -1 && (in_quotes || c != ']')) {
+    if (c == '"') in_quotes = !in_quotes;
+    g_string_append_c(reader->token, c);
+  }
+
+  if (reader->in_game) reset_game(reader);
+
+  /* split into name, value and the rest */
+  split = g_strsplit(reader->token->str, "\"", 3);
+  if (g_strv_length(split) >= 2 &&
+      g_ascii_strcasecmp(g_strstrip(split[0]), "FEN") == 0 &&
+      !parse_fen(reader, split[1])) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "Invalid FEN tag \"%s\" in game %u", split[1],
+                reader->n_games + 1);
+    g_strfreev(split);
+    return FALSE;
+  }
+  g_strfreev(split);
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Searches for a sequence of jumps that takes a piece to a given square
+ *
+ * Shorter sequences are tried first by the caller, which limits the depth.
+ *
+ * \param[in]     board     the board, where the moving piece has been lifted
+ * \param[in]     sq        the square that the piece is currently on
+ * \param[in]     target    the square to reach
+ * \param[in]     piece     the moving piece
+ * \param[in]     captured  bitmask of squares already jumped over
+ * \param[in,out] path      the squares visited so far
+ * \param[in,out] n         the number of squares in \p path
+ * \param[in]     max       the maximum number of squares in \p path
+ *
+ * \return
+ * whether \p target was reached, in which case \p path holds the jumps
+ */
+static gboolean
+find_jumps(const gchar * const board,
+           const guint8        sq,
+           const guint8        target,
+           const gchar         piece,
+           const guint32       captured,
+           guint8      * const path,
+           guint8      * const n,
+           const guint8        max)
+{
+  const gint row = BOARD_ROW(sq);
+  const gint col = BOARD_COL(sq);
+  const gchar color = piece | 0x20;
+
+  if (*n == max) return FALSE;
+  /* a man that reaches the far side is crowned, which ends the move, as in
+     rules.c */
+  if ((piece == 'r' && row == 7) || (piece == 'w' && row == 0)) return FALSE;
+
+  for (guint8 d = 0; d < 4; ++d) {
+    const gint dr = (d & 2) ? -1 : 1;
+    const gint dc = (d & 1) ? -1 : 1;
+    guint8 mid;
+    guint8 land;
+
+    /* men only move towards the opponent (red down, white up) */
+    if (piece == 'r' && dr < 0) continue;
+    if (piece == 'w' && dr > 0) continue;
+    if (row + 2*dr < 0 || row + 2*dr > 7 ||
+        col + 2*dc < 0 || col + 2*dc > 7) continue;
+
+    mid  = BOARD_SQ(row + dr, col + dc);
+    land = BOARD_SQ(row + 2*dr, col + 2*dc);
+    if ((captured >> mid) & 1) continue;
+    if (board[mid] == '.' || (board[mid] | 0x20) == color) continue;
+    if (board[land] != '.') continue;
+
+    path[(*n)++] = land;
+    if (land == target ||
+        find_jumps(board, land, target, piece, captured | 1u << mid,
+                   path, n, max)) return TRUE;
+    --*n;
+  }
+  return FALSE;
+}
+
+/*!
+ * \brief
+ * Plays a move on the board and queues the resulting message
+ *
+ * \param[in] reader      the reader
+ * \param[in] squares     the squares given in the move text
+ * \param[in] n_squares   the number of entries in \p squares (at least two)
+ * \param[in] is_capture  whether the move text used \c x
+ * \param[in] text        the move text, for error messages
+ * \param[in] error       as for pdn_reader_next()
+ *
+ * \return
+ * whether the move could be played
+ */
+static gboolean
+play_move(pdn_reader_t * const reader,
+          const guint8 * const squares,
+          const guint8         n_squares,
+          const gboolean       is_capture,
+          const gchar  * const text,
+          GError      ** const error)
+{
+  gchar board[NUM_DARK_SQ];
+  gchar piece;
+  guint8 path[MAX_SQUARES];
+  guint8 n = 1;
+  guint32 captured = 0;
+  gint jumps;
+  GString *action;
+
+  start_reading_game(reader);
+
+  memcpy(board, reader->board, NUM_DARK_SQ);
+  piece = board[squares[0]];
+  board[squares[0]] = '.';
+  path[0] = squares[0];
+
+  if (n_squares == 2 && !is_capture && board[squares[1]] == '.' &&
+      abs(BOARD_ROW(squares[0]) - BOARD_ROW(squares[1])) == 1 &&
+      abs(BOARD_COL(squares[0]) - BOARD_COL(squares[1])) == 1) {
+    path[n++] = squares[1];
+  } else if (piece != '.') {
+    /* expand each leg of the jump, trying the shortest sequences first */
+    for (guint8 i = 1; i < n_squares; ++i) {
+      const guint8 start = n;
+      guint8 max;
+      for (max = n + 1; max <= MAX_SQUARES; ++max) {
+        n = start;
+        if (find_jumps(board, path[n - 1], squares[i], piece, captured,
+                       path, &n, max)) break;
+      }
+      if (max > MAX_SQUARES) {
+        n = 1;
+        break;
+      }
+      for (guint8 j = start; j < n; ++j) {
+        captured |= 1u << BOARD_SQ((BOARD_ROW(path[j - 1]) +
+                                    BOARD_ROW(path[j]))/2,
+                                   (BOARD_COL(path[j - 1]) +
+                                    BOARD_COL(path[j]))/2);
+      }
+    }
+  }
+
+  if (piece == '.' || n == 1) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "Impossible move \"%s\" in game %u", text, reader->n_games);
+    return FALSE;
+  }
+
+  /* remove the jumped pieces, move the piece and crown it if it's a man
+     reaching the opposite side */
+  jumps = 0;
+  for (guint8 sq = 0; sq < NUM_DARK_SQ; ++sq) {
+    if ((captured >> sq) & 1) {
+      board[sq] = '.';
+      ++jumps;
+    }
+  }
+  if ((piece == 'r' && BOARD_ROW(path[n - 1]) == 7) ||
+      (piece == 'w' && BOARD_ROW(path[n - 1]) == 0)) {
+    piece = g_ascii_toupper(piece);
+  }
+  board[path[n - 1]] = piece;
+  memcpy(reader->board, board, NUM_DARK_SQ);
+
+  reader->side = (piece | 0x20) == 'r' ? 'w' : 'r';
+  if (jumps > 0) {
+    reader->moves_left = MOVES_LEFT;
+  } else if (reader->moves_left > 0) {
+    --reader->moves_left;
+  }
+
+  action = g_string_new(NULL);
+  g_string_append_printf(action, "%d", jumps);
+  for (guint8 i = 0; i < n; ++i) {
+    g_string_append_printf(action, "_%u", path[i] + 1);
+  }
+  push_message(reader, action->str);
+  g_string_free(action, TRUE);
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Interprets a word of move text: a move number, a move or a result
+ *
+ * \param[in] reader  the reader
+ * \param[in] error   as for pdn_reader_next()
+ *
+ * \return
+ * \c FALSE if the word was an impossible move
+ */
+static gboolean
+handle_word(pdn_reader_t * const reader, GError ** const error)
+{
+  static const struct {
+    const gchar *token;
+    const gchar *action;
+  } results[] = {
+    { "1-0",     "-2" }, { "2-0", "-2" },
+    { "0-1",     "-3" }, { "0-2", "-3" },
+    { "1/2-1/2", "-4" }, { "1-1", "-4" },
+    { "*",       NULL }, { "0-0", NULL },
+  };
+  gchar *word = reader->token->str;
+  guint8 squares[MAX_SQUARES];
+  guint8 n_squares = 0;
+  gboolean is_capture = FALSE;
+
+  for (guint8 i = 0; i < G_N_ELEMENTS(results); ++i) {
+    if (strcmp(word, results[i].token) != 0) continue;
+    if (results[i].action != NULL) {
+      start_reading_game(reader);
+      push_message(reader, results[i].action);
+    }
+    reset_game(reader);
+    return TRUE;
+  }
+
+  /* skip move numbers ("12." or "12..."), which may be glued to the move */
+  if (g_ascii_isdigit(*word)) {
+    gchar *p = word;
+    while (g_ascii_isdigit(*p)) ++p;
+    if (*p == '.') {
+      while (*p == '.') ++p;
+      word = p;
+    }
+  }
+
+  /* strip annotations such as "!" and "?" */
+  {
+    gsize len = strlen(word);
+    while (len > 0 && (word[len - 1] == '!' || word[len - 1] == '?')) {
+      word[--len] = '\0';
+    }
+  }
+
+  /* anything but a move (such as "$1") is ignored */
+  while (g_ascii_isdigit(*word)) {
+    gchar *end;
+    const glong sq = strtol(word, &end, 10);
+    if (sq < 1 || sq > NUM_DARK_SQ || n_squares == MAX_SQUARES) return TRUE;
+    squares[n_squares++] = sq - 1;
+    if (*end == '\0') break;
+    if (*end == 'x' || *end == ':') {
+      is_capture = TRUE;
+    } else if (*end != '-') {
+      return TRUE;
+    }
+    word = end + 1;
+  }
+  if (n_squares < 2) return TRUE;
+
+  return play_move(reader, squares, n_squares, is_capture,
+                   reader->token->str, error);
+}
+
+/* documented in pdn.h */
+pdn_reader_t *
+pdn_reader_new(GIOChannel *channel)
+{
+  pdn_reader_t *reader;
+
+  assert(channel != NULL);
+
+  reader = g_new0(pdn_reader_t, 1);
+  reader->channel = g_io_channel_ref(channel);
+  reader->token = g_string_new(NULL);
+  reader->messages = g_queue_new();
+  reset_game(reader);
+  return reader;
+}
+
+/* documented in pdn.h */
+gchar *
+pdn_reader_next(pdn_reader_t *reader, GError **error)
+{
+  assert(reader != NULL);
+
+  while (g_queue_is_empty(reader->messages)) {
+    const gint c = next_char(reader);
+
+    if (c == -1) {
+      if (reader->read_error != NULL) {
+        g_propagate_error(error, reader->read_error);
+        reader->read_error = NULL;
+      }
+      return NULL;
+    }
+    if (g_ascii_isspace(c)) continue;
+
+    switch (c) {
+    case '[':
+      if (!read_tag(reader, error)) return NULL;
+      break;
+    case '{':
+      skip_until(reader, '}');
+      break;
+    case '(':
+      skip_variation(reader);
+      break;
+    case ';':
+      skip_until(reader, '\n');
+      break;
+    default: {
+      gint d = c;
+      g_string_truncate(reader->token, 0);
+      do {
+        g_string_append_c(reader->token, d);
+        d = next_char(reader);
+      } while (d != -1 && !g_ascii_isspace(d) && strchr("[{(;", d) == NULL);
+      /* the delimiter was just read, so it's still in the buffer */
+      if (d != -1 && !g_ascii_isspace(d)) --reader->pos;
+      if (!handle_word(reader, error)) return NULL;
+    }
+    }
+  }
+  return g_queue_pop_head(reader->messages);
+}
+
+/* documented in pdn.h */
+void
+pdn_reader_free(pdn_reader_t *reader)
+{
+  assert(reader != NULL);
+
+  g_io_channel_unref(reader->channel);
+  g_string_free(reader->token, TRUE);
+  g_queue_free_full(reader->messages, g_free);
+  if (reader->read_error != NULL) g_error_free(reader->read_error);
+  g_free(reader);
+}
@@ -0,0 +1,110 @@
+/*!
+ * \file pdn.h
+ * \brief
+ * Provides streaming conversion between recorded games and Portable Draughts
+ * Notation (PDN)
+ *
+ * The red player moves first and corresponds to Black in PDN, so the square
+ * numbers of the protocol (plus one) are the standard PDN square numbers. A
+ * result of \c 1-0 means that Black (red) won, and \c 0-1 that White won.
+ */
+#ifndef PDN_H
+#define PDN_H
+
+#include <stdio.h>
+#include <gtk/gtk.h>
+
+/*! \brief A PDN stream being written (private to pdn.c) */
+typedef struct pdn_writer pdn_writer_t;
+
+/*! \brief A PDN stream being read (private to pdn.c) */
+typedef struct pdn_reader pdn_reader_t;
+
+/*!
+ * \brief
+ * Starts writing PDN to a stream
+ *
+ * \param[in] file  the stream, which remains owned by the caller
+ *
+ * \return
+ * the writer
+ */
+pdn_writer_t *
+pdn_writer_new(FILE *file);
+
+/*!
+ * \brief
+ * Converts a message to PDN and writes it
+ *
+ * An initial setup message starts a new game (with a \c FEN tag unless it's
+ * the standard starting position), a move is written as a move, and a result
+ * message ends the game. Nothing is buffered except the current line. A known
+ * think time is written after the move as an elapsed move time comment, such
+ * as \c {[%emt 0:00:01.250000]}, and a comment on a result, such as the
+ * reason for a forfeit, is written before the result.
+ *
+ * \param[in] writer    the writer
+ * \param[in] message   a message in the protocol format
+ * \param[in] think_us  the time in microseconds that the client took to make
+ *                      the move, or a negative value if unknown
+ * \param[in] comment   a comment on a result message, or \c NULL
+ */
+void
+pdn_writer_add(pdn_writer_t *writer,
+               const gchar  *message,
+               gint64        think_us,
+               const gchar  *comment);
+
+/*!
+ * \brief
+ * Ends any unfinished game and frees the writer
+ *
+ * \param[in] writer  the writer
+ */
+void
+pdn_writer_free(pdn_writer_t *writer);
+
+/*!
+ * \brief
+ * Starts reading PDN from a channel
+ *
+ * \param[in] channel  the channel, which is referenced by the reader
+ *
+ * \return
+ * the reader
+ */
+pdn_reader_t *
+pdn_reader_new(GIOChannel *channel);
+
+/*!
+ * \brief
+ * Reads PDN until the next message can be produced
+ *
+ * Each game yields an initial setup message, one message per move and (if
+ * the game has a decisive result or is drawn) a result message. Moves are
+ * played on a board to produce the messages, and jumps written in short form
+ * (only the first and last squares) are expanded. Tags other than \c FEN,
+ * comments, variations and annotations are skipped.
+ *
+ * \param[in] reader  the reader
+ * \param[in] error   either \c NULL to disregard errors, or the address of a
+ *                    pointer initialized to \c NULL (which should be freed
+ *                    afterwards if set)
+ *
+ * \return
+ * the message in a string that should be freed by the caller, or \c NULL at
+ * end-of-file or on errors
+ */
+gchar *
+pdn_reader_next(pdn_reader_t *reader, GError **error);
+
+/*!
+ * \brief
+ * Frees a reader and releases its channel
+ *
+ * \param[in] reader  the reader
+ */
+void
+pdn_reader_free(pdn_reader_t *reader);
+
+#endif /* PDN_H */
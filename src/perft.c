@@ -0,0 +1,196 @@
+/*!
+ * \file perft.c
+ * \brief
+ * Counts the positions below a position with a pool of worker threads.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "perft.h"
+#include "protocol.h"
+#include "rules.h"
+
+/*! \brief The message of the initial position */
+#define INITIAL_MESSAGE "rrrrrrrrrrrr........wwwwwwwwwwww -1 r 50"
+
+/*! \brief Largest accepted depth */
+#define MAX_PERFT_DEPTH 32
+
+/*!
+ * \brief
+ * A unit of work for the thread pool: the positions below a position two
+ * plies down
+ */
+typedef struct {
+  /*! \brief The position */
+  position_t position;
+  /*! \brief The index of the move of the root position that leads to it */
+  guint      root_move;
+  /*! \brief The depth still to count */
+  guint      depth;
+} job_t;
+
+/*!
+ * \brief
+ * State shared between the worker threads
+ */
+typedef struct {
+  /*! \brief Protects #counts */
+  GMutex  mutex;
+  /*! \brief The number of positions below each move of the root position */
+  guint64 counts[MAX_MOVES];
+} perft_state_t;
+
+/*!
+ * \brief
+ * Counts the positions at a depth below a position
+ *
+ * The positions one ply above are counted by their number of moves, without
+ * making them.
+ *
+ * \param[in] position  the position
+ * \param[in] depth     the depth
+ *
+ * \return
+ * the number of positions
+ */
+static guint64
+count_positions(const position_t * const position, const guint depth)
+{
+  move_t moves[MAX_MOVES];
+  guint n_moves;
+  guint64 n_positions = 0;
+
+  if (depth == 0) return 1;
+  n_moves = generate_moves(position, moves);
+  if (depth == 1) return n_moves;
+
+  for (guint i = 0; i < n_moves; ++i) {
+    position_t child;
+    make_move(position, &moves[i], &child);
+    n_positions += count_positions(&child, depth - 1);
+  }
+  return n_positions;
+}
+
+/*!
+ * \brief
+ * Counts the positions of a job, following the signature of \c GFunc
+ *
+ * \param[in] data       the ::job_t, which is freed
+ * \param[in] user_data  the ::perft_state_t
+ */
+static void
+count_job(gpointer data, gpointer user_data)
+{
+  job_t * const job = data;
+  perft_state_t * const state = user_data;
+  const guint64 n_positions = count_positions(&job->position, job->depth);
+
+  g_mutex_lock(&state->mutex);
+  state->counts[job->root_move] += n_positions;
+  g_mutex_unlock(&state->mutex);
+  g_slice_free(job_t, job);
+}
+
+/* documented in perft.h */
+gboolean
+run_perft(gchar * const *args, GError **error)
+{
+  extern guint    option_jobs;
+  extern gboolean option_divide;
+  const gchar *line = INITIAL_MESSAGE;
+  perft_state_t state;
+  GThreadPool *pool;
+  message_t message;
+  position_t position;
+  move_t moves[MAX_MOVES];
+  guint n_moves;
+  guint64 depth;
+  guint64 n_positions = 0;
+  gint64 start_us;
+  gdouble seconds;
+  gchar *end;
+
+  assert(args != NULL);
+  assert(error == NULL || *error == NULL);
+
+  if (args[0] == NULL || (args[1] != NULL && args[2] != NULL)) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Expected " PERFT_COMMAND " DEPTH [MESSAGE]");
+    return FALSE;
+  }
+  depth = g_ascii_strtoull(args[0], &end, 10);
+  if (*end != '\0' || end == args[0] || depth > MAX_PERFT_DEPTH) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Invalid depth \"%s\" (expected 0 to %d)", args[0],
+                MAX_PERFT_DEPTH);
+    return FALSE;
+  }
+  if (args[1] != NULL) line = args[1];
+  if (!parse_message(line, &message) || !get_position(&message, &position)) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Invalid message \"%s\"", line);
+    return FALSE;
+  }
+
+  memset(state.counts, 0, sizeof(state.counts));
+  g_mutex_init(&state.mutex);
+  pool = g_thread_pool_new(count_job, &state,
+                           option_jobs > 0 ? (gint)option_jobs
+                                           : (gint)g_get_num_processors(),
+                           TRUE, error);
+  if (pool == NULL) {
+    g_mutex_clear(&state.mutex);
+    return FALSE;
+  }
+
+  start_us = g_get_monotonic_time();
+  n_moves = depth > 0 ? generate_moves(&position, moves) : 0;
+  for (guint i = 0; i < n_moves; ++i) {
+    position_t child;
+    move_t child_moves[MAX_MOVES];
+    guint n_child_moves;
+
+    make_move(&position, &moves[i], &child);
+    if (depth < 3) {
+      /* too little work to share out */
+      state.counts[i] = count_positions(&child, depth - 1);
+      continue;
+    }
+    /* the root position has too few moves to keep many threads busy, so
+       the moves one ply further down make the jobs */
+    n_child_moves = generate_moves(&child, child_moves);
+    for (guint j = 0; j < n_child_moves; ++j) {
+      job_t * const job = g_slice_new(job_t);
+      make_move(&child, &child_moves[j], &job->position);
+      job->root_move = i;
+      job->depth = depth - 2;
+      g_thread_pool_push(pool, job, NULL);
+    }
+  }
+
+  /* wait for the queued jobs to finish */
+  g_thread_pool_free(pool, FALSE, TRUE);
+  g_mutex_clear(&state.mutex);
+  seconds = (g_get_monotonic_time() - start_us) / 1e6;
+
+  for (guint i = 0; i < n_moves; ++i) {
+    if (option_divide) {
+      gchar * const text = format_move(&moves[i]);
+      printf("%s: %" G_GUINT64_FORMAT "\n", text, state.counts[i]);
+      g_free(text);
+    }
+    n_positions += state.counts[i];
+  }
+  if (depth == 0) n_positions = 1;
+  if (option_divide) putchar('\n');
+  printf("Depth:       %" G_GUINT64_FORMAT "\n"
+         "Positions:   %" G_GUINT64_FORMAT "\n"
+         "Time:        %.3f s\n"
+         "Positions/s: %.0f\n",
+         depth, n_positions, seconds,
+         seconds > 0 ? n_positions / seconds : 0);
+  return TRUE;
+}
@@ -0,0 +1,39 @@
+/*!
+ * \file perft.h
+ * \brief
+ * Provides a benchmark of the move generator, which counts the positions a
+ * number of plies ahead (perft)
+ */
+#ifndef PERFT_H
+#define PERFT_H
+
+#include <gtk/gtk.h>
+
+/*! \brief The word on the command line that runs the benchmark */
+#define PERFT_COMMAND "perft"
+
+/*!
+ * \brief
+ * Counts the positions at a depth below a position, and writes the count and
+ * the positions per second to standard output
+ *
+ * The moves two plies below the position are shared out to a pool of worker
+ * threads. With option \c -d (divide), the count below each move of the
+ * position is written as well, so that a move generator can be compared
+ * with this one move at a time.
+ *
+ * \param[in] args   a \c NULL-terminated array of the depth in plies and
+ *                   optionally a message in the format of the protocol, whose
+ *                   board and next player give the position (by default the
+ *                   initial position)
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * whether the arguments were valid and the positions were counted
+ */
+gboolean
+run_perft(gchar * const *args, GError **error);
+
+#endif /* PERFT_H */
@@ -0,0 +1,245 @@
+/*!
+ * \file plot.c
+ * \brief
+ * Draws rows side by side on a Cairo context, keeping what has been drawn in
+ * an offscreen surface so that only new or changed rows are drawn again.
+ */
+#include <assert.h>
+#include <math.h>
+#include <gtk/gtk.h>
+#include "plot.h"
+
+/* -- macros for colors */
+#define BACKGROUND_R (255./255.) /*!< \brief Background, red component */
+#define BACKGROUND_G (255./255.) /*!< \brief Background, green component */
+#define BACKGROUND_B (255./255.) /*!< \brief Background, blue component */
+
+/* white is drawn in grey to be visible */
+#define WHITE_R      ( 96./255.) /*!< \brief White, red component */
+#define WHITE_G      ( 96./255.) /*!< \brief White, green component */
+#define WHITE_B      ( 96./255.) /*!< \brief White, blue component */
+
+#define RED_R        (196./255.) /*!< \brief Red, red component */
+#define RED_G        (  0./255.) /*!< \brief Red, green component */
+#define RED_B        (  3./255.) /*!< \brief Red, blue component */
+
+#define AXIS_R       (192./255.) /*!< \brief Axis and label, red component */
+#define AXIS_G       (192./255.) /*!< \brief Axis and label, green component */
+#define AXIS_B       (192./255.) /*!< \brief Axis and label, blue component */
+
+#define SELECTED_R   (  0./255.) /*!< \brief Selected row, red component */
+#define SELECTED_G   (  0./255.) /*!< \brief Selected row, green component */
+#define SELECTED_B   (255./255.) /*!< \brief Selected row, blue component */
+
+/* -- macros for various sizes */
+/*! \brief Font size of the labels in pixels */
+#define LABEL_FONTSIZE 10.
+
+/* documented in plot.h */
+void
+plot_init(plot_t *plot, gdouble margin_px, gdouble max_row_width_px)
+{
+  assert(plot != NULL);
+
+  plot->margin_px = margin_px;
+  plot->max_row_width_px = max_row_width_px;
+  plot->cache = NULL;
+  plot->width_px = 0;
+  plot->height_px = 0;
+  plot_clear(plot);
+}
+
+/* documented in plot.h */
+void
+plot_clear(plot_t *plot)
+{
+  assert(plot != NULL);
+
+  plot->selected = -1;
+  plot->row_width_px = plot->max_row_width_px;
+  plot->n_drawn = 0;
+}
+
+/* documented in plot.h */
+void
+plot_invalidate(plot_t *plot, guint row)
+{
+  assert(plot != NULL);
+
+  plot->n_drawn = MIN(plot->n_drawn, row);
+}
+
+/* documented in plot.h */
+gdouble
+plot_get_part_height(const plot_t *plot, guint n_parts)
+{
+  assert(plot != NULL);
+  assert(n_parts > 0);
+
+  return (plot->height_px - (n_parts + 1)*plot->margin_px) / n_parts;
+}
+
+/* documented in plot.h */
+gdouble
+plot_get_row_x(const plot_t *plot, guint row)
+{
+  assert(plot != NULL);
+
+  return plot->margin_px + row*plot->row_width_px;
+}
+
+/* documented in plot.h */
+void
+plot_set_player_source(cairo_t *cr, gchar player)
+{
+  assert(cr != NULL);
+
+  if (player == 'r') {
+    cairo_set_source_rgb(cr, RED_R, RED_G, RED_B);
+  } else {
+    cairo_set_source_rgb(cr, WHITE_R, WHITE_G, WHITE_B);
+  }
+}
+
+/* documented in plot.h */
+void
+plot_draw_axis(const plot_t *plot,
+               cairo_t      *cr,
+               gdouble       axis,
+               gdouble       label_x,
+               gdouble       top,
+               const gchar  *label)
+{
+  assert(plot != NULL);
+  assert(cr != NULL);
+  assert(label != NULL);
+
+  cairo_set_source_rgb(cr, AXIS_R, AXIS_G, AXIS_B);
+  cairo_set_line_width(cr, 1.);
+  cairo_set_font_size(cr, LABEL_FONTSIZE);
+  /* half a pixel off to draw crisp lines */
+  cairo_move_to(cr, plot->margin_px, floor(axis) + .5);
+  cairo_line_to(cr, plot->width_px - plot->margin_px, floor(axis) + .5);
+  cairo_stroke(cr);
+  cairo_move_to(cr, label_x, top + LABEL_FONTSIZE);
+  cairo_show_text(cr, label);
+}
+
+/*!
+ * \brief
+ * Draws the rows from a given row onwards on #plot_t::cache, replacing
+ * whatever was drawn there before
+ *
+ * \param[in] plot       the plot
+ * \param[in] first      the number of the first row to draw
+ * \param[in] rows_func  the function that draws the rows
+ * \param[in] user_data  data to pass to \p rows_func
+ */
+static void
+draw_rows(plot_t * const         plot,
+          guint                  first,
+          const plot_rows_func_t rows_func,
+          const gpointer         user_data)
+{
+  gdouble x;
+  cairo_t *cr;
+
+  /* a line to a row starts at the row before it */
+  if (first > 0) --first;
+
+  /* rows narrower than a pixel share pixels with the rows before them */
+  x = 0.;
+  if (first > 0) {
+    x = floor(plot_get_row_x(plot, first));
+    first = (x - plot->margin_px) / plot->row_width_px;
+  }
+
+  cr = cairo_create(plot->cache);
+  cairo_rectangle(cr, x, 0., plot->width_px - x, plot->height_px);
+  cairo_set_source_rgb(cr, BACKGROUND_R, BACKGROUND_G, BACKGROUND_B);
+  cairo_fill(cr);
+  rows_func(cr, first, user_data);
+  cairo_destroy(cr);
+}
+
+/* documented in plot.h */
+void
+plot_draw(plot_t             *plot,
+          cairo_t            *cr,
+          int                 width_px,
+          int                 height_px,
+          guint               n_rows,
+          plot_rows_func_t    rows_func,
+          plot_labels_func_t  labels_func,
+          gpointer            user_data)
+{
+  const gdouble plot_width = width_px - 2*plot->margin_px;
+
+  assert(plot != NULL);
+  assert(cr != NULL);
+  assert(rows_func != NULL);
+  assert(labels_func != NULL);
+
+  /* a new size invalidates everything */
+  if (plot->cache == NULL || plot->width_px != width_px ||
+      plot->height_px != height_px) {
+    if (plot->cache != NULL) cairo_surface_destroy(plot->cache);
+    plot->cache = cairo_surface_create_similar(cairo_get_target(cr),
+                                               CAIRO_CONTENT_COLOR,
+                                               width_px, height_px);
+    plot->width_px = width_px;
+    plot->height_px = height_px;
+    plot->row_width_px = plot->max_row_width_px;
+    plot->n_drawn = 0;
+  }
+  if (plot_width <= 0.) return;
+
+  /* halving the width redraws everything, but only a logarithmic number of
+     times as rows are added */
+  while (n_rows*plot->row_width_px > plot_width) {
+    plot->row_width_px /= 2.;
+    plot->n_drawn = 0;
+  }
+  if (plot->n_drawn < n_rows || plot->n_drawn == 0) {
+    draw_rows(plot, plot->n_drawn, rows_func, user_data);
+    plot->n_drawn = n_rows;
+  }
+
+  cairo_set_source_surface(cr, plot->cache, 0., 0.);
+  cairo_paint(cr);
+  labels_func(cr, user_data);
+
+  if (plot->selected >= 0 && (guint)plot->selected < n_rows) {
+    const gdouble x =
+      floor(plot_get_row_x(plot, plot->selected) + plot->row_width_px/2.) +
+      .5;
+    cairo_set_source_rgb(cr, SELECTED_R, SELECTED_G, SELECTED_B);
+    cairo_set_line_width(cr, 1.);
+    cairo_move_to(cr, x, plot->margin_px);
+    cairo_line_to(cr, x, height_px - plot->margin_px);
+    cairo_stroke(cr);
+  }
+}
+
+/* documented in plot.h */
+gint
+plot_get_row_at(const plot_t *plot, gdouble x, guint n_rows)
+{
+  gdouble row;
+
+  assert(plot != NULL);
+
+  row = floor((x - plot->margin_px) / plot->row_width_px);
+  if (row < 0. || row >= n_rows) return -1;
+  return row;
+}
+
+/* documented in plot.h */
+void
+plot_finish(plot_t *plot)
+{
+  assert(plot != NULL);
+
+  if (plot->cache != NULL) cairo_surface_destroy(plot->cache);
+  plot->cache = NULL;
+}
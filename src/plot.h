@@ -0,0 +1,203 @@
+/*!
+ * \file plot.h
+ * \brief
+ * Provides what the charts and the timeline share: rows drawn side by side
+ * in an offscreen surface, which narrow as rows are added, with the axes,
+ * labels and selected row drawn over them
+ */
+#ifndef PLOT_H
+#define PLOT_H
+
+#include <gtk/gtk.h>
+
+/*!
+ * \brief
+ * The drawing state of a plot, which is part of the structure of the charts
+ * or timeline that owns the rows
+ */
+typedef struct {
+  /*! \brief Space around and between the parts of the plot in pixels */
+  gdouble          margin_px;
+  /*! \brief Width of a row in pixels while few enough rows have been
+             added */
+  gdouble          max_row_width_px;
+  /*! \brief Width of a row in pixels */
+  gdouble          row_width_px;
+  /*! \brief Number of the selected row, or -1 */
+  gint             selected;
+  /*! \brief Rows drawn so far, or \c NULL before the first plot_draw() */
+  cairo_surface_t *cache;
+  /*! \brief Width of #cache in pixels */
+  int              width_px;
+  /*! \brief Height of #cache in pixels */
+  int              height_px;
+  /*! \brief Number of rows at the start that are up to date in #cache */
+  guint            n_drawn;
+} plot_t;
+
+/*!
+ * \brief
+ * A function that draws the rows from a given row onwards, over a cleared
+ * background
+ *
+ * \param[in] cr         the Cairo context of #plot_t::cache
+ * \param[in] first      the number of the first row to draw
+ * \param[in] user_data  the data passed to plot_draw()
+ */
+typedef void (*plot_rows_func_t)(cairo_t  *cr,
+                                 guint     first,
+                                 gpointer  user_data);
+
+/*!
+ * \brief
+ * A function that draws the axes and labels, which aren't kept in
+ * #plot_t::cache since the labels may overlap the rows
+ *
+ * \param[in] cr         the Cairo context to draw on
+ * \param[in] user_data  the data passed to plot_draw()
+ */
+typedef void (*plot_labels_func_t)(cairo_t *cr, gpointer user_data);
+
+/*!
+ * \brief
+ * Initializes a plot without rows
+ *
+ * \param[in] plot              the plot
+ * \param[in] margin_px         the space around and between the parts of
+ *                              the plot in pixels
+ * \param[in] max_row_width_px  the width of a row in pixels while few
+ *                              enough rows have been added
+ */
+void
+plot_init(plot_t *plot, gdouble margin_px, gdouble max_row_width_px);
+
+/*!
+ * \brief
+ * Forgets the rows drawn so far and the selected row
+ *
+ * \param[in] plot  the plot
+ */
+void
+plot_clear(plot_t *plot);
+
+/*!
+ * \brief
+ * Marks the rows from a given row onwards as changed, so that the next
+ * plot_draw() draws them again
+ *
+ * \param[in] plot  the plot
+ * \param[in] row   the number of the first changed row, or zero if every
+ *                  row is changed (such as by a new scale)
+ */
+void
+plot_invalidate(plot_t *plot, guint row);
+
+/*!
+ * \brief
+ * Gets the height of each of a number of parts of the plot that are stacked
+ * from top to bottom
+ *
+ * \param[in] plot     the plot
+ * \param[in] n_parts  the number of parts
+ *
+ * \return
+ * the height in pixels
+ */
+gdouble
+plot_get_part_height(const plot_t *plot, guint n_parts);
+
+/*!
+ * \brief
+ * Gets the left edge of a row
+ *
+ * \param[in] plot  the plot
+ * \param[in] row   the number of the row
+ *
+ * \return
+ * the position in pixels
+ */
+gdouble
+plot_get_row_x(const plot_t *plot, guint row);
+
+/*!
+ * \brief
+ * Sets the source of a Cairo context to the color of a player, where white
+ * is drawn in grey to be visible
+ *
+ * \param[in] cr      the Cairo context
+ * \param[in] player  \c 'r' for red, or \c 'w' for white
+ */
+void
+plot_set_player_source(cairo_t *cr, gchar player);
+
+/*!
+ * \brief
+ * Draws a horizontal axis across the plot and a label above it, in the
+ * color of the axes
+ *
+ * \param[in] plot     the plot
+ * \param[in] cr       the Cairo context to draw on
+ * \param[in] axis     the vertical position of the axis in pixels
+ * \param[in] label_x  the horizontal position of the label in pixels
+ * \param[in] top      the top of the label in pixels
+ * \param[in] label    the label
+ */
+void
+plot_draw_axis(const plot_t *plot,
+               cairo_t      *cr,
+               gdouble       axis,
+               gdouble       label_x,
+               gdouble       top,
+               const gchar  *label);
+
+/*!
+ * \brief
+ * Draws a plot, drawing only the changed rows in #plot_t::cache at the same
+ * size
+ *
+ * Once the rows don't fit, their width is halved until they do, which
+ * draws every row again.
+ *
+ * \param[in] plot         the plot
+ * \param[in] cr           the Cairo context to draw on
+ * \param[in] width_px     the width of the widget in pixels
+ * \param[in] height_px    the height of the widget in pixels
+ * \param[in] n_rows       the number of rows
+ * \param[in] rows_func    the function that draws the rows
+ * \param[in] labels_func  the function that draws the axes and labels
+ * \param[in] user_data    data to pass to \p rows_func and \p labels_func
+ */
+void
+plot_draw(plot_t             *plot,
+          cairo_t            *cr,
+          int                 width_px,
+          int                 height_px,
+          guint               n_rows,
+          plot_rows_func_t    rows_func,
+          plot_labels_func_t  labels_func,
+          gpointer            user_data);
+
+/*!
+ * \brief
+ * Finds the row drawn at a horizontal position
+ *
+ * \param[in] plot    the plot
+ * \param[in] x       the position in pixels, as in the last plot_draw()
+ * \param[in] n_rows  the number of rows
+ *
+ * \return
+ * the number of the row, or -1 if there is no row at \p x
+ */
+gint
+plot_get_row_at(const plot_t *plot, gdouble x, guint n_rows);
+
+/*!
+ * \brief
+ * Frees the surface of a plot
+ *
+ * \param[in] plot  the plot
+ */
+void
+plot_finish(plot_t *plot);
+
+#endif /* PLOT_H */
@@ -0,0 +1,758 @@
+/*!
+ * \file positions.c
+ * \brief
+ * Indexes the positions of recorded games with a pool of worker threads, and
+ * keeps the index in a file sorted by key.
+ */
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "positions.h"
+#include "cache.h"
+#include "gamelog.h"
+#include "gui.h"
+#include "protocol.h"
+#include "rules.h"
+#include "session.h"
+#include "transcript.h"
+
+/*! \brief Name of the default index file, in #CACHE_DIR */
+#define POSITIONS_FILE "positions.index"
+
+/* documented in positions.h */
+struct positions {
+  /*! \brief Protects the other members while files are indexed */
+  GMutex     mutex;
+  /*! \brief The index file */
+  gchar     *path;
+  /*! \brief The absolute name of each file, or \c NULL for a file whose
+             rows are forgotten */
+  GPtrArray *files;
+  /*! \brief The ::positions_entry_t of each row (in host order) */
+  GArray    *entries;
+  /*! \brief Number of entries at the beginning that are sorted by key */
+  guint      n_sorted;
+  /*! \brief Whether anything was added since the file was read */
+  gboolean   is_changed;
+};
+
+/*!
+ * \brief
+ * The rows of a file as they are read, numbered as append_text() numbers
+ * them: a row holds the output of one client until another client writes
+ */
+typedef struct {
+  /*! \brief The function that receives the message of each row */
+  positions_row_func_t  func;
+  /*! \brief Data to pass to #func */
+  gpointer              user_data;
+  /*! \brief The current row, or -1 before the first output */
+  gint                  row;
+  /*! \brief The client of the current row */
+  guint8                client_id;
+  /*! \brief The stdout text of the current row */
+  GString              *text;
+} rows_t;
+
+/*! \brief State shared between the worker threads */
+typedef struct {
+  /*! \brief The index, whose mutex also protects #error */
+  positions_t *positions;
+  /*! \brief The error of the first file that couldn't be read, or \c NULL */
+  GError      *error;
+} index_state_t;
+
+/*!
+ * \brief
+ * Passes the message of the current row on, if it holds a valid one
+ *
+ * \param[in,out] rows  the rows
+ */
+static void
+finish_row(rows_t * const rows)
+{
+  message_t message;
+
+  if (rows->row >= 0 && parse_message(rows->text->str, &message)) {
+    rows->func(rows->row, &message, rows->user_data);
+  }
+}
+
+/*!
+ * \brief
+ * Feeds output of a client to the rows
+ *
+ * \param[in,out] rows        the rows
+ * \param[in]     channel_id  the channel of the output
+ * \param[in]     text        the output
+ * \param[in]     len         the length of \p text in bytes
+ */
+static void
+feed_rows(rows_t * const      rows,
+          const guint8        channel_id,
+          const gchar * const text,
+          const gsize         len)
+{
+  if (rows->row < 0 || CLIENT_ID(channel_id) != rows->client_id) {
+    finish_row(rows);
+    ++rows->row;
+    rows->client_id = CLIENT_ID(channel_id);
+    g_string_truncate(rows->text, 0);
+  }
+  if (IS_STDOUT(channel_id)) g_string_append_len(rows->text, text, len);
+}
+
+/* documented in positions.h */
+gboolean
+positions_read_file(const gchar          *path,
+                    positions_row_func_t  func,
+                    gpointer              user_data,
+                    GError              **error)
+{
+  rows_t rows = { func, user_data, -1, 0, g_string_new(NULL) };
+  GError *read_error = NULL;
+  session_t *session;
+
+  if ((session = session_open(path, NULL)) != NULL) {
+    for (guint64 n = 0; n < session_get_n_moves(session); ++n) {
+      const session_record_t * const record =
+        session_get_record(session, n);
+      /* a corrupt record ends the session, as if it was never closed */
+      if (record == NULL) break;
+      for (guint8 type = STDOUT; type <= STDERR; ++type) {
+        gsize length;
+        const gchar * const text = session_get_blob(session, record, type,
+                                                    &length);
+        if (length > 0) {
+          feed_rows(&rows, CHANNEL_ID(record->client_id, type), text,
+                    length);
+        }
+      }
+    }
+    session_close(session);
+  } else if (g_str_has_suffix(path, ".pdn") ||
+             g_str_has_suffix(path, ".PDN")) {
+    gamelog_t * const log = gamelog_open(path, &read_error);
+    gchar *line;
+
+    while (log != NULL && (line = gamelog_read(log, &read_error)) != NULL) {
+      message_t message;
+      /* the players take turns as in a replay */
+      if (parse_message(line, &message)) {
+        feed_rows(&rows,
+                  CHANNEL_ID(message.next_player == 'r' ? 0 : 1, STDOUT),
+                  line, strlen(line));
+      }
+      g_free(line);
+    }
+    if (log != NULL) gamelog_close(log);
+  } else {
+    transcript_reader_t * const reader =
+      transcript_reader_open(path, &read_error);
+    const gchar *text;
+    guint8 channel_id;
+    gsize len;
+    reply_stats_t stats;
+
+    while (reader != NULL &&
+           (text = transcript_reader_next(reader, &channel_id, &len,
+                                          &stats)) != NULL) {
+      feed_rows(&rows, channel_id, text, len);
+    }
+    if (reader != NULL) transcript_reader_close(reader);
+  }
+  finish_row(&rows);
+  g_string_free(rows.text, TRUE);
+
+  if (read_error != NULL) {
+    g_propagate_error(error, read_error);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Appends the board of a row to an array of entries, following the signature
+ * of ::positions_row_func_t
+ *
+ * \param[in] row        the row
+ * \param[in] message    the message of the row
+ * \param[in] user_data  the array of ::positions_entry_t, without file
+ */
+static void
+add_entry(const guint32           row,
+          const message_t * const message,
+          const gpointer          user_data)
+{
+  GArray * const entries = user_data;
+  position_t position;
+
+  if (get_position(message, &position)) {
+    positions_entry_t entry;
+    entry.key = get_position_key(&position);
+    entry.file = 0;
+    entry.row = row;
+    g_array_append_val(entries, entry);
+  }
+}
+
+/*!
+ * \brief
+ * Indexes a file, following the signature of \c GFunc
+ *
+ * \param[in] data       the file name, which is freed
+ * \param[in] user_data  the ::index_state_t
+ */
+static void
+index_job(gpointer data, gpointer user_data)
+{
+  gchar * const path = data;
+  index_state_t * const state = user_data;
+  GArray * const entries = g_array_new(FALSE, FALSE,
+                                       sizeof(positions_entry_t));
+  GError *error = NULL;
+
+  if (positions_read_file(path, add_entry, entries, &error)) {
+    const guint32 file = positions_begin_file(state->positions, path);
+    g_mutex_lock(&state->positions->mutex);
+    for (guint i = 0; i < entries->len; ++i) {
+      g_array_index(entries, positions_entry_t, i).file = file;
+    }
+    g_array_append_vals(state->positions->entries, entries->data,
+                        entries->len);
+    g_mutex_unlock(&state->positions->mutex);
+  } else {
+    g_mutex_lock(&state->positions->mutex);
+    if (state->error == NULL) {
+      state->error = error;
+      error = NULL;
+    }
+    g_mutex_unlock(&state->positions->mutex);
+    g_clear_error(&error);
+  }
+  g_array_free(entries, TRUE);
+  g_free(path);
+}
+
+/*!
+ * \brief
+ * Compares entries by key, then by file and row, following the signature of
+ * \c GCompareFunc
+ *
+ * \param[in] a  the first ::positions_entry_t
+ * \param[in] b  the second ::positions_entry_t
+ *
+ * \return
+ * a negative number, zero or a positive number if \p a is less than, equal
+ * to or greater than \p b
+ */
+static gint
+compare_entries(gconstpointer a, gconstpointer b)
+{
+  const positions_entry_t * const entry_a = a;
+  const positions_entry_t * const entry_b = b;
+
+  if (entry_a->key != entry_b->key) {
+    return entry_a->key < entry_b->key ? -1 : 1;
+  }
+  if (entry_a->file != entry_b->file) {
+    return entry_a->file < entry_b->file ? -1 : 1;
+  }
+  return (entry_a->row > entry_b->row) - (entry_a->row < entry_b->row);
+}
+
+/*!
+ * \brief
+ * Compares entries by file and row, following the signature of
+ * \c GCompareFunc
+ *
+ * \param[in] a  the first ::positions_entry_t
+ * \param[in] b  the second ::positions_entry_t
+ *
+ * \return
+ * as for compare_entries()
+ */
+static gint
+compare_rows(gconstpointer a, gconstpointer b)
+{
+  const positions_entry_t * const entry_a = a;
+  const positions_entry_t * const entry_b = b;
+
+  if (entry_a->file != entry_b->file) {
+    return entry_a->file < entry_b->file ? -1 : 1;
+  }
+  return (entry_a->row > entry_b->row) - (entry_a->row < entry_b->row);
+}
+
+/*!
+ * \brief
+ * Reads the file names and entries of an index file
+ *
+ * \param[in,out] positions  the index, whose #files and #entries are set
+ * \param[in]     data       the contents of the file
+ * \param[in]     length     the length of \p data in bytes
+ *
+ * \return
+ * whether the file is a valid position index
+ */
+static gboolean
+read_index(positions_t * const positions,
+           const gchar * const data,
+           const gsize         length)
+{
+  const positions_header_t * const header = (const positions_header_t *)data;
+  const gchar *names;
+  const positions_entry_t *entries;
+  guint64 names_size;
+  guint64 n_entries;
+  guint32 n_files;
+  gsize offset;
+
+  if (length < sizeof(*header) ||
+      memcmp(header->magic, POSITIONS_MAGIC, sizeof(header->magic)) != 0 ||
+      GUINT32_FROM_LE(header->version) != POSITIONS_VERSION) return FALSE;
+  n_files = GUINT32_FROM_LE(header->n_files);
+  names_size = GUINT64_FROM_LE(header->names_size);
+  n_entries = GUINT64_FROM_LE(header->n_entries);
+  if (names_size % 8 != 0 || names_size > length - sizeof(*header) ||
+      n_entries != (length - sizeof(*header) - names_size) /
+                   sizeof(positions_entry_t)) return FALSE;
+
+  names = data + sizeof(*header);
+  for (offset = 0; positions->files->len < n_files; ++offset) {
+    const gchar * const end = memchr(names + offset, 0, names_size - offset);
+    if (end == NULL) return FALSE;
+    g_ptr_array_add(positions->files, g_strdup(names + offset));
+    offset = end - names;
+  }
+
+  entries = (const positions_entry_t *)(names + names_size);
+  g_array_set_size(positions->entries, n_entries);
+  for (guint64 i = 0; i < n_entries; ++i) {
+    positions_entry_t * const entry =
+      &g_array_index(positions->entries, positions_entry_t, i);
+    memcpy(entry, &entries[i], sizeof(*entry));
+    entry->key = GUINT64_FROM_LE(entry->key);
+    entry->file = GUINT32_FROM_LE(entry->file);
+    entry->row = GUINT32_FROM_LE(entry->row);
+    if (entry->file >= n_files ||
+        (i > 0 && compare_entries(entry - 1, entry) > 0)) return FALSE;
+  }
+  positions->n_sorted = n_entries;
+  return TRUE;
+}
+
+/* documented in positions.h */
+positions_t *
+positions_open(const gchar *path, GError **error)
+{
+  positions_t *positions;
+  gchar *default_path = NULL;
+
+  assert(error == NULL || *error == NULL);
+
+  if (path == NULL) path = default_path = cache_get_path(POSITIONS_FILE);
+
+  positions = g_new0(positions_t, 1);
+  g_mutex_init(&positions->mutex);
+  positions->path = default_path != NULL ? default_path : g_strdup(path);
+  positions->files = g_ptr_array_new_with_free_func(g_free);
+  positions->entries = g_array_new(FALSE, FALSE, sizeof(positions_entry_t));
+
+  if (g_file_test(path, G_FILE_TEST_EXISTS)) {
+    gchar *data;
+    gsize length;
+    if (!g_file_get_contents(path, &data, &length, error)) {
+      positions_close(positions);
+      return NULL;
+    }
+    if (!read_index(positions, data, length)) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                  "\"%s\" isn't a position index", path);
+      g_free(data);
+      positions_close(positions);
+      return NULL;
+    }
+    g_free(data);
+  }
+  return positions;
+}
+
+/* documented in positions.h */
+gboolean
+positions_add_files(positions_t    *positions,
+                    gchar * const  *files,
+                    GError        **error)
+{
+  extern guint option_jobs;
+  index_state_t state;
+  GThreadPool *pool;
+
+  assert(positions != NULL);
+  assert(files != NULL);
+  assert(error == NULL || *error == NULL);
+
+  state.positions = positions;
+  state.error = NULL;
+  pool = g_thread_pool_new(index_job, &state,
+                           option_jobs > 0 ? (gint)option_jobs
+                                           : (gint)g_get_num_processors(),
+                           TRUE, error);
+  if (pool == NULL) return FALSE;
+
+  for (; *files != NULL; ++files) {
+    g_thread_pool_push(pool, g_strdup(*files), NULL);
+  }
+  /* wait for the queued files to be read */
+  g_thread_pool_free(pool, FALSE, TRUE);
+
+  if (state.error != NULL) {
+    g_propagate_error(error, state.error);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* documented in positions.h */
+guint32
+positions_begin_file(positions_t *positions, const gchar *file)
+{
+  gchar *path;
+  guint32 id;
+
+  assert(positions != NULL);
+  assert(file != NULL);
+
+  if (g_path_is_absolute(file)) {
+    path = g_strdup(file);
+  } else {
+    gchar * const dir = g_get_current_dir();
+    path = g_build_filename(dir, file, NULL);
+    g_free(dir);
+  }
+
+  g_mutex_lock(&positions->mutex);
+  /* the rows of the file are dropped when the index is saved */
+  for (guint i = 0; i < positions->files->len; ++i) {
+    gchar ** const name = (gchar **)&g_ptr_array_index(positions->files, i);
+    if (*name != NULL && strcmp(*name, path) == 0) {
+      g_free(*name);
+      *name = NULL;
+    }
+  }
+  id = positions->files->len;
+  g_ptr_array_add(positions->files, path);
+  positions->is_changed = TRUE;
+  g_mutex_unlock(&positions->mutex);
+  return id;
+}
+
+/* documented in positions.h */
+void
+positions_add(positions_t *positions,
+              guint32      file,
+              guint32      row,
+              guint64      key)
+{
+  positions_entry_t entry;
+
+  assert(positions != NULL);
+  assert(file < positions->files->len);
+
+  g_mutex_lock(&positions->mutex);
+  positions->is_changed = TRUE;
+  /* the entries of the file follow the sorted ones, in the order of the
+     rows, so a row that was added before is found near the end */
+  for (guint i = positions->entries->len; i > positions->n_sorted; --i) {
+    positions_entry_t * const added =
+      &g_array_index(positions->entries, positions_entry_t, i - 1);
+    if (added->file != file) continue;
+    if (added->row < row) break;
+    if (added->row == row) {
+      added->key = key;
+      g_mutex_unlock(&positions->mutex);
+      return;
+    }
+  }
+  entry.key = key;
+  entry.file = file;
+  entry.row = row;
+  g_array_append_val(positions->entries, entry);
+  g_mutex_unlock(&positions->mutex);
+}
+
+/* documented in positions.h */
+GArray *
+positions_find(const positions_t *positions, guint64 key)
+{
+  GArray *found;
+  const positions_entry_t *entries;
+  guint low = 0;
+  guint high;
+
+  assert(positions != NULL);
+
+  found = g_array_new(FALSE, FALSE, sizeof(positions_entry_t));
+  entries = (const positions_entry_t *)positions->entries->data;
+  high = positions->n_sorted;
+  /* binary search for the first entry of the key among the sorted ones */
+  while (low < high) {
+    const guint middle = low + (high - low) / 2;
+    if (entries[middle].key < key) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  /* then the entries of the key, and those added since */
+  for (guint i = low; i < positions->entries->len; ++i) {
+    if (entries[i].key != key) {
+      if (i < positions->n_sorted) i = positions->n_sorted - 1;
+      continue;
+    }
+    if (g_ptr_array_index(positions->files, entries[i].file) != NULL) {
+      g_array_append_val(found, entries[i]);
+    }
+  }
+  g_array_sort(found, compare_rows);
+  return found;
+}
+
+/* documented in positions.h */
+const gchar *
+positions_get_file(const positions_t *positions, guint32 file)
+{
+  assert(positions != NULL);
+  assert(file < positions->files->len);
+
+  return g_ptr_array_index(positions->files, file);
+}
+
+/*!
+ * \brief
+ * Adds the files of the index file that another process saved since the
+ * index was read, along with their entries
+ *
+ * A file that the index already has keeps its own entries.
+ *
+ * \param[in,out] positions  the index
+ */
+static void
+merge_saved(positions_t * const positions)
+{
+  positions_t saved;
+  GHashTable *names;
+  guint32 *ids;
+  gchar *data;
+  gsize length;
+
+  if (!g_file_get_contents(positions->path, &data, &length, NULL)) return;
+  memset(&saved, 0, sizeof(saved));
+  saved.files = g_ptr_array_new_with_free_func(g_free);
+  saved.entries = g_array_new(FALSE, FALSE, sizeof(positions_entry_t));
+  if (read_index(&saved, data, length)) {
+    names = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < positions->files->len; ++i) {
+      gchar * const name = g_ptr_array_index(positions->files, i);
+      if (name != NULL) g_hash_table_add(names, name);
+    }
+    ids = g_new(guint32, saved.files->len);
+    for (guint i = 0; i < saved.files->len; ++i) {
+      gchar * const name = g_ptr_array_index(saved.files, i);
+      if (g_hash_table_contains(names, name)) {
+        ids[i] = G_MAXUINT32;
+      } else {
+        ids[i] = positions->files->len;
+        g_ptr_array_add(positions->files, g_strdup(name));
+      }
+    }
+    for (guint i = 0; i < saved.entries->len; ++i) {
+      positions_entry_t entry =
+        g_array_index(saved.entries, positions_entry_t, i);
+      if (ids[entry.file] == G_MAXUINT32) continue;
+      entry.file = ids[entry.file];
+      g_array_append_val(positions->entries, entry);
+    }
+    g_free(ids);
+    g_hash_table_destroy(names);
+  }
+  g_ptr_array_free(saved.files, TRUE);
+  g_array_free(saved.entries, TRUE);
+  g_free(data);
+}
+
+/* documented in positions.h */
+gboolean
+positions_save(positions_t *positions, GError **error)
+{
+  static const gchar padding[8] = { 0 };
+  positions_header_t header;
+  guint32 *ids;
+  GArray *entries;
+  GString *names;
+  gchar *lock_path;
+  gchar *temp_path;
+  gboolean success = TRUE;
+  FILE *file;
+  int lock;
+
+  assert(positions != NULL);
+  assert(error == NULL || *error == NULL);
+
+  if (!positions->is_changed) return TRUE;
+
+  /* other processes that save the same index wait for this one, and then
+     merge what it saved */
+  lock_path = g_strconcat(positions->path, ".lock", NULL);
+  lock = g_open(lock_path, O_RDWR | O_CREAT, 0644);
+  if (lock < 0 || flock(lock, LOCK_EX) != 0) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't lock the position index \"%s\"", lock_path);
+    if (lock >= 0) close(lock);
+    g_free(lock_path);
+    return FALSE;
+  }
+  g_free(lock_path);
+  merge_saved(positions);
+  ids = g_new(guint32, positions->files->len + 1);
+
+  /* the files whose rows are forgotten are left out, and the others
+     numbered again */
+  names = g_string_new(NULL);
+  memset(&header, 0, sizeof(header));
+  for (guint i = 0; i < positions->files->len; ++i) {
+    const gchar * const name = g_ptr_array_index(positions->files, i);
+    if (name == NULL) continue;
+    ids[i] = header.n_files++;
+    g_string_append_len(names, name, strlen(name) + 1);
+  }
+  g_string_append_len(names, padding, -names->len & 7);
+  entries = g_array_sized_new(FALSE, FALSE, sizeof(positions_entry_t),
+                              positions->entries->len);
+  for (guint i = 0; i < positions->entries->len; ++i) {
+    positions_entry_t entry =
+      g_array_index(positions->entries, positions_entry_t, i);
+    if (g_ptr_array_index(positions->files, entry.file) == NULL) continue;
+    entry.file = ids[entry.file];
+    g_array_append_val(entries, entry);
+  }
+  g_array_sort(entries, compare_entries);
+
+  /* the new index replaces the old one once it's complete */
+  temp_path = g_strconcat(positions->path, ".tmp", NULL);
+  file = g_fopen(temp_path, "wb");
+  if (file == NULL) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't create the position index \"%s\"", temp_path);
+    success = FALSE;
+  } else {
+    memcpy(header.magic, POSITIONS_MAGIC, sizeof(header.magic));
+    header.version = GUINT32_TO_LE(POSITIONS_VERSION);
+    header.n_files = GUINT32_TO_LE(header.n_files);
+    header.names_size = GUINT64_TO_LE(names->len);
+    header.n_entries = GUINT64_TO_LE(entries->len);
+    success &= fwrite(&header, sizeof(header), 1, file) == 1;
+    success &= fwrite(names->str, 1, names->len, file) == names->len;
+    for (guint i = 0; i < entries->len; ++i) {
+      positions_entry_t entry =
+        g_array_index(entries, positions_entry_t, i);
+      entry.key = GUINT64_TO_LE(entry.key);
+      entry.file = GUINT32_TO_LE(entry.file);
+      entry.row = GUINT32_TO_LE(entry.row);
+      success &= fwrite(&entry, sizeof(entry), 1, file) == 1;
+    }
+    if (fclose(file) != 0) success = FALSE;
+    if (success && g_rename(temp_path, positions->path) != 0) {
+      success = FALSE;
+    }
+    if (!success) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                  "Couldn't write the position index \"%s\"",
+                  positions->path);
+      g_unlink(temp_path);
+    }
+  }
+  g_free(temp_path);
+
+  if (success) {
+    /* number the files as in the saved index */
+    GPtrArray * const files = g_ptr_array_new_with_free_func(g_free);
+    for (guint i = 0; i < positions->files->len; ++i) {
+      gchar ** const name =
+        (gchar **)&g_ptr_array_index(positions->files, i);
+      if (*name == NULL) continue;
+      g_ptr_array_add(files, *name);
+      *name = NULL;
+    }
+    g_ptr_array_free(positions->files, TRUE);
+    positions->files = files;
+    g_array_free(positions->entries, TRUE);
+    positions->entries = entries;
+    positions->n_sorted = entries->len;
+    positions->is_changed = FALSE;
+  } else {
+    g_array_free(entries, TRUE);
+  }
+  g_string_free(names, TRUE);
+  g_free(ids);
+  /* releases the lock */
+  close(lock);
+  return success;
+}
+
+/* documented in positions.h */
+void
+positions_close(positions_t *positions)
+{
+  if (positions == NULL) return;
+
+  g_mutex_clear(&positions->mutex);
+  g_free(positions->path);
+  g_ptr_array_free(positions->files, TRUE);
+  g_array_free(positions->entries, TRUE);
+  g_free(positions);
+}
+
+/* documented in positions.h */
+gboolean
+run_index(gchar * const *args, GError **error)
+{
+  extern gchar *option_positions;
+  positions_t *positions;
+  guint n_files = 0;
+  guint n_added;
+  gint64 start_us;
+  gboolean success;
+
+  assert(args != NULL);
+  assert(error == NULL || *error == NULL);
+
+  if (args[0] == NULL) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Expected " POSITIONS_COMMAND " FILE...");
+    return FALSE;
+  }
+  positions = positions_open(option_positions, error);
+  if (positions == NULL) return FALSE;
+
+  start_us = g_get_monotonic_time();
+  n_added = positions->entries->len;
+  while (args[n_files] != NULL) ++n_files;
+  success = positions_add_files(positions, args, error);
+  n_added = positions->entries->len - n_added;
+  /* the files that were read are kept even if another one failed */
+  if (!positions_save(positions, success ? error : NULL)) success = FALSE;
+  printf("Indexed %u rows of %u files in %.3f s, %u rows in the index\n",
+         n_added, n_files,
+         (g_get_monotonic_time() - start_us) / 1e6,
+         positions->entries->len);
+  positions_close(positions);
+  return success;
+}
@@ -0,0 +1,225 @@
+/*!
+ * \file positions.h
+ * \brief
+ * Provides an index of the positions reached in recorded games, kept on disk
+ * between runs, which finds every game and row where a board occurred
+ */
+#ifndef POSITIONS_H
+#define POSITIONS_H
+
+#include <gtk/gtk.h>
+#include "protocol.h"
+
+/*! \brief The word on the command line that adds files to the index */
+#define POSITIONS_COMMAND "index"
+
+/*! \brief The first eight bytes of every position index file */
+#define POSITIONS_MAGIC "CKVPIDX"
+
+/*! \brief The version of the file format written by this program */
+#define POSITIONS_VERSION 1
+
+/*!
+ * \brief
+ * Header at the beginning of a position index file (all integers
+ * little-endian)
+ *
+ * The header is followed by the names of the indexed files, each terminated
+ * by a zero and padded together to a multiple of eight bytes, and then by a
+ * ::positions_entry_t for each row, sorted by key.
+ */
+typedef struct {
+  /*! \brief #POSITIONS_MAGIC including the terminating zero */
+  gchar   magic[8];
+  /*! \brief #POSITIONS_VERSION of the writer */
+  guint32 version;
+  /*! \brief Number of indexed files */
+  guint32 n_files;
+  /*! \brief Number of bytes of the file names, including the padding */
+  guint64 names_size;
+  /*! \brief Number of entries */
+  guint64 n_entries;
+} positions_header_t;
+
+/*! \brief One row of an indexed file where a position occurred */
+typedef struct {
+  /*! \brief The key of the position, from get_position_key() */
+  guint64 key;
+  /*! \brief The number of the file, in the order of the names */
+  guint32 file;
+  /*! \brief The row of the board in the list when the file is loaded */
+  guint32 row;
+} positions_entry_t;
+
+/*!
+ * \brief
+ * Function that receives the message of a row of a file
+ *
+ * \param[in] row        the row, as numbered when the file is loaded in the
+ *                       window
+ * \param[in] message    the message of the row
+ * \param[in] user_data  the data given to positions_read_file()
+ */
+typedef void (*positions_row_func_t)(guint32          row,
+                                     const message_t *message,
+                                     gpointer         user_data);
+
+/*! \brief A position index (private to positions.c) */
+typedef struct positions positions_t;
+
+/*!
+ * \brief
+ * Reads the rows of a session, transcript or PDN file in the same way as the
+ * window loads them, and passes on the message of each row that holds one
+ *
+ * \param[in] path       the file name
+ * \param[in] func       the function to pass the messages to
+ * \param[in] user_data  data to pass to \p func
+ * \param[in] error      as for positions_open()
+ *
+ * \return
+ * whether the file was read
+ */
+gboolean
+positions_read_file(const gchar          *path,
+                    positions_row_func_t  func,
+                    gpointer              user_data,
+                    GError              **error);
+
+/*!
+ * \brief
+ * Reads a position index
+ *
+ * \param[in] path   the index file, which is created when the index is
+ *                   saved if it doesn't exist, or \c NULL for one in the
+ *                   user's cache directory
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * the index, or \c NULL if the file couldn't be read
+ */
+positions_t *
+positions_open(const gchar *path, GError **error);
+
+/*!
+ * \brief
+ * Indexes the rows of session, transcript and PDN files, replacing the rows
+ * of any of them that were indexed before
+ *
+ * The files are read in the worker threads set by option \c -j. The rows
+ * are numbered as when the file is loaded in the window.
+ *
+ * \param[in] positions  the index
+ * \param[in] files      a \c NULL-terminated array of file names
+ * \param[in] error      as for positions_open(), set for the first file
+ *                       that couldn't be read (the others are still
+ *                       indexed)
+ *
+ * \return
+ * whether every file was read
+ */
+gboolean
+positions_add_files(positions_t    *positions,
+                    gchar * const  *files,
+                    GError        **error);
+
+/*!
+ * \brief
+ * Starts indexing a file row by row, forgetting its rows that were indexed
+ * before
+ *
+ * \param[in] positions  the index
+ * \param[in] file       the file name
+ *
+ * \return
+ * the number of the file, to pass to positions_add()
+ */
+guint32
+positions_begin_file(positions_t *positions, const gchar *file);
+
+/*!
+ * \brief
+ * Adds a row of a file to the index, or changes the key of a row that was
+ * added before, as when the board of the row is completed
+ *
+ * The rows of a file are added in order.
+ *
+ * \param[in] positions  the index
+ * \param[in] file       the number from positions_begin_file()
+ * \param[in] row        the row
+ * \param[in] key        the key of the board, from get_position_key()
+ */
+void
+positions_add(positions_t *positions,
+              guint32      file,
+              guint32      row,
+              guint64      key);
+
+/*!
+ * \brief
+ * Finds the rows where a position occurred
+ *
+ * \param[in] positions  the index
+ * \param[in] key        the key of the position
+ *
+ * \return
+ * an array of ::positions_entry_t sorted by file and row, which should be
+ * freed by the caller
+ */
+GArray *
+positions_find(const positions_t *positions, guint64 key);
+
+/*!
+ * \brief
+ * Gets the name of an indexed file
+ *
+ * \param[in] positions  the index
+ * \param[in] file       the number of the file
+ *
+ * \return
+ * the name, which is owned by \p positions
+ */
+const gchar *
+positions_get_file(const positions_t *positions, guint32 file);
+
+/*!
+ * \brief
+ * Writes the index back to its file if anything was added
+ *
+ * The file is locked while it's written, and the files that another process
+ * has saved to it since it was read are merged in first.
+ *
+ * \param[in] positions  the index
+ * \param[in] error      as for positions_open()
+ *
+ * \return
+ * whether the index was written (or didn't need to be)
+ */
+gboolean
+positions_save(positions_t *positions, GError **error);
+
+/*!
+ * \brief
+ * Frees a position index without saving it
+ *
+ * \param[in] positions  the index (or \c NULL)
+ */
+void
+positions_close(positions_t *positions);
+
+/*!
+ * \brief
+ * Adds files to the index given by option \c -p, and saves it
+ *
+ * \param[in] args   a \c NULL-terminated array of file names
+ * \param[in] error  as for positions_open()
+ *
+ * \return
+ * whether every file was indexed and the index was saved
+ */
+gboolean
+run_index(gchar * const *args, GError **error);
+
+#endif /* POSITIONS_H */
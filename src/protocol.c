@@ -0,0 +1,196 @@
+/*!
+ * \file protocol.c
+ * \brief
+ * Parses the messages that the clients send to each other.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "protocol.h"
+#include "gui.h"
+
+/* documented in protocol.h */
+gboolean
+parse_client_stdout(gchar   *move_line,
+                    gchar  **board,
+                    GSList **moves,
+                    gchar  **description,
+                    gchar  **player)
+{
+  gchar **split_line;
+  guint n_squares;
+  int action;
+
+  assert(board != NULL && *board == NULL);
+  assert(moves != NULL && *moves == NULL);
+  assert(description != NULL && *description == NULL);
+  assert(player != NULL && *player == NULL);
+
+  if (move_line == NULL) return FALSE;
+
+  /* split_line needs to be freed before every return statement */
+  split_line = g_strsplit(move_line, " ", 0);
+
+  /* we need at least the three first sequences to parse */
+  if (g_strv_length(split_line) < 3) {
+    g_strfreev(split_line);
+    return FALSE;
+  }
+
+  /* the first sequence needs to correspond to the board size */
+  if (strlen(split_line[0]) != NUM_DARK_SQ) {
+    g_strfreev(split_line);
+    return FALSE;
+  }
+
+  {
+    gchar **strv_moves;
+    /* strv_moves needs to be freed before leaving this block */
+    strv_moves = g_strsplit(split_line[1], "_", 0);
+    n_squares = g_strv_length(strv_moves);
+
+    /* str_action should be non-empty, and thus strv_moves as well */
+    assert(n_squares != 0);
+
+    action = atoi(strv_moves[0]);
+
+    /* the action identifier is not one of the squares */
+    --n_squares;
+
+    /* verify that the action is legal and that it has a corresponding
+       number of moves in the sequence */
+    if ((action  < -5) ||
+        (action  <  0  &&  n_squares != 0) ||
+        (action ==  0  &&  n_squares != 2) ||
+        (action  >  0  &&  n_squares != 1 + (guint)action)) {
+      g_strfreev(strv_moves);
+      g_strfreev(split_line);
+      return FALSE;
+    }
+
+    /* early return if this is a special action */
+    if (action < 0) {
+      static const gchar * const special_actions[5] = {
+        "Initial setup", /* -1 */
+        "Red wins",      /* -2 */
+        "White wins",    /* -3 */
+        "Draw",          /* -4 */
+        "Null move",     /* -5 */
+      };
+
+      *description = g_strdup(special_actions[-1-action]);
+      *board = g_strdup(split_line[0]);
+      g_strfreev(strv_moves);
+      g_strfreev(split_line);
+      return TRUE;
+    }
+
+    /* read the integers from the array of squares */
+    /* read backwards, since prepending the linked list is cheaper */
+    for (guint i = n_squares; i != 0; --i) {
+      const int sq = atoi(strv_moves[i]);
+
+      /* verify that the number is in range, otherwise quit */
+      if (sq < 1 || sq > NUM_DARK_SQ) {
+        /* illegal value, restore and abort */
+        g_slist_free(*moves);
+        *moves = NULL;
+        g_strfreev(strv_moves);
+        g_strfreev(split_line);
+        return FALSE;
+      }
+      assert(sq > 0);
+      *moves = g_slist_prepend(*moves, GUINT_TO_POINTER((guint)sq - 1));
+    }
+    g_strfreev(strv_moves);
+  }
+
+  *player = g_strdup(strcmp(split_line[2], "r") == 0 ? "[W]" : "[R]");
+  *board = g_strdup(split_line[0]);
+
+  /* generate the description string and the list of moves */
+  {
+    GSList *move = *moves;
+    /* moves are written "A-B", and jumps "AxB", "AxBxC", ... */
+    const gchar * const append_string = (action == 0) ? "-%u" : "x%u";
+
+    /* a reasonable starting length is the length of the input string */
+    GString *desc = g_string_sized_new(strlen(split_line[1]));
+    guint old;
+
+    /* there should be at least two squares in the list */
+    assert(move != NULL);
+    old = GPOINTER_TO_UINT(move->data);
+
+    /* write the first value, without leading "-" or "x" */
+    g_string_append_printf(desc, "%u", old + 1);
+
+    while ((move = g_slist_next(move)) != NULL) {
+      const guint new = GPOINTER_TO_UINT(move->data);
+      g_string_append_printf(desc, append_string, new + 1);
+
+      /* figure out which square we're jumping over, and mark it "x" */
+      if (action > 0) (*board)[(old + new)/2 + ((new&4) == 0)] = 'x';
+
+      old = new;
+    }
+    /* free the GString but keep the character data */
+    *description = g_string_free(desc, FALSE);
+  }
+
+  g_strfreev(split_line);
+  return TRUE;
+}
+
+/* documented in protocol.h */
+gboolean
+parse_message(const gchar *line, message_t *message)
+{
+  const gchar *p = line;
+  gchar *end;
+  glong value;
+
+  assert(message != NULL);
+
+  if (line == NULL) return FALSE;
+
+  /* the board is exactly one word of NUM_DARK_SQ characters */
+  for (guint8 i = 0; i < NUM_DARK_SQ; ++i) {
+    if (p[i] == ' ' || p[i] == '\0') return FALSE;
+    message->board[i] = p[i];
+  }
+  p += NUM_DARK_SQ;
+  if (*p++ != ' ') return FALSE;
+
+  /* action, followed by "_"-separated squares */
+  value = strtol(p, &end, 10);
+  if (end == p || value < -5 || value > MAX_SQUARES - 1) return FALSE;
+  message->action = value;
+  message->n_squares = 0;
+  p = end;
+  while (*p == '_') {
+    ++p;
+    value = strtol(p, &end, 10);
+    if (end == p || value < 1 || value > NUM_DARK_SQ ||
+        message->n_squares == MAX_SQUARES) return FALSE;
+    message->squares[message->n_squares++] = value - 1;
+    p = end;
+  }
+  if ((message->action  < 0 && message->n_squares != 0) ||
+      (message->action == 0 && message->n_squares != 2) ||
+      (message->action  > 0 &&
+       message->n_squares != 1 + message->action)) return FALSE;
+  if (*p++ != ' ') return FALSE;
+
+  /* next player and (optionally) the number of moves left */
+  if (*p == ' ' || *p == '\0' || *p == '\n') return FALSE;
+  message->next_player = *p++;
+  while (*p != ' ' && *p != '\0' && *p != '\n') ++p;
+  message->moves_left = 0;
+  if (*p == ' ') {
+    value = strtol(p + 1, NULL, 10);
+    message->moves_left = CLAMP(value, 0, G_MAXUINT8);
+  }
+  return TRUE;
+}
@@ -0,0 +1,112 @@
+/*!
+ * \file protocol.h
+ * \brief
+ * Provides functions to interpret the messages that the clients exchange
+ */
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <gtk/gtk.h>
+#include "gui.h"
+
+/*!
+ * \brief
+ * Gets the board row from a dark square index
+ */
+#define BOARD_ROW(i) ((i)/4)
+/*!
+ * \brief
+ * Gets the board column from a dark square index
+ *
+ * Use the three least significant bits, rotate them to the left and flip the
+ * least significant bit, so that \f$[b_4, b_3, b_2, b_1, b_0]\f$ becomes
+ * \f$[0, 0, b_1, b_0, !b_2]\f$, or in other words
+ * (given that rows and columns are both in the range `0..7`) map
+ *
+ * From (square id) | To (column id) | Row  | Column
+ * ---------------- | -------------- | ---: | ------
+ * xx000            | 00001          | even | 1
+ * xx001            | 00011          | even | 3
+ * xx010            | 00101          | even | 5
+ * xx011            | 00111          | even | 7
+ * xx100            | 00000          |  odd | 0
+ * xx101            | 00010          |  odd | 2
+ * xx110            | 00100          |  odd | 4
+ * xx111            | 00110          |  odd | 6
+ */
+#define BOARD_COL(i) ((((i)&3)<<1) | (((i)&4)==0))
+
+/*!
+ * \brief
+ * Gets the dark square index from a board row and column, which must refer
+ * to a dark square (i.e. the row and column can't both be even or both odd)
+ */
+#define BOARD_SQ(row, col) ((row)*4 + ((col)>>1))
+
+/*!
+ * \brief
+ * The largest number of squares in a move (a jump over nine pieces)
+ */
+#define MAX_SQUARES 10
+
+/*! \brief Number of moves left at the start of a game or after a jump */
+#define MOVES_LEFT 50
+
+/*!
+ * \brief
+ * A parsed message, in a compact form that doesn't need to be freed
+ */
+typedef struct {
+  /*! \brief Content of each dark square, as in the message (not terminated) */
+  gchar  board[NUM_DARK_SQ];
+  /*! \brief Action code (`-5..-1` for special actions, `0` for a move and
+             the number of jumped pieces for a jump) */
+  gint8  action;
+  /*! \brief Number of valid entries in #squares */
+  guint8 n_squares;
+  /*! \brief Dark squares (range `0..31`) visited by the move, in order */
+  guint8 squares[MAX_SQUARES];
+  /*! \brief The player to move next, \c r or \c w */
+  gchar  next_player;
+  /*! \brief Number of moves left before the game is drawn */
+  guint8 moves_left;
+} message_t;
+
+/*!
+ * \brief
+ * Parses a message into its compact form without allocating memory
+ *
+ * This is stricter than parse_client_stdout() and is intended for batch
+ * processing, where the description strings and lists aren't needed.
+ *
+ * \param[in]  line     the message (trailing whitespace is ignored)
+ * \param[out] message  the parsed message (undefined if parsing fails)
+ *
+ * \return
+ * whether the line was successfully parsed
+ */
+gboolean
+parse_message(const gchar *line, message_t *message);
+
+/*!
+ * \brief
+ * Parses the line that the client wrote to standard output
+ *
+ * \param[in]  move_line    the string to be parsed
+ * \param[out] board        the board setup described by the input
+ * \param[out] moves        the set of moves or jumps described by the input
+ * \param[out] description  a description of the move to display to the user
+ * \param[out] player       a string describing which player made the move, or
+ *                          \c NULL if it's a special move
+ *
+ * \return
+ * whether the line was successfully parsed
+ */
+gboolean
+parse_client_stdout(gchar   *move_line,
+                    gchar  **board,
+                    GSList **moves,
+                    gchar  **description,
+                    gchar  **player);
+
+#endif /* PROTOCOL_H */
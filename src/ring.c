@@ -0,0 +1,208 @@
+/*!
+ * \file ring.c
+ * \brief
+ * Implements the visualizer's end of the shared-memory transport.
+ */
+/*! \cond */
+#define _GNU_SOURCE
+/*! \endcond */
+#include <assert.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#endif
+#include <gtk/gtk.h>
+#include "ring.h"
+
+/*! \brief The visualizer's end of a transport */
+struct ring {
+  /*! \brief The shared memory */
+  ring_shared_t *shared;
+  /*! \brief File descriptor of the shared memory */
+  gint           memory_fd;
+  /*! \brief Counter that the visualizer increments after writing */
+  gint           to_client_fd;
+  /*! \brief Counter that the client increments after writing */
+  gint           from_client_fd;
+};
+
+/*!
+ * \brief
+ * Reads a ring counter that the other side updates
+ *
+ * \param[in] counter  the counter
+ *
+ * \return
+ * the value, with every write before it by the other side visible
+ */
+static guint32
+get_counter(guint32 * const counter)
+{
+  return (guint32)g_atomic_int_get((volatile gint *)counter);
+}
+
+/*!
+ * \brief
+ * Publishes a new value of a ring counter, after every write before it
+ *
+ * \param[in] counter  the counter
+ * \param[in] value    the value
+ */
+static void
+set_counter(guint32 * const counter, const guint32 value)
+{
+  g_atomic_int_set((volatile gint *)counter, (gint)value);
+}
+
+/* documented in ring.h */
+ring_t *
+ring_new(GError **error)
+{
+#ifdef __linux__
+  ring_t *ring;
+  void *memory;
+
+  assert(error == NULL || *error == NULL);
+
+  ring = g_slice_new(ring_t);
+  ring->memory_fd = memfd_create("checkers-ring", MFD_CLOEXEC);
+  ring->to_client_fd = eventfd(0, EFD_CLOEXEC);
+  ring->from_client_fd = eventfd(0, EFD_CLOEXEC);
+  ring->shared = NULL;
+  if (ring->memory_fd < 0 || ring->to_client_fd < 0 ||
+      ring->from_client_fd < 0 ||
+      ftruncate(ring->memory_fd, sizeof(ring_shared_t)) != 0 ||
+      (memory = mmap(NULL, sizeof(ring_shared_t), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, ring->memory_fd, 0)) == MAP_FAILED) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't create the shared memory for a client");
+    ring_free(ring);
+    return NULL;
+  }
+
+  /* the memory file starts out zeroed, so both rings are empty */
+  ring->shared = memory;
+  ring->shared->magic = RING_MAGIC;
+  ring->shared->size = RING_SIZE;
+  return ring;
+#else
+  g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+              "Shared memory for the clients is only supported on Linux");
+  return NULL;
+#endif
+}
+
+/* documented in ring.h */
+gchar *
+ring_get_env(const ring_t *ring)
+{
+  assert(ring != NULL);
+
+  return g_strdup_printf(RING_ENV "=%d,%d,%d", ring->memory_fd,
+                         ring->to_client_fd, ring->from_client_fd);
+}
+
+/* documented in ring.h */
+void
+ring_prepare_child(const ring_t *ring)
+{
+  assert(ring != NULL);
+
+  fcntl(ring->memory_fd, F_SETFD, 0);
+  fcntl(ring->to_client_fd, F_SETFD, 0);
+  fcntl(ring->from_client_fd, F_SETFD, 0);
+}
+
+/* documented in ring.h */
+gint
+ring_get_fd(const ring_t *ring)
+{
+  assert(ring != NULL);
+
+  return ring->from_client_fd;
+}
+
+/* documented in ring.h */
+gsize
+ring_write(ring_t *ring, const gchar *text, gsize len)
+{
+  ring_buffer_t *buffer;
+  guint32 head;
+  guint32 offset;
+  gsize first_len;
+  const guint64 one = 1;
+
+  assert(ring != NULL);
+  assert(text != NULL || len == 0);
+
+  buffer = &ring->shared->to_client;
+  head = buffer->head;
+  len = MIN(len, RING_SIZE - (head - get_counter(&buffer->tail)));
+  if (len == 0) return 0;
+
+  offset = head % RING_SIZE;
+  first_len = MIN(len, RING_SIZE - offset);
+  memcpy(buffer->data + offset, text, first_len);
+  memcpy(buffer->data, text + first_len, len - first_len);
+  set_counter(&buffer->head, head + len);
+
+  if (write(ring->to_client_fd, &one, sizeof(one)) != sizeof(one)) {
+    /* the counter can't overflow in practice, and the data is in place
+       for the next wakeup anyway */
+  }
+  return len;
+}
+
+/* documented in ring.h */
+gsize
+ring_read(ring_t *ring, gchar *buffer, gsize size)
+{
+  ring_buffer_t *from;
+  struct pollfd readable = { 0, POLLIN, 0 };
+  guint32 tail;
+  guint32 offset;
+  gsize len;
+  gsize first_len;
+  guint64 wakeups;
+
+  assert(ring != NULL);
+  assert(buffer != NULL);
+
+  /* the counter can only be read without blocking if it's nonzero */
+  readable.fd = ring->from_client_fd;
+  if (poll(&readable, 1, 0) == 1 && (readable.revents & POLLIN) != 0 &&
+      read(ring->from_client_fd, &wakeups, sizeof(wakeups)) < 0) {
+    /* nothing was reset, but the data is read regardless */
+  }
+
+  from = &ring->shared->from_client;
+  tail = from->tail;
+  len = MIN(size, (guint32)(get_counter(&from->head) - tail));
+  if (len == 0) return 0;
+
+  offset = tail % RING_SIZE;
+  first_len = MIN(len, RING_SIZE - offset);
+  memcpy(buffer, from->data + offset, first_len);
+  memcpy(buffer + first_len, from->data, len - first_len);
+  set_counter(&from->tail, tail + len);
+  return len;
+}
+
+/* documented in ring.h */
+void
+ring_free(ring_t *ring)
+{
+  if (ring == NULL) return;
+
+#ifdef __linux__
+  if (ring->shared != NULL) munmap(ring->shared, sizeof(ring_shared_t));
+#endif
+  if (ring->memory_fd >= 0) close(ring->memory_fd);
+  if (ring->to_client_fd >= 0) close(ring->to_client_fd);
+  if (ring->from_client_fd >= 0) close(ring->from_client_fd);
+  g_slice_free(ring_t, ring);
+}
@@ -0,0 +1,178 @@
+/*!
+ * \file ring.h
+ * \brief
+ * Provides a transport between the visualizer and a client over two ring
+ * buffers in shared memory, as an alternative to its stdin and stdout pipes
+ *
+ * A client opts in by looking for the environment variable #RING_ENV, which
+ * the visualizer sets (with option \c -Z) to three file descriptor numbers
+ * separated by commas, such as \c 3,4,5: a memory file holding a
+ * #ring_shared_t to map with \c mmap(MAP_SHARED), and two \c eventfd(2)
+ * counters. The first counter is incremented by the visualizer after it has
+ * written to ring_shared_t::to_client, and the second one should be
+ * incremented by the client after it has written to
+ * ring_shared_t::from_client. A client then reads its messages from one ring
+ * instead of stdin and writes its replies to the other one instead of stdout,
+ * while stderr stays a pipe.
+ *
+ * Each ring is a stream of bytes with a single writer and a single reader.
+ * The writer copies its data to <tt>data[head % RING_SIZE]</tt> onwards
+ * (wrapping around), and then increments \c head by the number of bytes with
+ * release semantics. The reader copies the data from
+ * <tt>data[tail % RING_SIZE]</tt> up to \c head (read with acquire
+ * semantics), and then increments \c tail likewise. The counters wrap
+ * around at 2^32, and \c head never gets more than #RING_SIZE ahead of
+ * \c tail. The visualizer drains ring_shared_t::from_client whenever its
+ * counter is incremented, so a client that finds the ring full can retry
+ * shortly after.
+ */
+#ifndef RING_H
+#define RING_H
+
+#include <gtk/gtk.h>
+
+/*! \brief Name of the environment variable that tells a client its rings */
+#define RING_ENV "CHECKERS_RING"
+
+/*! \brief Value of ring_shared_t::magic ("RING" in little-endian order) */
+#define RING_MAGIC 0x474e4952
+
+/*! \brief Size of the data of each ring in bytes (a power of two) */
+#define RING_SIZE (64 << 10)
+
+/*! \brief Assumed size of a cache line, which separates the counters */
+#define RING_CACHE_LINE 64
+
+/*!
+ * \brief
+ * One direction of the transport, in shared memory
+ *
+ * The counters are on separate cache lines, so that the writer and the
+ * reader don't invalidate each other's line with every update.
+ */
+typedef struct {
+  /*! \brief Number of bytes written, modulo 2^32 (updated by the writer) */
+  guint32 head;
+  /*! \brief Padding up to the next cache line */
+  guint8  padding_head[RING_CACHE_LINE - sizeof(guint32)];
+  /*! \brief Number of bytes read, modulo 2^32 (updated by the reader) */
+  guint32 tail;
+  /*! \brief Padding up to the next cache line */
+  guint8  padding_tail[RING_CACHE_LINE - sizeof(guint32)];
+  /*! \brief The data */
+  gchar   data[RING_SIZE];
+} ring_buffer_t;
+
+/*! \brief The shared memory of a client's transport (in host byte order) */
+typedef struct {
+  /*! \brief #RING_MAGIC */
+  guint32       magic;
+  /*! \brief #RING_SIZE */
+  guint32       size;
+  /*! \brief Padding up to the next cache line */
+  guint8        padding[RING_CACHE_LINE - 2*sizeof(guint32)];
+  /*! \brief The messages that the client receives */
+  ring_buffer_t to_client;
+  /*! \brief The messages that the client sends */
+  ring_buffer_t from_client;
+} ring_shared_t;
+
+/*! \brief The visualizer's end of a transport (private to ring.c) */
+typedef struct ring ring_t;
+
+/*!
+ * \brief
+ * Creates the shared memory and counters of a transport
+ *
+ * Their file descriptors are closed on \c exec() until ring_prepare_child()
+ * is called. Only supported on Linux.
+ *
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * the transport, or \c NULL on error
+ */
+ring_t *
+ring_new(GError **error);
+
+/*!
+ * \brief
+ * Formats the value of #RING_ENV for the client
+ *
+ * \param[in] ring  the transport
+ *
+ * \return
+ * a string such as "CHECKERS_RING=3,4,5", which should be freed by the caller
+ */
+gchar *
+ring_get_env(const ring_t *ring);
+
+/*!
+ * \brief
+ * Lets the client inherit the transport across \c exec()
+ *
+ * Only calls async-signal-safe functions, so that it can be called from a
+ * \c GSpawnChildSetupFunc.
+ *
+ * \param[in] ring  the transport
+ */
+void
+ring_prepare_child(const ring_t *ring);
+
+/*!
+ * \brief
+ * Gets the file descriptor that becomes readable when the client has written
+ * to its ring
+ *
+ * \param[in] ring  the transport
+ *
+ * \return
+ * the file descriptor, to be watched for \c G_IO_IN
+ */
+gint
+ring_get_fd(const ring_t *ring);
+
+/*!
+ * \brief
+ * Writes to the client's ring as much as fits, and wakes the client
+ *
+ * \param[in] ring  the transport
+ * \param[in] text  the data
+ * \param[in] len   the length of \p text in bytes
+ *
+ * \return
+ * the number of bytes written, which is less than \p len if the ring is full
+ */
+gsize
+ring_write(ring_t *ring, const gchar *text, gsize len);
+
+/*!
+ * \brief
+ * Reads what the client has written to its ring so far
+ *
+ * The counter of the client's wakeups is reset first, so that the file
+ * descriptor of ring_get_fd() stays readable only if more is written.
+ *
+ * \param[in]  ring    the transport
+ * \param[out] buffer  the buffer to read into
+ * \param[in]  size    the size of \p buffer in bytes
+ *
+ * \return
+ * the number of bytes read, which is zero if there was nothing to read
+ */
+gsize
+ring_read(ring_t *ring, gchar *buffer, gsize size);
+
+/*!
+ * \brief
+ * Unmaps the shared memory, closes the file descriptors and frees the
+ * transport
+ *
+ * \param[in] ring  the transport (or \c NULL)
+ */
+void
+ring_free(ring_t *ring);
+
+#endif /* RING_H */
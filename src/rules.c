@@ -0,0 +1,530 @@
+/*!
+ * \file rules.c
+ * \brief
+ * Checks moves against the rules, using a bitboard of the 32 dark squares.
+ */
+#include <assert.h>
+#include <gtk/gtk.h>
+#include "rules.h"
+#include "protocol.h"
+
+/*! \brief Number of diagonal directions */
+#define NUM_DIRECTIONS 4
+
+/*! \brief Number of kinds of pieces (men and kings of either player) */
+#define NUM_PIECE_KINDS 4
+
+/*! \brief Bits of the rows where red and white men are crowned */
+#define CROWNING_ROWS(player) ((player) == 'r' ? 0xf0000000u : 0x0000000fu)
+
+/*! \brief Squares that can be reached from each square and direction */
+typedef struct {
+  /*! \brief Bit of the neighbouring square, or zero at the edge */
+  guint32 step[NUM_DARK_SQ][NUM_DIRECTIONS];
+  /*! \brief Bit of the square two steps away, or zero past the edge */
+  guint32 jump[NUM_DARK_SQ][NUM_DIRECTIONS];
+  /*! \brief Number of the neighbouring square, where #step is nonzero */
+  guint8  step_sq[NUM_DARK_SQ][NUM_DIRECTIONS];
+  /*! \brief Number of the square two steps away, where #jump is nonzero */
+  guint8  jump_sq[NUM_DARK_SQ][NUM_DIRECTIONS];
+  /*! \brief Zobrist numbers of red men, red kings, white men and white
+             kings on each square */
+  guint64 keys[NUM_PIECE_KINDS][NUM_DARK_SQ];
+  /*! \brief Zobrist number of white being the player to move */
+  guint64 white_key;
+} tables_t;
+
+/*!
+ * \brief
+ * Gets the lookup tables, computing them on first use
+ *
+ * Directions 0 and 1 lead towards higher rows (forward for red), and 2 and 3
+ * towards lower rows (forward for white).
+ *
+ * \return
+ * the tables, which are kept until the program ends
+ */
+static const tables_t *
+get_tables(void)
+{
+  static tables_t tables;
+  static gsize is_initialized = 0;
+
+  if (g_once_init_enter(&is_initialized)) {
+    static const gint8 row_steps[NUM_DIRECTIONS] = { 1, 1, -1, -1 };
+    static const gint8 col_steps[NUM_DIRECTIONS] = { -1, 1, -1, 1 };
+
+    for (guint8 sq = 0; sq < NUM_DARK_SQ; ++sq) {
+      for (guint8 dir = 0; dir < NUM_DIRECTIONS; ++dir) {
+        for (guint8 n = 1; n <= 2; ++n) {
+          const gint row = BOARD_ROW(sq) + n*row_steps[dir];
+          const gint col = BOARD_COL(sq) + n*col_steps[dir];
+          const guint32 bit = row < 0 || row > 7 || col < 0 || col > 7 ? 0 :
+                              (guint32)1 << BOARD_SQ(row, col);
+          if (n == 1) {
+            tables.step[sq][dir] = bit;
+            tables.step_sq[sq][dir] = bit != 0 ? BOARD_SQ(row, col) : 0;
+          } else if (tables.step[sq][dir] != 0) {
+            tables.jump[sq][dir] = bit;
+            tables.jump_sq[sq][dir] = bit != 0 ? BOARD_SQ(row, col) : 0;
+          }
+        }
+      }
+    }
+    /* the same numbers in every run (from splitmix64 with a fixed seed),
+       so that keys can be kept in files */
+    {
+      guint64 state = G_GUINT64_CONSTANT(0x636865636b657273);
+      guint64 * const numbers = &tables.keys[0][0];
+      for (guint i = 0; i <= NUM_PIECE_KINDS * NUM_DARK_SQ; ++i) {
+        guint64 z = state += G_GUINT64_CONSTANT(0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * G_GUINT64_CONSTANT(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)) * G_GUINT64_CONSTANT(0x94d049bb133111eb);
+        z ^= z >> 31;
+        if (i < NUM_PIECE_KINDS * NUM_DARK_SQ) {
+          numbers[i] = z;
+        } else {
+          tables.white_key = z;
+        }
+      }
+    }
+    g_once_init_leave(&is_initialized, 1);
+  }
+  return &tables;
+}
+
+/*!
+ * \brief
+ * Reads a position from a board
+ *
+ * \param[in]  board     the board, as in #message_t
+ * \param[in]  player    the player to move, \c r or \c w
+ * \param[out] position  the position
+ *
+ * \return
+ * whether the board and player are valid
+ */
+static gboolean
+read_position(const gchar * const board,
+              const gchar         player,
+              position_t  * const position)
+{
+  guint32 red = 0;
+  guint32 white = 0;
+
+  position->kings = 0;
+  for (guint8 sq = 0; sq < NUM_DARK_SQ; ++sq) {
+    const guint32 bit = (guint32)1 << sq;
+    switch (board[sq]) {
+    case 'R': position->kings |= bit; /* FALLTHROUGH */
+    case 'r': red |= bit; break;
+    case 'W': position->kings |= bit; /* FALLTHROUGH */
+    case 'w': white |= bit; break;
+    case '.': break;
+    default: return FALSE;
+    }
+  }
+  if (player != 'r' && player != 'w') return FALSE;
+  position->own      = player == 'r' ? red : white;
+  position->opponent = player == 'r' ? white : red;
+  position->player   = player;
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Gets the directions that a piece may move in
+ *
+ * \param[in]  is_king  whether the piece is a king
+ * \param[in]  player   the player of the piece, \c r or \c w
+ * \param[out] first    the first direction
+ *
+ * \return
+ * the number of directions, starting at \p first
+ */
+static guint8
+get_directions(const gboolean is_king,
+               const gchar    player,
+               guint8 * const first)
+{
+  if (is_king) {
+    *first = 0;
+    return NUM_DIRECTIONS;
+  }
+  *first = player == 'r' ? 0 : 2;
+  return 2;
+}
+
+/*!
+ * \brief
+ * Finds the direction from one square to another
+ *
+ * \param[in] steps  the table of steps or jumps from the first square
+ * \param[in] bit    the bit of the second square
+ *
+ * \return
+ * the direction, or #NUM_DIRECTIONS if the square can't be reached
+ */
+static guint8
+find_direction(const guint32 steps[static NUM_DIRECTIONS], const guint32 bit)
+{
+  guint8 dir = 0;
+
+  while (dir < NUM_DIRECTIONS && steps[dir] != bit) ++dir;
+  return dir;
+}
+
+/*!
+ * \brief
+ * Checks whether a piece can jump
+ *
+ * \param[in] is_king   whether the piece is a king
+ * \param[in] player    the player of the piece, \c r or \c w
+ * \param[in] sq        the square of the piece
+ * \param[in] jumpable  the opponent's pieces that may be jumped over
+ * \param[in] empty     the empty squares
+ *
+ * \return
+ * whether the piece can jump
+ */
+static gboolean
+can_jump(const gboolean is_king,
+         const gchar    player,
+         const guint8   sq,
+         const guint32  jumpable,
+         const guint32  empty)
+{
+  const tables_t * const tables = get_tables();
+  guint8 first;
+  const guint8 n = get_directions(is_king, player, &first);
+
+  for (guint8 dir = first; dir < first + n; ++dir) {
+    if ((tables->step[sq][dir] & jumpable) != 0 &&
+        (tables->jump[sq][dir] & empty) != 0) return TRUE;
+  }
+  return FALSE;
+}
+
+/*!
+ * \brief
+ * Checks whether a message leaves a position that can be moved from
+ *
+ * \param[in] message  the message
+ *
+ * \return
+ * \c TRUE for a setup, a move, a jump or a null move, but not for a result
+ */
+static gboolean
+is_in_play(const message_t * const message)
+{
+  return message->action >= 0 || message->action == -1 ||
+         message->action == -5;
+}
+
+/* documented in rules.h */
+verdict_t
+check_move(const message_t *before, const message_t *move)
+{
+  const tables_t * const tables = get_tables();
+  const gchar player = before->next_player;
+  const guint8 last_row = player == 'r' ? 7 : 0;
+  position_t position;
+  position_t after;
+  guint32 from;
+  guint32 to;
+  guint32 empty;
+  guint32 captured = 0;
+  guint8 sq;
+  gboolean is_king;
+  gboolean is_crowned = FALSE;
+
+  assert(before != NULL);
+  assert(move != NULL);
+
+  if (move->action < 0 || !is_in_play(before) ||
+      !read_position(before->board, player, &position)) return VERDICT_LEGAL;
+
+  if (move->next_player == player) return VERDICT_WRONG_TURN;
+  sq = move->squares[0];
+  from = (guint32)1 << sq;
+  if ((position.own & from) == 0) return VERDICT_NOT_OWN_PIECE;
+  is_king = (position.kings & from) != 0;
+  /* the square that the piece leaves counts as empty, which matters to a
+     king that jumps around in a circle */
+  empty = ~(position.own | position.opponent) | from;
+
+  if (move->action == 0) {
+    guint8 first;
+    const guint8 n = get_directions(is_king, player, &first);
+    const guint8 dir =
+      find_direction(tables->step[sq], (guint32)1 << move->squares[1]);
+
+    if (dir < first || dir >= first + n ||
+        (tables->step[sq][dir] & empty) == 0) return VERDICT_BAD_STEP;
+    /* a step is only allowed if none of the pieces can jump (from where
+       they stand, so the square that the piece leaves is occupied) */
+    for (guint32 pieces = position.own; pieces != 0; pieces &= pieces - 1) {
+      const guint8 piece = g_bit_nth_lsf(pieces, -1);
+      if (can_jump((position.kings >> piece & 1) != 0, player, piece,
+                   position.opponent, empty & ~from)) {
+        return VERDICT_MISSED_JUMP;
+      }
+    }
+    sq = move->squares[1];
+    is_crowned = !is_king && BOARD_ROW(sq) == last_row;
+  } else {
+    for (guint8 i = 1; i < move->n_squares; ++i) {
+      guint8 first;
+      const guint8 n = get_directions(is_king, player, &first);
+      const guint8 dir =
+        find_direction(tables->jump[sq], (guint32)1 << move->squares[i]);
+
+      if (is_crowned) return VERDICT_JUMP_AFTER_CROWNING;
+      if (dir < first || dir >= first + n ||
+          (tables->jump[sq][dir] & empty) == 0 ||
+          (tables->step[sq][dir] & position.opponent & ~captured) == 0) {
+        return VERDICT_BAD_JUMP;
+      }
+      /* the jumped pieces stay on the board until the move is over, so
+         they can't be jumped again or landed on */
+      captured |= tables->step[sq][dir];
+      empty = (empty & ~tables->jump[sq][dir]) | (guint32)1 << sq;
+      sq = move->squares[i];
+      is_crowned = !is_king && BOARD_ROW(sq) == last_row;
+    }
+    if (!is_crowned &&
+        can_jump(is_king, player, sq, position.opponent & ~captured,
+                 empty)) return VERDICT_UNFINISHED_JUMP;
+  }
+
+  /* the board after the move must show exactly the move */
+  to = (guint32)1 << sq;
+  if (!read_position(move->board, player, &after) ||
+      after.own != ((position.own & ~from) | to) ||
+      after.opponent != (position.opponent & ~captured) ||
+      after.kings != ((position.kings & ~from & ~captured) |
+                      (is_king || is_crowned ? to : 0))) {
+    return VERDICT_WRONG_BOARD;
+  }
+  return VERDICT_LEGAL;
+}
+
+/* documented in rules.h */
+gboolean
+get_position(const message_t *message, position_t *position)
+{
+  assert(message != NULL);
+  assert(position != NULL);
+
+  return read_position(message->board, message->next_player, position);
+}
+
+/* documented in rules.h */
+void
+put_board(const position_t *position, gchar board[static NUM_DARK_SQ])
+{
+  const gboolean is_red = position->player == 'r';
+
+  assert(position != NULL);
+
+  for (guint8 sq = 0; sq < NUM_DARK_SQ; ++sq) {
+    const guint32 bit = (guint32)1 << sq;
+    gchar piece = '.';
+    if ((position->own & bit) != 0) {
+      piece = is_red ? 'r' : 'w';
+    } else if ((position->opponent & bit) != 0) {
+      piece = is_red ? 'w' : 'r';
+    }
+    board[sq] = (position->kings & bit) != 0 ? g_ascii_toupper(piece)
+                                              : piece;
+  }
+}
+
+/*!
+ * \brief
+ * Adds every way of continuing a jump to the moves
+ *
+ * \param[in]     position  the position before the jump
+ * \param[in]     is_king   whether the jumping piece is a king
+ * \param[in]     empty     the empty squares, which include the square that
+ *                          the piece left but not the squares of the pieces
+ *                          jumped over so far
+ * \param[in]     jump      the jump so far, with at least its first square
+ * \param[out]    moves     the moves
+ * \param[in,out] n_moves   the number of moves
+ */
+static void
+add_jumps(const position_t * const position,
+          const gboolean           is_king,
+          const guint32            empty,
+          const move_t   * const   jump,
+          move_t                   moves[static MAX_MOVES],
+          guint          * const   n_moves)
+{
+  const tables_t * const tables = get_tables();
+  const guint8 sq = jump->squares[jump->n_squares - 1];
+  const guint32 jumpable = position->opponent & ~jump->captured;
+  gboolean is_continued = FALSE;
+  guint8 first;
+  const guint8 n = get_directions(is_king, position->player, &first);
+
+  for (guint8 dir = first; dir < first + n; ++dir) {
+    move_t next;
+
+    if ((tables->step[sq][dir] & jumpable) == 0 ||
+        (tables->jump[sq][dir] & empty) == 0) continue;
+    is_continued = TRUE;
+    next = *jump;
+    next.captured |= tables->step[sq][dir];
+    next.to = tables->jump[sq][dir];
+    next.squares[next.n_squares++] = tables->jump_sq[sq][dir];
+    if (!is_king && (next.to & CROWNING_ROWS(position->player)) != 0) {
+      /* crowning ends the move */
+      if (*n_moves < MAX_MOVES) moves[(*n_moves)++] = next;
+    } else {
+      add_jumps(position, is_king,
+                (empty & ~next.to) | (guint32)1 << sq, &next, moves,
+                n_moves);
+    }
+  }
+  if (!is_continued && jump->n_squares > 1 && *n_moves < MAX_MOVES) {
+    moves[(*n_moves)++] = *jump;
+  }
+}
+
+/* documented in rules.h */
+guint
+generate_moves(const position_t *position, move_t moves[static MAX_MOVES])
+{
+  const tables_t * const tables = get_tables();
+  const guint32 empty = ~(position->own | position->opponent);
+  guint n_moves = 0;
+
+  assert(position != NULL);
+  assert(moves != NULL);
+
+  for (guint32 pieces = position->own; pieces != 0; pieces &= pieces - 1) {
+    const guint8 sq = g_bit_nth_lsf(pieces, -1);
+    move_t jump;
+    jump.from = jump.to = (guint32)1 << sq;
+    jump.captured = 0;
+    jump.n_squares = 1;
+    jump.squares[0] = sq;
+    add_jumps(position, (position->kings & jump.from) != 0,
+              empty | jump.from, &jump, moves, &n_moves);
+  }
+  if (n_moves > 0) return n_moves;
+
+  /* steps are only allowed if there are no jumps */
+  for (guint32 pieces = position->own; pieces != 0; pieces &= pieces - 1) {
+    const guint8 sq = g_bit_nth_lsf(pieces, -1);
+    guint8 first;
+    const guint8 n = get_directions((position->kings >> sq & 1) != 0,
+                                    position->player, &first);
+    for (guint8 dir = first; dir < first + n; ++dir) {
+      move_t * const move = &moves[n_moves];
+      if ((tables->step[sq][dir] & empty) == 0 ||
+          n_moves == MAX_MOVES) continue;
+      move->from = (guint32)1 << sq;
+      move->to = tables->step[sq][dir];
+      move->captured = 0;
+      move->n_squares = 2;
+      move->squares[0] = sq;
+      move->squares[1] = tables->step_sq[sq][dir];
+      ++n_moves;
+    }
+  }
+  return n_moves;
+}
+
+/* documented in rules.h */
+void
+make_move(const position_t *position, const move_t *move, position_t *after)
+{
+  const guint32 own = position->own;
+  const guint32 opponent = position->opponent;
+  guint32 kings = position->kings & ~move->captured;
+
+  assert(position != NULL);
+  assert(move != NULL);
+  assert(after != NULL);
+
+  if ((kings & move->from) != 0) {
+    kings = (kings & ~move->from) | move->to;
+  } else if ((move->to & CROWNING_ROWS(position->player)) != 0) {
+    kings |= move->to;
+  }
+  after->player = position->player == 'r' ? 'w' : 'r';
+  after->own = opponent & ~move->captured;
+  after->opponent = (own & ~move->from) | move->to;
+  after->kings = kings;
+}
+
+/* documented in rules.h */
+gchar *
+format_move(const move_t *move)
+{
+  GString * const text = g_string_new(NULL);
+
+  assert(move != NULL);
+
+  for (guint8 i = 0; i < move->n_squares; ++i) {
+    if (i > 0) g_string_append_c(text, move->captured != 0 ? 'x' : '-');
+    g_string_append_printf(text, "%u", move->squares[i] + 1);
+  }
+  return g_string_free(text, FALSE);
+}
+
+/* documented in rules.h */
+guint64
+get_position_key(const position_t *position)
+{
+  const tables_t * const tables = get_tables();
+  const gboolean is_red = position->player == 'r';
+  const guint32 red = is_red ? position->own : position->opponent;
+  const guint32 white = is_red ? position->opponent : position->own;
+  const guint32 kinds[NUM_PIECE_KINDS] = {
+    red & ~position->kings, red & position->kings,
+    white & ~position->kings, white & position->kings
+  };
+  guint64 key = is_red ? 0 : tables->white_key;
+
+  assert(position != NULL);
+
+  for (guint8 kind = 0; kind < NUM_PIECE_KINDS; ++kind) {
+    for (guint32 pieces = kinds[kind]; pieces != 0; pieces &= pieces - 1) {
+      key ^= tables->keys[kind][g_bit_nth_lsf(pieces, -1)];
+    }
+  }
+  return key;
+}
+
+/* documented in rules.h */
+guint
+count_bits(guint32 bits)
+{
+  bits = bits - ((bits >> 1) & 0x55555555u);
+  bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+  return (((bits + (bits >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24;
+}
+
+/* documented in rules.h */
+const gchar *
+get_verdict_description(verdict_t verdict)
+{
+  static const gchar * const descriptions[N_VERDICTS] = {
+    "is legal",
+    "doesn't pass the turn to the opponent",
+    "doesn't start on one of the player's pieces",
+    "isn't a step to an empty square diagonally ahead",
+    "isn't a jump over an opponent's piece to an empty square",
+    "misses a compulsory jump",
+    "stops while the jump can continue",
+    "continues after the man is crowned",
+    "leaves a board that doesn't follow from the move"
+  };
+
+  assert(verdict < N_VERDICTS);
+
+  return descriptions[verdict];
+}
@@ -0,0 +1,191 @@
+/*!
+ * \file rules.h
+ * \brief
+ * Provides a check of the moves that the clients make against the rules, and
+ * a move generator for the built-in engine
+ *
+ * The rules are those of English draughts as used by the judge: red moves
+ * first from squares 1-12 towards 29-32, men move and jump diagonally
+ * forward only, kings one square in any diagonal direction, jumping is
+ * compulsory and a jump must be continued while it can, and a man that
+ * reaches the far row is crowned, which ends the move. The number of moves
+ * left before a draw isn't checked.
+ */
+#ifndef RULES_H
+#define RULES_H
+
+#include <gtk/gtk.h>
+#include "protocol.h"
+
+/*!
+ * \brief
+ * Largest number of moves that generate_moves() returns for a position
+ *
+ * No position of a real game comes close, so any further moves are dropped.
+ */
+#define MAX_MOVES 128
+
+/*! \brief A position, where bit N stands for dark square N */
+typedef struct {
+  /*! \brief The pieces of the player to move */
+  guint32 own;
+  /*! \brief The pieces of the opponent */
+  guint32 opponent;
+  /*! \brief The kings of either player */
+  guint32 kings;
+  /*! \brief The player to move, \c r or \c w */
+  gchar   player;
+} position_t;
+
+/*! \brief A move or a (possibly multiple) jump */
+typedef struct {
+  /*! \brief Bit of the square that the piece leaves */
+  guint32 from;
+  /*! \brief Bit of the square that the piece ends on */
+  guint32 to;
+  /*! \brief Bits of the pieces that are jumped over */
+  guint32 captured;
+  /*! \brief Number of valid entries in #squares */
+  guint8  n_squares;
+  /*! \brief Dark squares (range `0..31`) visited by the move, in order */
+  guint8  squares[MAX_SQUARES];
+} move_t;
+
+/*! \brief The outcome of checking a move */
+typedef enum {
+  VERDICT_LEGAL,             /*!< legal, or not checked */
+  VERDICT_WRONG_TURN,        /*!< the turn isn't passed to the opponent */
+  VERDICT_NOT_OWN_PIECE,     /*!< doesn't start on one of its own pieces */
+  VERDICT_BAD_STEP,          /*!< not a step to an empty square ahead */
+  VERDICT_BAD_JUMP,          /*!< not a jump over an opponent's piece */
+  VERDICT_MISSED_JUMP,       /*!< a step while a jump is possible */
+  VERDICT_UNFINISHED_JUMP,   /*!< stops while the jump can continue */
+  VERDICT_JUMP_AFTER_CROWNING, /*!< continues after the man is crowned */
+  VERDICT_WRONG_BOARD,       /*!< the board doesn't follow from the move */
+  N_VERDICTS                 /*!< number of verdicts (end of enum) */
+} verdict_t;
+
+/*!
+ * \brief
+ * Checks a move against the position before it
+ *
+ * Takes constant time apart from the number of squares in the move, since
+ * the position is held in 32-bit masks and the neighbours of each square are
+ * looked up in tables.
+ *
+ * \param[in] before  the message that the move replies to, whose board and
+ *                    next player give the position
+ * \param[in] move    the reply
+ *
+ * \return
+ * the verdict, which is #VERDICT_LEGAL unless \p move is a move or jump and
+ * \p before has a valid board (a setup or another move)
+ */
+verdict_t
+check_move(const message_t *before, const message_t *move);
+
+/*!
+ * \brief
+ * Reads the position that a message leaves
+ *
+ * \param[in]  message   the message
+ * \param[out] position  the position, with message_t::next_player to move
+ *
+ * \return
+ * whether the message has a valid board and next player
+ */
+gboolean
+get_position(const message_t *message, position_t *position);
+
+/*!
+ * \brief
+ * Writes the board of a position in the format of message_t::board
+ *
+ * \param[in]  position  the position
+ * \param[out] board     the board (not terminated)
+ */
+void
+put_board(const position_t *position, gchar board[static NUM_DARK_SQ]);
+
+/*!
+ * \brief
+ * Generates the legal moves of the player to move
+ *
+ * Only jumps are generated if there is one, and every jump is continued for
+ * as long as it can be. Each way of continuing a jump is a move of its own.
+ *
+ * \param[in]  position  the position
+ * \param[out] moves     the moves
+ *
+ * \return
+ * the number of moves, which is zero if the player to move has lost
+ */
+guint
+generate_moves(const position_t *position, move_t moves[static MAX_MOVES]);
+
+/*!
+ * \brief
+ * Makes a move, as generated by generate_moves()
+ *
+ * \param[in]  position  the position
+ * \param[in]  move      the move
+ * \param[out] after     the position after the move, with the opponent to
+ *                       move (may be the same as \p position)
+ */
+void
+make_move(const position_t *position, const move_t *move,
+          position_t *after);
+
+/*!
+ * \brief
+ * Writes a move in the notation of PDN, such as "11-15" or "15x24x31"
+ *
+ * \param[in] move  the move
+ *
+ * \return
+ * the move in a string that should be freed by the caller
+ */
+gchar *
+format_move(const move_t *move);
+
+/*!
+ * \brief
+ * Computes the Zobrist key of a position
+ *
+ * The key is the exclusive or of a fixed random number for each piece on
+ * each square, and of another one if white is to move. The numbers are the
+ * same in every run, so keys can be stored and compared between runs.
+ *
+ * \param[in] position  the position
+ *
+ * \return
+ * the key
+ */
+guint64
+get_position_key(const position_t *position);
+
+/*!
+ * \brief
+ * Counts the bits that are set, such as the pieces on a bitboard
+ *
+ * \param[in] bits  the bits
+ *
+ * \return
+ * the number of bits set
+ */
+guint
+count_bits(guint32 bits);
+
+/*!
+ * \brief
+ * Describes why a move is illegal
+ *
+ * \param[in] verdict  the verdict
+ *
+ * \return
+ * a static string, such as "misses a compulsory jump"
+ */
+const gchar *
+get_verdict_description(verdict_t verdict);
+
+#endif /* RULES_H */
@@ -0,0 +1,374 @@
+/*!
+ * \file session.c
+ * \brief
+ * Writes and reads session files.
+ *
+ * A session file consists of a #session_header_t, followed by one
+ * #session_record_t per move (each directly followed by the move's stdout and
+ * stderr text), and finally an index with the offset of every record. Records
+ * are appended as the moves are made, while the index and the final header
+ * are written when the session is closed. Reading a session maps the file
+ * into memory, so any move and its output can be reached without reading the
+ * rest of the file.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "session.h"
+#include "clients.h"
+#include "gui.h"
+#include "main.h"
+#include "protocol.h"
+
+/*! \brief Rounds a file offset up to the alignment of the records */
+#define ALIGN8(x) (((x) + 7) & ~(guint64)7)
+
+/*! \brief A session file that is being written */
+struct session_writer {
+  /*! \brief The file being written */
+  FILE   *file;
+  /*! \brief Current end of the file */
+  guint64 offset;
+  /*! \brief Offsets of the records written so far (in file byte order) */
+  GArray *index;
+};
+
+/*! \brief A session file opened for reading */
+struct session {
+  /*! \brief The mapped file */
+  GMappedFile    *mapped;
+  /*! \brief Contents of the file */
+  const gchar    *data;
+  /*! \brief Length of the file in bytes */
+  gsize           length;
+  /*! \brief Number of moves */
+  guint64         n_moves;
+  /*! \brief Offsets of the records (in file byte order) */
+  const guint64  *index;
+  /*! \brief Index rebuilt by scanning, if the file lacks one (or \c NULL) */
+  GArray         *rebuilt;
+};
+
+/*!
+ * \brief
+ * Fills in and writes the header of a session file
+ *
+ * \param[in] file          the file, positioned at its beginning
+ * \param[in] n_moves       the number of moves in the index
+ * \param[in] index_offset  the offset of the index, or zero
+ * \param[in] created_us    the creation time
+ * \param[in] cpu_mask      the CPUs that each client is pinned to
+ */
+static void
+write_header(FILE * const  file,
+             const guint64 n_moves,
+             const guint64 index_offset,
+             const gint64  created_us,
+             const guint64 cpu_mask[static NUM_CLIENTS])
+{
+  session_header_t header;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SESSION_MAGIC, sizeof(header.magic));
+  header.version      = GUINT32_TO_LE(SESSION_VERSION);
+  header.record_size  = GUINT32_TO_LE(sizeof(session_record_t));
+  header.n_moves      = GUINT64_TO_LE(n_moves);
+  header.index_offset = GUINT64_TO_LE(index_offset);
+  header.created_us   = GINT64_TO_LE(created_us);
+  for (guint8 i = 0; i < NUM_CLIENTS; ++i) {
+    header.cpu_mask[i] = GUINT64_TO_LE(cpu_mask[i]);
+  }
+  fwrite(&header, sizeof(header), 1, file);
+}
+
+/* documented in session.h */
+session_writer_t *
+session_writer_open(const gchar *path, GError **error)
+{
+  session_writer_t *writer;
+  guint64 cpu_mask[NUM_CLIENTS];
+  FILE *file;
+
+  assert(path != NULL);
+
+  file = g_fopen(path, "w+b");
+  if (file == NULL) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't create the session file \"%s\"", path);
+    return NULL;
+  }
+  for (guint8 i = 0; i < NUM_CLIENTS; ++i) {
+    cpu_mask[i] = get_client_cpu_mask(i);
+  }
+  write_header(file, 0, 0, g_get_real_time(), cpu_mask);
+
+  writer = g_slice_new(session_writer_t);
+  writer->file   = file;
+  writer->offset = sizeof(session_header_t);
+  writer->index  = g_array_new(FALSE, FALSE, sizeof(guint64));
+  return writer;
+}
+
+/* documented in session.h */
+void
+session_writer_append(session_writer_t    *writer,
+                      guint8               client_id,
+                      const reply_stats_t *stats,
+                      const gchar         *out,
+                      gsize                out_length,
+                      const gchar         *err,
+                      gsize                err_length)
+{
+  static const gchar padding[8] = { 0 };
+  session_record_t record;
+  message_t message;
+  guint64 offset;
+  gchar *line;
+
+  assert(writer != NULL);
+  assert(client_id < NUM_CLIENTS);
+
+  /* align the record so that it can be accessed in place when mapped */
+  offset = ALIGN8(writer->offset);
+  fwrite(padding, 1, offset - writer->offset, writer->file);
+
+  memset(&record, 0, sizeof(record));
+  line = g_strndup(out, out_length);
+  if (parse_message(line, &message)) {
+    memcpy(record.board, message.board, NUM_DARK_SQ);
+    record.action      = message.action;
+    record.n_squares   = message.n_squares;
+    memcpy(record.squares, message.squares, message.n_squares);
+    record.next_player = message.next_player;
+    record.moves_left  = message.moves_left;
+    record.flags      |= SESSION_PARSED;
+  }
+  g_free(line);
+  record.client_id = client_id;
+  record.think_us  = GINT64_TO_LE(stats != NULL ? stats->think_us : -1);
+  record.cpu_us    = GINT64_TO_LE(stats != NULL ? stats->cpu_us : -1);
+  record.rss_kb    = GINT64_TO_LE(stats != NULL ? stats->rss_kb : -1);
+  record.blob_offset[STDOUT] = GUINT64_TO_LE(offset + sizeof(record));
+  record.blob_offset[STDERR] = GUINT64_TO_LE(offset + sizeof(record) +
+                                             out_length);
+  record.blob_length[STDOUT] = GUINT32_TO_LE(out_length);
+  record.blob_length[STDERR] = GUINT32_TO_LE(err_length);
+
+  fwrite(&record, sizeof(record), 1, writer->file);
+  fwrite(out, 1, out_length, writer->file);
+  fwrite(err, 1, err_length, writer->file);
+  fflush(writer->file);
+
+  writer->offset = offset + sizeof(record) + out_length + err_length;
+  offset = GUINT64_TO_LE(offset);
+  g_array_append_val(writer->index, offset);
+}
+
+/* documented in session.h */
+gboolean
+session_writer_close(session_writer_t *writer, GError **error)
+{
+  static const gchar padding[8] = { 0 };
+  const guint64 index_offset = ALIGN8(writer->offset);
+  session_header_t header;
+  gboolean success;
+
+  assert(writer != NULL);
+
+  fwrite(padding, 1, index_offset - writer->offset, writer->file);
+  fwrite(writer->index->data, sizeof(guint64), writer->index->len,
+         writer->file);
+
+  /* keep the creation time and pinning, but fill in the index */
+  rewind(writer->file);
+  if (fread(&header, sizeof(header), 1, writer->file) == 1) {
+    guint64 cpu_mask[NUM_CLIENTS];
+    for (guint8 i = 0; i < NUM_CLIENTS; ++i) {
+      cpu_mask[i] = GUINT64_FROM_LE(header.cpu_mask[i]);
+    }
+    rewind(writer->file);
+    write_header(writer->file, writer->index->len, index_offset,
+                 GINT64_FROM_LE(header.created_us), cpu_mask);
+  }
+
+  success = fflush(writer->file) == 0 && !ferror(writer->file);
+  success &= fclose(writer->file) == 0;
+  if (!success) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't write the session file");
+  }
+
+  g_array_free(writer->index, TRUE);
+  g_slice_free(session_writer_t, writer);
+  return success;
+}
+
+/*!
+ * \brief
+ * Checks that a record and its blobs are within the file
+ *
+ * \param[in] session  the session
+ * \param[in] offset   the offset of the record (in host byte order)
+ *
+ * \return
+ * the offset where the next record may begin, or zero if the record is
+ * invalid
+ */
+static guint64
+check_record(const session_t * const session, const guint64 offset)
+{
+  const session_record_t *record;
+  guint64 end;
+
+  if (offset % 8 != 0 || offset < sizeof(session_header_t) ||
+      offset > session->length - sizeof(session_record_t)) return 0;
+
+  record = (const session_record_t *)(session->data + offset);
+  if (record->client_id >= NUM_CLIENTS) return 0;
+
+  end = offset + sizeof(session_record_t);
+  for (guint8 i = 0; i < 2; ++i) {
+    const guint64 blob_offset = GUINT64_FROM_LE(record->blob_offset[i]);
+    const guint64 blob_length = GUINT32_FROM_LE(record->blob_length[i]);
+    if (blob_offset != end || blob_length > session->length - end) return 0;
+    end += blob_length;
+  }
+  return end;
+}
+
+/* documented in session.h */
+session_t *
+session_open(const gchar *path, GError **error)
+{
+  const session_header_t *header;
+  session_t *session;
+  guint64 index_offset;
+
+  assert(path != NULL);
+
+  session = g_slice_new0(session_t);
+  session->mapped = g_mapped_file_new(path, FALSE, error);
+  if (session->mapped == NULL) {
+    g_slice_free(session_t, session);
+    return NULL;
+  }
+  session->data   = g_mapped_file_get_contents(session->mapped);
+  session->length = g_mapped_file_get_length(session->mapped);
+
+  header = (const session_header_t *)session->data;
+  if (session->length < sizeof(session_header_t) + sizeof(session_record_t)
+      || memcmp(header->magic, SESSION_MAGIC, sizeof(header->magic)) != 0
+      || GUINT32_FROM_LE(header->version) != SESSION_VERSION
+      || GUINT32_FROM_LE(header->record_size) != sizeof(session_record_t)) {
+    /* an empty session is as good as no session */
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "\"%s\" isn't a session file, or it's empty", path);
+    session_close(session);
+    return NULL;
+  }
+
+  index_offset = GUINT64_FROM_LE(header->index_offset);
+  session->n_moves = GUINT64_FROM_LE(header->n_moves);
+
+  if (index_offset != 0 && index_offset % 8 == 0 &&
+      index_offset <= session->length &&
+      session->n_moves <= (session->length - index_offset)/8) {
+    /* the records are only checked as they're accessed, so that opening
+       doesn't depend on the length of the session */
+    session->index = (const guint64 *)(session->data + index_offset);
+  } else {
+    /* the writer never finished, so recover every complete record */
+    guint64 offset = sizeof(session_header_t);
+    guint64 end;
+    session->rebuilt = g_array_new(FALSE, FALSE, sizeof(guint64));
+    while ((end = check_record(session, offset)) != 0) {
+      const guint64 le_offset = GUINT64_TO_LE(offset);
+      g_array_append_val(session->rebuilt, le_offset);
+      offset = ALIGN8(end);
+    }
+    session->index = (const guint64 *)session->rebuilt->data;
+    session->n_moves = session->rebuilt->len;
+  }
+
+  return session;
+}
+
+/* documented in session.h */
+guint64
+session_get_n_moves(const session_t *session)
+{
+  assert(session != NULL);
+
+  return session->n_moves;
+}
+
+/* documented in session.h */
+const session_record_t *
+session_get_record(const session_t *session, guint64 n)
+{
+  guint64 offset;
+
+  assert(session != NULL);
+  assert(n < session->n_moves);
+
+  offset = GUINT64_FROM_LE(session->index[n]);
+  if (check_record(session, offset) == 0) return NULL;
+  return (const session_record_t *)(session->data + offset);
+}
+
+/* documented in session.h */
+const gchar *
+session_get_blob(const session_t        *session,
+                 const session_record_t *record,
+                 guint8                  type,
+                 gsize                  *length)
+{
+  assert(session != NULL);
+  assert(record != NULL);
+  assert(type == STDOUT || type == STDERR);
+  assert(length != NULL);
+
+  *length = GUINT32_FROM_LE(record->blob_length[type]);
+  return session->data + GUINT64_FROM_LE(record->blob_offset[type]);
+}
+
+/* documented in session.h */
+void
+session_get_reply_stats(const session_t        *session,
+                        const session_record_t *record,
+                        reply_stats_t          *stats)
+{
+  UNUSED(session);
+  assert(record != NULL);
+  assert(stats != NULL);
+
+  stats->think_us = GINT64_FROM_LE(record->think_us);
+  stats->cpu_us = GINT64_FROM_LE(record->cpu_us);
+  stats->rss_kb = GINT64_FROM_LE(record->rss_kb);
+}
+
+/* documented in session.h */
+guint64
+session_get_cpu_mask(const session_t *session, guint8 client_id)
+{
+  const session_header_t *header;
+
+  assert(session != NULL);
+  assert(client_id < NUM_CLIENTS);
+
+  header = (const session_header_t *)session->data;
+  return GUINT64_FROM_LE(header->cpu_mask[client_id]);
+}
+
+/* documented in session.h */
+void
+session_close(session_t *session)
+{
+  assert(session != NULL);
+
+  if (session->rebuilt != NULL) g_array_free(session->rebuilt, TRUE);
+  g_mapped_file_unref(session->mapped);
+  g_slice_free(session_t, session);
+}
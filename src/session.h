@@ -0,0 +1,248 @@
+/*!
+ * \file session.h
+ * \brief
+ * Provides functions to save a session to a compact binary file while it's
+ * being played, and to open such a file with random access to every move
+ */
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <gtk/gtk.h>
+#include "gui.h"
+#include "protocol.h"
+
+/*! \brief The first eight bytes of every session file */
+#define SESSION_MAGIC "CKVSESS"
+
+/*! \brief The version of the file format written by this program */
+#define SESSION_VERSION 1
+
+/*! \brief #session_record_t flag: the stdout text was a valid message */
+#define SESSION_PARSED 1
+
+/*!
+ * \brief
+ * Header at the beginning of a session file (all integers little-endian)
+ */
+typedef struct {
+  /*! \brief #SESSION_MAGIC including the terminating zero */
+  gchar   magic[8];
+  /*! \brief #SESSION_VERSION of the writer */
+  guint32 version;
+  /*! \brief Size of each move record, sizeof(session_record_t) */
+  guint32 record_size;
+  /*! \brief Number of moves in the index (zero if never closed) */
+  guint64 n_moves;
+  /*! \brief Offset of the index, or zero if the session was never closed */
+  guint64 index_offset;
+  /*! \brief Wall-clock time when the session was created (microseconds
+             since the epoch) */
+  gint64  created_us;
+  /*! \brief CPUs that each client was pinned to (bit N for CPU N), or zero
+             if it wasn't pinned */
+  guint64 cpu_mask[NUM_CLIENTS];
+  /*! \brief Reserved for future use (zero) */
+  guint64 reserved[1];
+} session_header_t;
+
+/*!
+ * \brief
+ * One move (i.e. one row in the list) as stored in a session file
+ *
+ * Each record starts at an offset divisible by eight, directly followed by
+ * its stdout and stderr blobs. The layout has no padding, so that a record
+ * can be read straight from a mapped file.
+ */
+typedef struct {
+  /*! \brief Content of each dark square (see #message_t) */
+  gchar   board[NUM_DARK_SQ];
+  /*! \brief Action code (see #message_t) */
+  gint8   action;
+  /*! \brief Number of valid entries in #squares */
+  guint8  n_squares;
+  /*! \brief Dark squares visited by the move */
+  guint8  squares[MAX_SQUARES];
+  /*! \brief The player to move next, \c r or \c w */
+  gchar   next_player;
+  /*! \brief Number of moves left before the game is drawn */
+  guint8  moves_left;
+  /*! \brief The client that wrote the output */
+  guint8  client_id;
+  /*! \brief Bitwise or of flags such as #SESSION_PARSED */
+  guint8  flags;
+  /*! \brief File offsets of the stdout and stderr blobs */
+  guint64 blob_offset[2];
+  /*! \brief Lengths of the stdout and stderr blobs in bytes */
+  guint32 blob_length[2];
+  /*! \brief Time that the client took to reply in microseconds, or -1 if
+             unknown */
+  gint64  think_us;
+  /*! \brief CPU time used for the reply in microseconds, or -1 if
+             unknown */
+  gint64  cpu_us;
+  /*! \brief Resident set size of the client after the reply in KiB, or -1
+             if unknown */
+  gint64  rss_kb;
+} session_record_t;
+
+/*! \brief A session file that is being written (private to session.c) */
+typedef struct session_writer session_writer_t;
+
+/*! \brief A session file opened for reading (private to session.c) */
+typedef struct session session_t;
+
+/*!
+ * \brief
+ * Creates (or truncates) a session file for writing
+ *
+ * \param[in] path   the file name
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * the writer, or \c NULL on error
+ */
+session_writer_t *
+session_writer_open(const gchar *path, GError **error);
+
+/*!
+ * \brief
+ * Appends a move to a session file
+ *
+ * The record is written immediately, so that a session is preserved up to
+ * the last complete move even if the program is terminated.
+ *
+ * \param[in] writer      the writer
+ * \param[in] client_id   the client that wrote the output
+ * \param[in] stats       measurements of the client's reply, or \c NULL if
+ *                        unknown
+ * \param[in] out         the stdout text of the move
+ * \param[in] out_length  the length of \p out in bytes
+ * \param[in] err         the stderr text of the move
+ * \param[in] err_length  the length of \p err in bytes
+ */
+void
+session_writer_append(session_writer_t    *writer,
+                      guint8               client_id,
+                      const reply_stats_t *stats,
+                      const gchar         *out,
+                      gsize                out_length,
+                      const gchar         *err,
+                      gsize                err_length);
+
+/*!
+ * \brief
+ * Writes the index, finalizes the header and closes the file
+ *
+ * \param[in] writer  the writer, which is freed
+ * \param[in] error   as for session_writer_open()
+ *
+ * \return
+ * whether all data was successfully written
+ */
+gboolean
+session_writer_close(session_writer_t *writer, GError **error);
+
+/*!
+ * \brief
+ * Maps a session file into memory
+ *
+ * Only the header is read, and the records are checked as they're accessed,
+ * so this takes the same time however long the session is. If the session
+ * was never closed, the records are scanned to rebuild the index.
+ *
+ * \param[in] path   the file name
+ * \param[in] error  as for session_writer_open()
+ *
+ * \return
+ * the session, or \c NULL on error
+ */
+session_t *
+session_open(const gchar *path, GError **error);
+
+/*!
+ * \brief
+ * Gets the number of moves in a session
+ *
+ * \param[in] session  the session
+ *
+ * \return
+ * the number of moves
+ */
+guint64
+session_get_n_moves(const session_t *session);
+
+/*!
+ * \brief
+ * Gets a move record, in constant time
+ *
+ * The record is checked to lie within the file, with its blobs.
+ *
+ * \param[in] session  the session
+ * \param[in] n        the zero-based number of the move
+ *
+ * \return
+ * a pointer into the mapped file, valid until session_close(), or \c NULL
+ * if the record is corrupt, in which case it and the moves after it should
+ * be treated as missing (as in a session that was never closed)
+ */
+const session_record_t *
+session_get_record(const session_t *session, guint64 n);
+
+/*!
+ * \brief
+ * Gets the stdout or stderr text belonging to a move record
+ *
+ * \param[in]  session  the session
+ * \param[in]  record   a record from session_get_record()
+ * \param[in]  type     #STDOUT or #STDERR
+ * \param[out] length   the length of the text in bytes
+ *
+ * \return
+ * a pointer into the mapped file (not zero-terminated), valid until
+ * session_close()
+ */
+const gchar *
+session_get_blob(const session_t        *session,
+                 const session_record_t *record,
+                 guint8                  type,
+                 gsize                  *length);
+
+/*!
+ * \brief
+ * Gets the measurements of the client's reply that a move record holds
+ *
+ * \param[in]  session  the session
+ * \param[in]  record   a record from session_get_record()
+ * \param[out] stats    the measurements
+ */
+void
+session_get_reply_stats(const session_t        *session,
+                        const session_record_t *record,
+                        reply_stats_t          *stats);
+
+/*!
+ * \brief
+ * Gets the CPUs that a client was pinned to while the session was played
+ *
+ * \param[in] session    the session
+ * \param[in] client_id  the client
+ *
+ * \return
+ * a mask as from get_client_cpu_mask(), which is zero if the client wasn't
+ * pinned (or the session predates pinning)
+ */
+guint64
+session_get_cpu_mask(const session_t *session, guint8 client_id);
+
+/*!
+ * \brief
+ * Unmaps a session file and frees its resources
+ *
+ * \param[in] session  the session
+ */
+void
+session_close(session_t *session);
+
+#endif /* SESSION_H */
@@ -0,0 +1,434 @@
+/*!
+ * \file suite.c
+ * \brief
+ * Runs the positions of a test suite with a pool of worker threads, each of
+ * which starts a client for one position at a time.
+ */
+/*! \cond */
+#define _POSIX_C_SOURCE 200112L
+/*! \endcond */
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <gtk/gtk.h>
+#include "suite.h"
+#include "clients.h"
+#include "engine.h"
+#include "protocol.h"
+#include "rules.h"
+
+/*! \brief Size of the buffer when reading from a client */
+#define BUFFER_SIZE 4096
+
+/*! \brief The outcome of a position */
+typedef enum {
+  OUTCOME_SOLVED,   /*!< the reply is one of the expected moves */
+  OUTCOME_WRONG,    /*!< the reply is another legal move */
+  OUTCOME_ILLEGAL,  /*!< the reply breaks the rules, or isn't a move */
+  OUTCOME_TIMEOUT,  /*!< the client didn't reply within the time limit */
+  OUTCOME_NO_REPLY, /*!< the client exited, or couldn't be started */
+  N_OUTCOMES        /*!< number of outcomes (end of enum) */
+} outcome_t;
+
+/*! \brief A position of the suite, and the outcome once it's run */
+typedef struct {
+  /*! \brief The line of the suite file, counted from one */
+  guint      line;
+  /*! \brief The message to hand to the client, ending with a newline */
+  gchar     *text;
+  /*! \brief The parsed message */
+  message_t  message;
+  /*! \brief The expected moves, as written by format_move() */
+  gchar    **expected;
+  /*! \brief The outcome */
+  outcome_t  outcome;
+  /*! \brief The move of the reply as written by format_move(), or
+             \c NULL */
+  gchar     *move;
+  /*! \brief Time from handing over the message until the reply began to
+             arrive, in microseconds, or -1 if there was no reply */
+  gint64     think_us;
+} test_t;
+
+/*! \brief State shared between the worker threads */
+typedef struct {
+  /*! \brief The command line of the client */
+  const gchar *cmd;
+  /*! \brief Protects #error */
+  GMutex       mutex;
+  /*! \brief The error of the first client that couldn't be started, or
+             \c NULL */
+  GError      *error;
+} suite_state_t;
+
+/*!
+ * \brief
+ * Checks whether a move is in a list
+ *
+ * \param[in] moves  a \c NULL-terminated array of moves
+ * \param[in] move   the move
+ *
+ * \return
+ * whether \p move is one of \p moves
+ */
+static gboolean
+contains_move(gchar * const * const moves, const gchar * const move)
+{
+  for (guint i = 0; moves[i] != NULL; ++i) {
+    if (strcmp(moves[i], move) == 0) return TRUE;
+  }
+  return FALSE;
+}
+
+/*!
+ * \brief
+ * Reads a position of the suite from a line
+ *
+ * \param[in]  words  the words of the line, at least five
+ * \param[in]  line   the number of the line
+ * \param[out] test   the position, whose #test_t::outcome and #test_t::move
+ *                    are left to be set
+ * \param[in]  error  as for run_suite()
+ *
+ * \return
+ * whether the message is valid and every expected move is legal
+ */
+static gboolean
+parse_test(gchar ** const words,
+           const guint    line,
+           test_t * const test,
+           GError       **error)
+{
+  move_t moves[MAX_MOVES];
+  position_t position;
+  gchar *legal[MAX_MOVES + 1];
+  guint n_moves;
+  guint n_words = 0;
+  gboolean success = TRUE;
+
+  while (words[n_words] != NULL) ++n_words;
+  assert(n_words >= 5);
+
+  test->line = line;
+  test->text = g_strdup_printf("%s %s %s %s\n", words[0], words[1],
+                               words[2], words[3]);
+  if (!parse_message(test->text, &test->message) ||
+      !get_position(&test->message, &position)) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "Line %u has an invalid message", line);
+    g_free(test->text);
+    return FALSE;
+  }
+
+  /* the expected moves are compared as written by format_move() */
+  n_moves = generate_moves(&position, moves);
+  for (guint i = 0; i < n_moves; ++i) {
+    legal[i] = format_move(&moves[i]);
+  }
+  legal[n_moves] = NULL;
+  test->expected = g_new0(gchar *, n_words - 4 + 1);
+  for (guint i = 4; i < n_words && success; ++i) {
+    if (!contains_move(legal, words[i])) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                  "Line %u expects \"%s\", which isn't a legal move", line,
+                  words[i]);
+      success = FALSE;
+    }
+    test->expected[i - 4] = g_strdup(words[i]);
+  }
+  for (guint i = 0; i < n_moves; ++i) g_free(legal[i]);
+
+  if (!success) {
+    g_free(test->text);
+    g_strfreev(test->expected);
+  }
+  test->move = NULL;
+  test->think_us = -1;
+  return success;
+}
+
+/*!
+ * \brief
+ * Reads the first line of output of a client
+ *
+ * \param[in]  fd          the client's stdout
+ * \param[in]  started_us  the monotonic time when the message was handed
+ *                         over
+ * \param[in]  timeout_us  the time limit after \p started_us, or zero for
+ *                         none
+ * \param[out] think_us    the time until the first output arrived, or -1
+ * \param[out] outcome     #OUTCOME_TIMEOUT or #OUTCOME_NO_REPLY if there is
+ *                         no line, otherwise untouched
+ *
+ * \return
+ * the line in a string that should be freed by the caller, or \c NULL
+ */
+static gchar *
+read_reply(const gint          fd,
+           const gint64        started_us,
+           const gint64        timeout_us,
+           gint64 * const      think_us,
+           outcome_t * const   outcome)
+{
+  GString * const reply = g_string_new(NULL);
+  gchar buffer[BUFFER_SIZE];
+
+  *think_us = -1;
+  while (strchr(reply->str, '\n') == NULL) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    gint timeout_ms = -1;
+    ssize_t n_read;
+
+    if (timeout_us > 0) {
+      const gint64 left_us = started_us + timeout_us - g_get_monotonic_time();
+      if (left_us <= 0) {
+        *outcome = OUTCOME_TIMEOUT;
+        break;
+      }
+      timeout_ms = (gint)((left_us + 999) / 1000);
+    }
+    if (poll(&pfd, 1, timeout_ms) < 0) {
+      if (errno == EINTR) continue;
+      *outcome = OUTCOME_NO_REPLY;
+      break;
+    }
+    if (pfd.revents == 0) continue;
+    n_read = read(fd, buffer, sizeof(buffer));
+    if (n_read < 0 && errno == EINTR) continue;
+    if (n_read <= 0) {
+      *outcome = OUTCOME_NO_REPLY;
+      break;
+    }
+    if (*think_us < 0) *think_us = g_get_monotonic_time() - started_us;
+    g_string_append_len(reply, buffer, n_read);
+  }
+  if (strchr(reply->str, '\n') == NULL) {
+    g_string_free(reply, TRUE);
+    return NULL;
+  }
+  *strchr(reply->str, '\n') = '\0';
+  return g_string_free(reply, FALSE);
+}
+
+/*!
+ * \brief
+ * Runs a position with a new client, following the signature of \c GFunc
+ *
+ * \param[in] data       the ::test_t
+ * \param[in] user_data  the ::suite_state_t
+ */
+static void
+suite_job(gpointer data, gpointer user_data)
+{
+  extern guint option_move_time_ms;
+  test_t * const test = data;
+  suite_state_t * const state = user_data;
+  gchar ** const cmdline = g_strsplit(state->cmd, " ", 0);
+  const gsize length = strlen(test->text);
+  GError *error = NULL;
+  GPid pid;
+  gint fd_stdin;
+  gint fd_stdout;
+  gint64 started_us;
+  gchar *reply;
+  message_t message;
+  position_t position;
+  move_t moves[MAX_MOVES];
+  guint n_moves;
+
+  test->outcome = OUTCOME_NO_REPLY;
+  if (!g_spawn_async_with_pipes(NULL, cmdline, NULL,
+                                G_SPAWN_SEARCH_PATH |
+                                G_SPAWN_DO_NOT_REAP_CHILD |
+                                G_SPAWN_STDERR_TO_DEV_NULL,
+                                NULL, NULL, &pid, &fd_stdin, &fd_stdout,
+                                NULL, &error)) {
+    g_mutex_lock(&state->mutex);
+    if (state->error == NULL) {
+      state->error = error;
+      error = NULL;
+    }
+    g_mutex_unlock(&state->mutex);
+    g_clear_error(&error);
+    g_strfreev(cmdline);
+    return;
+  }
+  g_strfreev(cmdline);
+
+  /* the position is the first message that the client receives */
+  started_us = g_get_monotonic_time();
+  if (write(fd_stdin, test->text, length) == (ssize_t)length) {
+    reply = read_reply(fd_stdout, started_us,
+                       (gint64)option_move_time_ms * 1000,
+                       &test->think_us, &test->outcome);
+  } else {
+    reply = NULL;
+  }
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+  g_spawn_close_pid(pid);
+  close(fd_stdin);
+  close(fd_stdout);
+  if (reply == NULL) return;
+
+  if (!parse_message(reply, &message) || message.action < 0 ||
+      check_move(&test->message, &message) != VERDICT_LEGAL) {
+    test->outcome = OUTCOME_ILLEGAL;
+  } else {
+    /* a legal reply is one of the moves of the position */
+    get_position(&test->message, &position);
+    n_moves = generate_moves(&position, moves);
+    for (guint i = 0; i < n_moves && test->move == NULL; ++i) {
+      if (moves[i].n_squares == message.n_squares &&
+          memcmp(moves[i].squares, message.squares,
+                 message.n_squares) == 0) {
+        test->move = format_move(&moves[i]);
+      }
+    }
+    test->outcome = test->move != NULL &&
+                    contains_move(test->expected, test->move)
+                    ? OUTCOME_SOLVED : OUTCOME_WRONG;
+  }
+  g_free(reply);
+}
+
+/* documented in suite.h */
+gboolean
+run_suite(gchar * const *args, GError **error)
+{
+  static const gchar * const outcome_names[N_OUTCOMES] = {
+    "solved", "wrong", "illegal", "timeout", "no-reply"
+  };
+  extern gchar *option_cmds[NUM_CLIENTS];
+  extern guint  option_jobs;
+  suite_state_t state;
+  GThreadPool *pool;
+  GArray *tests;
+  gchar *contents;
+  gchar **lines;
+  guint counts[N_OUTCOMES] = { 0 };
+  gint64 solved_us = 0;
+  gint64 start_us;
+  gboolean success = TRUE;
+
+  assert(args != NULL);
+  assert(error == NULL || *error == NULL);
+
+  if (args[0] == NULL || args[1] != NULL) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Expected " SUITE_COMMAND " FILE");
+    return FALSE;
+  }
+  if (option_cmds[0] == NULL || option_cmds[0][0] == '\0' ||
+      g_str_has_prefix(option_cmds[0], ENGINE_PREFIX)) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Expected the command line of a client with -1");
+    return FALSE;
+  }
+  if (!g_file_get_contents(args[0], &contents, NULL, error)) return FALSE;
+
+  tests = g_array_new(FALSE, FALSE, sizeof(test_t));
+  lines = g_strsplit(contents, "\n", 0);
+  g_free(contents);
+  for (guint i = 0; lines[i] != NULL && success; ++i) {
+    gchar ** const words = g_strsplit_set(g_strstrip(lines[i]), " \t", 0);
+    gchar **word = words;
+    test_t test;
+
+    /* separators in a row make empty words */
+    for (gchar **p = words; *p != NULL; ++p) {
+      if (**p != '\0') {
+        *word++ = *p;
+      } else {
+        g_free(*p);
+      }
+    }
+    *word = NULL;
+    if (words[0] != NULL && words[0][0] != '#') {
+      if (word - words < 5) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                    "Line %u has no expected moves", i + 1);
+        success = FALSE;
+      } else if (parse_test(words, i + 1, &test, error)) {
+        g_array_append_val(tests, test);
+      } else {
+        success = FALSE;
+      }
+    }
+    g_strfreev(words);
+  }
+  g_strfreev(lines);
+
+  /* a client that exits before reading its message mustn't stop the
+     runner */
+  signal(SIGPIPE, SIG_IGN);
+  g_mutex_init(&state.mutex);
+  state.cmd = option_cmds[0];
+  state.error = NULL;
+  start_us = g_get_monotonic_time();
+  pool = success ? g_thread_pool_new(suite_job, &state,
+                                     option_jobs > 0
+                                     ? (gint)option_jobs
+                                     : (gint)g_get_num_processors(),
+                                     TRUE, error)
+                 : NULL;
+  if (pool != NULL) {
+    for (guint i = 0; i < tests->len; ++i) {
+      g_thread_pool_push(pool, &g_array_index(tests, test_t, i), NULL);
+    }
+    /* wait for the queued positions to be run */
+    g_thread_pool_free(pool, FALSE, TRUE);
+
+    /* one line per position, in the order of the suite */
+    for (guint i = 0; i < tests->len; ++i) {
+      const test_t * const test = &g_array_index(tests, test_t, i);
+      printf("%u\t%s\t%s\t", test->line, outcome_names[test->outcome],
+             test->move != NULL ? test->move : "-");
+      if (test->think_us >= 0) {
+        printf("%.1f\n", test->think_us / 1e3);
+      } else {
+        printf("-\n");
+      }
+      ++counts[test->outcome];
+      if (test->outcome == OUTCOME_SOLVED) solved_us += test->think_us;
+    }
+    printf("Solved %u of %u positions (%.1f%%) in %.3f s",
+           counts[OUTCOME_SOLVED], tests->len,
+           tests->len > 0 ? 100.0 * counts[OUTCOME_SOLVED] / tests->len
+                          : 0.0,
+           (g_get_monotonic_time() - start_us) / 1e6);
+    if (counts[OUTCOME_SOLVED] > 0) {
+      printf(", %.1f ms on average to solve",
+             solved_us / 1e3 / counts[OUTCOME_SOLVED]);
+    }
+    printf("\n");
+  } else {
+    success = FALSE;
+  }
+  g_mutex_clear(&state.mutex);
+
+  for (guint i = 0; i < tests->len; ++i) {
+    test_t * const test = &g_array_index(tests, test_t, i);
+    g_free(test->text);
+    g_strfreev(test->expected);
+    g_free(test->move);
+  }
+  g_array_free(tests, TRUE);
+
+  if (state.error != NULL) {
+    if (success) {
+      g_propagate_error(error, state.error);
+      success = FALSE;
+    } else {
+      g_error_free(state.error);
+    }
+  }
+  return success;
+}
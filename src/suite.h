@@ -0,0 +1,44 @@
+/*!
+ * \file suite.h
+ * \brief
+ * Provides a runner for suites of test positions, which hands each position
+ * to a fresh client and checks its move against the expected ones
+ */
+#ifndef SUITE_H
+#define SUITE_H
+
+#include <gtk/gtk.h>
+
+/*! \brief The word on the command line that runs a test suite */
+#define SUITE_COMMAND "suite"
+
+/*!
+ * \brief
+ * Runs the positions of a test suite, and writes the outcome of each and
+ * the solve rate to standard output
+ *
+ * Each line of the suite is a message in the format of the protocol,
+ * followed by one or more expected moves written as in PDN (such as
+ * \c 11-15 or \c 15x24x31), where blank lines and lines that start with
+ * \c # are skipped:
+ *
+ *     rrrrrrrrrrrr........wwwwwwwwwwww -1 r 50 11-15 11-16
+ *
+ * Every position is handed to a new process of the client set by option
+ * \c -1 as its first message, in the worker threads set by option \c -j,
+ * and the client is killed once it has replied or the time limit of a move
+ * set by option \c -T has passed. A position is solved if the reply is a
+ * legal move and one of the expected ones.
+ *
+ * \param[in] args   a \c NULL-terminated array of the suite file
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * whether the suite was read and every position was run (solved or not)
+ */
+gboolean
+run_suite(gchar * const *args, GError **error);
+
+#endif /* SUITE_H */
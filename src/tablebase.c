@@ -0,0 +1,774 @@
+/*!
+ * \file tablebase.c
+ * \brief
+ * Generates endgame tablebases in passes over every position, and looks up
+ * positions in the mapped files.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "tablebase.h"
+#include "rules.h"
+
+/*! \brief Number of values of each entry of tablebase_entry_t::material */
+#define MATERIAL_RANGE (TABLEBASE_MAX_PIECES + 1)
+
+/*! \brief Number of material balances that a tablebase can hold */
+#define N_MATERIALS \
+  (MATERIAL_RANGE * MATERIAL_RANGE * MATERIAL_RANGE * MATERIAL_RANGE)
+
+/*!
+ * \brief
+ * Squares where the men of the player to move can be, seen from the side of
+ * red (a man on the far row would be a king)
+ */
+#define OWN_MEN_SQUARES 0x0fffffffu
+
+/*! \brief Squares where the men of the opponent can be */
+#define OPPONENT_MEN_SQUARES 0xfffffff0u
+
+/*! \brief Number of squares in #OWN_MEN_SQUARES and #OPPONENT_MEN_SQUARES */
+#define NUM_MEN_SQ 28
+
+/*!
+ * \brief
+ * Largest number of plies to the end of a game that a table can hold, so
+ * that the value still fits in a byte
+ */
+#define MAX_PLIES 254
+
+/* documented in tablebase.h */
+struct tablebase {
+  /*! \brief The file, or \c NULL while the tablebase is generated */
+  GMappedFile *mapped;
+  /*! \brief Largest number of pieces of the positions */
+  guint        max_pieces;
+  /*! \brief The table of each material balance, indexed by
+             get_material_index(), or \c NULL */
+  guint8      *tables[N_MATERIALS];
+};
+
+/*! \brief The state of one thread in a pass over a table */
+typedef struct {
+  /*! \brief The tablebase */
+  const tablebase_t *tablebase;
+  /*! \brief The material balance of the table */
+  const guint8      *material;
+  /*! \brief The number of the pass, and of the plies of the positions to
+             find */
+  guint              pass;
+  /*! \brief The first index of the positions of this thread */
+  guint64            begin;
+  /*! \brief The index after the last position of this thread */
+  guint64            end;
+  /*! \brief Number of positions that were solved */
+  guint64            n_solved;
+} pass_t;
+
+/*!
+ * \brief
+ * Reverses the order of the bits, which turns the board around so that
+ * white's pieces are seen from the side of red
+ *
+ * \param[in] bits  the bits
+ *
+ * \return
+ * the reversed bits
+ */
+static guint32
+reverse_bits(guint32 bits)
+{
+  bits = ((bits >> 1) & 0x55555555u) | ((bits & 0x55555555u) << 1);
+  bits = ((bits >> 2) & 0x33333333u) | ((bits & 0x33333333u) << 2);
+  bits = ((bits >> 4) & 0x0f0f0f0fu) | ((bits & 0x0f0f0f0fu) << 4);
+  bits = ((bits >> 8) & 0x00ff00ffu) | ((bits & 0x00ff00ffu) << 8);
+  return (bits >> 16) | (bits << 16);
+}
+
+/*!
+ * \brief
+ * Returns the binomial coefficients, which are computed the first time
+ *
+ * \return
+ * a table where entry [N][K] is N choose K
+ */
+static const guint64 (*
+get_binomials(void))[TABLEBASE_MAX_PIECES + 1]
+{
+  static guint64 binomials[NUM_DARK_SQ + 1][TABLEBASE_MAX_PIECES + 1];
+  static gsize is_initialized = 0;
+
+  if (g_once_init_enter(&is_initialized)) {
+    for (guint n = 0; n <= NUM_DARK_SQ; ++n) {
+      binomials[n][0] = 1;
+      for (guint k = 1; k <= TABLEBASE_MAX_PIECES; ++k) {
+        binomials[n][k] = n == 0 ? 0 :
+                          binomials[n - 1][k - 1] + binomials[n - 1][k];
+      }
+    }
+    g_once_init_leave(&is_initialized, 1);
+  }
+  return (const guint64 (*)[TABLEBASE_MAX_PIECES + 1])binomials;
+}
+
+/*!
+ * \brief
+ * Computes the index of a material balance in tablebase::tables
+ *
+ * \param[in] material  the number of men and kings of the player to move,
+ *                      then of the opponent
+ *
+ * \return
+ * the index
+ */
+static guint
+get_material_index(const guint8 material[static 4])
+{
+  return ((material[0]*MATERIAL_RANGE + material[1])*MATERIAL_RANGE +
+          material[2])*MATERIAL_RANGE + material[3];
+}
+
+/*!
+ * \brief
+ * Computes the number of indices of a table
+ *
+ * The men of each player are placed on their squares independently (so some
+ * indices put two men on the same square, and stand for no position), and
+ * then the kings on the squares that are left.
+ *
+ * \param[in] material  the material balance of the table
+ *
+ * \return
+ * the number of indices
+ */
+static guint64
+get_table_size(const guint8 material[static 4])
+{
+  const guint64 (* const binomials)[TABLEBASE_MAX_PIECES + 1] =
+    get_binomials();
+  const guint free = NUM_DARK_SQ - material[0] - material[2];
+
+  return binomials[NUM_MEN_SQ][material[0]] *
+         binomials[NUM_MEN_SQ][material[2]] *
+         binomials[free][material[1]] *
+         binomials[free - material[1]][material[3]];
+}
+
+/*!
+ * \brief
+ * Ranks a set of squares among all sets of as many squares in a universe
+ *
+ * \param[in] squares   the squares, all of which are in \p universe
+ * \param[in] universe  the squares to choose from
+ *
+ * \return
+ * the rank, in the combinatorial number system
+ */
+static guint64
+rank_squares(guint32 squares, const guint32 universe)
+{
+  const guint64 (* const binomials)[TABLEBASE_MAX_PIECES + 1] =
+    get_binomials();
+  guint64 rank = 0;
+  guint k = 0;
+
+  while (squares != 0) {
+    const guint32 bit = squares & (~squares + 1);
+    rank += binomials[count_bits(universe & (bit - 1))][++k];
+    squares ^= bit;
+  }
+  return rank;
+}
+
+/*!
+ * \brief
+ * Finds the set of squares of a rank, as the inverse of rank_squares()
+ *
+ * \param[in] rank      the rank
+ * \param[in] k         the number of squares
+ * \param[in] universe  the squares to choose from
+ *
+ * \return
+ * the squares
+ */
+static guint32
+unrank_squares(guint64 rank, const guint k, const guint32 universe)
+{
+  const guint64 (* const binomials)[TABLEBASE_MAX_PIECES + 1] =
+    get_binomials();
+  guint32 squares = 0;
+
+  for (guint i = k; i > 0; --i) {
+    guint32 rest = universe;
+    guint n = i - 1;
+
+    /* the largest n with n choose i not above the rank */
+    while (n < NUM_DARK_SQ && binomials[n + 1][i] <= rank) ++n;
+    rank -= binomials[n][i];
+    /* the square of the nth bit of the universe */
+    for (guint j = 0; j < n; ++j) rest &= rest - 1;
+    squares |= rest & (~rest + 1);
+  }
+  return squares;
+}
+
+/*!
+ * \brief
+ * Reads the pieces of a position as seen by the player to move, with the
+ * board turned around if it's white
+ *
+ * \param[in]  position  the position
+ * \param[out] own       the pieces of the player to move
+ * \param[out] opponent  the pieces of the opponent
+ * \param[out] kings     the kings of either player
+ * \param[out] material  the material balance
+ */
+static void
+get_pieces(const position_t * const position,
+           guint32 * const          own,
+           guint32 * const          opponent,
+           guint32 * const          kings,
+           guint8                   material[static 4])
+{
+  const gboolean is_turned = position->player == 'w';
+
+  *own      = is_turned ? reverse_bits(position->own) : position->own;
+  *opponent = is_turned ? reverse_bits(position->opponent)
+                        : position->opponent;
+  *kings    = is_turned ? reverse_bits(position->kings) : position->kings;
+  material[0] = count_bits(*own & ~*kings);
+  material[1] = count_bits(*own & *kings);
+  material[2] = count_bits(*opponent & ~*kings);
+  material[3] = count_bits(*opponent & *kings);
+}
+
+/*!
+ * \brief
+ * Computes the index of a position in the table of its material balance
+ *
+ * \param[in] material  the material balance
+ * \param[in] own       the pieces of the player to move, seen from red
+ * \param[in] opponent  the pieces of the opponent
+ * \param[in] kings     the kings of either player
+ *
+ * \return
+ * the index
+ */
+static guint64
+get_index(const guint8  material[static 4],
+          const guint32 own,
+          const guint32 opponent,
+          const guint32 kings)
+{
+  const guint64 (* const binomials)[TABLEBASE_MAX_PIECES + 1] =
+    get_binomials();
+  const guint32 own_men = own & ~kings;
+  const guint32 opponent_men = opponent & ~kings;
+  const guint free = NUM_DARK_SQ - material[0] - material[2];
+  guint64 index;
+
+  index = rank_squares(own_men, OWN_MEN_SQUARES);
+  index = index * binomials[NUM_MEN_SQ][material[2]] +
+          rank_squares(opponent_men, OPPONENT_MEN_SQUARES);
+  index = index * binomials[free][material[1]] +
+          rank_squares(own & kings, ~(own_men | opponent_men));
+  index = index * binomials[free - material[1]][material[3]] +
+          rank_squares(opponent & kings, ~(own | opponent_men));
+  return index;
+}
+
+/*!
+ * \brief
+ * Finds the position of an index, as the inverse of get_index(), with red to
+ * move
+ *
+ * \param[in]  material  the material balance
+ * \param[in]  index     the index
+ * \param[out] position  the position
+ *
+ * \return
+ * whether the index stands for a position, rather than men on the same
+ * square
+ */
+static gboolean
+get_position_at(const guint8     material[static 4],
+                guint64          index,
+                position_t * const position)
+{
+  const guint64 (* const binomials)[TABLEBASE_MAX_PIECES + 1] =
+    get_binomials();
+  const guint free = NUM_DARK_SQ - material[0] - material[2];
+  const guint64 n_opponent_kings =
+    binomials[free - material[1]][material[3]];
+  const guint64 n_own_kings = binomials[free][material[1]];
+  const guint64 n_opponent_men = binomials[NUM_MEN_SQ][material[2]];
+  guint64 opponent_kings_rank;
+  guint64 own_kings_rank;
+  guint64 opponent_men_rank;
+  guint32 own_men;
+  guint32 opponent_men;
+  guint32 own_kings;
+
+  opponent_kings_rank = index % n_opponent_kings;
+  index /= n_opponent_kings;
+  own_kings_rank = index % n_own_kings;
+  index /= n_own_kings;
+  opponent_men_rank = index % n_opponent_men;
+  index /= n_opponent_men;
+
+  own_men = unrank_squares(index, material[0], OWN_MEN_SQUARES);
+  opponent_men = unrank_squares(opponent_men_rank, material[2],
+                                OPPONENT_MEN_SQUARES);
+  if ((own_men & opponent_men) != 0) return FALSE;
+  own_kings = unrank_squares(own_kings_rank, material[1],
+                             ~(own_men | opponent_men));
+  position->kings = own_kings |
+                    unrank_squares(opponent_kings_rank, material[3],
+                                   ~(own_men | opponent_men | own_kings));
+  position->own = own_men | own_kings;
+  position->opponent = opponent_men | (position->kings & ~own_kings);
+  position->player = 'r';
+  return TRUE;
+}
+
+/*!
+ * \brief
+ * Looks up the value of a position, as described for ::tablebase_entry_t
+ *
+ * \param[in] tablebase  the tablebase
+ * \param[in] position   the position
+ *
+ * \return
+ * the value, or -1 if the position isn't in the tablebase
+ */
+static gint
+get_value(const tablebase_t * const tablebase,
+          const position_t * const  position)
+{
+  guint8 material[4];
+  guint32 own;
+  guint32 opponent;
+  guint32 kings;
+  const guint8 *table;
+
+  get_pieces(position, &own, &opponent, &kings, material);
+  /* without pieces, the game is lost */
+  if (own == 0) return 1;
+  if (opponent == 0 ||
+      material[0] + material[1] + material[2] + material[3] >
+      (gint)tablebase->max_pieces) return -1;
+  table = tablebase->tables[get_material_index(material)];
+  if (table == NULL) return -1;
+  return table[get_index(material, own, opponent, kings)];
+}
+
+/*!
+ * \brief
+ * Solves the positions of a part of a table that are won or lost in as many
+ * plies as the number of the pass
+ *
+ * Pass zero finds the positions without moves, which are lost. In an odd
+ * pass N, a position is won if a move leads to a position that is lost in
+ * N - 1 plies, and in an even pass N, it's lost if every move leads to a
+ * position that is won in fewer than N plies. The positions that another
+ * thread solves in the same pass are thus never used in it.
+ *
+ * \param[in] data  the ::pass_t
+ *
+ * \return
+ * \c NULL
+ */
+static gpointer
+pass_thread(gpointer data)
+{
+  pass_t * const pass = data;
+  const gint k = pass->pass;
+  guint8 * const table =
+    pass->tablebase->tables[get_material_index(pass->material)];
+
+  for (guint64 index = pass->begin; index < pass->end; ++index) {
+    move_t moves[MAX_MOVES];
+    position_t position;
+    guint n_moves;
+    gboolean is_solved;
+
+    if (table[index] != 0 ||
+        !get_position_at(pass->material, index, &position)) continue;
+    n_moves = generate_moves(&position, moves);
+
+    is_solved = k % 2 == 0;
+    for (guint i = 0; i < n_moves; ++i) {
+      position_t child;
+      gint value;
+
+      make_move(&position, &moves[i], &child);
+      value = get_value(pass->tablebase, &child);
+      if (k % 2 == 1 && value == k) {
+        is_solved = TRUE;
+        break;
+      }
+      if (k % 2 == 0 && (value <= 0 || value % 2 == 1 || value > k)) {
+        is_solved = FALSE;
+        break;
+      }
+    }
+    if (is_solved) {
+      table[index] = k + 1;
+      ++pass->n_solved;
+    }
+  }
+  return NULL;
+}
+
+/*!
+ * \brief
+ * Runs one pass over the tables of a material balance and of the balance
+ * with the players swapped, which depend on each other
+ *
+ * \param[in] tablebase  the tablebase
+ * \param[in] materials  the material balances (which may be the same)
+ * \param[in] k          the number of the pass
+ * \param[in] n_threads  the number of threads
+ *
+ * \return
+ * the number of positions solved
+ */
+static guint64
+run_pass(const tablebase_t * const tablebase,
+         guint8                    materials[static 2][4],
+         const guint               k,
+         const guint               n_threads)
+{
+  pass_t * const passes = g_new0(pass_t, n_threads);
+  GThread ** const threads = g_new0(GThread *, n_threads);
+  guint64 n_solved = 0;
+  const guint n_tables = memcmp(materials[0], materials[1], 4) == 0 ? 1 : 2;
+
+  for (guint t = 0; t < n_tables; ++t) {
+    const guint64 size = get_table_size(materials[t]);
+    for (guint i = 0; i < n_threads; ++i) {
+      passes[i].tablebase = tablebase;
+      passes[i].material = materials[t];
+      passes[i].pass = k;
+      passes[i].begin = size * i / n_threads;
+      passes[i].end = size * (i + 1) / n_threads;
+      passes[i].n_solved = 0;
+      threads[i] = g_thread_new("tablebase", pass_thread, &passes[i]);
+    }
+    for (guint i = 0; i < n_threads; ++i) {
+      g_thread_join(threads[i]);
+      n_solved += passes[i].n_solved;
+    }
+  }
+  g_free(threads);
+  g_free(passes);
+  return n_solved;
+}
+
+/*!
+ * \brief
+ * Solves the tables of a material balance and of the balance with the
+ * players swapped, and writes a summary of each
+ *
+ * \param[in,out] tablebase  the tablebase, with tables for the balances
+ * \param[in]     materials  the material balances (which may be the same)
+ * \param[in,out] is_seen    whether each value occurs in the tables solved
+ *                           so far, which is updated
+ * \param[in]     n_threads  the number of threads
+ */
+static void
+solve_tables(const tablebase_t * const tablebase,
+             guint8                    materials[static 2][4],
+             gboolean                  is_seen[static MAX_PLIES + 2],
+             const guint               n_threads)
+{
+  guint64 n_solved = run_pass(tablebase, materials, 0, n_threads);
+  guint max_seen = 0;
+
+  for (guint v = 0; v < MAX_PLIES + 2; ++v) {
+    if (is_seen[v]) max_seen = v;
+  }
+  for (guint k = 1; k <= MAX_PLIES; ++k) {
+    /* a position of pass K needs a move to one of pass K - 1, in these
+       tables or in one that is already solved */
+    if (n_solved == 0 && !is_seen[k]) {
+      if (k > max_seen) break;
+      continue;
+    }
+    n_solved = run_pass(tablebase, materials, k, n_threads);
+  }
+
+  for (guint t = 0; t < 2; ++t) {
+    const guint8 * const material = materials[t];
+    const guint8 * const table =
+      tablebase->tables[get_material_index(material)];
+    const guint64 size = get_table_size(material);
+    guint64 n_outcomes[2] = { 0, 0 };
+    guint64 n_draws = 0;
+    guint longest = 0;
+
+    if (t == 1 && memcmp(materials[0], materials[1], 4) == 0) break;
+    for (guint64 index = 0; index < size; ++index) {
+      position_t position;
+      if (table[index] != 0) {
+        is_seen[table[index]] = TRUE;
+        ++n_outcomes[table[index] % 2];
+        if (table[index] % 2 == 0) longest = MAX(longest, table[index] - 1u);
+      } else if (get_position_at(material, index, &position)) {
+        ++n_draws;
+      }
+    }
+    printf("%u+%uK v %u+%uK: %" G_GUINT64_FORMAT " wins (longest %u "
+           "plies), %" G_GUINT64_FORMAT " losses, %" G_GUINT64_FORMAT
+           " draws\n",
+           material[0], material[1], material[2], material[3],
+           n_outcomes[0], longest, n_outcomes[1], n_draws);
+    fflush(stdout);
+  }
+}
+
+/*!
+ * \brief
+ * Writes the tables of a tablebase to a file
+ *
+ * \param[in] tablebase  the tablebase
+ * \param[in] path       the path of the file
+ * \param[in] error      as for run_tablebase()
+ *
+ * \return
+ * whether the file was written
+ */
+static gboolean
+write_tablebase(const tablebase_t * const tablebase,
+                const gchar * const       path,
+                GError                  **error)
+{
+  static const gchar padding[8] = { 0 };
+  tablebase_header_t header;
+  guint64 offset;
+  gboolean success = TRUE;
+  FILE *file;
+
+  file = g_fopen(path, "wb");
+  if (file == NULL) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't create the tablebase \"%s\"", path);
+    return FALSE;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TABLEBASE_MAGIC, sizeof(header.magic));
+  header.version = GUINT32_TO_LE(TABLEBASE_VERSION);
+  header.max_pieces = GUINT32_TO_LE(tablebase->max_pieces);
+  for (guint i = 0; i < N_MATERIALS; ++i) {
+    if (tablebase->tables[i] != NULL) ++header.n_tables;
+  }
+  offset = sizeof(header) + header.n_tables * sizeof(tablebase_entry_t);
+  header.n_tables = GUINT32_TO_LE(header.n_tables);
+  success &= fwrite(&header, sizeof(header), 1, file) == 1;
+
+  /* the tables follow the entries in the same order, each aligned to
+     eight bytes */
+  for (guint i = 0; i < N_MATERIALS; ++i) {
+    tablebase_entry_t entry;
+    if (tablebase->tables[i] == NULL) continue;
+    memset(&entry, 0, sizeof(entry));
+    entry.material[0] = i / (MATERIAL_RANGE * MATERIAL_RANGE *
+                             MATERIAL_RANGE);
+    entry.material[1] = i / (MATERIAL_RANGE * MATERIAL_RANGE) %
+                        MATERIAL_RANGE;
+    entry.material[2] = i / MATERIAL_RANGE % MATERIAL_RANGE;
+    entry.material[3] = i % MATERIAL_RANGE;
+    offset = (offset + 7) & ~(guint64)7;
+    entry.offset = GUINT64_TO_LE(offset);
+    entry.size = GUINT64_TO_LE(get_table_size(entry.material));
+    offset += get_table_size(entry.material);
+    success &= fwrite(&entry, sizeof(entry), 1, file) == 1;
+  }
+  offset = sizeof(header) +
+           GUINT32_FROM_LE(header.n_tables) * sizeof(tablebase_entry_t);
+  for (guint i = 0; i < N_MATERIALS; ++i) {
+    guint8 material[4];
+    guint64 size;
+    if (tablebase->tables[i] == NULL) continue;
+    material[0] = i / (MATERIAL_RANGE * MATERIAL_RANGE * MATERIAL_RANGE);
+    material[1] = i / (MATERIAL_RANGE * MATERIAL_RANGE) % MATERIAL_RANGE;
+    material[2] = i / MATERIAL_RANGE % MATERIAL_RANGE;
+    material[3] = i % MATERIAL_RANGE;
+    size = get_table_size(material);
+    success &= fwrite(padding, 1, -offset & 7, file) == (-offset & 7);
+    offset = (offset + 7) & ~(guint64)7;
+    success &= fwrite(tablebase->tables[i], 1, size, file) == size;
+    offset += size;
+  }
+
+  if (fclose(file) != 0) success = FALSE;
+  if (!success) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't write the tablebase \"%s\"", path);
+  }
+  return success;
+}
+
+/* documented in tablebase.h */
+gboolean
+run_tablebase(gchar * const *args, GError **error)
+{
+  extern guint option_jobs;
+  const guint n_threads = option_jobs > 0 ? option_jobs
+                                          : g_get_num_processors();
+  gboolean is_seen[MAX_PLIES + 2];
+  tablebase_t *tablebase;
+  guint64 max_pieces;
+  gboolean success;
+  gchar *end;
+
+  assert(args != NULL);
+  assert(error == NULL || *error == NULL);
+
+  if (args[0] == NULL || args[1] == NULL || args[2] != NULL) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Expected " TABLEBASE_COMMAND " PIECES FILE");
+    return FALSE;
+  }
+  max_pieces = g_ascii_strtoull(args[0], &end, 10);
+  if (*end != '\0' || end == args[0] || max_pieces < 2 ||
+      max_pieces > TABLEBASE_MAX_PIECES) {
+    g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                "Invalid number of pieces \"%s\" (expected 2 to %d)",
+                args[0], TABLEBASE_MAX_PIECES);
+    return FALSE;
+  }
+
+  tablebase = g_new0(tablebase_t, 1);
+  tablebase->max_pieces = max_pieces;
+  memset(is_seen, 0, sizeof(is_seen));
+  /* a jump over the last piece of the opponent wins in one ply */
+  is_seen[1] = TRUE;
+
+  /* the tables that a table depends on have fewer pieces, or as many but
+     fewer men, since the men of a jump can't return and a crowned man is
+     a king; only the tables with the players swapped are solved along */
+  for (guint n = 2; n <= max_pieces; ++n) {
+    for (guint men = 0; men <= n; ++men) {
+      for (guint8 own = 1; own < n; ++own) {
+        for (guint8 own_men = 0; own_men <= MIN(own, men); ++own_men) {
+          const guint8 opponent_men = men - own_men;
+          guint8 materials[2][4];
+
+          if (opponent_men > n - own) continue;
+          materials[0][0] = own_men;
+          materials[0][1] = own - own_men;
+          materials[0][2] = opponent_men;
+          materials[0][3] = n - own - opponent_men;
+          materials[1][0] = materials[0][2];
+          materials[1][1] = materials[0][3];
+          materials[1][2] = materials[0][0];
+          materials[1][3] = materials[0][1];
+          if (get_material_index(materials[1]) <
+              get_material_index(materials[0])) continue;
+          for (guint t = 0; t < 2; ++t) {
+            tablebase->tables[get_material_index(materials[t])] =
+              g_malloc0(get_table_size(materials[t]));
+          }
+          solve_tables(tablebase, materials, is_seen, n_threads);
+        }
+      }
+    }
+  }
+
+  success = write_tablebase(tablebase, args[1], error);
+  for (guint i = 0; i < N_MATERIALS; ++i) g_free(tablebase->tables[i]);
+  g_free(tablebase);
+  return success;
+}
+
+/* documented in tablebase.h */
+tablebase_t *
+tablebase_open(const gchar *path, GError **error)
+{
+  tablebase_t *tablebase;
+  const tablebase_header_t *header;
+  const tablebase_entry_t *entries;
+  gchar *data;
+  gsize length;
+  guint32 n_tables;
+
+  assert(path != NULL);
+  assert(error == NULL || *error == NULL);
+
+  tablebase = g_new0(tablebase_t, 1);
+  tablebase->mapped = g_mapped_file_new(path, FALSE, error);
+  if (tablebase->mapped == NULL) {
+    g_free(tablebase);
+    return NULL;
+  }
+  data = g_mapped_file_get_contents(tablebase->mapped);
+  length = g_mapped_file_get_length(tablebase->mapped);
+  header = (const tablebase_header_t *)data;
+  entries = (const tablebase_entry_t *)(header + 1);
+  n_tables = length < sizeof(*header) ? 0 :
+             GUINT32_FROM_LE(header->n_tables);
+
+  if (length < sizeof(*header) ||
+      memcmp(header->magic, TABLEBASE_MAGIC, sizeof(header->magic)) != 0 ||
+      GUINT32_FROM_LE(header->version) != TABLEBASE_VERSION ||
+      GUINT32_FROM_LE(header->max_pieces) > TABLEBASE_MAX_PIECES ||
+      n_tables > (length - sizeof(*header)) / sizeof(tablebase_entry_t)) {
+    n_tables = G_MAXUINT32;
+  } else {
+    tablebase->max_pieces = GUINT32_FROM_LE(header->max_pieces);
+  }
+  for (guint32 i = 0; i < n_tables && n_tables != G_MAXUINT32; ++i) {
+    const guint8 * const material = entries[i].material;
+    const guint64 offset = GUINT64_FROM_LE(entries[i].offset);
+    const guint64 size = GUINT64_FROM_LE(entries[i].size);
+
+    if (material[0] + material[1] + material[2] + material[3] >
+        (gint)tablebase->max_pieces ||
+        size != get_table_size(material) ||
+        offset > length || size > length - offset) {
+      n_tables = G_MAXUINT32;
+      break;
+    }
+    tablebase->tables[get_material_index(material)] =
+      (guint8 *)data + offset;
+  }
+  if (n_tables == G_MAXUINT32) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "\"%s\" isn't a tablebase", path);
+    tablebase_close(tablebase);
+    return NULL;
+  }
+  return tablebase;
+}
+
+/* documented in tablebase.h */
+outcome_t
+tablebase_probe(const tablebase_t *tablebase,
+                const position_t  *position,
+                guint             *plies)
+{
+  gint value;
+
+  assert(tablebase != NULL);
+  assert(position != NULL);
+
+  value = get_value(tablebase, position);
+  if (value < 0) return OUTCOME_UNKNOWN;
+  if (value == 0) return OUTCOME_DRAW;
+  if (plies != NULL) *plies = value - 1;
+  return value % 2 == 0 ? OUTCOME_WIN : OUTCOME_LOSS;
+}
+
+/* documented in tablebase.h */
+void
+tablebase_close(tablebase_t *tablebase)
+{
+  if (tablebase == NULL) return;
+
+  if (tablebase->mapped != NULL) g_mapped_file_unref(tablebase->mapped);
+  g_free(tablebase);
+}
@@ -0,0 +1,143 @@
+/*!
+ * \file tablebase.h
+ * \brief
+ * Provides endgame tablebases: a generator that solves every position with
+ * up to a number of pieces by retrograde analysis, and lookups in the
+ * generated file, which is mapped into memory
+ *
+ * A tablebase holds, for each position with the player to move, whether that
+ * player wins, loses or draws with best play, and the number of plies to the
+ * end of a won game. The number of moves left before a draw is disregarded,
+ * so a tablebase shows wins that a client must play quickly to reach.
+ */
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <gtk/gtk.h>
+#include "rules.h"
+
+/*! \brief The word on the command line that generates a tablebase */
+#define TABLEBASE_COMMAND "tablebase"
+
+/*! \brief The first eight bytes of every tablebase file */
+#define TABLEBASE_MAGIC "CKVTBAS"
+
+/*! \brief The version of the file format written by this program */
+#define TABLEBASE_VERSION 1
+
+/*! \brief Largest number of pieces that a tablebase can be generated for */
+#define TABLEBASE_MAX_PIECES 6
+
+/*!
+ * \brief
+ * Header at the beginning of a tablebase file (all integers little-endian),
+ * followed by a ::tablebase_entry_t for each table
+ */
+typedef struct {
+  /*! \brief #TABLEBASE_MAGIC including the terminating zero */
+  gchar   magic[8];
+  /*! \brief #TABLEBASE_VERSION of the writer */
+  guint32 version;
+  /*! \brief Largest number of pieces of the positions */
+  guint32 max_pieces;
+  /*! \brief Number of tables */
+  guint32 n_tables;
+  /*! \brief Reserved for future use (zero) */
+  guint32 reserved;
+} tablebase_header_t;
+
+/*!
+ * \brief
+ * The location of the table of one material balance in a tablebase file
+ *
+ * A table has one byte per index, as computed in tablebase.c from the
+ * squares of the men and kings of the player to move and of the opponent,
+ * seen from the side of red. Zero is a draw (or no position), and any other
+ * value is one more than the number of plies to the end of the game, which
+ * the player to move wins if the number is odd and loses if it's even.
+ */
+typedef struct {
+  /*! \brief Number of men and kings of the player to move, then of the
+             opponent */
+  guint8  material[4];
+  /*! \brief Reserved for future use (zero) */
+  guint32 reserved;
+  /*! \brief Offset of the table from the beginning of the file */
+  guint64 offset;
+  /*! \brief Number of bytes in the table */
+  guint64 size;
+} tablebase_entry_t;
+
+/*! \brief The result of a position with best play */
+typedef enum {
+  OUTCOME_UNKNOWN, /*!< the position isn't in the tablebase */
+  OUTCOME_WIN,     /*!< the player to move wins */
+  OUTCOME_LOSS,    /*!< the player to move loses */
+  OUTCOME_DRAW     /*!< neither player can force a win */
+} outcome_t;
+
+/*! \brief An opened tablebase (private to tablebase.c) */
+typedef struct tablebase tablebase_t;
+
+/*!
+ * \brief
+ * Generates the tablebase of every position with up to a number of pieces,
+ * and writes it to a file
+ *
+ * The positions of each material balance are solved in passes over all of
+ * them, shared out to the threads set by option \c -j, where the positions
+ * that are won or lost in N plies are found in pass N. A line is written to
+ * standard output for each material balance.
+ *
+ * \param[in] args   a \c NULL-terminated array of the number of pieces and
+ *                   the path of the file
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * whether the tablebase was written
+ */
+gboolean
+run_tablebase(gchar * const *args, GError **error);
+
+/*!
+ * \brief
+ * Opens a tablebase file by mapping it into memory
+ *
+ * \param[in] path   the path of the file
+ * \param[in] error  as for run_tablebase()
+ *
+ * \return
+ * the tablebase, or \c NULL if the file couldn't be read
+ */
+tablebase_t *
+tablebase_open(const gchar *path, GError **error);
+
+/*!
+ * \brief
+ * Looks up a position in a tablebase
+ *
+ * \param[in]  tablebase  the tablebase
+ * \param[in]  position   the position
+ * \param[out] plies      the number of plies to the end of a won or lost
+ *                        game (may be \c NULL)
+ *
+ * \return
+ * the outcome for the player to move
+ */
+outcome_t
+tablebase_probe(const tablebase_t *tablebase,
+                const position_t  *position,
+                guint             *plies);
+
+/*!
+ * \brief
+ * Closes a tablebase
+ *
+ * \param[in] tablebase  the tablebase (or \c NULL)
+ */
+void
+tablebase_close(tablebase_t *tablebase);
+
+#endif /* TABLEBASE_H */
@@ -0,0 +1,355 @@
+/*!
+ * \file timeline.c
+ * \brief
+ * Keeps the material and mobility of each row, updating the material from
+ * the previous row by the squares of the move, and draws them as sparklines
+ * through plot.c.
+ */
+#include <assert.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "timeline.h"
+#include "gui.h"
+#include "plot.h"
+#include "protocol.h"
+#include "rules.h"
+
+/* -- macros for various sizes */
+/*! \brief Number of sparklines, stacked from top to bottom */
+#define N_SPARKLINES 2
+/*! \brief Space around and between the sparklines in pixels */
+#define MARGIN_PX 2.
+/*! \brief Width of a row in pixels while few enough rows have been added */
+#define MAX_ROW_WIDTH_PX 4.
+/*! \brief Largest difference in pieces, the full scale of the material */
+#define MATERIAL_SCALE 12
+/*! \brief Smallest full scale of the mobility in moves */
+#define MIN_MOBILITY_SCALE 10
+
+/*! \brief Index of red in the arrays of ::timeline_row_t */
+#define RED 0
+/*! \brief Index of white in the arrays of ::timeline_row_t */
+#define WHITE 1
+
+/*! \brief The values of a row */
+typedef struct {
+  /*! \brief Whether the row has a board */
+  gboolean is_known;
+  /*! \brief Number of men of red and white */
+  gint8    men[2];
+  /*! \brief Number of kings of red and white */
+  gint8    kings[2];
+  /*! \brief Number of legal moves of red and white the last time that
+             they were to move in the game, or -1 */
+  gint16   mobility[2];
+} timeline_row_t;
+
+/* documented in timeline.h */
+struct timeline {
+  /*! \brief Array of ::timeline_row_t, one per row */
+  GArray *rows;
+  /*! \brief The row whose board is #last_board, or -1 */
+  gint    last_row;
+  /*! \brief The board of the row that was set last */
+  gchar   last_board[NUM_DARK_SQ];
+  /*! \brief Full scale of the mobility sparkline in moves */
+  gint    mobility_scale;
+  /*! \brief The drawing state */
+  plot_t  plot;
+};
+
+/*!
+ * \brief
+ * Adds or removes the piece on a square to or from the material of a row
+ *
+ * \param[in,out] entry  the row
+ * \param[in]     piece  the content of the square (see ::message_t)
+ * \param[in]     sign   1 to add the piece, or -1 to remove it
+ */
+static void
+count_piece(timeline_row_t * const entry,
+            const gchar            piece,
+            const gint8            sign)
+{
+  switch (piece) {
+  case 'r': entry->men[RED]     += sign; break;
+  case 'w': entry->men[WHITE]   += sign; break;
+  case 'R': entry->kings[RED]   += sign; break;
+  case 'W': entry->kings[WHITE] += sign; break;
+  }
+}
+
+/*!
+ * \brief
+ * Gets the squares that a move can change: those it visits and those of
+ * the pieces it jumps over
+ *
+ * \param[in] message  the message of the move
+ *
+ * \return
+ * the squares as bits
+ */
+static guint32
+get_touched_squares(const message_t * const message)
+{
+  guint32 touched = 0;
+
+  for (guint8 k = 0; k < message->n_squares; ++k) {
+    const guint8 to = message->squares[k];
+    touched |= 1u << to;
+    if (k > 0 && message->action > 0) {
+      const guint8 from = message->squares[k - 1];
+      touched |= 1u << BOARD_SQ((BOARD_ROW(from) + BOARD_ROW(to)) / 2,
+                                (BOARD_COL(from) + BOARD_COL(to)) / 2);
+    }
+  }
+  return touched;
+}
+
+/* documented in timeline.h */
+timeline_t *
+timeline_new(void)
+{
+  timeline_t *timeline;
+
+  timeline = g_slice_new(timeline_t);
+  timeline->rows = g_array_new(FALSE, FALSE, sizeof(timeline_row_t));
+  plot_init(&timeline->plot, MARGIN_PX, MAX_ROW_WIDTH_PX);
+  timeline_clear(timeline);
+  return timeline;
+}
+
+/* documented in timeline.h */
+void
+timeline_clear(timeline_t *timeline)
+{
+  assert(timeline != NULL);
+
+  g_array_set_size(timeline->rows, 0);
+  timeline->last_row = -1;
+  timeline->mobility_scale = MIN_MOBILITY_SCALE;
+  plot_clear(&timeline->plot);
+}
+
+/* documented in timeline.h */
+void
+timeline_update(timeline_t      *timeline,
+                guint            row,
+                const message_t *message)
+{
+  static const timeline_row_t unknown = { FALSE, { 0, 0 }, { 0, 0 },
+                                          { -1, -1 } };
+  timeline_row_t *entry;
+  const timeline_row_t *previous;
+  position_t position;
+
+  assert(timeline != NULL);
+  assert(message != NULL);
+
+  /* the result of a game repeats the last board */
+  if (message->action <= -2 && message->action >= -4) return;
+
+  while (timeline->rows->len <= row) {
+    g_array_append_val(timeline->rows, unknown);
+  }
+  entry = &g_array_index(timeline->rows, timeline_row_t, row);
+  previous = row > 0 ? entry - 1 : NULL;
+
+  if (previous != NULL && previous->is_known && message->action >= 0 &&
+      timeline->last_row == (gint)row - 1) {
+    /* only the squares of the move differ from the previous board */
+    guint32 touched = get_touched_squares(message);
+    memcpy(entry->men, previous->men, sizeof(entry->men));
+    memcpy(entry->kings, previous->kings, sizeof(entry->kings));
+    while (touched != 0) {
+      const guint8 i = g_bit_nth_lsf(touched, -1);
+      count_piece(entry, timeline->last_board[i], -1);
+      count_piece(entry, message->board[i], 1);
+      touched &= touched - 1;
+    }
+  } else {
+    memset(entry->men, 0, sizeof(entry->men));
+    memset(entry->kings, 0, sizeof(entry->kings));
+    for (guint8 i = 0; i < NUM_DARK_SQ; ++i) {
+      count_piece(entry, message->board[i], 1);
+    }
+  }
+  entry->is_known = TRUE;
+  memcpy(timeline->last_board, message->board, NUM_DARK_SQ);
+  timeline->last_row = row;
+
+  /* a new game forgets the mobility of the previous one */
+  if (previous != NULL && message->action != -1) {
+    memcpy(entry->mobility, previous->mobility, sizeof(entry->mobility));
+  } else {
+    entry->mobility[RED] = entry->mobility[WHITE] = -1;
+  }
+  if (get_position(message, &position)) {
+    move_t moves[MAX_MOVES];
+    const gint16 n_moves = generate_moves(&position, moves);
+    entry->mobility[position.player == 'r' ? RED : WHITE] = n_moves;
+    /* a larger scale makes every row drawn so far obsolete */
+    while (n_moves > timeline->mobility_scale) {
+      timeline->mobility_scale *= 2;
+      plot_invalidate(&timeline->plot, 0);
+    }
+  }
+  plot_invalidate(&timeline->plot, row);
+}
+
+/* documented in timeline.h */
+void
+timeline_select(timeline_t *timeline, gint row)
+{
+  assert(timeline != NULL);
+
+  timeline->plot.selected = row;
+}
+
+/*!
+ * \brief
+ * Gets the horizontal center of a row in pixels
+ *
+ * \param[in] timeline  the timeline
+ * \param[in] row       the number of the row
+ *
+ * \return
+ * the position
+ */
+static gdouble
+get_row_center(const timeline_t * const timeline, const guint row)
+{
+  return plot_get_row_x(&timeline->plot, row) +
+         timeline->plot.row_width_px/2.;
+}
+
+/*!
+ * \brief
+ * Draws the rows from a given row onwards, following the signature of
+ * ::plot_rows_func_t
+ *
+ * \param[in] cr         the Cairo context of the cache
+ * \param[in] first      the number of the first row to draw
+ * \param[in] user_data  the timeline
+ */
+static void
+draw_rows(cairo_t * const cr, const guint first, const gpointer user_data)
+{
+  const timeline_t * const timeline = user_data;
+  const gdouble height = plot_get_part_height(&timeline->plot,
+                                              N_SPARKLINES);
+  const gdouble zero = MARGIN_PX + height/2.;
+  const gdouble bottom = 2.*(MARGIN_PX + height);
+
+  /* the material balance as bars up for red and down for white, and the
+     mobility as a line per player */
+  cairo_set_line_width(cr, 1.);
+  for (guint8 side = RED; side <= WHITE; ++side) {
+    for (guint i = first; i < timeline->rows->len; ++i) {
+      const timeline_row_t * const entry =
+        &g_array_index(timeline->rows, timeline_row_t, i);
+      const gint balance = entry->men[RED] + entry->kings[RED] -
+                           entry->men[WHITE] - entry->kings[WHITE];
+      if (!entry->is_known || balance == 0 ||
+          (balance > 0) != (side == RED)) {
+        continue;
+      }
+      cairo_rectangle(cr, plot_get_row_x(&timeline->plot, i), zero,
+                      timeline->plot.row_width_px,
+                      -CLAMP(balance, -MATERIAL_SCALE, MATERIAL_SCALE)*
+                      height/2./MATERIAL_SCALE);
+    }
+    plot_set_player_source(cr, side == RED ? 'r' : 'w');
+    cairo_fill(cr);
+
+    for (guint i = MAX(first, 1); i < timeline->rows->len; ++i) {
+      const timeline_row_t * const entry =
+        &g_array_index(timeline->rows, timeline_row_t, i);
+      const gint16 from = (entry - 1)->mobility[side];
+      const gint16 to = entry->mobility[side];
+      if (from < 0 || to < 0) continue;
+      cairo_move_to(cr, get_row_center(timeline, i - 1),
+                    bottom - height*from/timeline->mobility_scale);
+      cairo_line_to(cr, get_row_center(timeline, i),
+                    bottom - height*to/timeline->mobility_scale);
+    }
+    cairo_stroke(cr);
+  }
+}
+
+/*!
+ * \brief
+ * Draws the axes and labels, with the values of the selected row or else
+ * of the last row, following the signature of ::plot_labels_func_t
+ *
+ * \param[in] cr         the Cairo context to draw on
+ * \param[in] user_data  the timeline
+ */
+static void
+draw_labels(cairo_t * const cr, const gpointer user_data)
+{
+  const timeline_t * const timeline = user_data;
+  const gdouble height = plot_get_part_height(&timeline->plot,
+                                              N_SPARKLINES);
+  const gint row = timeline->plot.selected >= 0 ?
+    timeline->plot.selected : (gint)timeline->rows->len - 1;
+  const timeline_row_t *entry = NULL;
+  gchar *labels[N_SPARKLINES];
+
+  if (row >= 0 && (guint)row < timeline->rows->len) {
+    entry = &g_array_index(timeline->rows, timeline_row_t, row);
+  }
+  if (entry != NULL && entry->is_known) {
+    labels[0] = g_strdup_printf("Material r %d+%d w %d+%d",
+                                entry->men[RED], entry->kings[RED],
+                                entry->men[WHITE], entry->kings[WHITE]);
+    labels[1] = g_strdup_printf("Mobility (%d) r %d w %d",
+                                timeline->mobility_scale,
+                                MAX(entry->mobility[RED], 0),
+                                MAX(entry->mobility[WHITE], 0));
+  } else {
+    labels[0] = g_strdup("Material");
+    labels[1] = g_strdup_printf("Mobility (%d)", timeline->mobility_scale);
+  }
+
+  for (guint8 sparkline = 0; sparkline < N_SPARKLINES; ++sparkline) {
+    const gdouble top = MARGIN_PX + sparkline*(MARGIN_PX + height);
+    /* the material is drawn around the middle, the mobility from below */
+    const gdouble axis = sparkline == 0 ? top + height/2. : top + height;
+    plot_draw_axis(&timeline->plot, cr, axis,
+                   timeline->plot.width_px/2., top, labels[sparkline]);
+    g_free(labels[sparkline]);
+  }
+}
+
+/* documented in timeline.h */
+void
+timeline_draw(timeline_t *timeline, cairo_t *cr, int width_px,
+              int height_px)
+{
+  assert(timeline != NULL);
+  assert(cr != NULL);
+
+  plot_draw(&timeline->plot, cr, width_px, height_px, timeline->rows->len,
+            draw_rows, draw_labels, timeline);
+}
+
+/* documented in timeline.h */
+gint
+timeline_get_row_at(const timeline_t *timeline, gdouble x)
+{
+  assert(timeline != NULL);
+
+  return plot_get_row_at(&timeline->plot, x, timeline->rows->len);
+}
+
+/* documented in timeline.h */
+void
+timeline_free(timeline_t *timeline)
+{
+  assert(timeline != NULL);
+
+  plot_finish(&timeline->plot);
+  g_array_free(timeline->rows, TRUE);
+  g_slice_free(timeline_t, timeline);
+}
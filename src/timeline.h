@@ -0,0 +1,102 @@
+/*!
+ * \file timeline.h
+ * \brief
+ * Provides a compact timeline of the material and mobility of each side,
+ * which is updated from the previous row as rows are added and drawn as
+ * sparklines
+ */
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <gtk/gtk.h>
+#include "protocol.h"
+
+/*! \brief The timeline of a game (private to timeline.c) */
+typedef struct timeline timeline_t;
+
+/*!
+ * \brief
+ * Creates an empty timeline
+ *
+ * \return
+ * the timeline, to be freed with timeline_free()
+ */
+timeline_t *
+timeline_new(void);
+
+/*!
+ * \brief
+ * Removes every row from the timeline
+ *
+ * \param[in] timeline  the timeline
+ */
+void
+timeline_clear(timeline_t *timeline);
+
+/*!
+ * \brief
+ * Sets the board of a row, adding the rows up to it if needed
+ *
+ * The material is updated from the previous row on the squares of the move
+ * alone, when the previous row was the last one set, and is otherwise
+ * counted on the whole board. The mobility is the number of legal moves of
+ * the player to move, and the last mobility of the other player is kept.
+ * Only the updated row is redrawn by the next call to timeline_draw(),
+ * unless it no longer fits in the current scale.
+ *
+ * \param[in] timeline  the timeline
+ * \param[in] row       the number of the row
+ * \param[in] message   the message of the row
+ */
+void
+timeline_update(timeline_t      *timeline,
+                guint            row,
+                const message_t *message);
+
+/*!
+ * \brief
+ * Marks a row as selected, whose values are written next to the sparklines
+ *
+ * \param[in] timeline  the timeline
+ * \param[in] row       the number of the row, or -1 to select none
+ */
+void
+timeline_select(timeline_t *timeline, gint row);
+
+/*!
+ * \brief
+ * Draws the sparklines, reusing what was drawn previously at the same size
+ *
+ * \param[in] timeline   the timeline
+ * \param[in] cr         the Cairo context to draw on
+ * \param[in] width_px   the width of the widget in pixels
+ * \param[in] height_px  the height of the widget in pixels
+ */
+void
+timeline_draw(timeline_t *timeline, cairo_t *cr, int width_px,
+              int height_px);
+
+/*!
+ * \brief
+ * Finds the row drawn at a horizontal position
+ *
+ * \param[in] timeline  the timeline
+ * \param[in] x         the position in pixels, as in the last
+ *                      timeline_draw()
+ *
+ * \return
+ * the number of the row, or -1 if there is no row at \p x
+ */
+gint
+timeline_get_row_at(const timeline_t *timeline, gdouble x);
+
+/*!
+ * \brief
+ * Frees the timeline
+ *
+ * \param[in] timeline  the timeline
+ */
+void
+timeline_free(timeline_t *timeline);
+
+#endif /* TIMELINE_H */
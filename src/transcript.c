@@ -0,0 +1,229 @@
+/*!
+ * \file transcript.c
+ * \brief
+ * Records transcripts of the clients' output, and reads them back one line
+ * at a time so that transcripts of any size can be replayed.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "transcript.h"
+#include "gui.h"
+
+/*! \brief Size of the buffer when reading a transcript */
+#define BUFFER_SIZE (64<<10)
+
+/*! \brief Characters identifying the output type in a tag */
+static const gchar type_tags[2] = { 'o', 'e' };
+
+/*! \brief Character identifying a line of reply measurements in a tag */
+#define THINK_TAG 't'
+
+/*! \brief A transcript being written */
+struct transcript_writer {
+  /*! \brief The file being written */
+  FILE    *file;
+  /*! \brief Incomplete lines held back for each channel */
+  GString *pending[NUM_CHANNELS];
+};
+
+/*! \brief A transcript being read */
+struct transcript_reader {
+  /*! \brief The channel that the lines are read from */
+  GIOChannel *channel;
+  /*! \brief The most recently read line */
+  GString    *line;
+  /*! \brief Measurements of each client's next reply */
+  reply_stats_t stats[NUM_CLIENTS];
+};
+
+/* documented in transcript.h */
+transcript_writer_t *
+transcript_writer_open(const gchar *path, GError **error)
+{
+  transcript_writer_t *writer;
+  FILE *file;
+
+  assert(path != NULL);
+
+  file = g_fopen(path, "wb");
+  if (file == NULL) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                "Couldn't create the transcript \"%s\"", path);
+    return NULL;
+  }
+
+  writer = g_slice_new(transcript_writer_t);
+  writer->file = file;
+  for (guint8 i = 0; i < NUM_CHANNELS; ++i) {
+    writer->pending[i] = g_string_new(NULL);
+  }
+  return writer;
+}
+
+/*!
+ * \brief
+ * Writes one tagged line, consisting of held back text and a new segment
+ *
+ * \param[in] writer      the writer
+ * \param[in] channel_id  the channel that the line came from
+ * \param[in] text        the rest of the line, including the newline
+ * \param[in] len         the length of \p text in bytes
+ */
+static void
+write_line(transcript_writer_t * const writer,
+           const guint8                channel_id,
+           const gchar         * const text,
+           const gsize                 len)
+{
+  GString * const pending = writer->pending[channel_id];
+
+  fprintf(writer->file, "%u%c ", CLIENT_ID(channel_id) + 1,
+          type_tags[IS_STDERR(channel_id)]);
+  fwrite(pending->str, 1, pending->len, writer->file);
+  fwrite(text, 1, len, writer->file);
+  g_string_truncate(pending, 0);
+}
+
+/* documented in transcript.h */
+void
+transcript_writer_append(transcript_writer_t *writer,
+                         const gchar         *text,
+                         gsize                len,
+                         guint8               channel_id,
+                         const reply_stats_t *stats)
+{
+  const gchar *end = text + len;
+
+  assert(writer != NULL);
+  assert(channel_id < NUM_CHANNELS);
+
+  if (stats != NULL) {
+    fprintf(writer->file, "%u%c %" G_GINT64_FORMAT " %" G_GINT64_FORMAT
+            " %" G_GINT64_FORMAT "\n", CLIENT_ID(channel_id) + 1, THINK_TAG,
+            stats->think_us, stats->cpu_us, stats->rss_kb);
+  }
+  while (text < end) {
+    const gchar *newline = memchr(text, '\n', end - text);
+    if (newline == NULL) {
+      g_string_append_len(writer->pending[channel_id], text, end - text);
+      break;
+    }
+    write_line(writer, channel_id, text, newline + 1 - text);
+    text = newline + 1;
+  }
+  fflush(writer->file);
+}
+
+/* documented in transcript.h */
+void
+transcript_writer_close(transcript_writer_t *writer)
+{
+  assert(writer != NULL);
+
+  for (guint8 i = 0; i < NUM_CHANNELS; ++i) {
+    if (writer->pending[i]->len > 0) write_line(writer, i, "\n", 1);
+    g_string_free(writer->pending[i], TRUE);
+  }
+  fclose(writer->file);
+  g_slice_free(transcript_writer_t, writer);
+}
+
+/* documented in transcript.h */
+transcript_reader_t *
+transcript_reader_open(const gchar *path, GError **error)
+{
+  transcript_reader_t *reader;
+  GIOChannel *channel;
+
+  assert(path != NULL);
+
+  if (strcmp(path, "-") == 0) {
+    channel = g_io_channel_unix_new(0);
+  } else {
+    channel = g_io_channel_new_file(path, "r", error);
+    if (channel == NULL) return NULL;
+  }
+  /* pass the output on unchanged, just like the live clients' output */
+  g_io_channel_set_encoding(channel, NULL, NULL);
+  g_io_channel_set_buffer_size(channel, BUFFER_SIZE);
+
+  reader = g_slice_new(transcript_reader_t);
+  reader->channel = channel;
+  reader->line = g_string_sized_new(256);
+  for (guint8 i = 0; i < NUM_CLIENTS; ++i) {
+    reader->stats[i].think_us = -1;
+    reader->stats[i].cpu_us   = -1;
+    reader->stats[i].rss_kb   = -1;
+  }
+  return reader;
+}
+
+/* documented in transcript.h */
+const gchar *
+transcript_reader_next(transcript_reader_t *reader,
+                       guint8              *channel_id,
+                       gsize               *len,
+                       reply_stats_t       *stats)
+{
+  static const reply_stats_t unknown = { -1, -1, -1 };
+
+  assert(reader != NULL);
+  assert(channel_id != NULL);
+  assert(len != NULL);
+  assert(stats != NULL);
+
+  while (g_io_channel_read_line_string(reader->channel, reader->line, NULL,
+                                       NULL) == G_IO_STATUS_NORMAL) {
+    const gchar * const tag = reader->line->str;
+    guint8 client_id;
+    guint8 type;
+
+    if (reader->line->len < 3 || tag[0] < '1' ||
+        tag[0] >= '1' + NUM_CLIENTS || tag[2] != ' ') continue;
+    client_id = tag[0] - '1';
+    if (tag[1] == THINK_TAG) {
+      /* missing figures (such as in older transcripts) are unknown */
+      gint64 * const figures[3] = { &reader->stats[client_id].think_us,
+                                    &reader->stats[client_id].cpu_us,
+                                    &reader->stats[client_id].rss_kb };
+      gchar *p = reader->line->str + 3;
+      for (guint8 i = 0; i < G_N_ELEMENTS(figures); ++i) {
+        gchar *end;
+        *figures[i] = g_ascii_strtoll(p, &end, 10);
+        if (end == p) *figures[i] = -1;
+        p = end;
+      }
+      continue;
+    } else if (tag[1] == type_tags[STDOUT]) {
+      type = STDOUT;
+    } else if (tag[1] == type_tags[STDERR]) {
+      type = STDERR;
+    } else {
+      continue;
+    }
+
+    *channel_id = CHANNEL_ID(client_id, type);
+    *len = reader->line->len - 3;
+    *stats = unknown;
+    if (type == STDOUT) {
+      *stats = reader->stats[client_id];
+      reader->stats[client_id] = unknown;
+    }
+    return reader->line->str + 3;
+  }
+  return NULL;
+}
+
+/* documented in transcript.h */
+void
+transcript_reader_close(transcript_reader_t *reader)
+{
+  assert(reader != NULL);
+
+  g_io_channel_unref(reader->channel);
+  g_string_free(reader->line, TRUE);
+  g_slice_free(transcript_reader_t, reader);
+}
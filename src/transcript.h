@@ -0,0 +1,126 @@
+/*!
+ * \file transcript.h
+ * \brief
+ * Provides functions to record and read transcripts of the clients' output
+ *
+ * A transcript is a text file with one line of client output per line,
+ * prefixed by a tag telling where it came from: the client number (\c 1 or
+ * \c 2), \c o for standard output or \c e for standard error, and a space.
+ * The lines are in the order they were received. A line tagged with \c t
+ * instead precedes a reply with its measurements (see #reply_stats_t): the
+ * think time and CPU time in microseconds, and the resident set size in KiB,
+ * where -1 means unknown. For example:
+ *
+ *     1t 1204 1000 1532
+ *     1o rrrrrrrrrrrr........wwwwwwwwwwww -1 r 50
+ *     2e searching to depth 8
+ *     2t 853211 840000 10240
+ *     2o rrrrrrrrrr.r..r.....wwwwwwwwwwww 0_11_15 w 49
+ */
+#ifndef TRANSCRIPT_H
+#define TRANSCRIPT_H
+
+#include <gtk/gtk.h>
+#include "clients.h"
+
+/*! \brief A transcript being written (private to transcript.c) */
+typedef struct transcript_writer transcript_writer_t;
+
+/*! \brief A transcript being read (private to transcript.c) */
+typedef struct transcript_reader transcript_reader_t;
+
+/*!
+ * \brief
+ * Creates (or truncates) a transcript file for writing
+ *
+ * \param[in] path   the file name
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * the writer, or \c NULL on error
+ */
+transcript_writer_t *
+transcript_writer_open(const gchar *path, GError **error);
+
+/*!
+ * \brief
+ * Records output from a client
+ *
+ * The output doesn't have to consist of whole lines. Complete lines are
+ * written immediately, while an incomplete line is held back until the rest
+ * of it arrives (or the transcript is closed).
+ *
+ * \param[in] writer      the writer
+ * \param[in] text        the output
+ * \param[in] len         the length of \p text in bytes
+ * \param[in] channel_id  the channel that the output came from, as specified
+ *                        by #CHANNEL_ID
+ * \param[in] stats       measurements of the reply, as for append_text()
+ */
+void
+transcript_writer_append(transcript_writer_t *writer,
+                         const gchar         *text,
+                         gsize                len,
+                         guint8               channel_id,
+                         const reply_stats_t *stats);
+
+/*!
+ * \brief
+ * Writes any incomplete lines and closes the transcript
+ *
+ * \param[in] writer  the writer, which is freed
+ */
+void
+transcript_writer_close(transcript_writer_t *writer);
+
+/*!
+ * \brief
+ * Opens a transcript for reading
+ *
+ * Nothing but the first buffer of the file is read, so this returns
+ * immediately regardless of the size of the transcript.
+ *
+ * \param[in] path   the file name, or \c "-" for standard input
+ * \param[in] error  as for transcript_writer_open()
+ *
+ * \return
+ * the reader, or \c NULL on error
+ */
+transcript_reader_t *
+transcript_reader_open(const gchar *path, GError **error);
+
+/*!
+ * \brief
+ * Reads the next line of output from a transcript
+ *
+ * Lines without a valid tag are skipped.
+ *
+ * \param[in]  reader      the reader
+ * \param[out] channel_id  the channel that the line came from
+ * \param[out] len         the length of the line in bytes, including the
+ *                         trailing newline
+ * \param[out] stats       the measurements recorded before the line, if it's
+ *                         the first stdout line of a reply, otherwise all -1
+ *
+ * \return
+ * the line, which is valid until the next call, or \c NULL at end-of-file or
+ * on errors
+ */
+const gchar *
+transcript_reader_next(transcript_reader_t *reader,
+                       guint8              *channel_id,
+                       gsize               *len,
+                       reply_stats_t       *stats);
+
+/*!
+ * \brief
+ * Closes a transcript that was opened for reading
+ *
+ * \param[in] reader  the reader, which is freed
+ */
+void
+transcript_reader_close(transcript_reader_t *reader);
+
+#endif /* TRANSCRIPT_H */
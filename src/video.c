@@ -0,0 +1,520 @@
+/*!
+ * \file video.c
+ * \brief
+ * Encodes recorded games frame by frame into an animated PNG (APNG) or a raw
+ * YUV4MPEG2 (Y4M) stream.
+ *
+ * Both encoders are streaming: a frame is drawn on a single reusable image
+ * surface, converted and written before the next message is read.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "video.h"
+#include "board.h"
+#include "gamelog.h"
+#include "protocol.h"
+
+/*! \brief Maximum size of the data in each IDAT or fdAT chunk */
+#define CHUNK_SIZE (64<<10)
+
+/*! \brief Enumeration of the supported animation formats */
+typedef enum {
+  VIDEO_APNG,     /*!< animated PNG, lossless with per-frame delays */
+  VIDEO_Y4M,      /*!< uncompressed 4:2:0 video for piping into encoders */
+  N_VIDEO_FORMATS /*!< number of formats (end of enum) */
+} video_format_t;
+
+/*! \brief Format names, indexed by ::video_format_t */
+static const gchar * const video_formats[N_VIDEO_FORMATS] = { "apng", "y4m" };
+
+/*!
+ * \brief
+ * State of an ongoing encoding
+ */
+typedef struct {
+  /*! \brief The format being written */
+  video_format_t format;
+  /*! \brief Width and height of each frame in pixels */
+  gint size;
+  /*! \brief Output stream */
+  FILE *file;
+  /*! \brief The image surface that every frame is drawn on */
+  cairo_surface_t *surface;
+  /*! \brief Cairo context belonging to #surface */
+  cairo_t *cr;
+  /*! \brief Number of frames written so far */
+  guint n_frames;
+  /*! \brief APNG: deflate stream, reset for every frame */
+  z_stream zs;
+  /*! \brief APNG: compressed data waiting to be written as a chunk */
+  guint8 *zbuf;
+  /*! \brief APNG: one filtered scanline, including the filter type byte */
+  guint8 *scanline;
+  /*! \brief APNG: sequence number of the next fcTL or fdAT chunk */
+  guint32 sequence;
+  /*! \brief Y4M: the two chroma planes of the current frame */
+  guint8 *chroma;
+} encoder_t;
+
+/*!
+ * \brief
+ * Writes a 32-bit unsigned integer in network byte order
+ *
+ * \param[out] p  the location to write to (at least four bytes)
+ * \param[in]  v  the value
+ */
+static void
+put_u32(guint8 * const p, const guint32 v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+/*!
+ * \brief
+ * Writes a PNG chunk consisting of an optional prefix and a payload
+ *
+ * \param[in] enc         the encoder
+ * \param[in] type        the four-letter chunk type
+ * \param[in] prefix      bytes to write before \p data (or \c NULL)
+ * \param[in] prefix_len  the length of \p prefix
+ * \param[in] data        the payload (or \c NULL)
+ * \param[in] len         the length of \p data
+ */
+static void
+write_chunk(encoder_t    * const enc,
+            const gchar  * const type,
+            const guint8 * const prefix,
+            const gsize          prefix_len,
+            const guint8 * const data,
+            const gsize          len)
+{
+  guint8 word[4];
+  uLong crc;
+
+  put_u32(word, prefix_len + len);
+  fwrite(word, 1, 4, enc->file);
+  fwrite(type, 1, 4, enc->file);
+  crc = crc32(0L, (const Bytef *)type, 4);
+  if (prefix_len > 0) {
+    fwrite(prefix, 1, prefix_len, enc->file);
+    crc = crc32(crc, prefix, prefix_len);
+  }
+  if (len > 0) {
+    fwrite(data, 1, len, enc->file);
+    crc = crc32(crc, data, len);
+  }
+  put_u32(word, crc);
+  fwrite(word, 1, 4, enc->file);
+}
+
+/*!
+ * \brief
+ * Writes the compressed data collected so far as an IDAT chunk (first frame)
+ * or fdAT chunk (following frames)
+ *
+ * \param[in] enc  the encoder
+ */
+static void
+flush_image_data(encoder_t * const enc)
+{
+  const gsize len = CHUNK_SIZE - enc->zs.avail_out;
+
+  if (len == 0) return;
+
+  if (enc->n_frames == 0) {
+    write_chunk(enc, "IDAT", NULL, 0, enc->zbuf, len);
+  } else {
+    guint8 sequence[4];
+    put_u32(sequence, enc->sequence++);
+    write_chunk(enc, "fdAT", sequence, 4, enc->zbuf, len);
+  }
+  enc->zs.next_out = enc->zbuf;
+  enc->zs.avail_out = CHUNK_SIZE;
+}
+
+/*!
+ * \brief
+ * Feeds data into the deflate stream, writing chunks whenever the output
+ * buffer fills up
+ *
+ * \param[in] enc    the encoder
+ * \param[in] data   the uncompressed data (or \c NULL when finishing)
+ * \param[in] len    the length of \p data
+ * \param[in] flush  \c Z_NO_FLUSH, or \c Z_FINISH at the end of the frame
+ */
+static void
+deflate_data(encoder_t * const enc,
+             guint8    * const data,
+             const gsize       len,
+             const int         flush)
+{
+  int status;
+
+  enc->zs.next_in = data;
+  enc->zs.avail_in = len;
+  do {
+    status = deflate(&enc->zs, flush);
+    if (enc->zs.avail_out == 0) flush_image_data(enc);
+  } while (enc->zs.avail_in > 0 ||
+           (flush == Z_FINISH && status != Z_STREAM_END));
+  if (flush == Z_FINISH) flush_image_data(enc);
+}
+
+/*!
+ * \brief
+ * Writes the PNG signature and the chunks that precede the first frame
+ *
+ * \param[in] enc       the encoder
+ * \param[in] n_frames  the total number of frames in the animation
+ */
+static void
+write_apng_header(encoder_t * const enc, const guint n_frames)
+{
+  static const guint8 signature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+  guint8 ihdr[13];
+  guint8 actl[8];
+
+  fwrite(signature, 1, sizeof(signature), enc->file);
+
+  put_u32(ihdr, enc->size);
+  put_u32(ihdr + 4, enc->size);
+  ihdr[8]  = 8; /* bit depth */
+  ihdr[9]  = 2; /* color type: truecolor */
+  ihdr[10] = 0; /* compression method: deflate */
+  ihdr[11] = 0; /* filter method: adaptive */
+  ihdr[12] = 0; /* interlace method: none */
+  write_chunk(enc, "IHDR", NULL, 0, ihdr, sizeof(ihdr));
+
+  put_u32(actl, n_frames);
+  put_u32(actl + 4, 0); /* loop forever */
+  write_chunk(enc, "acTL", NULL, 0, actl, sizeof(actl));
+}
+
+/*!
+ * \brief
+ * Writes the surface as the next APNG frame
+ *
+ * \param[in] enc       the encoder
+ * \param[in] delay_ms  how long the frame is shown
+ */
+static void
+write_apng_frame(encoder_t * const enc, const guint delay_ms)
+{
+  const guint8 *data = cairo_image_surface_get_data(enc->surface);
+  const int stride = cairo_image_surface_get_stride(enc->surface);
+  const guint width = 3*enc->size;
+  guint8 fctl[26];
+
+  put_u32(fctl, enc->sequence++);
+  put_u32(fctl + 4, enc->size);
+  put_u32(fctl + 8, enc->size);
+  put_u32(fctl + 12, 0);                  /* x offset */
+  put_u32(fctl + 16, 0);                  /* y offset */
+  fctl[20] = MIN(delay_ms, 0xffff) >> 8;  /* delay numerator */
+  fctl[21] = MIN(delay_ms, 0xffff);
+  fctl[22] = 1000 >> 8;                   /* delay denominator */
+  fctl[23] = 1000 & 0xff;
+  fctl[24] = 0;                           /* dispose: none */
+  fctl[25] = 0;                           /* blend: source */
+  write_chunk(enc, "fcTL", NULL, 0, fctl, sizeof(fctl));
+
+  deflateReset(&enc->zs);
+  for (gint y = 0; y < enc->size; ++y) {
+    const guint32 * const pixels = (const guint32 *)(data + y*stride);
+    guint8 * const raw = enc->scanline + 1;
+
+    for (gint x = 0; x < enc->size; ++x) {
+      raw[3*x]     = pixels[x] >> 16;
+      raw[3*x + 1] = pixels[x] >> 8;
+      raw[3*x + 2] = pixels[x];
+    }
+    /* the "Sub" filter turns the large flat areas of the board into zeros,
+       working backwards so that the unfiltered bytes are still available */
+    enc->scanline[0] = 1;
+    for (guint i = width - 1; i >= 3; --i) raw[i] -= raw[i - 3];
+
+    deflate_data(enc, enc->scanline, width + 1, Z_NO_FLUSH);
+  }
+  deflate_data(enc, NULL, 0, Z_FINISH);
+}
+
+/*!
+ * \brief
+ * Writes the YUV4MPEG2 stream header
+ *
+ * \param[in] enc       the encoder
+ * \param[in] delay_ms  how long each frame is shown
+ */
+static void
+write_y4m_header(encoder_t * const enc, const guint delay_ms)
+{
+  fprintf(enc->file,
+          "YUV4MPEG2 W%d H%d F1000:%u Ip A1:1 C420jpeg XYSCSS=420JPEG\n",
+          enc->size, enc->size, MAX(delay_ms, 1));
+}
+
+/*!
+ * \brief
+ * Writes the surface as the next YUV4MPEG2 frame (full-range BT.601)
+ *
+ * The luma plane is written row by row, while the subsampled chroma planes
+ * are collected in a buffer and written after it.
+ *
+ * \param[in] enc  the encoder
+ */
+static void
+write_y4m_frame(encoder_t * const enc)
+{
+  const guint8 *data = cairo_image_surface_get_data(enc->surface);
+  const int stride = cairo_image_surface_get_stride(enc->surface);
+  const gint half = enc->size/2;
+  guint8 * const cb = enc->chroma;
+  guint8 * const cr = enc->chroma + half*half;
+
+  fputs("FRAME\n", enc->file);
+
+  for (gint y = 0; y < enc->size; ++y) {
+    const guint32 * const pixels = (const guint32 *)(data + y*stride);
+    /* reuse the scanline buffer for luma */
+    guint8 * const luma = enc->scanline;
+
+    for (gint x = 0; x < enc->size; ++x) {
+      const gint r = (pixels[x] >> 16) & 0xff;
+      const gint g = (pixels[x] >> 8) & 0xff;
+      const gint b = pixels[x] & 0xff;
+      luma[x] = (77*r + 150*g + 29*b + 128) >> 8;
+    }
+    fwrite(luma, 1, enc->size, enc->file);
+
+    /* average each 2x2 block once both of its rows are available */
+    if ((y & 1) == 0) continue;
+    for (gint x = 0; x < half; ++x) {
+      const guint32 * const above = (const guint32 *)(data + (y - 1)*stride);
+      gint r = 0, g = 0, b = 0;
+      for (guint8 i = 0; i < 4; ++i) {
+        const guint32 p = (i < 2 ? above : pixels)[2*x + (i & 1)];
+        r += (p >> 16) & 0xff;
+        g += (p >> 8) & 0xff;
+        b += p & 0xff;
+      }
+      /* the sums are four times the average, hence the extra shift by 2 */
+      cb[(y/2)*half + x] =
+        CLAMP((128*1024 - 43*r -  85*g + 128*b + 512) >> 10, 0, 255);
+      cr[(y/2)*half + x] =
+        CLAMP((128*1024 + 128*r - 107*g -  21*b + 512) >> 10, 0, 255);
+    }
+  }
+  fwrite(enc->chroma, 1, 2*half*half, enc->file);
+}
+
+/*!
+ * \brief
+ * Draws a message on the surface and writes it as the next frame
+ *
+ * \param[in] enc       the encoder
+ * \param[in] line      the message to draw
+ * \param[in] delay_ms  how long the frame is shown
+ */
+static void
+encode_message(encoder_t * const enc, gchar * const line, const guint delay_ms)
+{
+  gchar  *board       = NULL;
+  GSList *moves       = NULL;
+  gchar  *description = NULL;
+  gchar  *player      = NULL;
+
+  parse_client_stdout(line, &board, &moves, &description, &player);
+  cairo_save(enc->cr);
+  draw_board(enc->cr, enc->size, enc->size, board, moves, NULL);
+  cairo_restore(enc->cr);
+  cairo_surface_flush(enc->surface);
+
+  g_free(board);
+  g_slist_free(moves);
+  g_free(description);
+  g_free(player);
+
+  if (enc->format == VIDEO_APNG) {
+    write_apng_frame(enc, delay_ms);
+  } else {
+    write_y4m_frame(enc);
+  }
+  ++enc->n_frames;
+}
+
+/*!
+ * \brief
+ * Counts the positions in a set of games without keeping them in memory
+ *
+ * \param[in]  files     the files to read
+ * \param[out] n_frames  the total number of positions
+ * \param[in]  error     as for encode_games()
+ *
+ * \return
+ * whether all files could be read
+ */
+static gboolean
+count_frames(gchar * const *files, guint * const n_frames, GError **error)
+{
+  *n_frames = 0;
+  for (; *files != NULL; ++files) {
+    gamelog_t *log;
+    gchar *line;
+    GError *read_error = NULL;
+
+    if (strcmp(*files, "-") == 0) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                  "APNG can't be encoded from standard input, since the "
+                  "number of frames must be known in advance");
+      return FALSE;
+    }
+    log = gamelog_open(*files, error);
+    if (log == NULL) return FALSE;
+    while ((line = gamelog_read(log, &read_error)) != NULL) {
+      ++*n_frames;
+      g_free(line);
+    }
+    gamelog_close(log);
+    if (read_error != NULL) {
+      g_propagate_error(error, read_error);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/* documented in video.h */
+gboolean
+is_video_format(const gchar *format)
+{
+  for (guint8 i = 0; i < N_VIDEO_FORMATS; ++i) {
+    if (g_ascii_strcasecmp(format, video_formats[i]) == 0) return TRUE;
+  }
+  return FALSE;
+}
+
+/* documented in video.h */
+gboolean
+encode_games(gchar * const *files, GError **error)
+{
+  extern gchar *option_export_format;
+  extern gchar *option_output;
+  extern gint   option_size_px;
+  extern guint  option_timeout_ms;
+  encoder_t enc;
+  guint n_frames = 0;
+  gboolean success = TRUE;
+
+  assert(files != NULL);
+  assert(error == NULL || *error == NULL);
+
+  memset(&enc, 0, sizeof(enc));
+  enc.format = g_ascii_strcasecmp(option_export_format, "apng") == 0
+    ? VIDEO_APNG : VIDEO_Y4M;
+  /* 4:2:0 subsampling needs an even size */
+  enc.size = (MAX(option_size_px, 2) + 1) & ~1;
+
+  if (enc.format == VIDEO_APNG) {
+    if (!count_frames(files, &n_frames, error)) return FALSE;
+    if (n_frames == 0) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                  "There are no positions to encode");
+      return FALSE;
+    }
+  }
+
+  if (option_output == NULL || strcmp(option_output, "-") == 0) {
+    enc.file = stdout;
+  } else {
+    enc.file = g_fopen(option_output, "wb");
+    if (enc.file == NULL) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                  "Couldn't open \"%s\" for writing", option_output);
+      return FALSE;
+    }
+  }
+
+  enc.surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+                                           enc.size, enc.size);
+  enc.cr = cairo_create(enc.surface);
+  enc.scanline = g_malloc(3*enc.size + 1);
+
+  if (enc.format == VIDEO_APNG) {
+    enc.zbuf = g_malloc(CHUNK_SIZE);
+    enc.zs.next_out = enc.zbuf;
+    enc.zs.avail_out = CHUNK_SIZE;
+    deflateInit(&enc.zs, Z_DEFAULT_COMPRESSION);
+    write_apng_header(&enc, n_frames);
+  } else {
+    enc.chroma = g_malloc(2*(enc.size/2)*(enc.size/2));
+    write_y4m_header(&enc, option_timeout_ms);
+  }
+
+  for (; *files != NULL && success; ++files) {
+    gamelog_t *log;
+    gchar *line;
+    gchar *shown = NULL;
+    GError *read_error = NULL;
+
+    log = gamelog_open(*files, error);
+    if (log == NULL) {
+      success = FALSE;
+      break;
+    }
+    /* a position stays on the board while the next move is being thought
+       out, so a frame is written once the next think time is known */
+    do {
+      gint64 think_us;
+      line = gamelog_read(log, &read_error);
+      think_us = line != NULL ? gamelog_get_think_time(log) : -1;
+      /* the files may have grown since they were counted */
+      if (shown != NULL &&
+          (enc.format != VIDEO_APNG || enc.n_frames < n_frames)) {
+        encode_message(&enc, shown, think_us >= 0
+                                    ? (guint)MAX((think_us + 500)/1000, 1)
+                                    : option_timeout_ms);
+      }
+      g_free(shown);
+      shown = line;
+    } while (line != NULL);
+    gamelog_close(log);
+    if (read_error != NULL) {
+      g_propagate_error(error, read_error);
+      success = FALSE;
+    }
+  }
+
+  if (enc.format == VIDEO_APNG) {
+    if (success && enc.n_frames != n_frames) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                  "The games changed while they were being encoded");
+      success = FALSE;
+    }
+    write_chunk(&enc, "IEND", NULL, 0, NULL, 0);
+    deflateEnd(&enc.zs);
+    g_free(enc.zbuf);
+  } else {
+    g_free(enc.chroma);
+  }
+  g_free(enc.scanline);
+  cairo_destroy(enc.cr);
+  cairo_surface_destroy(enc.surface);
+
+  if (fflush(enc.file) != 0 || ferror(enc.file)) {
+    if (success) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                  "Couldn't write the %s stream", option_export_format);
+    }
+    success = FALSE;
+  }
+  if (enc.file != stdout) fclose(enc.file);
+
+  return success;
+}
@@ -0,0 +1,48 @@
+/*!
+ * \file video.h
+ * \brief
+ * Provides functions to encode recorded games as animations
+ */
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <gtk/gtk.h>
+
+/*!
+ * \brief
+ * Checks whether an export format is handled by encode_games()
+ *
+ * \param[in] format  the format name given on the command line
+ *
+ * \return
+ * \c TRUE for \c "apng" and \c "y4m", otherwise \c FALSE
+ */
+gboolean
+is_video_format(const gchar *format);
+
+/*!
+ * \brief
+ * Encodes one or more recorded games into a single animated PNG or a raw
+ * YUV4MPEG2 stream
+ *
+ * The games are played back to back, each position being one frame. In an
+ * APNG, a position from a session file is shown for as long as the next move
+ * was thought out, while other frames last for the animation timeout. Every
+ * frame is drawn on the same image surface and written as soon as it has been
+ * drawn, so memory usage doesn't depend on the length of the games.
+ *
+ * \param[in] files  a \c NULL-terminated array of file names to read the games
+ *                   from, where \c "-" means standard input (which isn't
+ *                   possible for APNG, as the number of frames has to be
+ *                   known in advance)
+ * \param[in] error  either \c NULL to disregard errors, or the address of a
+ *                   pointer initialized to \c NULL (which should be freed
+ *                   afterwards if set)
+ *
+ * \return
+ * whether the whole stream was successfully written
+ */
+gboolean
+encode_games(gchar * const *files, GError **error);
+
+#endif /* VIDEO_H */